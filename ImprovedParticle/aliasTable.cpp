@@ -0,0 +1,148 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "aliasTable.h"
+
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+//-----------------------------------------------------------------------------
+// build
+//-----------------------------------------------------------------------------
+void AliasTable::build( const F32 *weights, U32 count )
+{
+	mProbability.setSize( count );
+	mAlias.setSize( count );
+	if( count == 0 )
+		return;
+
+	F64 total = 0.0;
+	for( U32 i = 0; i < count; i++ )
+		total += getMax( weights[i], 0.0f );
+
+	// Scale the weights so the average bucket holds 1
+	Vector<F64> scaled( count );
+	scaled.setSize( count );
+	for( U32 i = 0; i < count; i++ )
+		scaled[i] = ( total > 0.0 ) ? getMax( weights[i], 0.0f ) * count / total : 1.0;
+
+	// Buckets below and above their share. Both lists live in one vector,
+	// small ones grow from the front and large ones from the back.
+	Vector<U32> work( count );
+	work.setSize( count );
+	U32 numSmall = 0;
+	U32 largeStart = count;
+	for( U32 i = 0; i < count; i++ )
+	{
+		if( scaled[i] < 1.0 )
+			work[numSmall++] = i;
+		else
+			work[--largeStart] = i;
+	}
+
+	// Fill every small bucket up with the share of a large one
+	while( numSmall > 0 && largeStart < count )
+	{
+		U32 small = work[--numSmall];
+		U32 large = work[largeStart];
+
+		mProbability[small] = (F32)scaled[small];
+		mAlias[small] = large;
+
+		scaled[large] = ( scaled[large] + scaled[small] ) - 1.0;
+		if( scaled[large] < 1.0 )
+		{
+			// The large bucket is now a small one
+			largeStart++;
+			work[numSmall++] = large;
+		}
+	}
+
+	// What remains is full, up to rounding errors
+	while( largeStart < count )
+	{
+		U32 large = work[largeStart++];
+		mProbability[large] = 1.0f;
+		mAlias[large] = large;
+	}
+	while( numSmall > 0 )
+	{
+		U32 small = work[--numSmall];
+		mProbability[small] = 1.0f;
+		mAlias[small] = small;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// clear
+//-----------------------------------------------------------------------------
+void AliasTable::clear()
+{
+	mProbability.clear();
+	mAlias.clear();
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testAliasTable, bool, ( S32 numWeights, S32 numSamples, F32 tolerance ), ( 50, 1000000, 0.05f ),
+	"@brief Samples an alias table built from random weights and compares how often "
+	"each index was picked with its weight.\n\n"
+	"Some of the weights are zero and one is much larger than the rest, like the "
+	"triangle areas of a mesh with a few huge triangles. The weights and picks use "
+	"a fixed seed.\n\n"
+	"@param numWeights Number of weights.\n"
+	"@param numSamples Number of indices to pick.\n"
+	"@param tolerance Largest allowed relative difference between the share of picks "
+	"and the share of the weight, for indices with at least 1% of the weight.\n"
+	"@return True if the picks match the weights.\n"
+	"@internal")
+{
+	if( numWeights <= 0 || numSamples <= 0 )
+		return false;
+
+	MRandomLCG rand( 0x2c7a );
+	Vector<F32> weights( numWeights );
+	weights.setSize( numWeights );
+	F32 total = 0.0f;
+	for( S32 i = 0; i < numWeights; i++ )
+	{
+		weights[i] = ( i % 7 == 3 ) ? 0.0f : rand.randF( 0.1f, 2.0f );
+		if( i == numWeights / 2 )
+			weights[i] = 40.0f;
+		total += weights[i];
+	}
+
+	AliasTable table;
+	table.build( weights.address(), numWeights );
+
+	Vector<U32> picks( numWeights );
+	picks.setSize( numWeights );
+	dMemset( picks.address(), 0, numWeights * sizeof(U32) );
+	for( S32 i = 0; i < numSamples; i++ )
+		picks[table.sample( rand.randF() )]++;
+
+	F32 maxError = 0.0f;
+	bool zeroPicked = false;
+	for( S32 i = 0; i < numWeights; i++ )
+	{
+		const F32 share = weights[i] / total;
+		if( share == 0.0f )
+			zeroPicked |= picks[i] != 0;
+		else if( share >= 0.01f )
+			maxError = getMax( maxError, mFabs( (F32)picks[i] / numSamples - share ) / share );
+	}
+
+	bool passed = !zeroPicked && maxError <= tolerance;
+	if( passed )
+		Con::printf( "testAliasTable - passed, largest relative difference %g", maxError );
+	else if( zeroPicked )
+		Con::errorf( "testAliasTable - failed, an index with zero weight was picked" );
+	else
+		Con::errorf( "testAliasTable - failed, largest relative difference %g exceeds %g", maxError, tolerance );
+
+	return passed;
+}
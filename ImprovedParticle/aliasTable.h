@@ -0,0 +1,52 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_ALIAS_TABLE
+#define _H_ALIAS_TABLE
+
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+//*****************************************************************************
+// Alias Table
+//
+// Picks an index with a probability proportional to its weight in constant
+// time (Walker's alias method, built with Vose's algorithm). Every index owns
+// one bucket of the table. A bucket holds the probability of keeping its own
+// index and the index it gives the rest of its share to. Sampling picks a
+// bucket and flips one biased coin.
+//*****************************************************************************
+class AliasTable
+{
+public:
+	/// Builds the table from count weights. Negative weights count as zero.
+	/// If all weights are zero every index is equally likely.
+	void build( const F32 *weights, U32 count );
+
+	void clear();
+
+	/// Picks an index from a uniform random number in [0, 1].
+	/// The table must not be empty.
+	U32 sample( F32 random ) const
+	{
+		const U32 count = mProbability.size();
+		F32 x = random * count;
+		U32 bucket = getMin( (U32)x, count - 1 );
+		return ( x - bucket < mProbability[bucket] ) ? bucket : mAlias[bucket];
+	}
+
+	U32 size() const { return mProbability.size(); }
+	bool empty() const { return mProbability.empty(); }
+
+	/// Bytes used by the table.
+	U32 getMemoryUsage() const { return mProbability.size() * ( sizeof(F32) + sizeof(U32) ); }
+
+private:
+	Vector<F32> mProbability;   ///< Chance of keeping the bucket's own index
+	Vector<U32> mAlias;         ///< Index picked otherwise
+};
+
+#endif // _H_ALIAS_TABLE
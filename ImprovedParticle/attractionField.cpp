@@ -0,0 +1,189 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "attractionField.h"
+
+//-----------------------------------------------------------------------------
+// AttractionField
+//-----------------------------------------------------------------------------
+AttractionField::AttractionField()
+{
+	for( U32 i = 0; i < MaxAttractors; i++ )
+	{
+		Attractor &a = mAttractors[i];
+		a.mode = None;
+		a.amount = 0.0f;
+		a.objectID = StringTable->EmptyString();
+		a.offsetString = StringTable->EmptyString();
+		a.offset.zero();
+		a.hasTarget = false;
+		a.target.zero();
+	}
+	mRange = 0.0f;
+}
+
+//-----------------------------------------------------------------------------
+// findObject
+// First check by name then by ID
+//-----------------------------------------------------------------------------
+GameBase* AttractionField::findObject( const char *objectID )
+{
+	if( !objectID || !objectID[0] )
+		return NULL;
+
+	GameBase* GB = dynamic_cast<GameBase*>(Sim::findObject(objectID));
+	if(!GB)
+		GB = dynamic_cast<GameBase*>(Sim::findObject(dAtoi(objectID)));
+	return GB;
+}
+
+//-----------------------------------------------------------------------------
+// setAttractor
+//-----------------------------------------------------------------------------
+void AttractionField::setAttractor( U32 slot, S32 mode, F32 amount, const char *objectID, const char *offset )
+{
+	AssertFatal( slot < MaxAttractors, "AttractionField::setAttractor - slot out of range" );
+	Attractor &a = mAttractors[slot];
+
+	a.mode = mode;
+	a.amount = amount;
+
+	if( !objectID )
+		objectID = "";
+	if( dStrcmp( a.objectID, objectID ) != 0 )
+	{
+		a.objectID = StringTable->insert( objectID );
+		a.object = findObject( a.objectID );
+	}
+
+	if( !offset )
+		offset = "";
+	if( dStrcmp( a.offsetString, offset ) != 0 )
+	{
+		a.offsetString = StringTable->insert( offset );
+		a.offset.zero();
+		dSscanf( a.offsetString, "%g %g %g", &a.offset.x, &a.offset.y, &a.offset.z );
+	}
+
+	a.hasTarget = false;
+}
+
+//-----------------------------------------------------------------------------
+// updateTargets
+//-----------------------------------------------------------------------------
+void AttractionField::updateTargets()
+{
+	for( U32 i = 0; i < MaxAttractors; i++ )
+	{
+		Attractor &a = mAttractors[i];
+		a.hasTarget = false;
+
+		if( a.mode != Attract && a.mode != Repulse )
+			continue;
+
+		if( a.object.isNull() )
+		{
+			a.object = findObject( a.objectID );
+			if( a.object.isNull() )
+				continue;
+		}
+
+		// Rotate the offset into the space of the object
+		Point3F rotated;
+		a.object->getTransform().mulV( a.offset, &rotated );
+		a.target = a.object->getPosition() + rotated;
+		a.hasTarget = true;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// setTarget
+//-----------------------------------------------------------------------------
+void AttractionField::setTarget( U32 slot, const Point3F &target )
+{
+	AssertFatal( slot < MaxAttractors, "AttractionField::setTarget - slot out of range" );
+	mAttractors[slot].target = target;
+	mAttractors[slot].hasTarget = true;
+}
+
+//-----------------------------------------------------------------------------
+// getTargets
+//-----------------------------------------------------------------------------
+U32 AttractionField::getTargets( Point3F *targets ) const
+{
+	U32 mask = 0;
+	for( U32 i = 0; i < MaxAttractors; i++ )
+	{
+		targets[i] = mAttractors[i].target;
+		if( mAttractors[i].hasTarget )
+			mask |= BIT(i);
+	}
+	return mask;
+}
+
+//-----------------------------------------------------------------------------
+// setTargets
+//-----------------------------------------------------------------------------
+void AttractionField::setTargets( U32 mask, const Point3F *targets )
+{
+	for( U32 i = 0; i < MaxAttractors; i++ )
+	{
+		mAttractors[i].target = targets[i];
+		mAttractors[i].hasTarget = ( mask & BIT(i) ) != 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// apply
+// Read more about the attraction algorithm in the docs or on the T3D - CE wiki
+//-----------------------------------------------------------------------------
+void AttractionField::apply( ParticlePool &pool ) const
+{
+	PROFILE_SCOPE(AttractionField_apply);
+
+	const U32 count = pool.size();
+	if( count == 0 )
+		return;
+
+	dMemset( pool.accX, 0, count * sizeof(F32) );
+	dMemset( pool.accY, 0, count * sizeof(F32) );
+	dMemset( pool.accZ, 0, count * sizeof(F32) );
+
+	for( U32 i = 0; i < MaxAttractors; i++ )
+	{
+		const Attractor &a = mAttractors[i];
+		if( !a.hasTarget )
+			continue;
+
+		// Repulsion is attraction in the opposite direction
+		const F32 amount = a.mode == Attract ? a.amount : -a.amount;
+		const F32 tx = a.target.x;
+		const F32 ty = a.target.y;
+		const F32 tz = a.target.z;
+
+		for( U32 idx = 0; idx < count; idx++ )
+		{
+			F32 dx = tx - pool.posX[idx];
+			F32 dy = ty - pool.posY[idx];
+			F32 dz = tz - pool.posZ[idx];
+			F32 lenSquared = dx * dx + dy * dy + dz * dz;
+			if( lenSquared == 0.0f )
+				continue;
+
+			// Particles closer than 1 unit are treated as being 1 unit away
+			F32 len = mSqrt( lenSquared );
+			F32 force = mRange / getMax( len, 1.0f ) - 1.0f;
+			if( force <= 0.0f )
+				continue;
+
+			// Scale the normalized direction by the force
+			F32 scale = force * amount / len;
+			pool.accX[idx] += dx * scale;
+			pool.accY[idx] += dy * scale;
+			pool.accZ[idx] += dz * scale;
+		}
+	}
+}
@@ -0,0 +1,91 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_ATTRACTION_FIELD
+#define _H_ATTRACTION_FIELD
+
+#ifndef _GAMEBASE_H_
+#include "T3D/gameBase/gameBase.h"
+#endif
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+
+//*****************************************************************************
+// Attraction Field
+//
+// The objects that attract or repulse the particles of an emitter.
+// The attractors are set up from the script fields when they change: the
+// object is looked up once and kept as a SimObjectPtr, and the offset string
+// is parsed into a Point3F. Each update the world position of every target
+// is computed once, after which the force on the particles is a tight loop
+// over the pool.
+//*****************************************************************************
+class AttractionField
+{
+public:
+	/// Same as the attrobjectCount of the emitters.
+	enum { MaxAttractors = 2 };
+
+	/// Values of the AttractionMode fields.
+	enum Mode
+	{
+		None = 0,
+		Attract = 1,
+		Repulse = 2,
+	};
+
+	AttractionField();
+
+	/// Sets up an attractor. The object is only looked up again when the
+	/// id changes, and the offset is only parsed when it changes.
+	/// @param   objectID   Name or id of the GameBase object
+	/// @param   offset     "x y z" offset in the object space of the object
+	void setAttractor( U32 slot, S32 mode, F32 amount, const char *objectID, const char *offset );
+
+	/// Range of influence, particles further away than this are not affected.
+	void setRange( F32 range ) { mRange = range; }
+
+	/// Computes the world space targets, call once per update before apply().
+	/// Attractors whose object was deleted are looked up again.
+	void updateTargets();
+
+	/// Points an attractor at a fixed world position until the next
+	/// updateTargets(), for running apply() without the object, like the
+	/// ParticleBenchmark does.
+	void setTarget( U32 slot, const Point3F &target );
+
+	/// Copies the targets of the last update into targets, which holds
+	/// MaxAttractors points, for recording them.
+	/// @return Mask with bit i set if attractor i has a target
+	U32 getTargets( Point3F *targets ) const;
+
+	/// Restores targets returned by getTargets(), for replaying them.
+	void setTargets( U32 mask, const Point3F *targets );
+
+	/// Sets the acceleration of every particle in the pool to the sum of the
+	/// forces of the attractors. Particles with no force get a zero acceleration.
+	void apply( ParticlePool &pool ) const;
+
+private:
+	struct Attractor
+	{
+		S32                    mode;
+		F32                    amount;
+		StringTableEntry       objectID;
+		StringTableEntry       offsetString;
+		Point3F                offset;       ///< Parsed offsetString
+		SimObjectPtr<GameBase> object;
+		bool                   hasTarget;    ///< Set by updateTargets() if the object exists
+		Point3F                target;       ///< World position of object + offset
+	};
+
+	static GameBase* findObject( const char *objectID );
+
+	Attractor mAttractors[MaxAttractors];
+	F32 mRange;
+};
+
+#endif // _H_ATTRACTION_FIELD
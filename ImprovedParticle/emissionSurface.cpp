@@ -0,0 +1,277 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "emissionSurface.h"
+
+#include "ts/tsShapeInstance.h"
+#include "ts/tsMesh.h"
+#include "T3D/shapeBase.h"
+#include "T3D/tsStatic.h"
+
+//-----------------------------------------------------------------------------
+// EmissionSurface
+//-----------------------------------------------------------------------------
+EmissionSurface::EmissionSurface()
+{
+	mObjectID = StringTable->EmptyString();
+	mIsStatic = false;
+	mSkinned = false;
+	mValid = false;
+	mTransform.identity();
+	mScale.set( 1.0f, 1.0f, 1.0f );
+	mPosition.zero();
+}
+
+//-----------------------------------------------------------------------------
+// findShape
+// First check by name then by ID
+//-----------------------------------------------------------------------------
+SceneObject* EmissionSurface::findShape( const char *objectID )
+{
+	if( !objectID || !objectID[0] )
+		return NULL;
+
+	SceneObject* SB = dynamic_cast<SceneObject*>(Sim::findObject(objectID));
+	if(!SB)
+		SB = dynamic_cast<SceneObject*>(Sim::findObject(dAtoi(objectID)));
+
+	// Only shapes have meshes to emit from
+	if( dynamic_cast<ShapeBase*>(SB) || dynamic_cast<TSStatic*>(SB) )
+		return SB;
+	return NULL;
+}
+
+//-----------------------------------------------------------------------------
+// clear
+//-----------------------------------------------------------------------------
+void EmissionSurface::clear()
+{
+	mObject = NULL;
+	mIsStatic = false;
+	mSkinned = false;
+	mValid = false;
+	mMeshes.clear();
+	mSources.clear();
+	mPositions.clear();
+	mNormals.clear();
+	mTriangles.clear();
+	mMeshPrims.clear();
+	mPrims.clear();
+	mAreaSampler.clear();
+}
+
+//-----------------------------------------------------------------------------
+// build
+// If the shape has skinned meshes only those are used, so a shape is never
+// emitted from partly skinned and partly static.
+//-----------------------------------------------------------------------------
+void EmissionSurface::build( const char *objectID )
+{
+	clear();
+	mObjectID = StringTable->insert( objectID ? objectID : "" );
+
+	SceneObject *obj = findShape( mObjectID );
+	if( !obj )
+		return;
+
+	ShapeBase *shapeBase = dynamic_cast<ShapeBase*>(obj);
+	TSStatic *tsStatic = dynamic_cast<TSStatic*>(obj);
+	TSShapeInstance *shapeInst = shapeBase ? shapeBase->getShapeInstance() : tsStatic->getShapeInstance();
+	if( !shapeInst )
+		return;
+	const TSShape *shape = shapeInst->getShape();
+
+	mObject = obj;
+	mIsStatic = (tsStatic != NULL);
+
+	for( S32 meshIndex = 0; meshIndex < shape->meshes.size(); meshIndex++ )
+	{
+		const TSSkinMesh *sMesh = dynamic_cast<const TSSkinMesh*>(shape->meshes[meshIndex]);
+		if( sMesh && sMesh->mVertexData.size() )
+		{
+			mSkinned = true;
+			break;
+		}
+	}
+
+	const Point3F scale = obj->getScale();
+	Vector<F32> areas;
+
+	for( S32 meshIndex = 0; meshIndex < shape->meshes.size(); meshIndex++ )
+	{
+		const TSMesh *mesh = shape->meshes[meshIndex];
+		if( !mesh || !mesh->mVertexData.size() )
+			continue;
+		if( mSkinned && !dynamic_cast<const TSSkinMesh*>(mesh) )
+			continue;
+
+		// The vertices of this mesh
+		const U32 meshSlot = mMeshes.size();
+		const U32 firstVertex = mSources.size();
+		const U32 numVerts = mesh->mVertexData.size();
+		mMeshes.push_back( mesh );
+		for( U32 v = 0; v < numVerts; v++ )
+		{
+			Source src;
+			src.mesh = meshSlot;
+			src.vertex = v;
+			mSources.push_back( src );
+			if( !mSkinned )
+			{
+				mPositions.push_back( mesh->mVertexData[v].vert() );
+				mNormals.push_back( mesh->mVertexData[v].normal() );
+			}
+		}
+
+		// The triangles of this mesh
+		Range meshPrims;
+		meshPrims.first = mPrims.size();
+		for( S32 primIndex = 0; primIndex < mesh->primitives.size(); primIndex++ )
+		{
+			const TSDrawPrimitive &prim = mesh->primitives[primIndex];
+			if( (prim.matIndex & TSDrawPrimitive::TypeMask) != TSDrawPrimitive::Triangles )
+				continue;
+
+			Range primTris;
+			primTris.first = mTriangles.size() / 3;
+			for( S32 i = 0; i + 2 < prim.numElements; i += 3 )
+			{
+				U32 idx[3];
+				for( U32 c = 0; c < 3; c++ )
+				{
+					idx[c] = mesh->indices[prim.start + i + c];
+					mTriangles.push_back( firstVertex + idx[c] );
+				}
+
+				Point3F p1 = mesh->mVertexData[idx[0]].vert() * scale;
+				Point3F p2 = mesh->mVertexData[idx[1]].vert() * scale;
+				Point3F p3 = mesh->mVertexData[idx[2]].vert() * scale;
+				F32 area = mCross( p2 - p1, p3 - p1 ).len() * 0.5f;
+				areas.push_back( mIsNaN_F(area) ? 0.0f : area );
+			}
+			primTris.count = mTriangles.size() / 3 - primTris.first;
+			if( primTris.count )
+				mPrims.push_back( primTris );
+		}
+		meshPrims.count = mPrims.size() - meshPrims.first;
+		if( meshPrims.count )
+			mMeshPrims.push_back( meshPrims );
+	}
+
+	mAreaSampler.build( areas.address(), areas.size() );
+	update();
+}
+
+//-----------------------------------------------------------------------------
+// update
+//-----------------------------------------------------------------------------
+bool EmissionSurface::update()
+{
+	mValid = false;
+	if( mObject.isNull() )
+	{
+		// The object may not have existed, or not been ghosted, when the
+		// surface was built.
+		if( !findShape( mObjectID ) )
+			return false;
+		build( mObjectID );
+		return mValid;
+	}
+
+	if( mIsStatic )
+	{
+		TSStatic *tsStatic = static_cast<TSStatic*>( (SceneObject*)mObject );
+		mTransform.mul( tsStatic->getTransform(), tsStatic->getShapeInstance()->mNodeTransforms[0] );
+		mScale = tsStatic->getScale();
+	}
+	else
+	{
+		mTransform = mObject->getTransform();
+		mScale.set( 1.0f, 1.0f, 1.0f );
+	}
+	mPosition = mObject->getPosition();
+
+	mValid = mSources.size() > 0;
+	return mValid;
+}
+
+//-----------------------------------------------------------------------------
+// getVertex
+//-----------------------------------------------------------------------------
+void EmissionSurface::getVertex( U32 idx, Point3F &pos, Point3F &normal ) const
+{
+	if( mSkinned )
+	{
+		const Source &src = mSources[idx];
+		const TSMesh *mesh = mMeshes[src.mesh];
+		pos = mesh->mVertexData[src.vertex].vert();
+		normal = mesh->mVertexData[src.vertex].normal();
+	}
+	else
+	{
+		pos = mPositions[idx];
+		normal = mNormals[idx];
+	}
+}
+
+//-----------------------------------------------------------------------------
+// pickTriangle
+//-----------------------------------------------------------------------------
+U32 EmissionSurface::pickTriangle( F32 randomMesh, F32 randomPrim, F32 randomTri ) const
+{
+	const U32 numMeshes = mMeshPrims.size();
+	const Range &meshPrims = mMeshPrims[ getMin( (U32)(randomMesh * numMeshes), numMeshes - 1 ) ];
+	const Range &prim = mPrims[ meshPrims.first + getMin( (U32)(randomPrim * meshPrims.count), meshPrims.count - 1 ) ];
+	return prim.first + getMin( (U32)(randomTri * prim.count), prim.count - 1 );
+}
+
+//-----------------------------------------------------------------------------
+// getTrianglePoint
+// A point in the parallelogram spanned by two edges, mirrored into the
+// triangle if it falls outside of it. This gives an even spread.
+//-----------------------------------------------------------------------------
+void EmissionSurface::getTrianglePoint( U32 tri, F32 a, F32 b, Point3F &pos, Point3F &normal ) const
+{
+	Point3F p1, p2, p3;
+	Point3F n1, n2, n3;
+	getVertex( mTriangles[tri * 3], p1, n1 );
+	getVertex( mTriangles[tri * 3 + 1], p2, n2 );
+	getVertex( mTriangles[tri * 3 + 2], p3, n3 );
+
+	if( a + b > 1.0f )
+	{
+		a = 1.0f - a;
+		b = 1.0f - b;
+	}
+	pos = p1 + (p2 - p1) * a + (p3 - p1) * b;
+
+	normal = n1 + n2 + n3;
+	normal.normalizeSafe();
+}
+
+//-----------------------------------------------------------------------------
+// toWorld
+//-----------------------------------------------------------------------------
+void EmissionSurface::toWorld( const Point3F &objPos, const Point3F &objNormal, Point3F &offset, Point3F &normal ) const
+{
+	mTransform.mulV( objPos * mScale, &offset );
+	mTransform.mulV( objNormal, &normal );
+}
+
+//-----------------------------------------------------------------------------
+// getMemoryUsage
+//-----------------------------------------------------------------------------
+U32 EmissionSurface::getMemoryUsage() const
+{
+	return mMeshes.size() * sizeof(const TSMesh*) +
+		mSources.size() * sizeof(Source) +
+		mPositions.size() * sizeof(Point3F) +
+		mNormals.size() * sizeof(Point3F) +
+		mTriangles.size() * sizeof(U32) +
+		mMeshPrims.size() * sizeof(Range) +
+		mPrims.size() * sizeof(Range) +
+		mAreaSampler.getMemoryUsage();
+}
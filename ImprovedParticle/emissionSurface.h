@@ -0,0 +1,119 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_EMISSION_SURFACE
+#define _H_EMISSION_SURFACE
+
+#ifndef _SCENEOBJECT_H_
+#include "scene/sceneObject.h"
+#endif
+#ifndef _H_ALIAS_TABLE
+#include "aliasTable.h"
+#endif
+
+class TSMesh;
+
+//*****************************************************************************
+// Emission Surface
+//
+// The vertices and triangles a MeshEmitter emits from, gathered once when
+// the emitMesh changes. The meshes of the shape are flattened into one
+// vertex array and one triangle array, so picking an emission point is an
+// index into contiguous arrays. The object is kept as a SimObjectPtr and its
+// transform is read once per update.
+// Skinned meshes are animated, so their vertices are read from the mesh when
+// they are used instead of being copied.
+//*****************************************************************************
+class EmissionSurface
+{
+public:
+	EmissionSurface();
+
+	/// Looks up the ShapeBase or TSStatic and gathers its meshes.
+	/// @param   objectID   Name or id of the object
+	void build( const char *objectID );
+
+	void clear();
+
+	/// Reads the transform of the object, call once per update before
+	/// emitting. The object is looked up again if it didn't exist yet.
+	/// @return  False if there is nothing to emit from.
+	bool update();
+
+	/// True if the last update() found something to emit from.
+	bool isValid() const { return mValid; }
+
+	/// The object emitted from, NULL if it isn't ghosted yet.
+	SceneObject* getObject() const { return mObject; }
+
+	U32 getVertexCount() const { return mSources.size(); }
+	U32 getTriangleCount() const { return mTriangles.size() / 3; }
+
+	/// Object space position and normal of a vertex.
+	void getVertex( U32 idx, Point3F &pos, Point3F &normal ) const;
+
+	/// Picks a triangle with a probability proportional to its area.
+	U32 pickTriangleByArea( F32 random ) const { return mAreaSampler.sample( random ); }
+
+	/// Picks a random mesh, then a random primitive of it and then a random
+	/// triangle of that, small triangles are picked as often as large ones.
+	U32 pickTriangle( F32 randomMesh, F32 randomPrim, F32 randomTri ) const;
+
+	/// Object space position of a point inside a triangle, given by two
+	/// random numbers in [0, 1], and the normal of the triangle.
+	void getTrianglePoint( U32 tri, F32 a, F32 b, Point3F &pos, Point3F &normal ) const;
+
+	/// Turns an object space position and normal into an offset from the
+	/// object position and a world space normal.
+	void toWorld( const Point3F &objPos, const Point3F &objNormal, Point3F &offset, Point3F &normal ) const;
+
+	/// World position of the object, as of the last update().
+	const Point3F& getPosition() const { return mPosition; }
+
+	/// Bytes used by the arrays.
+	U32 getMemoryUsage() const;
+
+private:
+	struct Range
+	{
+		U32 first;
+		U32 count;
+	};
+
+	/// Where a vertex came from.
+	struct Source
+	{
+		U32 mesh;      ///< Index into mMeshes
+		U32 vertex;    ///< Index into the mVertexData of the mesh
+	};
+
+	static SceneObject* findShape( const char *objectID );
+
+	StringTableEntry mObjectID;
+	SimObjectPtr<SceneObject> mObject;
+	bool mIsStatic;                 ///< The object is a TSStatic, not a ShapeBase
+	bool mSkinned;                  ///< The vertices are read from mMeshes
+	bool mValid;
+
+	Vector<const TSMesh*> mMeshes;
+	Vector<Source> mSources;
+	Vector<Point3F> mPositions;     ///< Object space vertex positions, unless mSkinned
+	Vector<Point3F> mNormals;       ///< Object space vertex normals, unless mSkinned
+	Vector<U32> mTriangles;         ///< 3 vertex indices per triangle
+
+	Vector<Range> mMeshPrims;       ///< Range of mPrims per mesh with triangles
+	Vector<Range> mPrims;           ///< Range of triangles per triangle primitive
+	AliasTable mAreaSampler;
+
+	/// @name Transform
+	/// Read by update().
+	/// @{
+	MatrixF mTransform;
+	Point3F mScale;
+	Point3F mPosition;
+	/// @}
+};
+
+#endif // _H_EMISSION_SURFACE
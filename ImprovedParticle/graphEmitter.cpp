@@ -5,11 +5,16 @@
 
 #include "platform/platform.h"
 #include "graphEmitter.h"
+#include "particleIntegrator.h"
+#include "particleCapacity.h"
+#include "particleCamera.h"
 
 #include "scene/sceneManager.h"
 #include "scene/sceneRenderState.h"
 #include "console/consoleTypes.h"
 #include "core/stream/bitStream.h"
+#include "core/stream/fileStream.h"
+#include "core/stream/memStream.h"
 #include "core/strings/stringUnit.h"
 #include "math/mRandom.h"
 #include "gfx/gfxDevice.h"
@@ -20,9 +25,6 @@
 #include "lighting/lightInfo.h"
 #include "console/engineAPI.h"
 
-#if defined(TORQUE_OS_XENON)
-#  include "gfx/D3D9/360/gfx360MemVertexBuffer.h"
-#endif
 
 Point3F GraphEmitter::mWindVelocity( 0.0, 0.0, 0.0 );
 const F32 GraphEmitter::AgedSpinToRadians = (1.0f/1000.0f) * (1.0f/360.0f) * M_PI_F * 2.0f;
@@ -86,6 +88,16 @@ static const float sgDefaultEjectionOffset = 0.f;
 static const float sgDefaultPhiReferenceVel = 0.f;
 static const float sgDefaultPhiVariance = 360.f;
 
+// The object box is padded by BoundsPadding of the size of the particle
+// bounds, at least MinBoundsPadding, and only refit when the particles leave
+// it or their padded bounds shrink below BoundsShrinkRatio of it.
+static const F32 BoundsPadding = 0.25f;
+static const F32 MinBoundsPadding = 0.5f;
+static const F32 BoundsShrinkRatio = 0.5f;
+
+// Particles per chunk when the vertices of an emitter are filled in parallel.
+static const U32 VertexFillChunk = 1024;
+
 //-----------------------------------------------------------------------------
 // GraphEmitterData
 //-----------------------------------------------------------------------------
@@ -120,12 +132,17 @@ GraphEmitterData::GraphEmitterData()
 	useEmitterColors = false;
 	particleString   = NULL;
 	partListInitSize = 0;
+	maxPartLifeMS = 0;
 
 	// These members added for support of user defined blend factors
 	// and optional particle sorting.
 	blendStyle = ParticleRenderInst::BlendUndefined;
 	sortParticles = false;
 	renderReflection = true;
+	budgetPriority = 0;
+	fixedStepMS = 0;
+	randomSeed = 0;
+	batchCollision = false;
 	reverseOrder = false;
 	textureName = 0;
 	textureHandle = 0;
@@ -255,9 +272,57 @@ void GraphEmitterData::initPersistFields()
 	addField( "renderReflection", TYPEID< bool >(), Offset(renderReflection, GraphEmitterData),
 		"Controls whether particles are rendered onto reflective surfaces like water." );
 
+	addField( "batchCollision", TYPEID< bool >(), Offset(batchCollision, GraphEmitterData),
+		"If true, the collision polygons around the particles are gathered once per update "
+		"and the particles are collided against those, instead of casting a ray per particle. "
+		"Faster for emitters with many particles." );
+
 	//@}
 
 	endGroup( "GraphEmitterData" );
+
+	addGroup( "LOD" );
+
+	addField( "lodDistance", TYPEID< F32 >(), Offset(lodBands.distance, GraphEmitterData), ParticleLOD::MaxBands,
+		"Distance from the camera each detail band starts at, in increasing order. Closer "
+		"than the first band the emitter runs at full detail, bands left at 0 are unused." );
+
+	addField( "lodEjectionRate", TYPEID< F32 >(), Offset(lodBands.ejectionRate, GraphEmitterData), ParticleLOD::MaxBands,
+		"Fraction of the particles ejected at the distance of each band, from 0.01 to 1. "
+		"The rate is blended between the bands, starting from 1 at the camera." );
+
+	addField( "lodMaxParticles", TYPEID< S32 >(), Offset(lodBands.maxParticles, GraphEmitterData), ParticleLOD::MaxBands,
+		"Most particles alive at once in each band, 0 for no limit. No particles are "
+		"ejected while the emitter is at the limit." );
+
+	addField( "lodTickInterval", TYPEID< S32 >(), Offset(lodBands.tickInterval, GraphEmitterData), ParticleLOD::MaxBands,
+		"The particles are simulated every this many frames in each band, from 1 to 8." );
+
+	addField( "lodSortDistance", TYPEID< F32 >(), Offset(lodBands.sortDistance, GraphEmitterData),
+		"Beyond this distance the particles are not sorted, 0 to always sort them." );
+
+	addField( "lodCollisionDistance", TYPEID< F32 >(), Offset(lodBands.collisionDistance, GraphEmitterData),
+		"Beyond this distance the particles don't collide, 0 to always collide them." );
+
+	endGroup( "LOD" );
+
+	addField( "budgetPriority", TYPEID< S32 >(), Offset(budgetPriority, GraphEmitterData),
+		"When the particles of all the emitters are over the budget set with "
+		"setParticleBudget(), emitters with a lower priority stop spawning first, "
+		"and distant emitters first within a priority." );
+
+	addGroup( "Deterministic" );
+
+	addField( "fixedStepMS", TYPEID< S32 >(), Offset(fixedStepMS, GraphEmitterData),
+		"Simulate the particles in steps of this many milliseconds, whatever the frame "
+		"rate, so the same inputs always give the same particles. The emitters are "
+		"left out of the LOD and the particle budget. 0 to simulate once per frame." );
+
+	addField( "randomSeed", TYPEID< S32 >(), Offset(randomSeed, GraphEmitterData),
+		"Seed of the random numbers of the emitters, which then all emit the same "
+		"particles. 0 to seed each emitter randomly." );
+
+	endGroup( "Deterministic" );
    /*
     addField( "Sticky", TYPEID< bool >(), Offset(sticky, GraphEmitterData),
     "If true then bla." );*/
@@ -323,6 +388,12 @@ void GraphEmitterData::packData(BitStream* stream)
 	}
 	stream->writeFlag(highResOnly);
 	stream->writeFlag(renderReflection);
+	stream->writeFlag(batchCollision);
+	lodBands.pack( stream );
+	stream->write( budgetPriority );
+	if( stream->writeFlag( fixedStepMS > 0 ) )
+		stream->writeInt( fixedStepMS, 10 );
+	stream->write( randomSeed );
 #ifndef GA_BITCOUNT_OPTIMIZATION
 	stream->writeInt( blendStyle, 4 );
 #else
@@ -386,6 +457,11 @@ void GraphEmitterData::unpackData(BitStream* stream)
 	}
 	highResOnly = stream->readFlag();
 	renderReflection = stream->readFlag();
+	batchCollision = stream->readFlag();
+	lodBands.unpack( stream );
+	stream->read( &budgetPriority );
+	fixedStepMS = stream->readFlag() ? stream->readInt( 10 ) : 0;
+	stream->read( &randomSeed );
 #ifndef GA_BITCOUNT_OPTIMIZATION
 	blendStyle = stream->readInt( 4 );
 #else
@@ -491,6 +567,11 @@ bool GraphEmitterData::onAdd()
 		Con::warnf(ConsoleLogEntry::General, "GraphEmitterData(%s) lifetimeVarianceMS >= lifetimeMS", getName());
 		lifetimeVarianceMS = lifetimeMS;
 	}
+	if( fixedStepMS < 0 || fixedStepMS > 500 )
+	{
+		Con::warnf(ConsoleLogEntry::General, "GraphEmitterData(%s) fixedStepMS not in [0, 500]", getName());
+		fixedStepMS = mClamp( fixedStepMS, 0, 500 );
+	}
 
 
 	// load the particle datablocks...
@@ -547,6 +628,8 @@ bool GraphEmitterData::onAdd()
 		}
 	}
 
+	lodBands.validate( "GraphEmitterData", getName() );
+
 	return true;
 }
 
@@ -614,70 +697,28 @@ bool GraphEmitterData::preload(bool server, String &errorStr)
 
 	if( !server )
 	{
-		allocPrimBuffer();
+		calcPartListInitSize();
+
+		// Bake the colors and sizes of the particles over their age
+		keyCurves.setSize( particleDataBlocks.size() );
+		for( S32 i = 0; i < particleDataBlocks.size(); i++ )
+			keyCurves[i].bake( particleDataBlocks[i] );
 	}
 
 	return true;
 }
 
 //-----------------------------------------------------------------------------
-// alloc PrimitiveBuffer
-// The datablock allocates this static index buffer because it's the same
-// for all of the emitters - each particle quad uses the same index ordering
+// calcPartListInitSize
+// The number of particles the emitters reserve room for at the emission rate
+// of the datablock, the most particles that can be alive at once.
 //-----------------------------------------------------------------------------
-void GraphEmitterData::allocPrimBuffer( S32 overrideSize )
+void GraphEmitterData::calcPartListInitSize()
 {
 	// calculate particle list size
 	AssertFatal(particleDataBlocks.size() > 0, "Error, no particles found." );
-	U32 maxPartLife = particleDataBlocks[0]->lifetimeMS + particleDataBlocks[0]->lifetimeVarianceMS;
-	for (S32 i = 1; i < particleDataBlocks.size(); i++)
-	{
-		U32 mpl = particleDataBlocks[i]->lifetimeMS + particleDataBlocks[i]->lifetimeVarianceMS;
-		if (mpl > maxPartLife)
-			maxPartLife = mpl;
-	}
-
-	partListInitSize = maxPartLife / (ejectionPeriodMS - periodVarianceMS);
-	partListInitSize += 8; // add 8 as "fudge factor" to make sure it doesn't realloc if it goes over by 1
-
-	// if override size is specified, then the emitter overran its buffer and needs a larger allocation
-	if( overrideSize != -1 )
-	{
-		partListInitSize = overrideSize;
-	}
-
-	// create index buffer based on that size
-	U32 indexListSize = partListInitSize * 6; // 6 indices per particle
-	U16 *indices = new U16[ indexListSize ];
-
-	for( U32 i=0; i<partListInitSize; i++ )
-	{
-		// this index ordering should be optimal (hopefully) for the vertex cache
-		U16 *idx = &indices[i*6];
-		volatile U32 offset = i * 4;  // set to volatile to fix VC6 Release mode compiler bug
-		idx[0] = 0 + offset;
-		idx[1] = 1 + offset;
-		idx[2] = 3 + offset;
-		idx[3] = 1 + offset;
-		idx[4] = 3 + offset;
-		idx[5] = 2 + offset;
-	}
-
-
-	U16 *ibIndices;
-	GFXBufferType bufferType = GFXBufferTypeStatic;
-
-#ifdef TORQUE_OS_XENON
-	// Because of the way the volatile buffers work on Xenon this is the only
-	// way to do this.
-	bufferType = GFXBufferTypeVolatile;
-#endif
-	primBuff.set( GFX, indexListSize, 0, bufferType );
-	primBuff.lock( &ibIndices );
-	dMemcpy( ibIndices, indices, indexListSize * sizeof(U16) );
-	primBuff.unlock();
-
-	delete [] indices;
+	maxPartLifeMS = ParticleCapacity::getMaxLifetime(particleDataBlocks);
+	partListInitSize = ParticleCapacity::estimate(maxPartLifeMS, ejectionPeriodMS, periodVarianceMS);
 }
 
 
@@ -692,19 +733,36 @@ GraphEmitter::GraphEmitter()
 	mInternalClock    = 0;
 	mNextParticleTime = 0;
 
+	mUpdateMS    = 0;
+	mUpdateCount = 0;
+
+	mCapacityPeriodMS   = 0;
+	mCapacityVarianceMS = 0;
+
+	mPartBounds = Box3F::Invalid;
+	mMaxPartSize = 0.0f;
+	mNumBoundsUpdates = 0;
+
+	mKeyCurvesDirty = true;
+
 	mLastPosition.set(0, 0, 0);
 	mHasLastPosition = false;
 
 	mLifetimeMS = 0;
 	mElapsedTimeMS = 0;
-
-	part_store = 0;
-	part_freelist = NULL;
-	part_list_head.next = NULL;
-	n_part_capacity = 0;
-	n_parts = 0;
-
-	mCurBuffSize = 0;
+	oldTime = 0;
+
+	mStepTime = 0.0f;
+	mStepPoint.zero();
+	mStepAxis.set(0, 0, 1);
+	mStepVelocity.zero();
+	mStepTransform.identity();
+	mHasStepEmit = false;
+	mNodeTransform = NULL;
+	mReplaying = false;
+	mReplayTerrain = NULL;
+	mIsRecording = false;
+	mRecordNodeProgress = false;
 
 	mDead = false;
 
@@ -715,7 +773,10 @@ GraphEmitter::GraphEmitter()
    attractionrange = 50;
    for(int i = 0; i < attrobjectCount; i++)
    {
-	   //Attraction_offset[i].setSize(255);
+	   AttractionMode[i] = 0;
+	   Amount[i] = 1;
+	   Attraction_offset[i] = "0 0 0";
+	   attractedObjectID[i] = "";
    }
 }
 
@@ -724,10 +785,6 @@ GraphEmitter::GraphEmitter()
 //-----------------------------------------------------------------------------
 GraphEmitter::~GraphEmitter()
 {
-	for( S32 i = 0; i < part_store.size(); i++ )
-	{
-		delete [] part_store[i];
-	}
 }
 
 //-----------------------------------------------------------------------------
@@ -752,6 +809,10 @@ bool GraphEmitter::onAdd()
 
 	removeFromProcessList();
 
+	// Deterministic emitters aren't throttled
+	if( mDataBlock->fixedStepMS == 0 )
+		mBudget.registerClient();
+
 	F32 radius = 5.0;
 	mObjBox.minExtents = Point3F(-radius, -radius, -radius);
 	mObjBox.maxExtents = Point3F(radius, radius, radius);
@@ -766,6 +827,8 @@ bool GraphEmitter::onAdd()
 //-----------------------------------------------------------------------------
 void GraphEmitter::onRemove()
 {
+	ParticleJobScheduler::cancel( this );
+	mBudget.unregisterClient();
 	removeFromScene();
 	Parent::onRemove();
 }
@@ -780,38 +843,36 @@ bool GraphEmitter::onNewDataBlock( GameBaseData *dptr, bool reload )
 	if ( !mDataBlock || !Parent::onNewDataBlock( dptr, reload ) )
 		return false;
 
+	mBudget.setPriority( mDataBlock->budgetPriority );
+	if( mDataBlock->fixedStepMS > 0 )
+		mBudget.unregisterClient();
+	else if( isProperlyAdded() )
+		mBudget.registerClient();
+
+	// Without a seed every emitter gets its own sequence
+	mRandom.setSeed( mDataBlock->randomSeed != 0 ? U32( mDataBlock->randomSeed ) : gRandGen.randI() );
+
 	mLifetimeMS = mDataBlock->lifetimeMS;
 	if( mDataBlock->lifetimeVarianceMS )
 	{
-		mLifetimeMS += S32( gRandGen.randI() % (2 * mDataBlock->lifetimeVarianceMS + 1)) - S32(mDataBlock->lifetimeVarianceMS );
+		mLifetimeMS += S32( mRandom.randI() % (2 * mDataBlock->lifetimeVarianceMS + 1)) - S32(mDataBlock->lifetimeVarianceMS );
 	}
 
-	//   Allocate particle structures and init the freelist. Member part_store
-	//   is a Vector so that we can allocate more particles if partListInitSize
-	//   turns out to be too small. 
+	//   Allocate the particle pool for the emission rate of the datablock.
+	//   The pool grows if the rate is overridden or partListInitSize turns
+	//   out to be too small.
 	//
 	if (mDataBlock->partListInitSize > 0)
 	{
-		for( S32 i = 0; i < part_store.size(); i++ )
-		{
-			delete [] part_store[i];
-		}
-		part_store.clear();
-		n_part_capacity = mDataBlock->partListInitSize;
-		Particle* store_block = new Particle[n_part_capacity];
-		part_store.push_back(store_block);
-		part_freelist = store_block;
-		Particle* last_part = part_freelist;
-		Particle* part = last_part+1;
-		for( S32 i = 1; i < n_part_capacity; i++, part++, last_part++ )
-		{
-			last_part->next = part;
-		}
-		store_block[n_part_capacity-1].next = NULL;
-		part_list_head.next = NULL;
-		n_parts = 0;
+		mParts.reset();
+		reserveParticles(mDataBlock->partListInitSize);
+		mCapacityPeriodMS = mDataBlock->ejectionPeriodMS;
+		mCapacityVarianceMS = mDataBlock->periodVarianceMS;
 	}
 
+	mKeyCurves.clear();
+	mKeyCurvesDirty = true;
+
 	scriptOnNewDataBlock();
 	return true;
 }
@@ -824,10 +885,10 @@ ColorF GraphEmitter::getCollectiveColor()
 	U32 count = 0;
 	ColorF color = ColorF(0.0f, 0.0f, 0.0f);
 
-	count = n_parts;
-	for( Particle* part = part_list_head.next; part != NULL; part = part->next )
+	count = mParts.size();
+	for( U32 i = 0; i < count; i++ )
 	{
-		color += part->color;
+		color += mParts.color[i];
 	}
 
 	if(count > 0)
@@ -857,53 +918,67 @@ void GraphEmitter::prepRenderImage(SceneRenderState* state)
 	PROFILE_SCOPE(GraphEmitter_prepRenderImage);
 
 	if (  mDead ||
-		n_parts == 0 || 
-		part_list_head.next == NULL )
+		mParts.empty() )
 		return;
 
 	RenderPassManager *renderManager = state->getRenderPass();
 	const Point3F &camPos = state->getCameraPosition();
 	copyToVB( camPos, state->getAmbientLightColor() );
 
-	if (!mVertBuff.isValid())
+	if (mVertBuffs.empty())
 		return;
 
-	ParticleRenderInst *ri = renderManager->allocInst<ParticleRenderInst>();
-
-	ri->vertBuff = &mVertBuff;
-	ri->primBuff = &getDataBlock()->primBuff;
-	ri->translucentSort = true;
-	ri->type = RenderPassManager::RIT_Particle;
-	ri->sortDistSq = getRenderWorldBox().getSqDistanceToPoint( camPos );
-
-	// Draw the system offscreen unless the highResOnly flag is set on the datablock
-	ri->systemState = ( getDataBlock()->highResOnly ? PSS_AwaitingHighResDraw : PSS_AwaitingOffscreenDraw );
-
-	ri->modelViewProj = renderManager->allocUniqueXform(  GFX->getProjectionMatrix() * 
+	const MatrixF *modelViewProj = renderManager->allocUniqueXform(  GFX->getProjectionMatrix() * 
 		GFX->getViewMatrix() * 
 		GFX->getWorldMatrix() );
 
 	// Update position on the matrix before multiplying it
 	mBBObjToWorld.setPosition(mLastPosition);
 
-	ri->bbModelViewProj = renderManager->allocUniqueXform( *ri->modelViewProj * mBBObjToWorld );
-
-	ri->count = n_parts;
-
-	ri->blendStyle = mDataBlock->blendStyle;
+	const MatrixF *bbModelViewProj = renderManager->allocUniqueXform( *modelViewProj * mBBObjToWorld );
 
 	// use first particle's texture unless there is an emitter texture to override it
+	GFXTextureObject *diffuseTex;
 	if (mDataBlock->textureHandle)
-		ri->diffuseTex = &*(mDataBlock->textureHandle);
+		diffuseTex = &*(mDataBlock->textureHandle);
 	else
-		ri->diffuseTex = &*(part_list_head.next->dataBlock->textureHandle);
+		diffuseTex = &*(mParts.dataBlock[0]->textureHandle);
+
+	const F32 sortDistSq = getRenderWorldBox().getSqDistanceToPoint( camPos );
+	const F32 batchSortBias = getMax( sortDistSq * 0.0001f, 0.001f );
+	const U32 numBatches = mVertBuffs.size();
+
+	// One render instance per batch, all drawing with the same quad indices.
+	for (U32 batch = 0; batch < numBatches; batch++)
+	{
+		ParticleRenderInst *ri = renderManager->allocInst<ParticleRenderInst>();
+
+		ri->vertBuff = mVertBuffs[batch];
+		ri->translucentSort = true;
+		ri->type = RenderPassManager::RIT_Particle;
+
+		// The earlier batches hold the farther particles when sorted, push
+		// them back a little so they are drawn first.
+		ri->sortDistSq = sortDistSq + batchSortBias * (numBatches - 1 - batch);
+
+		// Draw the system offscreen unless the highResOnly flag is set on the datablock
+		ri->systemState = ( getDataBlock()->highResOnly ? PSS_AwaitingHighResDraw : PSS_AwaitingOffscreenDraw );
+
+		ri->modelViewProj = modelViewProj;
+		ri->bbModelViewProj = bbModelViewProj;
 
-	ri->softnessDistance = mDataBlock->softnessDistance; 
+		ri->count = getMin( mParts.size() - batch * ParticleBufferPool::MaxBatchQuads, (U32)ParticleBufferPool::MaxBatchQuads );
+		ri->primBuff = ParticleBufferPool::getQuadIndices(ri->count);
 
-	// Sort by texture too.
-	ri->defaultKey = ri->diffuseTex ? (U32)ri->diffuseTex : (U32)ri->vertBuff;
+		ri->blendStyle = mDataBlock->blendStyle;
+		ri->diffuseTex = diffuseTex;
+		ri->softnessDistance = mDataBlock->softnessDistance; 
 
-	renderManager->addInst( ri );
+		// Sort by texture too.
+		ri->defaultKey = ri->diffuseTex ? (U32)ri->diffuseTex : (U32)ri->vertBuff;
+
+		renderManager->addInst( ri );
+	}
 
 }
 
@@ -916,6 +991,7 @@ void GraphEmitter::setSizes( F32 *sizeList )
 	{
 		sizes[i] = sizeList[i];
 	}
+	mKeyCurvesDirty = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -927,6 +1003,7 @@ void GraphEmitter::setColors( ColorF *colorList )
 	{
 		colors[i] = colorList[i];
 	}
+	mKeyCurvesDirty = true;
 }
 
 //-----------------------------------------------------------------------------
@@ -947,7 +1024,7 @@ void GraphEmitter::deleteWhenEmpty()
 	if (okToDelete)
 	{
 		mDeleteWhenEmpty = true;
-		if( !n_parts )
+		if( mParts.empty() )
 		{
 			// We're already empty, so delete us now.
 
@@ -1001,9 +1078,49 @@ void GraphEmitter::emitParticles(const Point3F& start,
 {
 	if( mDead ) return;
 
+	// Deterministic emitters emit after each of their steps instead, the
+	// node's last emission is kept for them, see advanceSteps()
+	if( mDataBlock->fixedStepMS > 0 )
+	{
+		mStepNode = node;
+		mStepPoint = end;
+		mStepAxis = axis;
+		mStepVelocity = velocity;
+		mStepTransform = node->getTransform();
+		mHasStepEmit = true;
+
+		// The steps run in advanceTime, so the emitter must tick before
+		// it has any particles
+		if( getSceneManager() == NULL )
+		{
+			gClientSceneGraph->addObjectToScene(this);
+			ClientProcessList::get()->addObject(this);
+		}
+		return;
+	}
+
+	emitNodeParticles( start, end, axis, velocity, numMilliseconds, node );
+}
+
+//-----------------------------------------------------------------------------
+// emitNodeParticles
+//-----------------------------------------------------------------------------
+void GraphEmitter::emitNodeParticles(const Point3F& start,
+	const Point3F& end,
+	const Point3F& axis,
+	const Point3F& velocity,
+	const U32      numMilliseconds,
+	GraphEmitterNode* node)
+{
+	if( mDead ) return;
+
 	if( mDataBlock->particleDataBlocks.empty() )
 		return;
 
+	// Stand alone emitters eject at the rate of the node
+	if( node->standAloneEmitter )
+		updateCapacity( node->sa_ejectionPeriodMS, node->sa_periodVarianceMS );
+
 	// lifetime over - no more particles
 	if( mLifetimeMS > 0 && mElapsedTimeMS > mLifetimeMS )
 	{
@@ -1012,6 +1129,7 @@ void GraphEmitter::emitParticles(const Point3F& start,
 
 	U32 currTime = 0;
 	bool particlesAdded = false;
+	const U32 firstNewPart = mParts.size();
 
 	Point3F axisx;
 	if( mFabs(axis.z) < 0.9f )
@@ -1042,12 +1160,15 @@ void GraphEmitter::emitParticles(const Point3F& start,
 			mInternalClock += mNextParticleTime;
 			// Emit particle at curr time
 
-			// Create particle at the correct position
-			Point3F pos;
-			pos.interpolate(start, end, F32(currTime) / F32(numMilliseconds));
-			// Also send the node on addParticle
-			addParticle(pos, axis, velocity, axisx, node);
-			particlesAdded = true;
+			if( mLOD.canAdd( mParts.size() ) && mBudget.trySpawn() )
+			{
+				// Create particle at the correct position
+				Point3F pos;
+				pos.interpolate(start, end, F32(currTime) / F32(numMilliseconds));
+				// Also send the node on addParticle
+				addParticle(pos, axis, velocity, axisx, node);
+				particlesAdded = true;
+			}
 			mNextParticleTime = 0;
 		}
 	}
@@ -1061,7 +1182,7 @@ void GraphEmitter::emitParticles(const Point3F& start,
 			nextTime = node->sa_ejectionPeriodMS;
 			if( node->sa_periodVarianceMS != 0 )
 			{
-				nextTime += S32(gRandGen.randI() % (2 * node->sa_periodVarianceMS + 1)) -
+				nextTime += S32(mRandom.randI() % (2 * node->sa_periodVarianceMS + 1)) -
 					S32(node->sa_periodVarianceMS);
 			}
 		}
@@ -1070,10 +1191,12 @@ void GraphEmitter::emitParticles(const Point3F& start,
 			nextTime = mDataBlock->ejectionPeriodMS;
 			if( mDataBlock->periodVarianceMS != 0 )
 			{
-				nextTime += S32(gRandGen.randI() % (2 * mDataBlock->periodVarianceMS + 1)) -
+				nextTime += S32(mRandom.randI() % (2 * mDataBlock->periodVarianceMS + 1)) -
 					S32(mDataBlock->periodVarianceMS);
 			}
 		}
+		// Distant emitters eject fewer particles
+		nextTime = mLOD.scalePeriod( nextTime );
 		AssertFatal(nextTime > 0, "Error, next particle ejection time must always be greater than 0");
 
 		if( currTime + nextTime > numMilliseconds )
@@ -1087,44 +1210,53 @@ void GraphEmitter::emitParticles(const Point3F& start,
 		currTime       += nextTime;
 		mInternalClock += nextTime;
 
+		// Distant emitters hold back new particles while at their limit, and
+		// all emitters while over the budget
+		if( !mLOD.canAdd( mParts.size() ) || !mBudget.trySpawn() )
+			continue;
+
 		// Create particle at the correct position
 		Point3F pos;
 		pos.interpolate(start, end, F32(currTime) / F32(numMilliseconds));
+		U32 prevParts = mParts.size();
 		// Sent the node aswell here
 		addParticle(pos, axis, velocity, axisx, node);
 		particlesAdded = true;
 
 		//   This override-advance code is restored in order to correctly adjust
 		//   animated parameters of particles allocated within the same frame
-		//   update. Note that ordering is important and this code correctly 
-		//   adds particles in the same newest-to-oldest ordering of the link-list.
+		//   update.
 		//
-		// NOTE: We are assuming that the just added particle is at the head of our
-		//  list.  If that changes, so must this...
+		// NOTE: New particles are always appended to the pool, so the just added
+		//  particle is the last one.  If that changes, so must this...
 		U32 advanceMS = numMilliseconds - currTime;
-		if (mDataBlock->overrideAdvance == false && advanceMS != 0) 
+		if (mDataBlock->overrideAdvance == false && advanceMS != 0 && mParts.size() > prevParts) 
 		{
-			Particle* last_part = part_list_head.next;
-			if (advanceMS > last_part->totalLifetime) 
+			U32 last_part = mParts.size() - 1;
+			// The new particle is also the last one waiting for its position
+			PendingParticle &pending = mPendingParts.last();
+			if (advanceMS > mParts.totalLifetime[last_part]) 
 			{
-				part_list_head.next = last_part->next;
-				n_parts--;
-				last_part->next = part_freelist;
-				part_freelist = last_part;
+				mParts.kill(last_part);
+				mPendingParts.pop_back();
 			} 
 			else 
 			{
 				if (advanceMS != 0)
 				{
 					F32 t = F32(advanceMS) / 1000.0;
+					const ParticleData *partDB = mParts.dataBlock[last_part];
 
-					Point3F a = last_part->acc;
-					a -= last_part->vel * last_part->dataBlock->dragCoefficient;
-					a -= mWindVelocity * last_part->dataBlock->windCoefficient;
-					a += Point3F(0.0f, 0.0f, -9.81f) * last_part->dataBlock->gravityCoefficient;
+					Point3F vel = mParts.getVel(last_part);
+					Point3F a = mParts.getAcc(last_part);
+					a -= vel * partDB->dragCoefficient;
+					a -= mWindVelocity * partDB->windCoefficient;
+					a += Point3F(0.0f, 0.0f, -9.81f) * partDB->gravityCoefficient;
 
-					last_part->vel += a * t;
-					last_part->pos += last_part->vel * t;
+					vel += a * t;
+					mParts.setVel(last_part, vel);
+					// The position is advanced once it is known
+					pending.advance = t;
 
 					updateKeyData( last_part );
 				}
@@ -1132,12 +1264,16 @@ void GraphEmitter::emitParticles(const Point3F& start,
 		}
 	}
 
-	// DMMFIX: Lame and slow...
-	if( particlesAdded == true )
-		updateBBox();
+	flushExpressionBatch( node, getTerrainCache( node ) );
 
+	if( particlesAdded == true )
+	{
+		extendBounds( firstNewPart );
+		updateBounds();
+	}
 
-	if( n_parts > 0 && getSceneManager() == NULL )
+	// Replays run on emitters that aren't registered
+	if( !mParts.empty() && getSceneManager() == NULL && isProperlyAdded() )
 	{
 		gClientSceneGraph->addObjectToScene(this);
 		ClientProcessList::get()->addObject(this);
@@ -1191,9 +1327,11 @@ void GraphEmitter::emitParticles(const Point3F& rCenter,
 	// particles within the hemisphere.
 	for( S32 i = 0; i < count; i++ )
 	{
-		Point3F pos = axisx * (radius * (1 - (2 * gRandGen.randF())));
-		pos        += axisy * (radius * (1 - (2 * gRandGen.randF())));
-		pos        += axisz * (radius * gRandGen.randF());
+		F32 randoms[3];
+		mRandom.fill( randoms, 3 );
+		Point3F pos = axisx * (radius * (1 - (2 * randoms[0])));
+		pos        += axisy * (radius * (1 - (2 * randoms[1])));
+		pos        += axisz * (radius * randoms[2]);
 
 		Point3F axis = pos;
 		axis.normalize();
@@ -1208,7 +1346,7 @@ void GraphEmitter::emitParticles(const Point3F& rCenter,
 	resetWorldBox();
 
 	// Make sure we're part of the world
-	if( n_parts > 0 && getSceneManager() == NULL )
+	if( !mParts.empty() && getSceneManager() == NULL )
 	{
 		gClientSceneGraph->addObjectToScene(this);
 		ClientProcessList::get()->addObject(this);
@@ -1218,23 +1356,42 @@ void GraphEmitter::emitParticles(const Point3F& rCenter,
 }
 
 //-----------------------------------------------------------------------------
-// updateBBox - SLOW, bad news
+// extendBounds
 //-----------------------------------------------------------------------------
-void GraphEmitter::updateBBox()
+void GraphEmitter::extendBounds( U32 first )
 {
-	Point3F minPt(1e10,   1e10,  1e10);
-	Point3F maxPt(-1e10, -1e10, -1e10);
-
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	for (U32 i = first; i < mParts.size(); i++)
 	{
-		Point3F particleSize(part->size * 0.5f, 0.0f, part->size * 0.5f);
-		minPt.setMin( part->pos - particleSize );
-		maxPt.setMax( part->pos + particleSize );
+		mPartBounds.extend( mParts.getPos(i) );
+		mMaxPartSize = getMax( mMaxPartSize, mParts.partSize[i] );
 	}
+}
 
-	mObjBox = Box3F(minPt, maxPt);
+//-----------------------------------------------------------------------------
+// updateBounds
+// Setting the transform moves the emitter in the scene container, so the
+// box is padded and kept while it still holds the particles.
+//-----------------------------------------------------------------------------
+void GraphEmitter::updateBounds()
+{
+	if( mParts.empty() || !mPartBounds.isValidBox() )
+		return;
+
+	// The particles are drawn as quads around their positions
+	const Point3F halfSize( mMaxPartSize * 0.5f );
+	const Box3F partBox( mPartBounds.minExtents - halfSize, mPartBounds.maxExtents + halfSize );
+
+	Point3F padding = partBox.getExtents() * BoundsPadding;
+	padding.setMax( Point3F( MinBoundsPadding ) );
+	const Box3F paddedBox( partBox.minExtents - padding, partBox.maxExtents + padding );
+
+	if( mObjBox.isContained( partBox ) && paddedBox.len() >= mObjBox.len() * BoundsShrinkRatio )
+		return;
+
+	mObjBox = paddedBox;
 	MatrixF temp = getTransform();
 	setTransform(temp);
+	mNumBoundsUpdates++;
 
 	mBBObjToWorld.identity();
 	Point3F boxScale = mObjBox.getExtents();
@@ -1253,33 +1410,26 @@ void GraphEmitter::addParticle(const Point3F& pos,
 	const Point3F& axisx)
 {
 	Con::errorf("Unproper!");
-	n_parts++;
-	if (n_parts > n_part_capacity || n_parts > mDataBlock->partListInitSize)
-	{
-		// In an emergency we allocate additional particles in blocks of 16.
-		// This should happen rarely.
-		Particle* store_block = new Particle[16];
-		part_store.push_back(store_block);
-		n_part_capacity += 16;
-		for (S32 i = 0; i < 16; i++)
-		{
-			store_block[i].next = part_freelist;
-			part_freelist = &store_block[i];
-		}
-		mDataBlock->allocPrimBuffer(n_part_capacity); // allocate larger primitive buffer or will crash 
-	}
-	Particle* pNew = part_freelist;
-	part_freelist = pNew->next;
-	pNew->next = part_list_head.next;
-	part_list_head.next = pNew;
+	// In an emergency the pool grows geometrically.
+	// This should happen rarely.
+	if (mParts.size() >= mParts.capacity())
+		growParticles();
+	// The particle is built here and copied into the pool once initialized
+	Particle part;
+	part.relPos.zero();
 
 	Point3F ejectionAxis = axis;
 
-	F32 theta = (mDataBlock->thetaMax - mDataBlock->thetaMin) * gRandGen.randF() +
+	// The numbers of the spawn are drawn at once: theta, phi, the velocity
+	//  - and the datablock
+	F32 randoms[4];
+	mRandom.fill( randoms, 4 );
+
+	F32 theta = (mDataBlock->thetaMax - mDataBlock->thetaMin) * randoms[0] +
 		mDataBlock->thetaMin;
 
 	F32 ref  = (F32(mInternalClock) / 1000.0) * mDataBlock->phiReferenceVel;
-	F32 phi  = ref + gRandGen.randF() * mDataBlock->phiVariance;
+	F32 phi  = ref + randoms[1] * mDataBlock->phiVariance;
 
 	// Both phi and theta are in degs.  Create axis angles out of them, and create the
 	//  appropriate rotation matrix...
@@ -1293,18 +1443,19 @@ void GraphEmitter::addParticle(const Point3F& pos,
 	temp.mulP(ejectionAxis);
 
 	F32 initialVel = mDataBlock->ejectionVelocity;
-	initialVel    += (mDataBlock->velocityVariance * 2.0f * gRandGen.randF()) - mDataBlock->velocityVariance;
+	initialVel    += (mDataBlock->velocityVariance * 2.0f * randoms[2]) - mDataBlock->velocityVariance;
 
-	pNew->pos = pos + (ejectionAxis * mDataBlock->ejectionOffset);
-	pNew->vel = ejectionAxis * initialVel;
-	pNew->orientDir = ejectionAxis;
-	pNew->acc.set(0, 0, 0);
-	pNew->currentAge = 0;
+	part.pos = pos + (ejectionAxis * mDataBlock->ejectionOffset);
+	part.vel = ejectionAxis * initialVel;
+	part.orientDir = ejectionAxis;
+	part.acc.set(0, 0, 0);
+	part.currentAge = 0;
 
 	// Choose a new particle datablack randomly from the list
-	U32 dBlockIndex = gRandGen.randI() % mDataBlock->particleDataBlocks.size();
-	mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(pNew, vel);
-	updateKeyData( pNew );
+	U32 dBlockIndex = ParticleRandom::toIndex( randoms[3], mDataBlock->particleDataBlocks.size() );
+	mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(&part, vel);
+	mRandom.randomizeParticle( mDataBlock->particleDataBlocks[dBlockIndex], part );
+	updateKeyData( mParts.add(part) );
 
 }
 
@@ -1314,45 +1465,37 @@ void GraphEmitter::addParticle(const Point3F& pos,
 	const Point3F& axisx,
 	GraphEmitterNode* nodeDat)
 {
-	n_parts++;
-	if (n_parts > n_part_capacity || n_parts > mDataBlock->partListInitSize)
-	{
-		// In an emergency we allocate additional particles in blocks of 16.
-		// This should happen rarely.
-		Particle* store_block = new Particle[16];
-		part_store.push_back(store_block);
-		n_part_capacity += 16;
-		for (S32 i = 0; i < 16; i++)
-		{
-			store_block[i].next = part_freelist;
-			part_freelist = &store_block[i];
-		}
-		mDataBlock->allocPrimBuffer(n_part_capacity); // allocate larger primitive buffer or will crash 
-	}
-	Particle* pNew = part_freelist;
-	part_freelist = pNew->next;
-	pNew->next = part_list_head.next;
-	part_list_head.next = pNew;
+	// In an emergency the pool grows geometrically.
+	// This should happen rarely.
+	if (mParts.size() >= mParts.capacity())
+		growParticles();
+	// The particle is built here and copied into the pool once initialized
+	Particle part;
+	part.relPos.zero();
 
 
 	Point3F ejectionAxis = axis;
 	F32 ref;
 	F32 phi;
 	F32 theta;
+	// The numbers of the spawn are drawn at once: theta, phi, the velocity
+	//  - and the datablock
+	F32 randoms[4];
+	mRandom.fill( randoms, 4 );
 	// If it is a standAloneEmitter, then we want it to use the sa values from the node
 	if(nodeDat->standAloneEmitter)
 	{
-		theta = (nodeDat->sa_thetaMax - nodeDat->sa_thetaMin) * gRandGen.randF() +
+		theta = (nodeDat->sa_thetaMax - nodeDat->sa_thetaMin) * randoms[0] +
 			nodeDat->sa_thetaMin;
 		ref  = (F32(mInternalClock) / 1000.0) * nodeDat->sa_phiReferenceVel;
-		phi  = ref + gRandGen.randF() * nodeDat->sa_phiVariance;
+		phi  = ref + randoms[1] * nodeDat->sa_phiVariance;
 	}
 	else{
-		theta = (mDataBlock->thetaMax - mDataBlock->thetaMin) * gRandGen.randF() +
+		theta = (mDataBlock->thetaMax - mDataBlock->thetaMin) * randoms[0] +
 			mDataBlock->thetaMin;
 
 		ref  = (F32(mInternalClock) / 1000.0) * mDataBlock->phiReferenceVel;
-		phi  = ref + gRandGen.randF() * mDataBlock->phiVariance;
+		phi  = ref + randoms[1] * mDataBlock->phiVariance;
 	}
 
 	// Both phi and theta are in degs.  Create axis angles out of them, and create the
@@ -1370,37 +1513,44 @@ void GraphEmitter::addParticle(const Point3F& pos,
 	if(nodeDat->standAloneEmitter)
 	{
 		initialVel = nodeDat->sa_ejectionVelocity;
-		initialVel    += (nodeDat->sa_velocityVariance * 2.0f * gRandGen.randF()) - nodeDat->sa_velocityVariance;
+		initialVel    += (nodeDat->sa_velocityVariance * 2.0f * randoms[2]) - nodeDat->sa_velocityVariance;
 	}
 	else
 	{
 		initialVel = mDataBlock->ejectionVelocity;
-		initialVel    += (mDataBlock->velocityVariance * 2.0f * gRandGen.randF()) - mDataBlock->velocityVariance;
+		initialVel    += (mDataBlock->velocityVariance * 2.0f * randoms[2]) - mDataBlock->velocityVariance;
 	}
 	// If it is a standAloneEmitter, then we want it to use the sa values from the node
 	if(nodeDat->standAloneEmitter)
-		pNew->pos = pos + (ejectionAxis * nodeDat->sa_ejectionOffset);
+		part.pos = pos + (ejectionAxis * nodeDat->sa_ejectionOffset);
 	else
-		pNew->pos = pos + (ejectionAxis * mDataBlock->ejectionOffset);
+		part.pos = pos + (ejectionAxis * mDataBlock->ejectionOffset);
 	if(!nodeDat->currentlyShuttingDown())
 	{
 		// Set the time since this code was last run
 		U32 dt = mInternalClock - oldTime;
 		oldTime = mInternalClock;
 
+		// The boundary callbacks may change the expressions, so the
+		//  - particles waiting for the current expressions are placed first.
+		if(nodeDat->particleProg > nodeDat->funcMax || nodeDat->particleProg < nodeDat->funcMin)
+			flushExpressionBatch(nodeDat, getTerrainCache(nodeDat));
+
 		// Did we hit the upper limit?
 		if(nodeDat->particleProg > nodeDat->funcMax)
 		{
 			if(nodeDat->Loop)
 				nodeDat->particleProg = nodeDat->funcMin;
-			nodeDat->onBoundaryLimit(true);
+			if( !mReplaying )
+				nodeDat->onBoundaryLimit(true);
 		}
 		// Did we hit the lower limit?
 		if(nodeDat->particleProg < nodeDat->funcMin)
 		{
 			if(nodeDat->Loop)
 				nodeDat->particleProg = nodeDat->funcMax;
-			nodeDat->onBoundaryLimit(false);
+			if( !mReplaying )
+				nodeDat->onBoundaryLimit(false);
 		}
 		// We don't want to risk dividing by zero.
 		//  - We don't care too much about accuracy, so whatever is close to zero is fine.
@@ -1409,45 +1559,9 @@ void GraphEmitter::addParticle(const Point3F& pos,
 			nodeDat->particleProg = F32_MIN;
 		}
 
-		F32 resultx = 0;
-		F32 resulty = 0;
-		F32 resultz = 0;
-		// Get the transform of the node to get the rotation matrix
-		MatrixF trans = nodeDat->getTransform();
-		// Evaluate the expressions and get the results.
-		try{
-			resultx = nodeDat->xfuncParser.Eval();
-			resulty = nodeDat->yfuncParser.Eval();
-			Point3F parserPos = Point3F(resultx, resulty, 0);
-			trans.mulV(parserPos);
-			parserPos *= nodeDat->sa_ejectionOffset;
-			nodeDat->parserX = pos.x+parserPos.x;
-			nodeDat->parserY = pos.y+parserPos.y;
-			nodeDat->TerZ = nodeDat->TerrainZ(nodeDat->parserX, nodeDat->parserY);
-			resultz = nodeDat->zfuncParser.Eval();
-		}
-		catch(mu::Parser::exception_type &e)
-		{
-			std::string expr = e.GetExpr();
-			std::string tok = e.GetToken();
-			size_t pos = e.GetPos();
-			std::string msg = e.GetMsg();
-			Con::errorf("Parsing error! Failed to parse: \n %s\nAt token: %s\nAt position: %u\nMessage: %s",expr.c_str(),tok.c_str(),pos,msg.c_str());
-		}
-		// Construct a vector from the 3 results
-		const Point3F *funcPos = new const Point3F(resultx, resulty, resultz);
-
-		// Rotate our point by the rotation matrix
-		const Point3F* p = rotate(trans, *funcPos);
-		// Add the position of the node to get coordinates in object space
-		//  - and set the position of the new particle.
-		pNew->pos = pos + (*p * nodeDat->sa_ejectionOffset);
-
-	   pNew->relPos = *p * nodeDat->sa_ejectionOffset;
-	   //pNew->parent = *nodeDat;
-
-	   delete(funcPos);
-	   delete(p);
+		// The expressions are evaluated for the whole batch of particles in
+		//  - flushExpressionBatch, remember the value of t for this particle.
+		F32 particleT = nodeDat->particleProg;
 
 		// Increment the t value based on the progressmode
 		if(nodeDat->ProgressMode == gProgressMode::byParticleCount){
@@ -1464,25 +1578,176 @@ void GraphEmitter::addParticle(const Point3F& pos,
 		}
 	   parentNodePos = pos;
 
-		pNew->vel = ejectionAxis * initialVel;
-		pNew->orientDir = ejectionAxis;
-		pNew->acc.set(0, 0, 0);
-		pNew->currentAge = 0;
+		part.vel = ejectionAxis * initialVel;
+		part.orientDir = ejectionAxis;
+		part.acc.set(0, 0, 0);
+		part.currentAge = 0;
 
 		// Choose a new particle datablack randomly from the list
-		U32 dBlockIndex = gRandGen.randI() % mDataBlock->particleDataBlocks.size();
-		mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(pNew, vel);
-		updateKeyData( pNew );
+		U32 dBlockIndex = ParticleRandom::toIndex( randoms[3], mDataBlock->particleDataBlocks.size() );
+		mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(&part, vel);
+		mRandom.randomizeParticle( mDataBlock->particleDataBlocks[dBlockIndex], part );
+		U32 idx = mParts.add(part);
+		updateKeyData( idx );
+
+		// The particle stays at the emission point until the batch is flushed
+		mPendingParts.increment();
+		PendingParticle &pending = mPendingParts.last();
+		pending.idx = idx;
+		pending.pos = pos;
+		pending.t = particleT;
+		pending.advance = 0;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// reserveParticles
+// Everything a new particle is written to grows here, so adding particles
+// doesn't allocate until the emitter has more particles than ever before.
+//-----------------------------------------------------------------------------
+void GraphEmitter::reserveParticles( U32 count )
+{
+	if( count > mParts.capacity() )
+	{
+		mParts.reserve( count );
+		mPendingParts.reserve( count );
+		mBatchT.reserve( count );
+		mBatchX.reserve( count );
+		mBatchY.reserve( count );
+		mBatchZ.reserve( count );
+		mBatchPartX.reserve( count );
+		mBatchPartY.reserve( count );
+		mBatchTerZ.reserve( count );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// updateCapacity
+//-----------------------------------------------------------------------------
+void GraphEmitter::updateCapacity( S32 periodMS, S32 varianceMS )
+{
+	if( periodMS == mCapacityPeriodMS && varianceMS == mCapacityVarianceMS )
+		return;
+
+	mCapacityPeriodMS = periodMS;
+	mCapacityVarianceMS = varianceMS;
+	reserveParticles( ParticleCapacity::estimate( mDataBlock->maxPartLifeMS, periodMS, varianceMS ) );
+}
+
+//-----------------------------------------------------------------------------
+// growParticles
+//-----------------------------------------------------------------------------
+void GraphEmitter::growParticles()
+{
+	const U32 oldCapacity = mParts.capacity();
+	reserveParticles( ParticleCapacity::grow( oldCapacity ) );
+	ParticleCapacity::recordGrowth( this, oldCapacity, mParts.capacity() );
+}
+
+//-----------------------------------------------------------------------------
+// flushExpressionBatch
+//-----------------------------------------------------------------------------
+void GraphEmitter::flushExpressionBatch( GraphEmitterNode* nodeDat, TerrainHeightCache &terrain )
+{
+	const U32 count = mPendingParts.size();
+	if( count == 0 )
+		return;
+
+	PROFILE_SCOPE(GraphEmitter_flushExpressionBatch);
+
+	mBatchT.setSize(count);
+	mBatchX.setSize(count);
+	mBatchY.setSize(count);
+	mBatchZ.setSize(count);
+	mBatchPartX.setSize(count);
+	mBatchPartY.setSize(count);
+	mBatchTerZ.setSize(count);
+	for( U32 i = 0; i < count; i++ )
+	{
+		mBatchT[i] = mPendingParts[i].t;
+		mBatchX[i] = 0;
+		mBatchY[i] = 0;
+		mBatchZ[i] = 0;
+	}
+
+	// Get the transform of the node to get the rotation matrix, the steps
+	//  - of the deterministic mode carry the one the node had.
+	const MatrixF trans = mNodeTransform ? *mNodeTransform : nodeDat->getTransform();
+	// Evaluate the expressions and get the results.
+	try{
+		mu::SBatchVar tVar = { &nodeDat->particleProg, mBatchT.address() };
+		nodeDat->xfuncParser.Eval(mBatchX.address(), count, &tVar, 1);
+		nodeDat->yfuncParser.Eval(mBatchY.address(), count, &tVar, 1);
+
+		for( U32 i = 0; i < count; i++ )
+		{
+			Point3F parserPos = Point3F(mBatchX[i], mBatchY[i], 0);
+			trans.mulV(parserPos);
+			parserPos *= nodeDat->sa_ejectionOffset;
+			mBatchPartX[i] = mPendingParts[i].pos.x+parserPos.x;
+			mBatchPartY[i] = mPendingParts[i].pos.y+parserPos.y;
+		}
+		// Leave the variables as the last particle left them
+		nodeDat->parserX = mBatchPartX.last();
+		nodeDat->parserY = mBatchPartY.last();
+
+		// The z expression can use the terrain height below the particle,
+		// only look it up if it does.
+		U32 numZVars = 3;
+		if( nodeDat->zfuncParser.IsVarUsed(&nodeDat->TerZ) )
+		{
+			const Point3F nodePos = trans.getPosition();
+			terrain.update(nodePos);
+			for( U32 i = 0; i < count; i++ )
+				mBatchTerZ[i] = terrain.getHeight(mBatchPartX[i], mBatchPartY[i]) - nodePos.z;
+			nodeDat->TerZ = mBatchTerZ.last();
+			numZVars = 4;
+		}
+
+		mu::SBatchVar zVars[] = {
+			{ &nodeDat->particleProg, mBatchT.address() },
+			{ &nodeDat->parserX, mBatchPartX.address() },
+			{ &nodeDat->parserY, mBatchPartY.address() },
+			{ &nodeDat->TerZ, mBatchTerZ.address() },
+		};
+		nodeDat->zfuncParser.Eval(mBatchZ.address(), count, zVars, numZVars);
+	}
+	catch(mu::Parser::exception_type &e)
+	{
+		std::string expr = e.GetExpr();
+		std::string tok = e.GetToken();
+		size_t pos = e.GetPos();
+		std::string msg = e.GetMsg();
+		Con::errorf("Parsing error! Failed to parse: \n %s\nAt token: %s\nAt position: %u\nMessage: %s",expr.c_str(),tok.c_str(),pos,msg.c_str());
+	}
+
+	for( U32 i = 0; i < count; i++ )
+	{
+		const PendingParticle &pending = mPendingParts[i];
+
+		// Rotate our point by the rotation matrix
+		Point3F p = rotate(trans, Point3F(mBatchX[i], mBatchY[i], mBatchZ[i]));
+		// Add the position of the node to get coordinates in object space
+		//  - and set the position of the new particle.
+		Point3F relPos = p * nodeDat->sa_ejectionOffset;
+		Point3F partPos = pending.pos + relPos;
+		if( pending.advance != 0 )
+			partPos += mParts.getVel(pending.idx) * pending.advance;
+
+		mParts.setPos(pending.idx, partPos);
+		mParts.relPos[pending.idx] = relPos;
 	}
+
+	mPendingParts.clear();
 }
 
 // Rotate a point based on a rotation matrix
-Point3F* GraphEmitter::rotate(MatrixF trans, Point3F p)
+Point3F GraphEmitter::rotate(const MatrixF &trans, const Point3F &p)
 {
-	Point3F* r = new Point3F();
-	r->x = p.x * trans[0] + p.y * trans[1] + p.z * trans[2];
-	r->y = p.x * trans[4] + p.y * trans[5] + p.z * trans[6];
-	r->z = p.x * trans[8] + p.y * trans[9] + p.z * trans[10];
+	Point3F r;
+	r.x = p.x * trans[0] + p.y * trans[1] + p.z * trans[2];
+	r.y = p.x * trans[4] + p.y * trans[5] + p.z * trans[6];
+	r.z = p.x * trans[8] + p.y * trans[9] + p.z * trans[10];
 	return r;
 }
 
@@ -1513,454 +1778,597 @@ void GraphEmitter::advanceTime(F32 dt)
 
 	if( mDead ) return;
 
+	if( mDataBlock->fixedStepMS > 0 )
+	{
+		advanceSteps( dt );
+		return;
+	}
+
 	mElapsedTimeMS += (S32)(dt * 1000.0f);
 
 	U32 numMSToUpdate = (U32)(dt * 1000.0f);
 	if( numMSToUpdate == 0 ) return;
 
-	// TODO: Prefetch
+	// The update from the last call is still queued if no frame was
+	// rendered since then
+	if( isQueued() )
+		ParticleJobScheduler::flush();
 
-	// remove dead particles
-	Particle* last_part = &part_list_head;
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	updateLOD();
+	mBudget.report( mParts.size(), mLOD.getDistance() );
+
+	if (mParts.empty())
 	{
-		part->currentAge += numMSToUpdate;
-		if (part->currentAge > part->totalLifetime)
-		{
-			n_parts--;
-			last_part->next = part->next;
-			part->next = part_freelist;
-			part_freelist = part;
-			part = last_part;
-		}
-		else
-		{
-			last_part = part;
-		}
+		if (mDeleteWhenEmpty)
+			mDeleteOnTick = true;
+		return;
 	}
 
-	AssertFatal( n_parts >= 0, "GraphEmitter: negative part count!" );
+	// Distant emitters simulate their particles every few frames
+	U32 numToUpdate = mParts.size();
+	if( !mLOD.advanceFrame( numMSToUpdate, numToUpdate ) )
+		return;
+
+	// The update runs in the next flush of the ParticleJobScheduler, which
+	// can't look up objects, so the attractors are found now
+	mAttraction.updateTargets();
+	mUpdateMS = numMSToUpdate;
+	mUpdateCount = numToUpdate;
+	ParticleJobScheduler::queue( this );
+}
 
-	if (n_parts < 1 && mDeleteWhenEmpty)
+//-----------------------------------------------------------------------------
+// updateLOD
+//-----------------------------------------------------------------------------
+void GraphEmitter::updateLOD()
+{
+	const ParticleCamera *camera = ParticleCamera::get();
+	if( !camera )
 	{
-		mDeleteOnTick = true;
+		mLOD.reset();
 		return;
 	}
 
-	if( numMSToUpdate != 0 && n_parts > 0 )
-	{
-		update( numMSToUpdate );
-	}
+	// The distance to the particles, or to where they are emitted from
+	// before there are any
+	const Point3F &camPos = camera->getPosition();
+	if( !mParts.empty() )
+		mLOD.update( mDataBlock->lodBands, getWorldBox().getDistanceToPoint( camPos ) );
+	else if( mHasLastPosition )
+		mLOD.update( mDataBlock->lodBands, ( mLastPosition - camPos ).len() );
+	else
+		mLOD.reset();
 }
 
 //-----------------------------------------------------------------------------
-// Update key related particle data
+// advanceSteps
+// The frame time is run in whole steps and the rest is carried over to the
+// next frame. The last emission of the node and the attractor targets of the
+// frame are the inputs of every step in it.
 //-----------------------------------------------------------------------------
-void GraphEmitter::updateKeyData( Particle *part )
+void GraphEmitter::advanceSteps( F32 dt )
 {
-	//Ensure that our lifetime is never below 0
-	if( part->totalLifetime < 1 )
-		part->totalLifetime = 1;
+	// Queued before the datablock switched to fixed steps
+	if( isQueued() )
+		ParticleJobScheduler::flush();
 
-	F32 t = F32(part->currentAge) / F32(part->totalLifetime);
-	AssertFatal(t <= 1.0f, "Out out bounds filter function for particle.");
+	// Always at full detail, the LOD depends on the camera
+	mLOD.reset();
 
-	for( U32 i = 1; i < ParticleData::PDC_NUM_KEYS; i++ )
-	{
-		if( part->dataBlock->times[i] >= t )
-		{
-			F32 firstPart = t - part->dataBlock->times[i-1];
-			F32 total     = part->dataBlock->times[i] -
-				part->dataBlock->times[i-1];
+	const U32 stepMS = mDataBlock->fixedStepMS;
+	const F32 stepTime = F32(stepMS) / 1000.0f;
+	mStepTime += dt;
+	if( mStepTime < stepTime )
+		return;
 
-			firstPart /= total;
+	GraphEmitterNode *node = mHasStepEmit ? (GraphEmitterNode*)mStepNode : NULL;
+	mHasStepEmit = false;
 
-			if( mDataBlock->useEmitterColors )
-			{
-				part->color.interpolate(colors[i-1], colors[i], firstPart);
-			}
-			else
-			{
-				part->color.interpolate(part->dataBlock->colors[i-1],
-					part->dataBlock->colors[i],
-					firstPart);
-			}
+	ParticleRecording::Step step;
+	step.stepMS = stepMS;
+	step.emitMS = node ? U32( stepMS * node->getTimeMultiple() ) : 0;
+	step.point = mStepPoint;
+	step.axis = mStepAxis;
+	step.velocity = mStepVelocity;
+	step.transform = mStepTransform;
+	step.checksum = 0;
 
-			if( mDataBlock->useEmitterSizes )
-			{
-				part->size = (sizes[i-1] * (1.0 - firstPart)) +
-					(sizes[i]   * firstPart);
-			}
-			else
-			{
-				part->size = (part->dataBlock->sizes[i-1] * (1.0 - firstPart)) +
-					(part->dataBlock->sizes[i]   * firstPart);
-			}
-			break;
+	mAttraction.updateTargets();
+	step.targetMask = mAttraction.getTargets( step.targets );
+
+	// The t value before the first particle of the recording
+	if( mIsRecording && mRecordNodeProgress && node )
+	{
+		mRecording.nodeProgress = node->particleProg;
+		mRecordNodeProgress = false;
+	}
 
+	while( mStepTime >= stepTime )
+	{
+		mStepTime -= stepTime;
+		runStep( step, node );
+
+		if( mIsRecording )
+		{
+			step.checksum = ParticleRecording::checksum( mParts );
+			mRecording.steps.push_back( step );
 		}
 	}
+
+	if( mParts.empty() && mDeleteWhenEmpty )
+		mDeleteOnTick = true;
 }
 
 //-----------------------------------------------------------------------------
-// Update particles
+// runStep
 //-----------------------------------------------------------------------------
-void GraphEmitter::update( U32 ms )
+void GraphEmitter::runStep( const ParticleRecording::Step &step, GraphEmitterNode *node )
 {
-	// TODO: Prefetch
+	mElapsedTimeMS += step.stepMS;
+	mAttraction.setTargets( step.targetMask, step.targets );
+
+	// The passes of the queued update, run here and now
+	if( !mParts.empty() )
+	{
+		mUpdateMS = step.stepMS;
+		mUpdateCount = mParts.size();
+		simulateForces();
+		simulateCollision();
+		simulateMotion();
+		finishSimulation();
+	}
 
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	if( node && step.emitMS > 0 )
 	{
-		F32 t = F32(ms) / 1000.0;
+		mNodeTransform = &step.transform;
+		emitNodeParticles( step.point, step.point, step.axis, step.velocity, step.emitMS, node );
+		mNodeTransform = NULL;
+	}
+}
 
-		if(AttractionMode > 0)
+//-----------------------------------------------------------------------------
+// startRecording
+//-----------------------------------------------------------------------------
+bool GraphEmitter::startRecording()
+{
+	if( mDataBlock->fixedStepMS == 0 )
+	{
+		Con::errorf( "GraphEmitter::startRecording - the datablock of %s has no fixedStepMS", getIdString() );
+		return false;
+	}
+
+	// Start over from the seed, so the recording holds everything the
+	// particles depend on
+	mParts.clear();
+	mPendingParts.clear();
+	mPartBounds = Box3F::Invalid;
+	mMaxPartSize = 0.0f;
+	mInternalClock = 0;
+	oldTime = 0;
+	mNextParticleTime = 0;
+	mElapsedTimeMS = 0;
+	mStepTime = 0.0f;
+	mRandom.setSeed( mRandom.getSeed() );
+
+	mRecording.clear();
+	mRecording.seed = mRandom.getSeed();
+	mRecording.lifetimeMS = mLifetimeMS;
+	mRecordNodeProgress = true;
+	mIsRecording = true;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// replayRecording
+// The copy starts out like the emitter did when the recording started, see
+// startRecording().
+//-----------------------------------------------------------------------------
+S32 GraphEmitter::replayRecording( const ParticleRecording &recording, U32 *elapsedMS )
+{
+	if( elapsedMS )
+		*elapsedMS = 0;
+
+	GraphEmitterNode *node = mStepNode;
+	if( !node )
+	{
+		for( U32 i = 0; i < recording.steps.size(); i++ )
 		{
-			part->acc.zero();
-			for(int i = 0; i < attrobjectCount; i++)
+			if( recording.steps[i].emitMS > 0 )
 			{
-				GameBase* GB = dynamic_cast<GameBase*>(Sim::findObject(attractedObjectID[i]));
-				if(!GB)
-					GB = dynamic_cast<GameBase*>(Sim::findObject(atoi(attractedObjectID[i])));
-				if(GB){
-					Point3F target = GB->getPosition();
-					char attrBuf[255];
-					strcpy(attrBuf,Attraction_offset[i]);
-
-					MatrixF trans = GB->getTransform();
-
-					char* xBuf = strtok(attrBuf, " ");
-					F32 x = atof(xBuf);
-					char* yBuf = strtok(NULL, " ");
-					F32 y = atof(yBuf);
-					char* zBuf = strtok(NULL, " ");
-					F32 z = atof(zBuf);
-					Point3F* po = new Point3F(x,y,z);
-					Point3F* p = rotate(trans, *po);
-					target += *p;
-
-					Point3F diff = (target - part->pos);
-					Point3F* attR = new Point3F(attractionrange);
-					if(diff.len() < 1)
-						diff.normalize();
-					Point3F ndiff = diff;
-					ndiff.normalize();
-					F32 fdiff = attractionrange/(diff.len())-1;
-					if(fdiff < 0)
-						fdiff = 0;
-					if(AttractionMode[i] == 1)
-						part->acc += (ndiff * fdiff)*Amount[i];
-					if(AttractionMode[i] == 2)
-						part->acc -= (ndiff * fdiff)*Amount[i];
-					delete(attR);
-					delete(p);
-					delete(po);
-				}
+				Con::errorf( "GraphEmitter::replayRecording - %s has no node to emit the particles", getIdString() );
+				return 0;
 			}
 		}
+	}
 
-		Point3F a = part->acc;
-		a -= part->vel * part->dataBlock->dragCoefficient;
-		a -= mWindVelocity * part->dataBlock->windCoefficient;
-		a += Point3F(0.0f, 0.0f, -9.81f) * part->dataBlock->gravityCoefficient;
-		part->vel += a * t;
+	GraphEmitter *replica = new GraphEmitter;
+	replica->mDataBlock = mDataBlock;
+	replica->setSizes( sizes );
+	replica->setColors( colors );
+	replica->reserveParticles( mDataBlock->partListInitSize );
+	replica->sticky = sticky;
+	replica->attractionrange = attractionrange;
+	for( U32 i = 0; i < attrobjectCount; i++ )
+	{
+		replica->AttractionMode[i] = AttractionMode[i];
+		replica->Amount[i] = Amount[i];
+		replica->Attraction_offset[i] = Attraction_offset[i];
+		replica->attractedObjectID[i] = attractedObjectID[i];
+	}
+	replica->updateAttraction();
+	replica->mRandom.setSeed( recording.seed );
+	replica->mLifetimeMS = recording.lifetimeMS;
+	replica->mReplaying = true;
+	replica->mReplayTerrain = new TerrainHeightCache;
 
-		// added part ----------------
-		RayInfo rInfo;
-		if(gClientContainer.castRay(part->pos, part->pos + part->vel * t, TerrainObjectType | InteriorObjectType | VehicleObjectType | PlayerObjectType, &rInfo))
-		{
-			Point3F proj = mDot(part->vel,rInfo.normal)/(rInfo.normal.len()*rInfo.normal.len())*rInfo.normal;
-			Point3F between = (part->vel - proj);
-			part->vel = -(part->vel-(between*2)*0.8);
-		}
-		// end addition ---------------
+	// The expressions of the node leave their variables set, they are put
+	// back once the replay is done
+	F32 nodeProgress = 0.0f, parserX = 0.0f, parserY = 0.0f, terZ = 0.0f;
+	if( node )
+	{
+		nodeProgress = node->particleProg;
+		parserX = node->parserX;
+		parserY = node->parserY;
+		terZ = node->TerZ;
+		node->particleProg = recording.nodeProgress;
+	}
 
-		part->pos += part->vel * t;
-		if(sticky)
-			part->pos = parentNodePos + part->relPos;
+	S32 mismatch = -1;
+	const U32 start = Platform::getRealMilliseconds();
+	for( U32 i = 0; i < recording.steps.size(); i++ )
+	{
+		const ParticleRecording::Step &step = recording.steps[i];
+		replica->runStep( step, node );
+		if( mismatch < 0 && ParticleRecording::checksum( replica->mParts ) != step.checksum )
+			mismatch = i;
+	}
+	if( elapsedMS )
+		*elapsedMS = Platform::getRealMilliseconds() - start;
 
-		updateKeyData( part );
+	if( node )
+	{
+		node->particleProg = nodeProgress;
+		node->parserX = parserX;
+		node->parserY = parserY;
+		node->TerZ = terZ;
 	}
+
+	delete replica->mReplayTerrain;
+	delete replica;
+	return mismatch;
 }
 
 //-----------------------------------------------------------------------------
-// Copy particles to vertex buffer
+// Update key related particle data
+//-----------------------------------------------------------------------------
+void GraphEmitter::updateKeyData( U32 idx )
+{
+	//Ensure that our lifetime is never below 0
+	if( mParts.totalLifetime[idx] < 1 )
+		mParts.totalLifetime[idx] = 1;
+
+	const ParticleKeyCurve *curve = getKeyCurve( mParts.dataBlock[idx] );
+	if( curve )
+		curve->apply( mParts, idx );
+}
+
+//-----------------------------------------------------------------------------
+// bakeKeyCurves
+// Emitters using the colors and sizes of the particles share the curves of
+// the datablock.
 //-----------------------------------------------------------------------------
+void GraphEmitter::bakeKeyCurves()
+{
+	const Vector<ParticleData*> &dataBlocks = mDataBlock->particleDataBlocks;
+	AssertFatal( mDataBlock->keyCurves.size() == dataBlocks.size(), "GraphEmitter::bakeKeyCurves - the datablock curves aren't baked" );
+
+	const bool ownCurves = mDataBlock->useEmitterColors || mDataBlock->useEmitterSizes;
+	mOwnKeyCurves.setSize( ownCurves ? dataBlocks.size() : 0 );
+	mKeyCurves.setSize( dataBlocks.size() );
+	for( S32 i = 0; i < dataBlocks.size(); i++ )
+	{
+		if( ownCurves )
+		{
+			mOwnKeyCurves[i].bake( dataBlocks[i], mDataBlock->useEmitterColors ? colors : NULL, mDataBlock->useEmitterSizes ? sizes : NULL );
+			mKeyCurves[i] = &mOwnKeyCurves[i];
+		}
+		else
+			mKeyCurves[i] = &mDataBlock->keyCurves[i];
+	}
+
+	mKeyCurvesDirty = false;
+}
 
-// structure used for particle sorting.
-struct SortParticle
+//-----------------------------------------------------------------------------
+// getKeyCurve
+//-----------------------------------------------------------------------------
+const ParticleKeyCurve* GraphEmitter::getKeyCurve( const ParticleData *dataBlock )
 {
-	Particle* p;
-	F32       k;
-};
+	if( mKeyCurvesDirty )
+		bakeKeyCurves();
+	return ParticleKeyCurve::find( dataBlock, mDataBlock->particleDataBlocks, mKeyCurves );
+}
 
-// qsort callback function for particle sorting
-int QSORT_CALLBACK g_cmpSortParticles(const void* p1, const void* p2)
+//-----------------------------------------------------------------------------
+// applyKeyCurves
+//-----------------------------------------------------------------------------
+F32 GraphEmitter::applyKeyCurves()
 {
-	const SortParticle* sp1 = (const SortParticle*)p1;
-	const SortParticle* sp2 = (const SortParticle*)p2;
+	if( mKeyCurvesDirty )
+		bakeKeyCurves();
+	return ParticleKeyCurve::apply( mParts, mDataBlock->particleDataBlocks, mKeyCurves );
+}
 
-	if (sp2->k > sp1->k)
-		return 1;
-	else if (sp2->k == sp1->k)
-		return 0;
-	else
-		return -1;
+//-----------------------------------------------------------------------------
+// Update attraction
+//-----------------------------------------------------------------------------
+void GraphEmitter::updateAttraction()
+{
+	mAttraction.setRange( attractionrange );
+	for(int i = 0; i < attrobjectCount; i++)
+		mAttraction.setAttractor( i, AttractionMode[i], Amount[i], attractedObjectID[i], Attraction_offset[i] );
 }
 
-void GraphEmitter::copyToVB( const Point3F &camPos, const ColorF &ambientColor )
+//-----------------------------------------------------------------------------
+// simulateForces
+//-----------------------------------------------------------------------------
+void GraphEmitter::simulateForces()
 {
-	static Vector<SortParticle> orderedVector(__FILE__, __LINE__);
+	// TODO: Prefetch
 
-	PROFILE_START(GraphEmitter_copyToVB);
+	// The particles emitted since the update was queued wait behind the others
+	mParts.hideTail( mUpdateCount );
 
-	PROFILE_START(GraphEmitter_copyToVB_Sort);
-	// build sorted list of particles (far to near)
-	if (mDataBlock->sortParticles)
+	// remove dead particles
+	for (U32 i = 0; i < mParts.size(); )
 	{
-		orderedVector.clear();
+		mParts.currentAge[i] += mUpdateMS;
+		if (mParts.currentAge[i] > mParts.totalLifetime[i])
+			mParts.kill(i); // the last particle is moved into i, so don't advance
+		else
+			i++;
+	}
 
-		MatrixF modelview = GFX->getWorldMatrix();
-		Point3F viewvec; modelview.getRow(1, &viewvec);
+	if( mParts.empty() )
+	{
+		mPartBounds = Box3F::Invalid;
+		mMaxPartSize = 0.0f;
+		return;
+	}
+
+	F32 t = F32(mUpdateMS) / 1000.0;
+
+	// Attract or repulse the particles, this sets their acceleration
+	mAttraction.apply( mParts );
+
+	// Apply drag, wind and gravity to all particles
+	ParticleIntegrator::integrate( mParts, mWindVelocity, t, ParticleIntegrator::IntegrateVelocity );
+}
+
+//-----------------------------------------------------------------------------
+// simulateCollision
+//-----------------------------------------------------------------------------
+void GraphEmitter::simulateCollision()
+{
+	if( mParts.empty() || !mLOD.shouldCollide() )
+		return;
+
+	F32 t = F32(mUpdateMS) / 1000.0;
+
+	// Bounce the particles off the scene
+	const U32 collisionMask = TerrainObjectType | InteriorObjectType | VehicleObjectType | PlayerObjectType;
+	if( mDataBlock->batchCollision )
+		mCollision.collide( mParts, t, collisionMask );
+	else
+		ParticleCollision::collideRays( mParts, t, collisionMask );
+}
+
+//-----------------------------------------------------------------------------
+// simulateMotion
+//-----------------------------------------------------------------------------
+void GraphEmitter::simulateMotion()
+{
+	if( mParts.empty() )
+		return;
+
+	F32 t = F32(mUpdateMS) / 1000.0;
+	const U32 count = mParts.size();
+
+	// Move the particles, collecting their bounds on the way
+	ParticleIntegrator::integrate( mParts, mWindVelocity, t, ParticleIntegrator::IntegratePosition, &mPartBounds );
 
-		// add each particle and a distance based sort key to orderedVector
-		for (Particle* pp = part_list_head.next; pp != NULL; pp = pp->next)
+	// Sticky particles follow the node instead
+	if(sticky)
+	{
+		mPartBounds = Box3F::Invalid;
+		for (U32 idx = 0; idx < count; idx++)
 		{
-			orderedVector.increment();
-			orderedVector.last().p = pp;
-			orderedVector.last().k = mDot(pp->pos, viewvec);
+			mParts.setPos(idx, parentNodePos + mParts.relPos[idx]);
+			mPartBounds.extend(mParts.getPos(idx));
 		}
-
-		// qsort the list into far to near ordering
-		dQsort(orderedVector.address(), orderedVector.size(), sizeof(SortParticle), g_cmpSortParticles);
 	}
-	PROFILE_END();
 
-#if defined(TORQUE_OS_XENON)
-	// Allocate writecombined since we don't read back from this buffer (yay!)
-	if(mVertBuff.isNull())
-		mVertBuff = new GFX360MemVertexBuffer(GFX, 1, getGFXVertexFormat<ParticleVertexType>(), sizeof(ParticleVertexType), GFXBufferTypeDynamic, PAGE_WRITECOMBINE);
-	if( n_parts > mCurBuffSize )
+	// Look up the colors and sizes of all the particles at their new age
+	mMaxPartSize = applyKeyCurves();
+}
+
+//-----------------------------------------------------------------------------
+// finishSimulation
+//-----------------------------------------------------------------------------
+void GraphEmitter::finishSimulation()
+{
+	// Bring back the particles emitted while the update was queued
+	extendBounds( mParts.showTail() );
+
+	if (mParts.empty() && mDeleteWhenEmpty)
 	{
-		mCurBuffSize = n_parts;
-		mVertBuff.resize(n_parts * 4);
+		mDeleteOnTick = true;
+		return;
 	}
 
-	ParticleVertexType *buffPtr = mVertBuff.lock();
-#else
-	static Vector<ParticleVertexType> tempBuff(2048);
-	tempBuff.reserve( n_parts*4 + 64); // make sure tempBuff is big enough
-	ParticleVertexType *buffPtr = tempBuff.address(); // use direct pointer (faster)
-#endif
+	updateBounds();
+}
+
+//-----------------------------------------------------------------------------
+// Copy particles to vertex buffer
+//-----------------------------------------------------------------------------
+
+void GraphEmitter::copyToVB( const Point3F &camPos, const ColorF &ambientColor )
+{
+	PROFILE_START(GraphEmitter_copyToVB);
 
-	if (mDataBlock->orientParticles)
+	const S32 n_parts = mParts.size();
+
+	PROFILE_START(GraphEmitter_copyToVB_Sort);
+	// build sorted list of particles (far to near)
+	const U32 *sortedParts = NULL;
+	if (mDataBlock->sortParticles && mLOD.shouldSort())
 	{
-		PROFILE_START(GraphEmitter_copyToVB_Orient);
+		MatrixF modelview = GFX->getWorldMatrix();
+		Point3F viewvec; modelview.getRow(1, &viewvec);
 
-		if (mDataBlock->reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
-			// do sorted-oriented particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr-=4 )
-					setupOriented(partPtr->p, camPos, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupOriented(partPtr, camPos, ambientColor, buffPtr);
-			}
-		}
-		else
-		{
-			// do sorted-oriented particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr+=4 )
-					setupOriented(partPtr->p, camPos, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupOriented(partPtr, camPos, ambientColor, buffPtr);
-			}
-		}
-		PROFILE_END();
+		// radix sort the particles into far to near ordering
+		sortedParts = mSort.sort(mParts, viewvec);
 	}
-	else if (mDataBlock->alignParticles)
-	{
-		PROFILE_START(GraphEmitter_copyToVB_Aligned);
+	PROFILE_END();
 
-		if (mDataBlock->reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
+	// The particles are drawn in batches of at most MaxBatchQuads, each from
+	// its own vertex buffer, as the shared quad index buffer is 16 bit.
+	const U32 numBatches = (n_parts + ParticleBufferPool::MaxBatchQuads - 1) / ParticleBufferPool::MaxBatchQuads;
+	mVertBuffs.setSize(numBatches);
+
+	VertexFill fill;
+	fill.emitter = this;
+	fill.sortedParts = sortedParts;
+	fill.numParts = n_parts;
+	fill.reverse = mDataBlock->reverseOrder;
+	fill.camPos = camPos;
+	fill.ambientColor = ambientColor;
+
+	// somewhat odd ordering so that texture coordinates match the oriented
+	// particles
+	fill.basePoints[0] = Point3F(-1.0, 0.0,  1.0);
+	fill.basePoints[1] = Point3F(-1.0, 0.0, -1.0);
+	fill.basePoints[2] = Point3F( 1.0, 0.0, -1.0);
+	fill.basePoints[3] = Point3F( 1.0, 0.0,  1.0);
+
+	fill.camView = GFX->getWorldMatrix();
+	fill.camView.transpose();  // inverse - this gets the particles facing camera
+
+	for (U32 batch = 0; batch < numBatches; batch++)
+	{
+		const U32 first = batch * ParticleBufferPool::MaxBatchQuads;
+		const U32 last = getMin(first + ParticleBufferPool::MaxBatchQuads, (U32)n_parts);
+
+		PROFILE_START(GraphEmitter_copyToVB_Lock);
+		// The vertices are written straight into the locked buffer
+		mVertBuffs[batch] = ParticleBufferPool::borrowVerts( last - first );
+		fill.verts = mVertBuffs[batch]->lock();
+		fill.firstSlot = first;
+		PROFILE_END();
 
-			// do sorted-oriented particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr-=4 )
-					setupAligned(partPtr->p, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				Particle *partPtr = part_list_head.next;
-				for (; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupAligned(partPtr, ambientColor, buffPtr);
-			}
-		}
+		PROFILE_START(GraphEmitter_copyToVB_Fill);
+		// Small emitters are filled here, the dispatch would cost more
+		if (last - first >= ParticleJobScheduler::getMinParallelItems())
+			ParticleJobScheduler::runParallel( fill, last - first, VertexFillChunk );
 		else
-		{
-			// do sorted-oriented particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr+=4 )
-					setupAligned(partPtr->p, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				Particle *partPtr = part_list_head.next;
-				for (; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupAligned(partPtr, ambientColor, buffPtr);
-			}
-		}
+			fill.run( 0, last - first );
 		PROFILE_END();
+
+		mVertBuffs[batch]->unlock();
 	}
-	else
-	{
-		PROFILE_START(GraphEmitter_copyToVB_NonOriented);
-		// somewhat odd ordering so that texture coordinates match the oriented
-		// particles
-		Point3F basePoints[4];
-		basePoints[0] = Point3F(-1.0, 0.0,  1.0);
-		basePoints[1] = Point3F(-1.0, 0.0, -1.0);
-		basePoints[2] = Point3F( 1.0, 0.0, -1.0);
-		basePoints[3] = Point3F( 1.0, 0.0,  1.0);
 
-		MatrixF camView = GFX->getWorldMatrix();
-		camView.transpose();  // inverse - this gets the particles facing camera
+	PROFILE_END();
+}
 
-		if (mDataBlock->reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
-			// do sorted-billboard particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle *partPtr = orderedVector.address();
-				for( U32 i=0; i<n_parts; i++, partPtr++, buffPtr-=4 )
-					setupBillboard( partPtr->p, basePoints, camView, ambientColor, buffPtr );
-			}
-			// do unsorted-billboard particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupBillboard( partPtr, basePoints, camView, ambientColor, buffPtr );
-			}
-		}
-		else
-		{
-			// do sorted-billboard particles
-			if (mDataBlock->sortParticles)
-			{
-				SortParticle *partPtr = orderedVector.address();
-				for( U32 i=0; i<n_parts; i++, partPtr++, buffPtr+=4 )
-					setupBillboard( partPtr->p, basePoints, camView, ambientColor, buffPtr );
-			}
-			// do unsorted-billboard particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupBillboard( partPtr, basePoints, camView, ambientColor, buffPtr );
-			}
-		}
+//-----------------------------------------------------------------------------
+// VertexFill
+//-----------------------------------------------------------------------------
+void GraphEmitter::VertexFill::run( U32 start, U32 end )
+{
+	ParticleVertexType *buffPtr = verts + start * 4;
+	const U32 first = firstSlot + start;
+	const U32 last = firstSlot + end;
 
-		PROFILE_END();
+	if (emitter->mDataBlock->orientParticles)
+	{
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupOriented(ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), camPos, ambientColor, buffPtr);
 	}
-
-#if defined(TORQUE_OS_XENON)
-	mVertBuff.unlock();
-#else
-	PROFILE_START(GraphEmitter_copyToVB_LockCopy);
-	// create new VB if emitter size grows
-	if( !mVertBuff || n_parts > mCurBuffSize )
+	else if (emitter->mDataBlock->alignParticles)
 	{
-		mCurBuffSize = n_parts;
-		mVertBuff.set( GFX, n_parts * 4, GFXBufferTypeDynamic );
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupAligned(ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), ambientColor, buffPtr);
+	}
+	else
+	{
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupBillboard( ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), basePoints, camView, ambientColor, buffPtr );
 	}
-	// lock and copy tempBuff to video RAM
-	ParticleVertexType *verts = mVertBuff.lock();
-	dMemcpy( verts, tempBuff.address(), n_parts * 4 * sizeof(ParticleVertexType) );
-	mVertBuff.unlock();
-	PROFILE_END();
-#endif
-
-	PROFILE_END();
 }
 
 //-----------------------------------------------------------------------------
 // Set up particle for billboard style render
 //-----------------------------------------------------------------------------
-void GraphEmitter::setupBillboard( Particle *part,
+void GraphEmitter::setupBillboard( U32 idx,
 	Point3F *basePts,
 	const MatrixF &camView,
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
-	F32 width     = part->size * 0.5f;
-	F32 spinAngle = part->spinSpeed * part->currentAge * AgedSpinToRadians;
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+
+	F32 width     = mParts.partSize[idx] * 0.5f;
+	F32 spinAngle = mParts.spinSpeed[idx] * mParts.currentAge[idx] * AgedSpinToRadians;
 
 	F32 sy, cy;
 	mSinCos(spinAngle, sy, cy);
 
 	const F32 ambientLerp = mClampF( mDataBlock->ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// fill four verts, use macro and unroll loop
+	// The point is built on the stack, lVerts is locked vertex buffer memory
+	//  - which should only be written to.
 #define fillVert(){ \
-	lVerts->point.x = cy * basePts->x - sy * basePts->z;  \
-	lVerts->point.y = 0.0f;                                \
-	lVerts->point.z = sy * basePts->x + cy * basePts->z;  \
-	camView.mulV( lVerts->point );                        \
-	lVerts->point *= width;                               \
-	lVerts->point += part->pos;                           \
+	Point3F vertPoint( cy * basePts->x - sy * basePts->z,  \
+		0.0f,                                              \
+		sy * basePts->x + cy * basePts->z );               \
+	camView.mulV( vertPoint );                            \
+	lVerts->point = vertPoint * width + partPos;          \
 	lVerts->color = partCol; } \
 
 	// Here we deal with UVs for animated particle (billboard)
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
-		S32 fm = (S32)(part->currentAge*(1.0/1000.0)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0/1000.0)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		fillVert();
 		// Here and below, we copy UVs from particle datablock's current frame's UVs (billboard)
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 		++basePts;
 
@@ -1969,22 +2377,22 @@ void GraphEmitter::setupBillboard( Particle *part,
 
 	fillVert();
 	// Here and below, we copy UVs from particle datablock's texCoords (billboard)
-	lVerts->texCoord = part->dataBlock->texCoords[0];
+	lVerts->texCoord = partDB->texCoords[0];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[1];
+	lVerts->texCoord = partDB->texCoords[1];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[2];
+	lVerts->texCoord = partDB->texCoords[2];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[3];
+	lVerts->texCoord = partDB->texCoords[3];
 	++lVerts;
 	++basePts;
 }
@@ -1992,70 +2400,86 @@ void GraphEmitter::setupBillboard( Particle *part,
 //-----------------------------------------------------------------------------
 // Set up oriented particle
 //-----------------------------------------------------------------------------
-void GraphEmitter::setupOriented( Particle *part,
+void GraphEmitter::setupOriented( U32 idx,
 	const Point3F &camPos,
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+	const Point3F partVel = mParts.getVel(idx);
+
 	Point3F dir;
 
 	if( mDataBlock->orientOnVelocity )
 	{
-		// don't render oriented particle if it has no velocity
-		if( part->vel.magnitudeSafe() == 0.0 ) return;
-		dir = part->vel;
+		// don't render oriented particle if it has no velocity, its quad is
+		//  - collapsed to a point since the buffer holds the vertices of
+		//  - whatever used it before.
+		if( partVel.magnitudeSafe() == 0.0 )
+		{
+			for( U32 i = 0; i < 4; i++, lVerts++ )
+			{
+				lVerts->point = partPos;
+				lVerts->color = ColorF( 0.0f, 0.0f, 0.0f, 0.0f );
+				lVerts->texCoord.set( 0.0f, 0.0f );
+			}
+			return;
+		}
+		dir = partVel;
 	}
 	else
 	{
-		dir = part->orientDir;
+		dir = mParts.orientDir[idx];
 	}
 
-	Point3F dirFromCam = part->pos - camPos;
+	Point3F dirFromCam = partPos - camPos;
 	Point3F crossDir;
 	mCross( dirFromCam, dir, &crossDir );
 	crossDir.normalize();
 	dir.normalize();
 
-	F32 width = part->size * 0.5f;
+	F32 width = mParts.partSize[idx] * 0.5f;
 	dir *= width;
 	crossDir *= width;
-	Point3F start = part->pos - dir;
-	Point3F end = part->pos + dir;
+	Point3F start = partPos - dir;
+	Point3F end = partPos + dir;
 
 	const F32 ambientLerp = mClampF( mDataBlock->ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// Here we deal with UVs for animated particle (oriented)
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
 		// Let particle compute the UV indices for current frame
-		S32 fm = (S32)(part->currentAge*(1.0f/1000.0f)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0f/1000.0f)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		lVerts->point = start + crossDir;
 		lVerts->color = partCol;
 		// Here and below, we copy UVs from particle datablock's current frame's UVs (oriented)
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 
 		lVerts->point = start - crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 
 		lVerts->point = end - crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 
 		lVerts->point = end + crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 
 		return;
@@ -2064,29 +2488,33 @@ void GraphEmitter::setupOriented( Particle *part,
 	lVerts->point = start + crossDir;
 	lVerts->color = partCol;
 	// Here and below, we copy UVs from particle datablock's texCoords (oriented)
-	lVerts->texCoord = part->dataBlock->texCoords[0];
+	lVerts->texCoord = partDB->texCoords[0];
 	++lVerts;
 
 	lVerts->point = start - crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[1];
+	lVerts->texCoord = partDB->texCoords[1];
 	++lVerts;
 
 	lVerts->point = end - crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[2];
+	lVerts->texCoord = partDB->texCoords[2];
 	++lVerts;
 
 	lVerts->point = end + crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[3];
+	lVerts->texCoord = partDB->texCoords[3];
 	++lVerts;
 }
 
-void GraphEmitter::setupAligned( const Particle *part, 
+void GraphEmitter::setupAligned( U32 idx, 
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+
 	// The aligned direction will always be normalized.
 	Point3F dir = mDataBlock->alignDirection;
 
@@ -2099,9 +2527,9 @@ void GraphEmitter::setupAligned( const Particle *part,
 	right.normalize();
 
 	// If we have a spin velocity.
-	if ( !mIsZero( part->spinSpeed ) )
+	if ( !mIsZero( mParts.spinSpeed[idx] ) )
 	{
-		F32 spinAngle = part->spinSpeed * part->currentAge * AgedSpinToRadians;
+		F32 spinAngle = mParts.spinSpeed[idx] * mParts.currentAge[idx] * AgedSpinToRadians;
 
 		// This is an inline quaternion vector rotation which
 		// is faster that QuatF.mulP(), but generates different
@@ -2127,45 +2555,45 @@ void GraphEmitter::setupAligned( const Particle *part,
 	Point3F cross;
 	mCross(right, dir, &cross);
 
-	F32 width = part->size * 0.5f;
+	F32 width = mParts.partSize[idx] * 0.5f;
 	right *= width;
 	cross *= width;
-	Point3F start = part->pos - right;
-	Point3F end = part->pos + right;
+	Point3F start = partPos - right;
+	Point3F end = partPos + right;
 
 	const F32 ambientLerp = mClampF( mDataBlock->ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// Here we deal with UVs for animated particle
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
 		// Let particle compute the UV indices for current frame
-		S32 fm = (S32)(part->currentAge*(1.0f/1000.0f)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0f/1000.0f)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		lVerts->point = start + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 
 		lVerts->point = start - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 
 		lVerts->point = end - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 
 		lVerts->point = end + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 	}
 	else
@@ -2173,22 +2601,22 @@ void GraphEmitter::setupAligned( const Particle *part,
 		// Here and below, we copy UVs from particle datablock's texCoords
 		lVerts->point = start + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[0];
+		lVerts->texCoord = partDB->texCoords[0];
 		++lVerts;
 
 		lVerts->point = start - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[1];
+		lVerts->texCoord = partDB->texCoords[1];
 		++lVerts;
 
 		lVerts->point = end - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[2];
+		lVerts->texCoord = partDB->texCoords[2];
 		++lVerts;
 
 		lVerts->point = end + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[3];
+		lVerts->texCoord = partDB->texCoords[3];
 		++lVerts;
 	}
 }
@@ -2256,3 +2684,267 @@ DefineEngineMethod(GraphEmitterData, reload, void,(),,
 {
 	object->reload();
 }
+
+DefineEngineMethod(GraphEmitter, getNumAllocs, S32, (),,
+	"@brief Returns the number of times the particles of this emitter were allocated.\n\n"
+	"Adding particles doesn't allocate, the number only increases while the emitter "
+	"has more particles than it had before. Compare it before and after a while of "
+	"steady emission to check that.\n")
+{
+	return object->getNumAllocs();
+}
+
+DefineEngineMethod(GraphEmitter, getNumBoundsUpdates, S32, (),,
+	"@brief Returns the number of times the bounding box of this emitter was refit "
+	"to its particles.\n\n"
+	"Each refit moves the emitter in the scene container. The box is padded, so "
+	"the number should only increase while the effect grows or moves.\n")
+{
+	return object->getNumBoundsUpdates();
+}
+
+DefineEngineMethod(GraphEmitter, startRecording, bool, (),,
+	"@brief Restarts this emitter from its seed and records the inputs of every "
+	"simulation step until stopRecording().\n\n"
+	"Only emitters whose datablock has a fixedStepMS can be recorded.\n"
+	"@return True if the recording started.\n")
+{
+	return object->startRecording();
+}
+
+DefineEngineMethod(GraphEmitter, stopRecording, S32, (),,
+	"@brief Stops recording this emitter.\n\n"
+	"@return The number of steps recorded.\n")
+{
+	object->stopRecording();
+	return object->getRecording().steps.size();
+}
+
+DefineEngineMethod(GraphEmitter, replayRecording, S32, (),,
+	"@brief Runs the recording of this emitter again, on a copy of it, and "
+	"checks that every step gives the same particles.\n\n"
+	"The time the replay took is printed, so a recording doubles as a benchmark "
+	"of the effect. The node of this emitter must still exist.\n"
+	"@return The index of the first step that gave different particles, or -1 if "
+	"the replay matched the recording.\n")
+{
+	const ParticleRecording &recording = object->getRecording();
+	U32 elapsedMS;
+	const S32 mismatch = object->replayRecording( recording, &elapsedMS );
+	if( mismatch < 0 )
+		Con::printf( "GraphEmitter::replayRecording - %u steps replayed in %u ms, all matched",
+			recording.steps.size(), elapsedMS );
+	else
+		Con::errorf( "GraphEmitter::replayRecording - step %d of %u didn't match the recording",
+			mismatch, recording.steps.size() );
+	return mismatch;
+}
+
+DefineEngineMethod(GraphEmitter, saveRecording, bool, (const char *fileName),,
+	"@brief Writes the recording of this emitter to a file.\n\n"
+	"@param fileName Path of the file.\n"
+	"@return True if the file was written.\n")
+{
+	char path[1024];
+	Con::expandScriptFilename( path, sizeof(path), fileName );
+
+	FileStream *stream = FileStream::createAndOpen( path, Torque::FS::File::Write );
+	if( !stream )
+	{
+		Con::errorf( "GraphEmitter::saveRecording - can't open %s", path );
+		return false;
+	}
+
+	const bool written = object->getRecording().write( *stream );
+	delete stream;
+	return written;
+}
+
+DefineEngineMethod(GraphEmitter, loadRecording, bool, (const char *fileName),,
+	"@brief Reads a recording written by saveRecording() into this emitter, to "
+	"replay it with replayRecording().\n\n"
+	"@param fileName Path of the file.\n"
+	"@return True if the file held a recording.\n")
+{
+	char path[1024];
+	Con::expandScriptFilename( path, sizeof(path), fileName );
+
+	FileStream *stream = FileStream::createAndOpen( path, Torque::FS::File::Read );
+	if( !stream )
+	{
+		Con::errorf( "GraphEmitter::loadRecording - can't open %s", path );
+		return false;
+	}
+
+	object->stopRecording();
+	const bool read = object->getRecording().read( *stream );
+	delete stream;
+	if( !read )
+		Con::errorf( "GraphEmitter::loadRecording - %s isn't a particle recording", path );
+	return read;
+}
+
+// Writes four vertices per particle the way setupBillboard does.
+static void fillBenchmarkVerts( GraphEmitter::ParticleVertexType *verts, U32 numParticles )
+{
+	const ColorI color( 255, 128, 64, 255 );
+	for( U32 i = 0; i < numParticles; i++ )
+	{
+		const Point3F pos( F32(i), 0.0f, 1.0f );
+		for( U32 v = 0; v < 4; v++, verts++ )
+		{
+			verts->point = pos + Point3F( F32(v & 1), 0.0f, F32(v >> 1) );
+			verts->color = color;
+			verts->texCoord.set( F32(v & 1), F32(v >> 1) );
+		}
+	}
+}
+
+DefineEngineFunction( benchmarkParticleVertexCopy, void, ( S32 numParticles, S32 numFrames ), ( 10000, 200 ),
+	"@brief Times filling particle vertices into a staging buffer and copying them "
+	"into the vertex buffer, as copyToVB used to, against filling the locked vertex "
+	"buffer directly.\n\n"
+	"Run it on the null GFX device to measure the CPU side only.\n\n"
+	"@param numParticles Number of particles, 4 vertices each.\n"
+	"@param numFrames Number of times the vertex buffer is filled per method.\n"
+	"@internal")
+{
+	if( numParticles < 1 || numFrames < 1 )
+	{
+		Con::errorf( "benchmarkParticleVertexCopy - the counts must be positive" );
+		return;
+	}
+	if( !GFXDevice::devicePresent() )
+	{
+		Con::errorf( "benchmarkParticleVertexCopy - no GFX device" );
+		return;
+	}
+
+	typedef GraphEmitter::ParticleVertexType VertexType;
+	const U32 numVerts = numParticles * 4;
+	GFXVertexBufferHandle<VertexType> vertBuff( GFX, numVerts, GFXBufferTypeDynamic );
+	Vector<VertexType> tempBuff;
+	tempBuff.setSize( numVerts );
+
+	U32 start = Platform::getRealMilliseconds();
+	for( S32 frame = 0; frame < numFrames; frame++ )
+	{
+		fillBenchmarkVerts( tempBuff.address(), numParticles );
+		VertexType *verts = vertBuff.lock();
+		dMemcpy( verts, tempBuff.address(), numVerts * sizeof(VertexType) );
+		vertBuff.unlock();
+	}
+	const U32 stagedTime = Platform::getRealMilliseconds() - start;
+
+	start = Platform::getRealMilliseconds();
+	for( S32 frame = 0; frame < numFrames; frame++ )
+	{
+		fillBenchmarkVerts( vertBuff.lock(), numParticles );
+		vertBuff.unlock();
+	}
+	const U32 directTime = Platform::getRealMilliseconds() - start;
+
+	const F32 copiedMB = F32(numVerts) * sizeof(VertexType) * numFrames / (1024.0f * 1024.0f);
+	Con::printf( "benchmarkParticleVertexCopy - %d particles, %d frames on %s", numParticles, numFrames,
+		GFX->getAdapterType() == NullDevice ? "the null device" : "the GFX device" );
+	Con::printf( "   staged %ums, direct %ums, %.1f MB less copied by the direct path", stagedTime, directTime, copiedMB );
+}
+
+DefineEngineFunction( testParticleRecording, bool, ( GraphEmitterNode* node, S32 numFrames ), ( 0, 120 ),
+	"@brief Records the emitter of a node for a number of frames, writes the "
+	"recording to memory, reads it back and checks that replaying it gives "
+	"the recorded particles.\n\n"
+	"The emitter is restarted from its seed for the recording.\n"
+	"@param node Client side node whose emitter datablock has a fixedStepMS.\n"
+	"@param numFrames Number of frames recorded.\n"
+	"@return True if the test passed.\n"
+	"@internal")
+{
+	GraphEmitter *emitter = node ? node->getGraphEmitter() : NULL;
+	if( !emitter || !emitter->startRecording() )
+	{
+		Con::errorf( "testParticleRecording - failed, needs a node whose emitter has a fixedStepMS" );
+		return false;
+	}
+
+	// Frames of a few lengths, so the steps carry time over between them
+	for( S32 i = 0; i < numFrames; i++ )
+	{
+		const F32 dt = ( 16 + i % 5 ) / 1000.0f;
+		node->advanceTime( dt );
+		emitter->advanceSteps( dt );
+	}
+	emitter->stopRecording();
+	const ParticleRecording &recording = emitter->getRecording();
+
+	MemStream stream( recording.getStreamSize() );
+	const bool written = recording.write( stream );
+	stream.setPosition( 0 );
+	ParticleRecording copy;
+	if( !written || !copy.read( stream ) || copy.steps.size() != recording.steps.size() )
+	{
+		Con::errorf( "testParticleRecording - failed, the %u steps didn't read back", recording.steps.size() );
+		return false;
+	}
+
+	U32 elapsedMS;
+	const S32 mismatch = emitter->replayRecording( copy, &elapsedMS );
+	if( mismatch >= 0 )
+	{
+		Con::errorf( "testParticleRecording - failed, step %d of %u didn't match the recording",
+			mismatch, copy.steps.size() );
+		return false;
+	}
+
+	Con::printf( "testParticleRecording - passed, %u steps read back and replayed in %u ms",
+		copy.steps.size(), elapsedMS );
+	return true;
+}
+
+DefineEngineFunction( testGraphEmitterAllocs, bool, ( GraphEmitterNode* node, S32 warmupFrames, S32 numFrames ), ( 0, 300, 300 ),
+	"@brief Emits from a node and checks that its emitter stops allocating "
+	"once its particles die as fast as they are spawned.\n\n"
+	"Neither the particle pool nor the arrays of the expression batch may grow "
+	"after the warmup, the particles must live shorter than it.\n"
+	"@param node Client side node with an emitter.\n"
+	"@param warmupFrames Frames of 16 ms before the allocations are counted.\n"
+	"@param numFrames Frames of 16 ms the allocations are counted over.\n"
+	"@return True if the test passed.\n"
+	"@internal")
+{
+	GraphEmitter *emitter = node ? node->getGraphEmitter() : NULL;
+	if( !emitter || warmupFrames <= 0 || numFrames <= 0 )
+	{
+		Con::errorf( "testGraphEmitterAllocs - failed, needs a node with an emitter and positive frame counts" );
+		return false;
+	}
+
+	// The emitter is advanced the way the process list does it
+	GameBase *process = emitter;
+	const F32 dt = 0.016f;
+	U32 warmupAllocs = 0, warmupBatch = 0;
+	for( S32 i = 0; i < warmupFrames + numFrames; i++ )
+	{
+		if( i == warmupFrames )
+		{
+			warmupAllocs = emitter->getNumAllocs();
+			warmupBatch = emitter->getBatchCapacity();
+		}
+		node->advanceTime( dt );
+		process->advanceTime( dt );
+		ParticleJobScheduler::flush();
+	}
+
+	const U32 steadyAllocs = emitter->getNumAllocs() - warmupAllocs;
+	const U32 batchCapacity = emitter->getBatchCapacity();
+	if( steadyAllocs != 0 || batchCapacity != warmupBatch )
+	{
+		Con::errorf( "testGraphEmitterAllocs - failed, %u pool allocations and the batch grew from %u to %u elements in %d frames",
+			steadyAllocs, warmupBatch, batchCapacity, numFrames );
+		return false;
+	}
+
+	Con::printf( "testGraphEmitterAllocs - passed, %u pool allocations in the warmup, none in %d frames",
+		warmupAllocs, numFrames );
+	return true;
+}
@@ -24,10 +24,40 @@
 #ifndef _GRAPH_EMITTERNODE_H_
 #include "graphEmitterNode.h"
 #endif
-
-#if defined(TORQUE_OS_XENON)
-#include "gfx/D3D9/360/gfx360MemVertexBuffer.h"
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+#ifndef _H_ATTRACTION_FIELD
+#include "attractionField.h"
+#endif
+#ifndef _H_PARTICLE_COLLISION
+#include "particleCollision.h"
+#endif
+#ifndef _H_PARTICLE_SORT
+#include "particleSort.h"
+#endif
+#ifndef _H_PARTICLE_BUFFER_POOL
+#include "particleBufferPool.h"
+#endif
+#ifndef _H_PARTICLE_KEY_CURVE
+#include "particleKeyCurve.h"
+#endif
+#ifndef _H_PARTICLE_JOBS
+#include "particleJobs.h"
 #endif
+#ifndef _H_PARTICLE_LOD
+#include "particleLOD.h"
+#endif
+#ifndef _H_PARTICLE_BUDGET
+#include "particleBudget.h"
+#endif
+#ifndef _H_PARTICLE_RANDOM
+#include "particleRandom.h"
+#endif
+#ifndef _H_PARTICLE_RECORDING
+#include "particleRecording.h"
+#endif
+
 
 class RenderPassManager;
 class ParticleData;
@@ -49,7 +79,7 @@ public:
 	void unpackData(BitStream* stream);
 	bool preload(bool server, String &errorStr);
 	bool onAdd();
-	void allocPrimBuffer( S32 overrideSize = -1 );
+	void calcPartListInitSize();
 
 public:
 	S32   ejectionPeriodMS;                   ///< Time, in Milliseconds, between particle ejection
@@ -89,8 +119,9 @@ public:
 	Vector<U32>           dataBlockIds;       ///< Datablock IDs (parellel array to particleDataBlocks)
 
 	U32                   partListInitSize;   /// initial size of particle list calc'd from datablock info
+	U32                   maxPartLifeMS;      /// longest particle lifetime calc'd from datablock info
+	Vector<ParticleKeyCurve> keyCurves;       ///< Colors and sizes of particleDataBlocks baked over the particle age
 
-	GFXPrimitiveBufferHandle   primBuff;
 
 	S32                   blendStyle;         ///< Pre-define blend factor setting
 	bool                  sortParticles;      ///< Particles are sorted back-to-front
@@ -99,6 +130,11 @@ public:
 	GFXTexHandle          textureHandle;      ///< Emitter texture handle from txrName
 	bool                  highResOnly;        ///< This particle system should not use the mixed-resolution particle rendering
 	bool                  renderReflection;   ///< Enables this emitter to render into reflection passes.
+	bool                  batchCollision;     ///< Collide the particles against a grid of the nearby polygons instead of a ray each
+	ParticleLOD::Bands    lodBands;           ///< Detail of the emitter at increasing distances from the camera
+	S32                   budgetPriority;     ///< Emitters with a lower priority are throttled first by the ParticleBudget
+	S32                   fixedStepMS;        ///< Simulate in steps of this length for deterministic results, 0 for off
+	S32                   randomSeed;         ///< Seed of the random numbers of the emitters, 0 for a random seed each
 
 	bool reload();
 };
@@ -106,21 +142,20 @@ public:
 //*****************************************************************************
 // Particle Emitter
 //*****************************************************************************
-class GraphEmitter : public GameBase
+class GraphEmitter : public GameBase, public ParticleJob
 {
 	typedef GameBase Parent;
 
 	U32	oldTime;
-	Point3F* rotate(MatrixF trans, Point3F p);
+	Point3F rotate(const MatrixF &trans, const Point3F &p);
    Point3F parentNodePos;
 
+	// Runs the particle passes of unregistered emitters
+	friend class ParticleBenchmark;
+
 public:
 
-#if defined(TORQUE_OS_XENON)
-	typedef GFXVertexPCTT ParticleVertexType;
-#else
-	typedef GFXVertexPCT ParticleVertexType;
-#endif
+	typedef ParticleBufferPool::VertexType ParticleVertexType;
 
 	GraphEmitter();
 	~GraphEmitter();
@@ -141,6 +176,21 @@ public:
 	void setColors( ColorF *colorList );
 
 	GraphEmitterData *getDataBlock(){ return mDataBlock; }
+
+	/// Number of times the particle pool was allocated.
+	U32 getNumAllocs() const { return mParts.getNumAllocs(); }
+
+	/// Elements allocated for the particles waiting for their expressions,
+	/// see flushExpressionBatch().
+	U32 getBatchCapacity() const
+	{
+		return mPendingParts.capacity() + mBatchT.capacity() + mBatchX.capacity() +
+			mBatchY.capacity() + mBatchZ.capacity() + mBatchPartX.capacity() +
+			mBatchPartY.capacity() + mBatchTerZ.capacity();
+	}
+
+	/// Number of times the object box was refit to the particles.
+	U32 getNumBoundsUpdates() const { return mNumBoundsUpdates; }
 	bool onNewDataBlock( GameBaseData *dptr, bool reload );
 
 	/// By default, a particle renderer will wait for it's owner to delete it.  When this
@@ -156,6 +206,10 @@ public:
 
    StringTableEntry attractedObjectID[attrobjectCount];
 
+	/// Sets up the attractors from the attraction fields above.
+	/// Call after changing any of the fields.
+	void updateAttraction();
+
 	/// @name Particle Emission
 	/// Main interface for creating particles.  The emitter does _not_ track changes
 	///  in axis or velocity over the course of a single update, so this should be called
@@ -187,6 +241,37 @@ public:
 
 	/// @}
 
+	/// @name Deterministic Mode
+	/// With a fixedStepMS on the datablock the emitter runs whole steps of
+	/// that length instead of the frame time, and only draws random numbers
+	/// from its own seeded sequence, so the same inputs always give the same
+	/// particles. The inputs can be recorded and replayed to check that.
+	/// @{
+
+	/// Restarts the emitter from its seed and records the inputs of every
+	/// step from now on.
+	/// @return  False if the datablock has no fixedStepMS.
+	bool startRecording();
+	void stopRecording() { mIsRecording = false; }
+	bool isRecording() const { return mIsRecording; }
+
+	/// Runs the whole fixed steps in dt, see fixedStepMS. Called by
+	/// advanceTime, the rest of the frame is kept for the next call.
+	void advanceSteps( F32 dt );
+
+	ParticleRecording& getRecording() { return mRecording; }
+
+	/// Runs a recording on a new, unregistered copy of this emitter and
+	/// compares the particles after each step. The node of the emitter
+	/// evaluates the expressions at the transforms of the recording, its
+	/// variables are restored afterwards and its onBoundaryLimit callbacks
+	/// are not fired.
+	/// @param   elapsedMS   Set to the real time the replay took
+	/// @return  Index of the first step that differs, or -1 if none did.
+	S32 replayRecording( const ParticleRecording &recording, U32 *elapsedMS = NULL );
+
+	/// @}
+
 	bool mDead;
 
 protected:
@@ -204,24 +289,86 @@ protected:
 	void addParticle(const Point3F &pos, const Point3F &axis, const Point3F &vel, const Point3F &axisx,
 		GraphEmitterNode* node);
 
+	/// Evaluates the expressions of the node for the particles added since
+	/// the last call, and moves the particles to their positions.
+	/// @param   terrain   Heights for the terz variable, see getTerrainCache().
+	void flushExpressionBatch( GraphEmitterNode* node, TerrainHeightCache &terrain );
+
+	/// The terrain heights of the node, or the replay's own while replaying
+	/// so the cache of the node isn't moved.
+	TerrainHeightCache& getTerrainCache( GraphEmitterNode* node )
+	{
+		return mReplayTerrain ? *mReplayTerrain : node->mTerrainCache;
+	}
+
+	/// Grows the particle pool and the batch arrays to hold count particles.
+	void reserveParticles( U32 count );
+
+	/// Reserves room for the particles alive at once when ejecting every
+	/// periodMS +- varianceMS.
+	void updateCapacity( S32 periodMS, S32 varianceMS );
+
+	/// Grows a full particle pool, and logs it.
+	void growParticles();
+
+	/// Picks the detail of the emitter from its distance to the camera.
+	void updateLOD();
+
+	/// Moves the particles by a step synchronously, then emits the
+	/// particles of the node for the step.
+	void runStep( const ParticleRecording::Step &step, GraphEmitterNode *node );
+
+	/// Adds the particles of the node for numMilliseconds, the emitParticles
+	/// of the node once the deterministic mode is taken care of.
+	void emitNodeParticles( const Point3F& start,
+		const Point3F& end,
+		const Point3F& axis,
+		const Point3F& velocity,
+		const U32      numMilliseconds,
+		GraphEmitterNode* node );
+
 
-	inline void setupBillboard( Particle *part,
+	inline void setupBillboard( U32 idx,
 		Point3F *basePts,
 		const MatrixF &camView,
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	inline void setupOriented( Particle *part,
+	inline void setupOriented( U32 idx,
 		const Point3F &camPos,
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	inline void setupAligned(  const Particle *part, 
+	inline void setupAligned(  U32 idx, 
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	/// Updates the bounding box for the particle system
-	void updateBBox();
+	/// Sets up the particles drawn in a range of slots of a vertex batch.
+	/// Every slot writes its own four vertices, so large emitters split
+	/// the batch over several threads.
+	struct VertexFill : public ParticleJobScheduler::Task
+	{
+		GraphEmitter *emitter;
+		const U32 *sortedParts;    ///< Far to near order, or NULL
+		U32 numParts;
+		bool reverse;
+		U32 firstSlot;             ///< Slot of the first vertex in verts
+		ParticleVertexType *verts;
+		Point3F camPos;
+		ColorF ambientColor;
+		MatrixF camView;
+		Point3F basePoints[4];
+
+		void run( U32 start, U32 end );
+	};
+
+	/// Extends the particle bounds by the particles from first on, which
+	/// were added since the last update.
+	void extendBounds( U32 first );
+
+	/// Refits the object box to the particle bounds when the particles leave
+	/// it or fill only a small part of it.
+	void updateBounds();
 
 	/// @}
 protected:
@@ -239,8 +386,27 @@ protected:
 	// PEngine interface
 private:
 
-	void update( U32 ms );
-	inline void updateKeyData( Particle *part );
+	/// @name ParticleJob
+	/// The update queued by advanceTime, run by the ParticleJobScheduler.
+	/// @{
+	void simulateForces();
+	void simulateCollision();
+	void simulateMotion();
+	void finishSimulation();
+	/// @}
+
+	inline void updateKeyData( U32 idx );
+
+	/// Points mKeyCurves at the curves of the datablock, or bakes the
+	/// emitter's own if it overrides the colors or sizes.
+	void bakeKeyCurves();
+
+	/// Curve of one of the particle datablocks of this emitter.
+	const ParticleKeyCurve* getKeyCurve( const ParticleData *dataBlock );
+
+	/// Sets the colors and sizes of all the particles from their age.
+	/// @return  The largest size set.
+	F32 applyKeyCurves();
 
 
 private:
@@ -255,10 +421,20 @@ private:
 
 	U32       mNextParticleTime;
 
+	U32       mUpdateMS;             ///< Milliseconds the queued update advances
+	U32       mUpdateCount;          ///< Particles alive when the update was queued
+
+	S32       mCapacityPeriodMS;     ///< Ejection period the pool was last reserved for
+	S32       mCapacityVarianceMS;   ///< Period variance the pool was last reserved for
+
 	Point3F   mLastPosition;
 	bool      mHasLastPosition;
 	MatrixF   mBBObjToWorld;
 
+	Box3F     mPartBounds;         ///< Bounds of the particle positions
+	F32       mMaxPartSize;        ///< Largest particle size at the last update
+	U32       mNumBoundsUpdates;   ///< Times the object box was refit
+
 	bool      mDeleteWhenEmpty;
 	bool      mDeleteOnTick;
 
@@ -268,23 +444,75 @@ private:
 	F32       sizes[ ParticleData::PDC_NUM_KEYS ];
 	ColorF    colors[ ParticleData::PDC_NUM_KEYS ];
 
-#if defined(TORQUE_OS_XENON)
-	GFX360MemVertexBufferHandle<ParticleVertexType> mVertBuff;
-#else
-	GFXVertexBufferHandle<ParticleVertexType> mVertBuff;
-#endif
-
-	//   These members are for implementing a link-list of the active emitter 
-	//   particles. Member part_store contains blocks of particles that can be
-	//   chained in a link-list. Usually the first part_store block is large
-	//   enough to contain all the particles but it can be expanded in emergency
-	//   circumstances.
-	Vector <Particle*> part_store;
-	Particle*  part_freelist;
-	Particle   part_list_head;
-	S32        n_part_capacity;
-	S32        n_parts;
-	S32       mCurBuffSize;
+	//   The color and size curves of the particle datablocks, parallel to
+	//   mDataBlock->particleDataBlocks. They are rebaked when the datablock or
+	//   the emitter colors and sizes change.
+	Vector<const ParticleKeyCurve*> mKeyCurves;
+	Vector<ParticleKeyCurve> mOwnKeyCurves;   ///< Baked with the emitter colors or sizes
+	bool      mKeyCurvesDirty;
+
+	//   The vertices written by the last copyToVB, one buffer per batch of
+	//   MaxBatchQuads particles, borrowed from the ParticleBufferPool until
+	//   the next frame.
+	Vector<ParticleBufferPool::VertexBuffer*> mVertBuffs;
+
+	//   The active emitter particles. The pool is reserved to partListInitSize
+	//   when the datablock is set, which is usually large enough to contain all
+	//   the particles, but it can be expanded in emergency circumstances.
+	ParticlePool mParts;
+
+	//   Particles added by a GraphEmitterNode waiting for their position.
+	//   The expressions of the node are evaluated for all the particles of
+	//   an emitParticles call at once, see flushExpressionBatch().
+	struct PendingParticle
+	{
+		U32     idx;        ///< Index in mParts
+		Point3F pos;        ///< Emission point
+		F32     t;          ///< Value of t for this particle
+		F32     advance;    ///< Seconds the particle is advanced after emission
+	};
+	Vector<PendingParticle> mPendingParts;
+	Vector<F32> mBatchT;
+	Vector<F32> mBatchX;
+	Vector<F32> mBatchY;
+	Vector<F32> mBatchZ;
+	Vector<F32> mBatchPartX;
+	Vector<F32> mBatchPartY;
+	Vector<F32> mBatchTerZ;
+
+	//   The attractors set up from the attraction fields, see updateAttraction().
+	AttractionField mAttraction;
+
+	//   Collision geometry gathered each update when the datablock uses batchCollision.
+	ParticleCollision mCollision;
+
+	//   Far to near order of the particles when the datablock uses sortParticles.
+	ParticleSort mSort;
+
+	//   The detail picked from the lodBands of the datablock each frame.
+	ParticleLOD mLOD;
+
+	//   Share of the particle budget, with the budgetPriority of the datablock.
+	ParticleBudget::Client mBudget;
+
+	//   The random numbers of the particles, seeded from the randomSeed of the datablock.
+	ParticleRandom mRandom;
+
+	//   The emission the node asked for since the last steps, see advanceSteps().
+	F32       mStepTime;           ///< Seconds not run in a step yet
+	SimObjectPtr<GraphEmitterNode> mStepNode;
+	Point3F   mStepPoint;
+	Point3F   mStepAxis;
+	Point3F   mStepVelocity;
+	MatrixF   mStepTransform;      ///< Of the node
+	bool      mHasStepEmit;
+	const MatrixF *mNodeTransform; ///< Used instead of the node's while a step emits
+	bool      mReplaying;          ///< The node's callbacks are not fired
+	TerrainHeightCache *mReplayTerrain; ///< Used instead of the node's while replaying
+
+	bool      mIsRecording;
+	bool      mRecordNodeProgress; ///< The t value of the node isn't recorded yet
+	ParticleRecording mRecording;
 
 };
 
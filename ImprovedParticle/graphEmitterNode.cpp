@@ -677,6 +677,7 @@ bool GraphEmitterNode::onNewDataBlock( GameBaseData *dptr, bool reload )
 	   }
 	   mEmitter->sticky = sticky;
 	   mEmitter->attractionrange = attractionrange;
+	   mEmitter->updateAttraction();
    }
 
    for(int i = 0; i < initialValues.size(); i=i+2)
@@ -989,7 +990,7 @@ void GraphEmitterNode::unpackUpdate(NetConnection* con, BitStream* stream)
 				mEmitter->attractedObjectID[i] = attractedObjectID[i];
 				mEmitter->Attraction_offset[i] = Attraction_offset[i];
 			}
-			
+			mEmitter->updateAttraction();
 		}
    }
    //ExprEditted
@@ -1231,6 +1232,7 @@ void GraphEmitterNode::setEmitterDataBlock(GraphEmitterData* data)
 			    mEmitter->Amount[i] = Amount[i];
 			    mEmitter->Attraction_offset[i] = Attraction_offset[i];
 			}
+			mEmitter->updateAttraction();
 		}
    }
 
@@ -1516,17 +1518,7 @@ void GraphEmitterNode::onDynamicModified(const char* slotName, const char*newVal
 
 F32 GraphEmitterNode::TerrainZ(F32 X, F32 Y)
 {
-	Point3F startPnt( X, Y, 10000.0f );
-	Point3F endPnt( X, Y, -10000.0f );
-
-	RayInfo ri;
-	bool hit;
-	hit = gClientContainer.castRay(startPnt, endPnt, TerrainObjectType, &ri);   
-	F32 height = 0;
-	if ( hit ){
-		height = ri.point.z;
-	}
-	return height - getPosition().z;
+	return mTerrainCache.getHeight(X, Y) - getPosition().z;
 }
 
 //-----------------------------------------------------------------------------
@@ -1662,4 +1654,59 @@ DefineEngineMethod(GraphEmitterNode, setDataBlock, void, (void),,
    "Delete the emitter.\n")
 {
 	object->safeDelete();
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( benchmarkGraphExpressions, void, ( S32 numEvals ), ( 1000000 ),
+	"@brief Times the expressions of the graph emitter with the muParser bytecode "
+	"interpreter and with the compiled closure tree.\n\n"
+	"The expressions are the typical graph emitter functions of t, spirals and "
+	"polynomials. The results of both evaluators are compared as well.\n\n"
+	"@param numEvals Number of evaluations per expression and evaluator.\n"
+	"@internal")
+{
+	static const char* expressions[] =
+	{
+		"sin(t/10)*t/100",
+		"cos(t/10)*t/100",
+		"t*t*0.001-2*t+3",
+		"sin(t)*cos(t*2)+t^2*0.5-t/3",
+	};
+
+	F32 t = 0.0f;
+	for( U32 i = 0; i < sizeof(expressions) / sizeof(expressions[0]); i++ )
+	{
+		U32 time[2];
+		F32 sum[2];
+		try
+		{
+			for( U32 compiled = 0; compiled < 2; compiled++ )
+			{
+				Parser parser;
+				parser.DefineVar( "t", &t );
+				parser.SetExpr( expressions[i] );
+				parser.EnableCompiler( compiled == 1 );
+
+				sum[compiled] = 0.0f;
+				U32 start = Platform::getRealMilliseconds();
+				for( S32 n = 0; n < numEvals; n++ )
+				{
+					t = n * 0.001f;
+					sum[compiled] += parser.Eval();
+				}
+				time[compiled] = Platform::getRealMilliseconds() - start;
+			}
+		}
+		catch( mu::Parser::exception_type &e )
+		{
+			Con::errorf( "benchmarkGraphExpressions - %s: %s", expressions[i], e.GetMsg().c_str() );
+			continue;
+		}
+
+		Con::printf( "%-28s interpreter %5ims, compiled %5ims, speedup %.2fx%s", expressions[i],
+			time[0], time[1], time[1] ? (F32)time[0] / time[1] : 0.0f,
+			sum[0] == sum[1] ? "" : " - RESULTS DIFFER" );
+	}
 }
\ No newline at end of file
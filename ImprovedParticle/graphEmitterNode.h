@@ -20,6 +20,10 @@
 #include "core/stream/bitStream.h"
 #endif
 
+#ifndef _H_TERRAIN_HEIGHT_CACHE
+#include "terrainHeightCache.h"
+#endif
+
 using namespace mu;
 static const int attrobjectCount = 2;
 
@@ -197,7 +201,8 @@ class GraphEmitterNode : public GameBase
 	F32 zMnDist;
 
 	int thisPtr;
-	F32 TerrainZ(F32 X, F32 Y);
+	TerrainHeightCache mTerrainCache;			///< Terrain heights around the node for the terz variable
+	F32 TerrainZ(F32 X, F32 Y);					///< Terrain height at X, Y relative to the node
 
    void updateMaxMinDistances();
 
@@ -213,6 +218,7 @@ class GraphEmitterNode : public GameBase
    ~GraphEmitterNode();
    
    GraphEmitter *getGraphEmitter() {return mEmitter;}
+   F32 getTimeMultiple() const { return mDataBlock ? mDataBlock->timeMultiple : 1.0f; }
    
    // Time/Move Management
   public:
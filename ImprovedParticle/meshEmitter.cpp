@@ -5,6 +5,9 @@
 
 #include "platform/platform.h"
 #include "meshEmitter.h"
+#include "particleIntegrator.h"
+#include "particleCapacity.h"
+#include "particleCamera.h"
 
 #include "scene/sceneManager.h"
 #include "scene/sceneRenderState.h"
@@ -34,9 +37,6 @@
 #include <string>
 #include <vector>
 
-#if defined(TORQUE_OS_XENON)
-#  include "gfx/D3D9/360/gfx360MemVertexBuffer.h"
-#endif
 
 Point3F MeshEmitter::mWindVelocity( 0.0, 0.0, 0.0 );
 const F32 MeshEmitter::AgedSpinToRadians = (1.0f/1000.0f) * (1.0f/360.0f) * M_PI_F * 2.0f;
@@ -101,6 +101,16 @@ static const float sgDefaultEjectionOffset = 0.f;
 static const float sgDefaultPhiReferenceVel = 0.f;
 static const float sgDefaultPhiVariance = 360.f;
 
+// The object box is padded by BoundsPadding of the size of the particle
+// bounds, at least MinBoundsPadding, and only refit when the particles leave
+// it or their padded bounds shrink below BoundsShrinkRatio of it.
+static const F32 BoundsPadding = 0.25f;
+static const F32 MinBoundsPadding = 0.5f;
+static const F32 BoundsShrinkRatio = 0.5f;
+
+// Particles per chunk when the vertices of an emitter are filled in parallel.
+static const U32 VertexFillChunk = 1024;
+
 //-----------------------------------------------------------------------------
 // MeshEmitterData
 // Changed
@@ -130,12 +140,16 @@ MeshEmitterData::MeshEmitterData()
 	useEmitterColors = false;
 	particleString   = NULL;
 	partListInitSize = 0;
+	maxPartLifeMS = 0;
 
 	// These members added for support of user defined blend factors
 	// and optional particle sorting.
 	blendStyle = ParticleRenderInst::BlendUndefined;
 	sortParticles = false;
 	renderReflection = true;
+	budgetPriority = 0;
+	fixedStepMS = 0;
+	randomSeed = 0;
 	reverseOrder = false;
 	textureName = 0;
 	textureHandle = 0;
@@ -268,6 +282,46 @@ void MeshEmitterData::initPersistFields()
 	//@}
 
 	endGroup( "MeshEmitterData" );
+
+	addGroup( "LOD" );
+
+	addField( "lodDistance", TYPEID< F32 >(), Offset(lodBands.distance, MeshEmitterData), ParticleLOD::MaxBands,
+		"Distance from the camera each detail band starts at, in increasing order. Closer "
+		"than the first band the emitter runs at full detail, bands left at 0 are unused." );
+
+	addField( "lodEjectionRate", TYPEID< F32 >(), Offset(lodBands.ejectionRate, MeshEmitterData), ParticleLOD::MaxBands,
+		"Fraction of the particles ejected at the distance of each band, from 0.01 to 1. "
+		"The rate is blended between the bands, starting from 1 at the camera." );
+
+	addField( "lodMaxParticles", TYPEID< S32 >(), Offset(lodBands.maxParticles, MeshEmitterData), ParticleLOD::MaxBands,
+		"Most particles alive at once in each band, 0 for no limit. No particles are "
+		"ejected while the emitter is at the limit." );
+
+	addField( "lodTickInterval", TYPEID< S32 >(), Offset(lodBands.tickInterval, MeshEmitterData), ParticleLOD::MaxBands,
+		"The particles are simulated every this many frames in each band, from 1 to 8." );
+
+	addField( "lodSortDistance", TYPEID< F32 >(), Offset(lodBands.sortDistance, MeshEmitterData),
+		"Beyond this distance the particles are not sorted, 0 to always sort them." );
+
+	endGroup( "LOD" );
+
+	addField( "budgetPriority", TYPEID< S32 >(), Offset(budgetPriority, MeshEmitterData),
+		"When the particles of all the emitters are over the budget set with "
+		"setParticleBudget(), emitters with a lower priority stop spawning first, "
+		"and distant emitters first within a priority." );
+
+	addGroup( "Deterministic" );
+
+	addField( "fixedStepMS", TYPEID< S32 >(), Offset(fixedStepMS, MeshEmitterData),
+		"Simulate the particles in steps of this many milliseconds, whatever the frame "
+		"rate, so the same inputs always give the same particles. The emitters are "
+		"left out of the LOD and the particle budget. 0 to simulate once per frame." );
+
+	addField( "randomSeed", TYPEID< S32 >(), Offset(randomSeed, MeshEmitterData),
+		"Seed of the random numbers of the emitters, which then all emit the same "
+		"particles. 0 to seed each emitter randomly." );
+
+	endGroup( "Deterministic" );
    /*
     addField( "Sticky", TYPEID< bool >(), Offset(sticky, MeshEmitterData),
     "If true then bla." );*/
@@ -328,6 +382,11 @@ void MeshEmitterData::packData(BitStream* stream)
 	}
 	stream->writeFlag(highResOnly);
 	stream->writeFlag(renderReflection);
+	lodBands.pack( stream );
+	stream->write( budgetPriority );
+	if( stream->writeFlag( fixedStepMS > 0 ) )
+		stream->writeInt( fixedStepMS, 10 );
+	stream->write( randomSeed );
 	stream->writeInt( blendStyle, 4 );
 }
 
@@ -376,12 +435,16 @@ void MeshEmitterData::unpackData(BitStream* stream)
 	}
 	highResOnly = stream->readFlag();
 	renderReflection = stream->readFlag();
+	lodBands.unpack( stream );
+	stream->read( &budgetPriority );
+	fixedStepMS = stream->readFlag() ? stream->readInt( 10 ) : 0;
+	stream->read( &randomSeed );
 	blendStyle = stream->readInt( 4 );
 }
 
 //-----------------------------------------------------------------------------
 // onAdd
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 bool MeshEmitterData::onAdd()
 {
@@ -458,6 +521,11 @@ bool MeshEmitterData::onAdd()
 		Con::warnf(ConsoleLogEntry::General, "MeshEmitterData(%s) lifetimeVarianceMS >= lifetimeMS", getName());
 		lifetimeVarianceMS = lifetimeMS;
 	}
+	if( fixedStepMS < 0 || fixedStepMS > 500 )
+	{
+		Con::warnf(ConsoleLogEntry::General, "MeshEmitterData(%s) fixedStepMS not in [0, 500]", getName());
+		fixedStepMS = mClamp( fixedStepMS, 0, 500 );
+	}
 
 
 	// load the particle datablocks...
@@ -514,12 +582,14 @@ bool MeshEmitterData::onAdd()
 		}
 	}
 
+	lodBands.validate( "MeshEmitterData", getName() );
+
 	return true;
 }
 
 //-----------------------------------------------------------------------------
 // preload
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 bool MeshEmitterData::preload(bool server, String &errorStr)
 {
@@ -582,71 +652,28 @@ bool MeshEmitterData::preload(bool server, String &errorStr)
 
 	if( !server )
 	{
-		allocPrimBuffer();
+		calcPartListInitSize();
+
+		// Bake the colors and sizes of the particles over their age
+		keyCurves.setSize( particleDataBlocks.size() );
+		for( S32 i = 0; i < particleDataBlocks.size(); i++ )
+			keyCurves[i].bake( particleDataBlocks[i] );
 	}
 
 	return true;
 }
 
 //-----------------------------------------------------------------------------
-// alloc PrimitiveBuffer
-// The datablock allocates this static index buffer because it's the same
-// for all of the emitters - each particle quad uses the same index ordering
-// Not changed
+// calcPartListInitSize
+// The number of particles the emitters reserve room for at the emission rate
+// of the datablock, the most particles that can be alive at once.
 //-----------------------------------------------------------------------------
-void MeshEmitterData::allocPrimBuffer( S32 overrideSize )
+void MeshEmitterData::calcPartListInitSize()
 {
 	// calculate particle list size
 	AssertFatal(particleDataBlocks.size() > 0, "Error, no particles found." );
-	U32 maxPartLife = particleDataBlocks[0]->lifetimeMS + particleDataBlocks[0]->lifetimeVarianceMS;
-	for (S32 i = 1; i < particleDataBlocks.size(); i++)
-	{
-		U32 mpl = particleDataBlocks[i]->lifetimeMS + particleDataBlocks[i]->lifetimeVarianceMS;
-		if (mpl > maxPartLife)
-			maxPartLife = mpl;
-	}
-
-	partListInitSize = maxPartLife / (ejectionPeriodMS - periodVarianceMS);
-	partListInitSize += 8; // add 8 as "fudge factor" to make sure it doesn't realloc if it goes over by 1
-
-	// if override size is specified, then the emitter overran its buffer and needs a larger allocation
-	if( overrideSize != -1 )
-	{
-		partListInitSize = overrideSize;
-	}
-
-	// create index buffer based on that size
-	U32 indexListSize = partListInitSize * 6; // 6 indices per particle
-	U16 *indices = new U16[ indexListSize ];
-
-	for( U32 i=0; i<partListInitSize; i++ )
-	{
-		// this index ordering should be optimal (hopefully) for the vertex cache
-		U16 *idx = &indices[i*6];
-		volatile U32 offset = i * 4;  // set to volatile to fix VC6 Release mode compiler bug
-		idx[0] = 0 + offset;
-		idx[1] = 1 + offset;
-		idx[2] = 3 + offset;
-		idx[3] = 1 + offset;
-		idx[4] = 3 + offset;
-		idx[5] = 2 + offset;
-	}
-
-
-	U16 *ibIndices;
-	GFXBufferType bufferType = GFXBufferTypeStatic;
-
-#ifdef TORQUE_OS_XENON
-	// Because of the way the volatile buffers work on Xenon this is the only
-	// way to do this.
-	bufferType = GFXBufferTypeVolatile;
-#endif
-	primBuff.set( GFX, indexListSize, 0, bufferType );
-	primBuff.lock( &ibIndices );
-	dMemcpy( ibIndices, indices, indexListSize * sizeof(U16) );
-	primBuff.unlock();
-
-	delete [] indices;
+	maxPartLifeMS = ParticleCapacity::getMaxLifetime(particleDataBlocks);
+	partListInitSize = ParticleCapacity::estimate(maxPartLifeMS, ejectionPeriodMS, periodVarianceMS);
 }
 
 //-----------------------------------------------------------------------------
@@ -667,19 +694,29 @@ MeshEmitter::MeshEmitter()
 	mInternalClock    = 0;
 	mNextParticleTime = 0;
 
+	mUpdateMS    = 0;
+	mUpdateCount = 0;
+
+	mCulledTicks  = 0;
+	mCulled       = false;
+	mCullStateSet = false;
+
+	mCapacityPeriodMS   = 0;
+	mCapacityVarianceMS = 0;
+
+	mPartBounds = Box3F::Invalid;
+	mMaxPartSize = 0.0f;
+	mNumBoundsUpdates = 0;
+
+	mKeyCurvesDirty = true;
+
 	mLastPosition.set(0, 0, 0);
 	mHasLastPosition = false;
 
 	mLifetimeMS = 0;
 	mElapsedTimeMS = 0;
+	mStepTime = 0.0f;
 
-	part_store = 0;
-	part_freelist = NULL;
-	part_list_head.next = NULL;
-	n_part_capacity = 0;
-	n_parts = 0;
-
-	mCurBuffSize = 0;
 
 	mDead = false;
 
@@ -723,7 +760,6 @@ MeshEmitter::MeshEmitter()
 	evenEmission = true;
 	emitOnFaces = true;
 	emitMesh = "";
-	vertexCount = 0;
 
 	// Physics variables
 	sticky = false;
@@ -740,17 +776,10 @@ MeshEmitter::MeshEmitter()
 
 //-----------------------------------------------------------------------------
 // destructor
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 MeshEmitter::~MeshEmitter()
 {
-	if(isClientObject())
-	{
-		for( S32 i = 0; i < part_store.size(); i++ )
-		{
-			delete [] part_store[i];
-		}
-	}
 }
 
 //-----------------------------------------------------------------------------
@@ -906,7 +935,7 @@ bool MeshEmitter::_setAlignDirection( void *object, const char *index, const cha
 
 //-----------------------------------------------------------------------------
 // onAdd
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 bool MeshEmitter::onAdd()
 {
@@ -915,6 +944,9 @@ bool MeshEmitter::onAdd()
 
 	if(isServerObject())
 		setMaskBits( StateMask );
+	// Deterministic emitters aren't throttled
+	else if( mDataBlock->fixedStepMS == 0 )
+		mBudget.registerClient();
 
 	F32 radius = 0.5;
 	mObjBox.minExtents = Point3F(-radius, -radius, -radius);
@@ -928,10 +960,12 @@ bool MeshEmitter::onAdd()
 
 //-----------------------------------------------------------------------------
 // onRemove
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::onRemove()
 {
+	ParticleJobScheduler::cancel( this );
+	mBudget.unregisterClient();
 	removeFromScene();
 	Parent::onRemove();
 }
@@ -946,36 +980,31 @@ bool MeshEmitter::onNewDataBlock( GameBaseData *dptr, bool reload )
 	if ( !mDataBlock || !Parent::onNewDataBlock( dptr, reload ) )
 		return false;
 
+	mBudget.setPriority( mDataBlock->budgetPriority );
+	if( mDataBlock->fixedStepMS > 0 )
+		mBudget.unregisterClient();
+	else if( isProperlyAdded() && isClientObject() )
+		mBudget.registerClient();
+
+	// Without a seed every emitter gets its own sequence
+	mRandom.setSeed( mDataBlock->randomSeed != 0 ? U32( mDataBlock->randomSeed ) : gRandGen.randI() );
+
 	mLifetimeMS = lifetimeMS;
 	if( lifetimeVarianceMS )
 	{
-		mLifetimeMS += S32( gRandGen.randI() % (2 * lifetimeVarianceMS + 1)) - S32(lifetimeVarianceMS );
+		mLifetimeMS += S32( mRandom.randI() % (2 * lifetimeVarianceMS + 1)) - S32(lifetimeVarianceMS );
 	}
 
-	//   Allocate particle structures and init the freelist. Member part_store
-	//   is a Vector so that we can allocate more particles if partListInitSize
-	//   turns out to be too small. 
+	//   Allocate the particle pool for the emission rate of the datablock.
+	//   The pool grows if the rate is overridden or partListInitSize turns
+	//   out to be too small.
 	//
 	if (mDataBlock->partListInitSize > 0)
 	{
-		for( S32 i = 0; i < part_store.size(); i++ )
-		{
-			delete [] part_store[i];
-		}
-		part_store.clear();
-		n_part_capacity = mDataBlock->partListInitSize;
-		Particle* store_block = new Particle[n_part_capacity];
-		part_store.push_back(store_block);
-		part_freelist = store_block;
-		Particle* last_part = part_freelist;
-		Particle* part = last_part+1;
-		for( S32 i = 1; i < n_part_capacity; i++, part++, last_part++ )
-		{
-			last_part->next = part;
-		}
-		store_block[n_part_capacity-1].next = NULL;
-		part_list_head.next = NULL;
-		n_parts = 0;
+		mParts.reset();
+		reserveParticles(mDataBlock->partListInitSize);
+		mCapacityPeriodMS = mDataBlock->ejectionPeriodMS;
+		mCapacityVarianceMS = mDataBlock->periodVarianceMS;
 	}
 
 	// Copy values from DB -----
@@ -1072,6 +1101,10 @@ bool MeshEmitter::onNewDataBlock( GameBaseData *dptr, bool reload )
 			i++;
 		}
    }
+	updateAttraction();
+
+	mKeyCurves.clear();
+	mKeyCurvesDirty = true;
 
 	scriptOnNewDataBlock();
 	return true;
@@ -1079,17 +1112,17 @@ bool MeshEmitter::onNewDataBlock( GameBaseData *dptr, bool reload )
 
 //-----------------------------------------------------------------------------
 // getCollectiveColor
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 ColorF MeshEmitter::getCollectiveColor()
 {
 	U32 count = 0;
 	ColorF color = ColorF(0.0f, 0.0f, 0.0f);
 
-	count = n_parts;
-	for( Particle* part = part_list_head.next; part != NULL; part = part->next )
+	count = mParts.size();
+	for( U32 i = 0; i < count; i++ )
 	{
-		color += part->color;
+		color += mParts.color[i];
 	}
 
 	if(count > 0)
@@ -1105,7 +1138,7 @@ ColorF MeshEmitter::getCollectiveColor()
 
 //-----------------------------------------------------------------------------
 // prepRenderImage
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::prepRenderImage(SceneRenderState* state)
 {
@@ -1119,59 +1152,73 @@ void MeshEmitter::prepRenderImage(SceneRenderState* state)
 	PROFILE_SCOPE(MeshEmitter_prepRenderImage);
 
 	if (  mDead ||
-		n_parts == 0 || 
-		part_list_head.next == NULL )
+		mParts.empty() )
 		return;
 
 	RenderPassManager *renderManager = state->getRenderPass();
 	const Point3F &camPos = state->getCameraPosition();
 	copyToVB( camPos, state->getAmbientLightColor() );
 
-	if (!mVertBuff.isValid())
+	if (mVertBuffs.empty())
 		return;
 
-	ParticleRenderInst *ri = renderManager->allocInst<ParticleRenderInst>();
-
-	ri->vertBuff = &mVertBuff;
-	ri->primBuff = &getDataBlock()->primBuff;
-	ri->translucentSort = true;
-	ri->type = RenderPassManager::RIT_Particle;
-	ri->sortDistSq = getRenderWorldBox().getSqDistanceToPoint( camPos );
-
-	// Draw the system offscreen unless the highResOnly flag is set on the datablock
-	ri->systemState = ( getDataBlock()->highResOnly ? PSS_AwaitingHighResDraw : PSS_AwaitingOffscreenDraw );
-
-	ri->modelViewProj = renderManager->allocUniqueXform(  GFX->getProjectionMatrix() * 
+	const MatrixF *modelViewProj = renderManager->allocUniqueXform(  GFX->getProjectionMatrix() * 
 		GFX->getViewMatrix() * 
 		GFX->getWorldMatrix() );
 
 	// Update position on the matrix before multiplying it
 	mBBObjToWorld.setPosition(mLastPosition);
 
-	ri->bbModelViewProj = renderManager->allocUniqueXform( *ri->modelViewProj * mBBObjToWorld );
-
-	ri->count = n_parts;
-
-	ri->blendStyle = blendStyle;
+	const MatrixF *bbModelViewProj = renderManager->allocUniqueXform( *modelViewProj * mBBObjToWorld );
 
 	// use first particle's texture unless there is an emitter texture to override it
+	GFXTextureObject *diffuseTex;
 	if (mDataBlock->textureHandle)
-		ri->diffuseTex = &*(mDataBlock->textureHandle);
+		diffuseTex = &*(mDataBlock->textureHandle);
 	else
-		ri->diffuseTex = &*(part_list_head.next->dataBlock->textureHandle);
+		diffuseTex = &*(mParts.dataBlock[0]->textureHandle);
+
+	const F32 sortDistSq = getRenderWorldBox().getSqDistanceToPoint( camPos );
+	const F32 batchSortBias = getMax( sortDistSq * 0.0001f, 0.001f );
+	const U32 numBatches = mVertBuffs.size();
+
+	// One render instance per batch, all drawing with the same quad indices.
+	for (U32 batch = 0; batch < numBatches; batch++)
+	{
+		ParticleRenderInst *ri = renderManager->allocInst<ParticleRenderInst>();
+
+		ri->vertBuff = mVertBuffs[batch];
+		ri->translucentSort = true;
+		ri->type = RenderPassManager::RIT_Particle;
+
+		// The earlier batches hold the farther particles when sorted, push
+		// them back a little so they are drawn first.
+		ri->sortDistSq = sortDistSq + batchSortBias * (numBatches - 1 - batch);
+
+		// Draw the system offscreen unless the highResOnly flag is set on the datablock
+		ri->systemState = ( getDataBlock()->highResOnly ? PSS_AwaitingHighResDraw : PSS_AwaitingOffscreenDraw );
 
-	ri->softnessDistance = softnessDistance; 
+		ri->modelViewProj = modelViewProj;
+		ri->bbModelViewProj = bbModelViewProj;
 
-	// Sort by texture too.
-	ri->defaultKey = ri->diffuseTex ? (U32)ri->diffuseTex : (U32)ri->vertBuff;
+		ri->count = getMin( mParts.size() - batch * ParticleBufferPool::MaxBatchQuads, (U32)ParticleBufferPool::MaxBatchQuads );
+		ri->primBuff = ParticleBufferPool::getQuadIndices(ri->count);
 
-	renderManager->addInst( ri );
+		ri->blendStyle = blendStyle;
+		ri->diffuseTex = diffuseTex;
+		ri->softnessDistance = softnessDistance; 
+
+		// Sort by texture too.
+		ri->defaultKey = ri->diffuseTex ? (U32)ri->diffuseTex : (U32)ri->vertBuff;
+
+		renderManager->addInst( ri );
+	}
 
 }
 
 //-----------------------------------------------------------------------------
 // setSizes
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::setSizes( F32 *sizeList )
 {
@@ -1179,11 +1226,12 @@ void MeshEmitter::setSizes( F32 *sizeList )
 	{
 		sizes[i] = sizeList[i];
 	}
+	mKeyCurvesDirty = true;
 }
 
 //-----------------------------------------------------------------------------
 // setColors
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::setColors( ColorF *colorList )
 {
@@ -1191,11 +1239,12 @@ void MeshEmitter::setColors( ColorF *colorList )
 	{
 		colors[i] = colorList[i];
 	}
+	mKeyCurvesDirty = true;
 }
 
 //-----------------------------------------------------------------------------
 // deleteWhenEmpty
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::deleteWhenEmpty()
 {
@@ -1212,7 +1261,7 @@ void MeshEmitter::deleteWhenEmpty()
 	if (okToDelete)
 	{
 		mDeleteWhenEmpty = true;
-		if( !n_parts )
+		if( mParts.empty() )
 		{
 			// We're already empty, so delete us now.
 
@@ -1237,6 +1286,9 @@ void MeshEmitter::emitParticles(
 	if( mDataBlock->particleDataBlocks.empty() )
 		return;
 
+	// The emission rate can be changed on the emitter
+	updateCapacity( ejectionPeriodMS, periodVarianceMS );
+
 	// lifetime over - no more particles
 	if( mLifetimeMS > 0 && mElapsedTimeMS > mLifetimeMS )
 	{
@@ -1245,6 +1297,10 @@ void MeshEmitter::emitParticles(
 
 	U32 currTime = 0;
 	bool particlesAdded = false;
+	const U32 firstNewPart = mParts.size();
+
+	// Read the transform of the emitMesh once for all the particles
+	mEmitSurface.update();
 
 	if( mNextParticleTime != 0 )
 	{
@@ -1268,8 +1324,11 @@ void MeshEmitter::emitParticles(
 			mInternalClock += mNextParticleTime;
 			// Emit particle at curr time
 			// Also send the node on addParticle
-			addParticle(velocity);
-			particlesAdded = true;
+			if( mLOD.canAdd( mParts.size() ) && mBudget.trySpawn() )
+			{
+				addParticle(velocity);
+				particlesAdded = true;
+			}
 			mNextParticleTime = 0;
 		}
 	}
@@ -1279,9 +1338,11 @@ void MeshEmitter::emitParticles(
 		S32 nextTime = ejectionPeriodMS;
 		if( periodVarianceMS != 0 )
 		{
-			nextTime += S32(gRandGen.randI() % (2 * periodVarianceMS + 1)) -
+			nextTime += S32(mRandom.randI() % (2 * periodVarianceMS + 1)) -
 				S32(periodVarianceMS);
 		}
+		// Distant emitters eject fewer particles
+		nextTime = mLOD.scalePeriod( nextTime );
 		AssertFatal(nextTime > 0, "Error, next particle ejection time must always be greater than 0");
 
 		if( currTime + nextTime > numMilliseconds )
@@ -1295,40 +1356,45 @@ void MeshEmitter::emitParticles(
 		currTime       += nextTime;
 		mInternalClock += nextTime;
 
+		// Distant emitters hold back new particles while at their limit, and
+		// all emitters while over the budget
+		if( !mLOD.canAdd( mParts.size() ) || !mBudget.trySpawn() )
+			continue;
+
+		U32 prevParts = mParts.size();
 		addParticle(velocity);
 		particlesAdded = true;
 
 		//   This override-advance code is restored in order to correctly adjust
 		//   animated parameters of particles allocated within the same frame
-		//   update. Note that ordering is important and this code correctly 
-		//   adds particles in the same newest-to-oldest ordering of the link-list.
+		//   update.
 		//
-		// NOTE: We are assuming that the just added particle is at the head of our
-		//  list.  If that changes, so must this...
+		// NOTE: New particles are always appended to the pool, so the just added
+		//  particle is the last one.  If that changes, so must this...
 		U32 advanceMS = numMilliseconds - currTime;
-		if (overrideAdvance == false && advanceMS != 0) 
+		if (overrideAdvance == false && advanceMS != 0 && mParts.size() > prevParts) 
 		{
-			Particle* last_part = part_list_head.next;
-			if (advanceMS > last_part->totalLifetime) 
+			U32 last_part = mParts.size() - 1;
+			if (advanceMS > mParts.totalLifetime[last_part]) 
 			{
-				part_list_head.next = last_part->next;
-				n_parts--;
-				last_part->next = part_freelist;
-				part_freelist = last_part;
+				mParts.kill(last_part);
 			} 
 			else 
 			{
 				if (advanceMS != 0)
 				{
 					F32 t = F32(advanceMS) / 1000.0;
+					const ParticleData *partDB = mParts.dataBlock[last_part];
 
-					Point3F a = last_part->acc;
-					a -= last_part->vel * last_part->dataBlock->dragCoefficient;
-					a -= mWindVelocity * last_part->dataBlock->windCoefficient;
-					a += Point3F(0.0f, 0.0f, -9.81f) * last_part->dataBlock->gravityCoefficient;
+					Point3F vel = mParts.getVel(last_part);
+					Point3F a = mParts.getAcc(last_part);
+					a -= vel * partDB->dragCoefficient;
+					a -= mWindVelocity * partDB->windCoefficient;
+					a += Point3F(0.0f, 0.0f, -9.81f) * partDB->gravityCoefficient;
 
-					last_part->vel += a * t;
-					last_part->pos += last_part->vel * t;
+					vel += a * t;
+					mParts.setVel(last_part, vel);
+					mParts.setPos(last_part, mParts.getPos(last_part) + vel * t);
 
 					updateKeyData( last_part );
 				}
@@ -1336,12 +1402,14 @@ void MeshEmitter::emitParticles(
 		}
 	}
 
-	// DMMFIX: Lame and slow...
 	if( particlesAdded == true )
-		updateBBox();
+	{
+		extendBounds( firstNewPart );
+		updateBounds();
+	}
 
 
-	if( n_parts > 0 && getSceneManager() == NULL )
+	if( !mParts.empty() && getSceneManager() == NULL )
 	{
 		gClientSceneGraph->addObjectToScene(this);
 		//ClientProcessList::get()->addObject(this);
@@ -1352,24 +1420,42 @@ void MeshEmitter::emitParticles(
 }
 
 //-----------------------------------------------------------------------------
-// updateBBox - SLOW, bad news
-// Not changed
+// extendBounds
 //-----------------------------------------------------------------------------
-void MeshEmitter::updateBBox()
+void MeshEmitter::extendBounds( U32 first )
 {
-	Point3F minPt(1e10,   1e10,  1e10);
-	Point3F maxPt(-1e10, -1e10, -1e10);
-
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	for (U32 i = first; i < mParts.size(); i++)
 	{
-		Point3F particleSize(part->size * 0.5f, 0.0f, part->size * 0.5f);
-		minPt.setMin( part->pos - particleSize );
-		maxPt.setMax( part->pos + particleSize );
+		mPartBounds.extend( mParts.getPos(i) );
+		mMaxPartSize = getMax( mMaxPartSize, mParts.partSize[i] );
 	}
+}
 
-	mObjBox = Box3F(minPt, maxPt);
+//-----------------------------------------------------------------------------
+// updateBounds
+// Setting the transform moves the emitter in the scene container, so the
+// box is padded and kept while it still holds the particles.
+//-----------------------------------------------------------------------------
+void MeshEmitter::updateBounds()
+{
+	if( mParts.empty() || !mPartBounds.isValidBox() )
+		return;
+
+	// The particles are drawn as quads around their positions
+	const Point3F halfSize( mMaxPartSize * 0.5f );
+	const Box3F partBox( mPartBounds.minExtents - halfSize, mPartBounds.maxExtents + halfSize );
+
+	Point3F padding = partBox.getExtents() * BoundsPadding;
+	padding.setMax( Point3F( MinBoundsPadding ) );
+	const Box3F paddedBox( partBox.minExtents - padding, partBox.maxExtents + padding );
+
+	if( mObjBox.isContained( partBox ) && paddedBox.len() >= mObjBox.len() * BoundsShrinkRatio )
+		return;
+
+	mObjBox = paddedBox;
 	MatrixF temp = getTransform();
 	setTransform(temp);
+	mNumBoundsUpdates++;
 
 	mBBObjToWorld.identity();
 	Point3F boxScale = mObjBox.getExtents();
@@ -1379,6 +1465,40 @@ void MeshEmitter::updateBBox()
 	mBBObjToWorld.scale(boxScale);
 }
 
+//-----------------------------------------------------------------------------
+// reserveParticles
+//-----------------------------------------------------------------------------
+void MeshEmitter::reserveParticles( U32 count )
+{
+	mParts.reserve( count );
+}
+
+//-----------------------------------------------------------------------------
+// updateCapacity
+//-----------------------------------------------------------------------------
+void MeshEmitter::updateCapacity( S32 periodMS, S32 varianceMS )
+{
+	if( periodMS == mCapacityPeriodMS && varianceMS == mCapacityVarianceMS )
+		return;
+
+	mCapacityPeriodMS = periodMS;
+	mCapacityVarianceMS = varianceMS;
+	reserveParticles( ParticleCapacity::estimate( mDataBlock->maxPartLifeMS, periodMS, varianceMS ) );
+}
+
+//-----------------------------------------------------------------------------
+// growParticles
+//-----------------------------------------------------------------------------
+void MeshEmitter::growParticles()
+{
+	const U32 oldCapacity = mParts.capacity();
+	reserveParticles( ParticleCapacity::grow( oldCapacity ) );
+	ParticleCapacity::recordGrowth( this, oldCapacity, mParts.capacity() );
+}
+
+//-----------------------------------------------------------------------------
+// addParticle
+//-----------------------------------------------------------------------------
 void MeshEmitter::addParticle(const F32 &vel)
 {
 	// This should never happen
@@ -1387,563 +1507,78 @@ void MeshEmitter::addParticle(const F32 &vel)
 		return;
 	PROFILE_SCOPE(meshEmitAddPart);
 
-	n_parts++;
-	if (n_parts > n_part_capacity || n_parts > mDataBlock->partListInitSize)
-	{
-		// In an emergency we allocate additional particles in blocks of 16.
-		// This should happen rarely.
-		Particle* store_block = new Particle[16];
-		part_store.push_back(store_block);
-		n_part_capacity += 16;
-		for (S32 i = 0; i < 16; i++)
-		{
-			store_block[i].next = part_freelist;
-			part_freelist = &store_block[i];
-		}
-		mDataBlock->allocPrimBuffer(n_part_capacity); // allocate larger primitive buffer or will crash 
-	}
-	Particle* pNew = part_freelist;
-	part_freelist = pNew->next;
-	pNew->next = part_list_head.next;
-	part_list_head.next = pNew;
+	// In an emergency the pool grows geometrically.
+	// This should happen rarely.
+	if (mParts.size() >= mParts.capacity())
+		growParticles();
+	// The particle is built here and copied into the pool once initialized
+	Particle part;
+	part.pos = getPosition();
+	part.vel.zero();
+	part.orientDir.set(0, 0, 1);
+	part.relPos.zero();
+
+	// The numbers of the spawn are drawn at once: the velocity, the vertex or
+	//  - triangle, the point in the triangle and the datablock
+	F32 randoms[7];
+	mRandom.fill( randoms, 7 );
 
 	F32 initialVel = ejectionVelocity;
-	initialVel    += (velocityVariance * 2.0f * gRandGen.randF()) - velocityVariance;
-
-	// Check if the emitMesh matches a name
-	SceneObject* SB = dynamic_cast<SceneObject*>(Sim::findObject(emitMesh));
-	// If not then check if it matches an ID
-	if(!SB)
-		SB = dynamic_cast<SceneObject*>(Sim::findObject(atoi(emitMesh)));
-	// Make sure that we are dealing with some proper objects
-	if(dynamic_cast<GameBase*>(SB) || dynamic_cast<TSStatic*>(SB)){
-		// Seed the random generator - this should maybe be swapped out in favor for the gRandGen.
-		//  - Although they both work fine.
-		srand(mainTime);
-		// Throw out some trash results. Apparently the first 1-2 results fails to give proper random numbers.
-		int trash = rand();
-		trash = rand();
-		// Set our count value to mainTime.
-		U32 co = mainTime;
-		// If evenEmission is on, set the co to a random number for the per vertex emission.
-		if(evenEmission && vertexCount != 0)
-			co = gRandGen.randI() % vertexCount;
-		mainTime++;
-
-		ShapeBase* SS = dynamic_cast<ShapeBase*>(SB);
-		const TSShape* shape;
-		if(SS)
-			shape = SS->getShape();
-		else{
-			shape = (dynamic_cast<TSStatic*>(SB))->getShape();
-		}
-		bool coHandled = false;
-		// -------------------------------------------------------------------------------------------------
-		// -- Per vertex BEGIN -----------------------------------------------------------------------------
-		// -------------------------------------------------------------------------------------------------
+	initialVel    += (velocityVariance * 2.0f * randoms[0]) - velocityVariance;
+
+	// The emitMesh was gathered by loadFaces and its transform read in
+	//  - emitParticles, so all that is left is picking a point.
+	if(mEmitSurface.isValid() && (!emitOnFaces || mEmitSurface.getTriangleCount()))
+	{
+		Point3F objPos, objNormal;
 		if(!emitOnFaces)
 		{
 			PROFILE_SCOPE(meshEmitVertex);
-#pragma region perVertex
-			for(U32 objIndex = 0; objIndex < shape->objects.size(); objIndex++)
+			// Per vertex emission goes through the vertices in order,
+			//  - unless evenEmission is on, then the vertex is random.
+			const U32 vertexCount = mEmitSurface.getVertexCount();
+			U32 co;
+			if(evenEmission)
+				co = ParticleRandom::toIndex( randoms[1], vertexCount );
+			else
 			{
-				for (S32 meshIndex = 0; meshIndex < shape->meshes.size(); meshIndex++)
-				{
-                    if(!shape->meshes[meshIndex])
-						continue;
-
-					TSSkinMesh* sMesh = dynamic_cast<TSSkinMesh*>(shape->meshes[meshIndex]);
-					//TSMesh::TSMeshVertexArray vertexList = shape->meshes[meshIndex]->mVertexData;
-					S32 numVerts;
-					numVerts = shape->meshes[meshIndex]->mVertexData.size();
-					if (sMesh)
-						numVerts = sMesh[meshIndex].mVertexData.size();
-
-					if(!numVerts)
-						continue;
-
-					vertexCount = numVerts;
-
-					if(co >= numVerts)
-					{
-						co -= numVerts;
-						continue;
-					}
-					coHandled = true;
-					
-					// Apparently, creating a TSMesh::TSMeshVertexArray vertexList instead of 
-					//  - accessing the vertexdata directly can cause the program to crash on shutdown and startup.
-					//  - It calls it's deconstructor when it goes out of scope. Seems like a bug.
-					const Point3F *vertPos;
-					const Point3F *vertNorm;
-					if (sMesh)
-					{
-						vertPos = new const Point3F(sMesh[meshIndex].mVertexData[co].vert());
-						vertNorm = new const Point3F(sMesh[meshIndex].mVertexData[co].normal());
-					}
-					else
-					{
-						vertPos = new const Point3F(shape->meshes[meshIndex]->mVertexData[co].vert());
-						vertNorm = new const Point3F(shape->meshes[meshIndex]->mVertexData[co].normal());
-					}
-
-					// Get the transform of the object to get the transform matrix.
-					//  - If it is a TSStatic we need to access the rootnode aswell
-					//  - Which contains the rotation information.
-					MatrixF trans;
-					MatrixF nodetrans;
-					MatrixF mat;
-					if(SS)
-					{
-						trans = SS->getTransform();
-					}
-					else
-					{
-						trans = (dynamic_cast<TSStatic*>(SB))->getTransform();
-						nodetrans = dynamic_cast<TSStatic*>(SB)->getShapeInstance()->mNodeTransforms[0];
-						mat.mul(trans, nodetrans);
-					}
-
-					Point3F* p = new Point3F();
-					if(SS)
-					{
-						trans.mulV(*vertPos,p);
-						pNew->pos = SS->getPosition() + *p + (*vertNorm * ejectionOffset);
-					}
-					else{
-						mat.mulV((*vertPos * dynamic_cast<TSStatic*>(SB)->getScale()),p);
-						pNew->pos = dynamic_cast<TSStatic*>(SB)->getPosition() + *p + (*vertNorm * ejectionOffset);
-					}
-					// Set the relative position for later use.
-					pNew->relPos = *p +(*vertNorm * ejectionOffset);
-					// Velocity is based on the normal of the vertex
-					pNew->vel = *vertNorm * initialVel;
-					pNew->orientDir = *vertNorm;
-
-					// Clean up
-					delete(*p);
-					delete(*vertPos);
-					// Exit the loop
-					break;
-				}
-				if(coHandled)
-					break;
+				if(U32(mainTime) >= vertexCount)
+					mainTime = 0;
+				co = mainTime++;
 			}
-#pragma endregion
+			mEmitSurface.getVertex(co, objPos, objNormal);
 		}
-		// -------------------------------------------------------------------------------------------------
-		// -- Per vertex END -------------------------------------------------------------------------------
-		// -- Per triangle BEGIN ---------------------------------------------------------------------------
-		// -------------------------------------------------------------------------------------------------
-		if(emitOnFaces)
+		else
 		{
 			PROFILE_SCOPE(meshEmitFace);
-#pragma region perTriangle
-			S32 meshIndex;
-
-			TSSkinMesh* sMesh;
-			TSMesh* Mesh;
-			bool accepted = false;
-			bool skinmesh = false;
-			for(meshIndex = 0; meshIndex < shape->meshes.size(); meshIndex++)
-			{
-                if(!shape->meshes[meshIndex])
-                    continue;
-				sMesh = dynamic_cast<TSSkinMesh*>(shape->meshes[meshIndex]);
-				if(sMesh)
-				{
-					if(sMesh->mVertexData.size()){
-						skinmesh = true;
-						break;
-					}
-				}
-			}
-			// We don't want to run with partly skinmesh, partly static mesh.
-			//  - So here we filter out skinmeshes from static meshes.
-			while(!accepted)
-			{
-				accepted = false;
-				// Pick a random mesh and test it.
-				//  - This prevents the uneven emission from 
-				//  - being as linear as it is with per vertex.
-				meshIndex = rand() % shape->meshes.size();
-				Mesh = shape->meshes[meshIndex];
-                if(!Mesh) continue;
-                
-				if(Mesh)
-					accepted = true;
-				if(skinmesh)
-				{
-					sMesh = dynamic_cast<TSSkinMesh*>(shape->meshes[meshIndex]);
-					if(sMesh)
-					{
-						if(sMesh->mVertexData.size()){
-							accepted = true;
-							skinmesh = true;
-						}
-						else
-							accepted = false;
-					}
-					else
-						accepted = false;
-				}
-				if(!skinmesh)
-				{
-					if(Mesh->verts.size() > 0)
-						accepted = true;
-					if(Mesh->verts.size() <= 0)
-						accepted = false;
-					if(Mesh->mVertexData.size() > 0)
-						accepted = true;
-					if(Mesh->mVertexData.size() <= 0)
-						accepted = false;
-				}
-			}
-			if(!evenEmission)
-			{
-				PROFILE_SCOPE(meshEmitOdd);
-#pragma region skinMesh
-			if(skinmesh)
-			{
-				Vector<Point3F> normList = shape->meshes[meshIndex]->norms;
-				if (sMesh)
-				{
-					S32 numVerts = sMesh->mVertexData.size();
-					if(numVerts)
-					{
-						S32 numPrims = sMesh->primitives.size();
-						if(numPrims)
-						{
-							S32 numIndices = sMesh->indices.size();
-							if(numIndices)
-							{
-								// Get a random primitive
-								S32 primIndex = rand() % numPrims;
-								S32 start = sMesh->primitives[primIndex].start;
-								S32 numElements = sMesh->primitives[primIndex].numElements;
-
-								// Define some variables we will use later
-								TSMesh::__TSMeshVertexBase v1, v2, v3;
-								Point3F vp1;
-
-								// Test if the primitive is a triangle. Which it should be.
-								//  - Theres no handler for other primitives than triangles,
-								//  - if such is needed email me at LukasPJ@FuzzyVoidStudio.com
-								if ( (shape->meshes[meshIndex]->primitives[primIndex].matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles)
-								{
-									coHandled = true;
-									// Get a random triangle
-									U32 triStart = (rand() % (numElements/3));
-									// This is not really necessary due to the way we handle the
-									//  - triangles, but it is an useful snippet for modifications!
-									//  - due to some rendering thing, every other triangle is 
-									//  - counter clock wise. Read about it in the official DX9 docs.
-									U8 indiceBool = (triStart * 3) % 2;
-									if(indiceBool == 0)
-									{
-										v1 = sMesh->mVertexData[sMesh->indices[start + (triStart*3)]];
-										v2 = sMesh->mVertexData[sMesh->indices[start + (triStart*3) + 1]];
-										v3 = sMesh->mVertexData[sMesh->indices[start + (triStart*3) + 2]];
-									}
-									else
-									{
-										v3 = sMesh->mVertexData[sMesh->indices[start + (triStart*3)]];
-										v2 = sMesh->mVertexData[sMesh->indices[start + (triStart*3) + 1]];
-										v1 = sMesh->mVertexData[sMesh->indices[start + (triStart*3) + 2]];
-										/*
-										v1
-										v3
-										v2
-										*/
-									}
-									// Create 2 vectors from the 3 points that make up the triangle
-									Point3F p1 = v1.vert();
-									Point3F p2 = v2.vert();
-									Point3F p3 = v3.vert();
-									Point3F vec1;
-									Point3F vec2;
-									vec1 = p2-p1;
-									vec2 = p3-p2;
-									// Get 2 random coefficients
-									F32 K1 = rand() % 1000 + 1;
-									F32 K2 = rand() % 1000 + 1;
-									Point3F planeVec;
-									// If the point is outside of the triangle, mirror it in so it fits
-									//  - into the triangle. This is for a perfectly even result on a 
-									//  - per face basis.
-									if(K2 <= K1)
-										planeVec = p1 + (vec1 * (K1 / 1000)) + (vec2 * (K2 / 1000));
-									else
-										planeVec = p1 + (vec1 * (1-(K1 / 1000))) + (vec2 * (1-(K2 / 1000)));
-
-									// Add up the normals of the three vertices and normalize them to get
-									//  - the correct normal of the plane.
-									Point3F* normalV = new Point3F((v1.normal()+v2.normal()+v3.normal())/3);
-									normalV->normalize();
-
-									// Get the transform of the object to get the transform matrix.
-									//  - If it is a TSStatic we need to access the rootnode aswell
-									//  - Which contains the rotation information.
-									MatrixF trans;
-									MatrixF nodetrans;
-									MatrixF mat;
-									if(SS)
-									{
-										trans = SS->getTransform();
-									}
-									else
-									{
-										trans = (dynamic_cast<TSStatic*>(SB))->getTransform();
-										nodetrans = dynamic_cast<TSStatic*>(SB)->getShapeInstance()->mNodeTransforms[0];
-										mat.mul(trans, nodetrans);
-									}
-
-									Point3F* p = new Point3F();
-									
-									if(SS)
-									{
-										trans.mulV(planeVec,p);
-										pNew->pos = SS->getPosition() + *p + (*normalV * ejectionOffset);
-									}
-									else{
-										mat.mulV((*planeVec * dynamic_cast<TSStatic*>(SB)->getScale()),p);
-										pNew->pos = dynamic_cast<TSStatic*>(SB)->getPosition() + *p + (*normalV * ejectionOffset);
-									}
-									delete(*p);
-									delete(*normalV);
-								}
-								else
-								{
-									Con::printf("Not tris?");
-								}
-							}
-						}
-					}
-				}
-			}
-#pragma endregion
-#pragma region staticmesh
-			// Same procedure as above
-			if(!skinmesh)
-			{
-				S32 numVerts = Mesh->mVertexData.size();
-				if(numVerts)
-				{
-					S32 numPrims = Mesh->primitives.size();
-					if(numPrims)
-					{
-						S32 numIndices = Mesh->indices.size();
-						if(numIndices)
-						{
-							S32 primIndex = rand() % numPrims;
-							S32 start = Mesh->primitives[primIndex].start;
-							S32 numElements = Mesh->primitives[primIndex].numElements;
-
-							TSMesh::__TSMeshVertexBase v1, v2, v3;
-							Point3F vp1;
-
-							if ( (Mesh->primitives[primIndex].matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles)
-							{
-								coHandled = true;
-								U32 triStart = (rand() % (numElements/3));
-								U8 indiceBool = (triStart * 3) % 2;
-								if(indiceBool == 0)
-								{
-									v1 = Mesh->mVertexData[Mesh->indices[start + (triStart*3)]];
-									v2 = Mesh->mVertexData[Mesh->indices[start + (triStart*3) + 1]];
-									v3 = Mesh->mVertexData[Mesh->indices[start + (triStart*3) + 2]];
-								}
-								else
-								{
-									v3 = Mesh->mVertexData[Mesh->indices[start + (triStart*3)]];
-									v2 = Mesh->mVertexData[Mesh->indices[start + (triStart*3) + 1]];
-									v1 = Mesh->mVertexData[Mesh->indices[start + (triStart*3) + 2]];
-									/*
-									v1
-									v3
-									v2
-									*/
-								}
-								Point3F p1 = v1.vert();
-								Point3F p2 = v2.vert();
-								Point3F p3 = v3.vert();
-								Point3F vec1;
-								Point3F vec2;
-								vec1 = p2-p1;
-								vec2 = p3-p2;
-								F32 K1 = rand() % 1000 + 1;
-								F32 K2 = rand() % 1000 + 1;
-								Point3F planeVec;
-								if(K2 <= K1)
-									planeVec = p1 + (vec1 * (K1 / 1000)) + (vec2 * (K2 / 1000));
-								else
-									planeVec = p1 + (vec1 * (1-(K1 / 1000))) + (vec2 * (1-(K2 / 1000)));
-
-								// Construct a vector from the 3 results
-								const Point3F *vertPos = new const Point3F(planeVec);
-
-								Point3F* normalV = new Point3F((v1.normal()+v2.normal()+v3.normal())/3);
-								normalV->normalize();
-
-								MatrixF trans;
-								MatrixF nodetrans;
-								MatrixF mat;
-								if(SS)
-								{
-									trans = SS->getTransform();
-								}
-								else
-								{
-									trans = (dynamic_cast<TSStatic*>(SB))->getTransform();
-									nodetrans = dynamic_cast<TSStatic*>(SB)->getShapeInstance()->mNodeTransforms[0];
-									mat.mul(trans, nodetrans);
-								}
-								// Rotate our point by the rotation matrix
-								Point3F* p = new Point3F();
-
-								if(SS)
-								{
-									trans.mulV(*vertPos,p);
-									pNew->pos = SS->getPosition() + *p + (*normalV * ejectionOffset);
-								}
-								else{
-									mat.mulV((*vertPos * dynamic_cast<TSStatic*>(SB)->getScale()),p);
-									pNew->pos = dynamic_cast<TSStatic*>(SB)->getPosition() + *p + (*normalV * ejectionOffset);
-								}
-							}
-							else
-							{
-								Con::printf("Not tris?");
-							}
-						}
-					}
-				}
-			}
-#pragma endregion
-			}
+			// Even emission picks faces in proportion to their area,
+			//  - otherwise a random mesh, primitive and triangle is picked.
+			U32 tri;
 			if(evenEmission)
-			{
-				if(emitfaces.size())
-				{
-					PROFILE_SCOPE(meshEmitEven);
-					// Get a random face from our emitfaces vector.
-					//  - then follow basically the same procedure as above.
-					//  - Just slightly simplified
-					S32 faceIndex = rand() % emitfaces.size();
-					face tris = emitfaces[faceIndex];
-					Mesh = shape->meshes[tris.meshIndex];
-
-					TSMesh::__TSMeshVertexBase v1, v2, v3;
-					Point3F p1, p2, p3;
-					if(tris.skinMesh)
-					{
-						sMesh = dynamic_cast<TSSkinMesh*>(Mesh);
-						U8 indiceBool = tris.triStart % 2;
-						if(indiceBool == 0)
-						{
-							v1 = sMesh->mVertexData[sMesh->indices[tris.triStart]];
-							v2 = sMesh->mVertexData[sMesh->indices[tris.triStart + 1]];
-							v3 = sMesh->mVertexData[sMesh->indices[tris.triStart + 2]];
-						}
-						else
-						{
-							v3 = sMesh->mVertexData[sMesh->indices[tris.triStart]];
-							v2 = sMesh->mVertexData[sMesh->indices[tris.triStart + 1]];
-							v1 = sMesh->mVertexData[sMesh->indices[tris.triStart + 2]];
-						}
-						p1 = v1.vert();
-						p2 = v2.vert();
-						p3 = v3.vert();
-					}
-					else{
-						U8 indiceBool = tris.triStart % 2;
-						if(indiceBool == 0)
-						{
-							v1 = Mesh->mVertexData[Mesh->indices[tris.triStart]];
-							v2 = Mesh->mVertexData[Mesh->indices[tris.triStart + 1]];
-							v3 = Mesh->mVertexData[Mesh->indices[tris.triStart + 2]];
-						}
-						else
-						{
-							v3 = Mesh->mVertexData[Mesh->indices[tris.triStart]];
-							v2 = Mesh->mVertexData[Mesh->indices[tris.triStart + 1]];
-							v1 = Mesh->mVertexData[Mesh->indices[tris.triStart + 2]];
-						}
-						p1 = v1.vert();
-						p2 = v2.vert();
-						p3 = v3.vert();
-					}
-					Point3F vec1;
-					Point3F vec2;
-					vec1 = p2-p1;
-					vec2 = p3-p2;
-					F32 K1 = rand() % 1000 + 1;
-					F32 K2 = rand() % 1000 + 1;
-					Point3F planeVec;
-					if(K2 <= K1)
-						planeVec = p1 + (vec1 * (K1 / 1000)) + (vec2 * (K2 / 1000));
-					else
-						planeVec = p1 + (vec1 * (1-(K1 / 1000))) + (vec2 * (1-(K2 / 1000)));
-					// Construct a vector from the 3 results
-					const Point3F *vertPos = new const Point3F(planeVec);
-					
-					Point3F* normalV = new Point3F((v1.normal()+v2.normal()+v3.normal())/3);
-					normalV->normalize();
-
-					MatrixF trans;
-					MatrixF nodetrans;
-					MatrixF mat;
-					if(SS)
-					{
-						trans = SS->getTransform();
-					}
-					else
-					{
-						trans = (dynamic_cast<TSStatic*>(SB))->getTransform();
-						nodetrans = dynamic_cast<TSStatic*>(SB)->getShapeInstance()->mNodeTransforms[0];
-						mat.mul(trans, nodetrans);
-					}
-					// Rotate our point by the rotation matrix
-					Point3F* p = new Point3F();
-
-					if(SS)
-					{
-						trans.mulV(*vertPos,p);
-						pNew->pos = SS->getPosition() + *p + (*normalV * ejectionOffset);
-					}
-					else{
-						mat.mulV((*vertPos * dynamic_cast<TSStatic*>(SB)->getScale()),p);
-						mat.mulV(*normalV);
-						pNew->pos = dynamic_cast<TSStatic*>(SB)->getPosition() + *p + (*normalV * ejectionOffset);
-					}
-					pNew->relPos = *p +(*normalV * ejectionOffset);
-					pNew->vel = *normalV * initialVel;
-					pNew->orientDir = *normalV;
-					delete(*p);
-					delete(*vertPos);
-					delete(*normalV);
-				}
-			}
-#pragma endregion
-			// -------------------------------------------------------------------------------------------------
-			// -- Per triangle END -----------------------------------------------------------------------------
-			// -------------------------------------------------------------------------------------------------
+				tri = mEmitSurface.pickTriangleByArea(randoms[1]);
+			else
+				tri = mEmitSurface.pickTriangle(randoms[1], randoms[2], randoms[3]);
+			mEmitSurface.getTrianglePoint(tri, randoms[4], randoms[5], objPos, objNormal);
 		}
-		if(evenEmission && mainTime == U32_MAX)
-			mainTime = 0;
-		if(!evenEmission && !coHandled)
-			mainTime = 0;
-		
-		/**/
+
+		Point3F p, normal;
+		mEmitSurface.toWorld(objPos, objNormal, p, normal);
+		// Set the relative position for later use.
+		part.relPos = p + (normal * ejectionOffset);
+		part.pos = mEmitSurface.getPosition() + part.relPos;
+		// Velocity is based on the normal of the vertex or face
+		part.vel = normal * initialVel;
+		part.orientDir = normal;
 	}
 
-	pNew->acc.set(0, 0, 0);
-	pNew->currentAge = 0;
+	part.acc.set(0, 0, 0);
+	part.currentAge = 0;
 
 	// Choose a new particle datablack randomly from the list
-	U32 dBlockIndex = gRandGen.randI() % mDataBlock->particleDataBlocks.size();
-	mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(pNew, pNew->vel);
-	updateKeyData( pNew );
+	U32 dBlockIndex = ParticleRandom::toIndex( randoms[6], mDataBlock->particleDataBlocks.size() );
+	mDataBlock->particleDataBlocks[dBlockIndex]->initializeParticle(&part, part.vel);
+	mRandom.randomizeParticle( mDataBlock->particleDataBlocks[dBlockIndex], part );
+	updateKeyData( mParts.add(part) );
 }
 
 //-----------------------------------------------------------------------------
@@ -1954,9 +1589,25 @@ void MeshEmitter::processTick(const Move* move)
 {
 	Parent::processTick(move);
 
+	// The object must stay out of view for a while before the emitter is
+	// culled, so emitters at the edge of the view don't flicker on and off.
+	if( isObjectCulled() )
+	{
+		if( mCulledTicks < ParticleCamera::CullDelayTicks )
+			mCulledTicks++;
+	}
+	else
+		mCulledTicks = 0;
+
+	const bool culled = mCulledTicks >= ParticleCamera::CullDelayTicks;
+	if( mCullStateSet && culled == mCulled )
+		return;
+	mCulled = culled;
+	mCullStateSet = true;
+
 	// If the object has been culled out we don't want to render the particles. 
 	// If it haven't, set the bounds to global so the particles will always be rendered regardless of whether the object is seen or not.
-	if(isObjectCulled())
+	if( culled )
 	{
 		mGlobalBounds = false;
 		setRenderEnabled(false);
@@ -1975,161 +1626,31 @@ void MeshEmitter::processTick(const Move* move)
 // isObjectCulled
 // Checks if the mesh which is being emitted on is getting culled out
 // If the object is culled out, so is the emitter.
-// This code is from guiShapeNameHud
-// Needs to get better, should simply do a isRendered test but
-// Didn't find any method for that.
+// Tests the world box of the object against the camera frustum, which is
+// shared by all emitters in a tick. The object is the one the emission
+// surface keeps, so it isn't looked up every tick.
 // Custom
 //-----------------------------------------------------------------------------
 bool MeshEmitter::isObjectCulled()
 {
 	PROFILE_SCOPE(isObjectCulled);
+
 	// Must have a connection and control object
-	GameConnection* conn = GameConnection::getConnectionToServer();
-	if (!conn) return true;
-	GameBase * control = dynamic_cast<GameBase*>(conn->getControlObject());
-	if (!control) return true;
-
-	// Get control camera info
-	MatrixF cam;
-	Point3F camPos;
-	VectorF camDir;
-	//cam = conn->getCameraObject()->getTransform();
-	conn->getControlCameraTransform(0,&cam);
-	cam.getColumn(3, &camPos);
-	cam.getColumn(1, &camDir);
-
-	F32 camFov;
-	conn->getControlCameraFov(&camFov);
-	camFov = mDegToRad(camFov) / 2;
-
-	// Visible distance info
-	F32 visDistance = gClientSceneGraph->getVisibleDistance();
-	F32 visDistanceSqr = visDistance * visDistance;
-
-	// Collision info. We're going to be running LOS tests and we
-	// don't want to collide with the control object.
-	static U32 losMask = TerrainObjectType | ShapeBaseObjectType;
-
-	SceneObject* SB = dynamic_cast<SceneObject*>(Sim::findObject(emitMesh));
-	if(!SB)
-		SB = dynamic_cast<SceneObject*>(Sim::findObject(atoi(emitMesh)));
-
-	// All ghosted objects are added to the server connection group,
-	// so we can find all the shape base objects by iterating through
-	// our current connection.
-	ShapeBase* shape = dynamic_cast< ShapeBase* >(SB);
-	//GameBase* GB = dynamic_cast< GameBase* >(SB);
-	TSStatic* TSshape = dynamic_cast<TSStatic*>(SB);
-	if ( shape ) {
-		// Target pos to test, if it's a player run the LOS to his eye
-		// point, otherwise we'll grab the generic box center.
-		Point3F shapePos;
-		if (shape->getTypeMask() & PlayerObjectType) 
-		{
-			MatrixF eye;
+	const ParticleCamera *camera = ParticleCamera::get();
+	if( !camera )
+		return true;
 
-			// Use the render eye transform, otherwise we'll see jittering
-			shape->getRenderEyeTransform(&eye);
-			eye.getColumn(3, &shapePos);
-		} 
-		else 
-		{
-			// Use the render transform instead of the box center
-			// otherwise it'll jitter.
-			MatrixF srtMat = shape->getRenderTransform();
-			srtMat.getColumn(3, &shapePos);
-		}
-		VectorF shapeDir = shapePos - camPos;
-
-		// Test to see if it's in range
-		F32 shapeDist = shapeDir.lenSquared();
-		if (shapeDist == 0 || shapeDist > visDistanceSqr)
-			return true;
-		shapeDist = mSqrt(shapeDist);
-
-		// Test to see if it's within our viewcone, this test doesn't
-		// actually match the viewport very well, should consider
-		// projection and box test.
-		shapeDir.normalize();
-		F32 dot = mDot(shapeDir, camDir);
-		if (dot < camFov)
-			return true;
-
-		// Don't raytest, if the object is slightly below the terrain (houses etc)
-		//  - then a ray test will exclude it, ruining the effect.
-
-		// Test to see if it's behind something, and we want to
-		// ignore anything it's mounted on when we run the LOS.
-		/*RayInfo info;
-		shape->disableCollision();
-		control->disableCollision();
-		SceneObject *mount = shape->getObjectMount();
-		if (mount)
-			mount->disableCollision();
-		bool los = !gClientContainer.castRay(camPos, shapePos,losMask, &info);
-		shape->enableCollision();
-		control->enableCollision();
-		if (mount)
-			mount->enableCollision();
-		if (!los)
-			return true;*/
-
-		// The object is not culled
-		return false;
-	}
+	// Not ghosted yet, the surface looks for it again on the next update
+	SceneObject *object = mEmitSurface.getObject();
+	if( !object )
+		return true;
 
-	else if( TSshape )
-	{
-		Point3F shapePos;
-		// Use the render transform instead of the box center
-		// otherwise it'll jitter.
-		MatrixF srtMat = TSshape->getRenderTransform();
-		srtMat.getColumn(3, &shapePos);
-
-		VectorF shapeDir = shapePos - camPos;
-
-		// Test to see if it's in range
-		F32 shapeDist = shapeDir.lenSquared();
-		if (shapeDist == 0 || shapeDist > visDistanceSqr)
-			return true;
-		shapeDist = mSqrt(shapeDist);
-
-		// Test to see if it's within our viewcone, this test doesn't
-		// actually match the viewport very well, should consider
-		// projection and box test.
-		shapeDir.normalize();
-		F32 dot = mDot(shapeDir, camDir);
-		if (dot < camFov)
-			return true;
-
-		// Don't raytest, if the object is slightly below the terrain (houses etc)
-		//  - then a ray test will exclude it, ruining the effect.
-
-		// Test to see if it's behind something, and we want to
-		// ignore anything it's mounted on when we run the LOS.
-		/*RayInfo info;
-		TSshape->disableCollision();
-		control->disableCollision();
-		SceneObject *mount = TSshape->getObjectMount();
-		if (mount)
-			mount->disableCollision();
-		bool los = !gClientContainer.castRay(camPos, shapePos,losMask, &info);
-		TSshape->enableCollision();
-		control->enableCollision();
-		if (mount)
-			mount->enableCollision();
-		if (!los)
-			return true;*/
-
-		// The object is not culled
-		return false;
-	}
-	return true;
+	return !camera->isVisible( object->getWorldBox() );
 }
 
 //-----------------------------------------------------------------------------
 // advanceTime
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
 void MeshEmitter::advanceTime(F32 dt)
 {
@@ -2141,471 +1662,437 @@ void MeshEmitter::advanceTime(F32 dt)
 
 	if( mDead ) return;
 
+	if( mDataBlock->fixedStepMS > 0 )
+	{
+		advanceSteps( dt );
+		return;
+	}
+
 	mElapsedTimeMS += (S32)(dt * 1000.0f);
 
 	U32 numMSToUpdate = (U32)(dt * 1000.0f);
 	if( numMSToUpdate == 0 ) return;
 
-	// TODO: Prefetch
+	// The update from the last call is still queued if no frame was
+	// rendered since then
+	if( isQueued() )
+		ParticleJobScheduler::flush();
 
-	// remove dead particles
-	Particle* last_part = &part_list_head;
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	updateLOD();
+	mBudget.report( mParts.size(), mLOD.getDistance() );
+
+	if (mParts.empty() && mDeleteWhenEmpty)
 	{
-		part->currentAge += numMSToUpdate;
-		if (part->currentAge > part->totalLifetime)
-		{
-			n_parts--;
-			last_part->next = part->next;
-			part->next = part_freelist;
-			part_freelist = part;
-			part = last_part;
-		}
-		else
-		{
-			last_part = part;
-		}
+		mDeleteOnTick = true;
+		return;
 	}
 
-	AssertFatal( n_parts >= 0, "MeshEmitter: negative part count!" );
+	// The update runs in the next flush of the ParticleJobScheduler, which
+	// can't look up objects, so the attractors are found now. The particles
+	// emitted below are left out of it. Distant emitters simulate their
+	// particles every few frames.
+	U32 numToUpdate = mParts.size();
+	if( !mParts.empty() && mLOD.advanceFrame( numMSToUpdate, numToUpdate ) )
+	{
+		mAttraction.updateTargets();
+		mUpdateMS = numMSToUpdate;
+		mUpdateCount = numToUpdate;
+		ParticleJobScheduler::queue( this );
+	}
+	emitParticles(ejectionVelocity, (U32)(dt * 1000.0f));
+}
 
-	if (n_parts < 1 && mDeleteWhenEmpty)
+//-----------------------------------------------------------------------------
+// updateLOD
+//-----------------------------------------------------------------------------
+void MeshEmitter::updateLOD()
+{
+	const ParticleCamera *camera = ParticleCamera::get();
+	if( !camera )
 	{
-		mDeleteOnTick = true;
+		mLOD.reset();
 		return;
 	}
 
-	if( numMSToUpdate != 0 && n_parts > 0 )
+	// The distance to the emitMesh, the bounds of the emitter itself are
+	// global while it is in view
+	const Point3F &camPos = camera->getPosition();
+	SceneObject *object = mEmitSurface.getObject();
+	if( object )
+		mLOD.update( mDataBlock->lodBands, object->getWorldBox().getDistanceToPoint( camPos ) );
+	else
+		mLOD.update( mDataBlock->lodBands, ( getPosition() - camPos ).len() );
+}
+
+//-----------------------------------------------------------------------------
+// advanceSteps
+// The frame time is run in whole steps and the rest is carried over to the
+// next frame.
+//-----------------------------------------------------------------------------
+void MeshEmitter::advanceSteps( F32 dt )
+{
+	// Queued before the datablock switched to fixed steps
+	if( isQueued() )
+		ParticleJobScheduler::flush();
+
+	// Always at full detail, the LOD depends on the camera
+	mLOD.reset();
+
+	const U32 stepMS = mDataBlock->fixedStepMS;
+	const F32 stepTime = F32(stepMS) / 1000.0f;
+	mStepTime += dt;
+	if( mStepTime < stepTime )
+		return;
+
+	mAttraction.updateTargets();
+	while( mStepTime >= stepTime )
 	{
-		update( numMSToUpdate );
+		mStepTime -= stepTime;
+		mElapsedTimeMS += stepMS;
+
+		// The passes of the queued update, run here and now
+		if( !mParts.empty() )
+		{
+			mUpdateMS = stepMS;
+			mUpdateCount = mParts.size();
+			simulateForces();
+			simulateMotion();
+			finishSimulation();
+		}
+		emitParticles( ejectionVelocity, stepMS );
 	}
-	emitParticles(ejectionVelocity, (U32)(dt * 1000.0f));
+
+	if( mParts.empty() && mDeleteWhenEmpty )
+		mDeleteOnTick = true;
 }
 
 //-----------------------------------------------------------------------------
 // Update key related particle data
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
-void MeshEmitter::updateKeyData( Particle *part )
+void MeshEmitter::updateKeyData( U32 idx )
 {
 	//Ensure that our lifetime is never below 0
-	if( part->totalLifetime < 1 )
-		part->totalLifetime = 1;
+	if( mParts.totalLifetime[idx] < 1 )
+		mParts.totalLifetime[idx] = 1;
+
+	const ParticleKeyCurve *curve = getKeyCurve( mParts.dataBlock[idx] );
+	if( curve )
+		curve->apply( mParts, idx );
+}
 
-	F32 t = F32(part->currentAge) / F32(part->totalLifetime);
-	AssertFatal(t <= 1.0f, "Out out bounds filter function for particle.");
+//-----------------------------------------------------------------------------
+// bakeKeyCurves
+// Emitters using the colors and sizes of the particles share the curves of
+// the datablock.
+//-----------------------------------------------------------------------------
+void MeshEmitter::bakeKeyCurves()
+{
+	const Vector<ParticleData*> &dataBlocks = mDataBlock->particleDataBlocks;
+	AssertFatal( mDataBlock->keyCurves.size() == dataBlocks.size(), "MeshEmitter::bakeKeyCurves - the datablock curves aren't baked" );
 
-	for( U32 i = 1; i < ParticleData::PDC_NUM_KEYS; i++ )
+	const bool ownCurves = useEmitterColors || useEmitterSizes;
+	mOwnKeyCurves.setSize( ownCurves ? dataBlocks.size() : 0 );
+	mKeyCurves.setSize( dataBlocks.size() );
+	for( S32 i = 0; i < dataBlocks.size(); i++ )
 	{
-		if( part->dataBlock->times[i] >= t )
+		if( ownCurves )
 		{
-			F32 firstPart = t - part->dataBlock->times[i-1];
-			F32 total     = part->dataBlock->times[i] -
-				part->dataBlock->times[i-1];
+			mOwnKeyCurves[i].bake( dataBlocks[i], useEmitterColors ? colors : NULL, useEmitterSizes ? sizes : NULL );
+			mKeyCurves[i] = &mOwnKeyCurves[i];
+		}
+		else
+			mKeyCurves[i] = &mDataBlock->keyCurves[i];
+	}
 
-			firstPart /= total;
+	mKeyCurvesDirty = false;
+}
 
-			if( useEmitterColors )
-			{
-				part->color.interpolate(colors[i-1], colors[i], firstPart);
-			}
-			else
-			{
-				part->color.interpolate(part->dataBlock->colors[i-1],
-					part->dataBlock->colors[i],
-					firstPart);
-			}
+//-----------------------------------------------------------------------------
+// getKeyCurve
+//-----------------------------------------------------------------------------
+const ParticleKeyCurve* MeshEmitter::getKeyCurve( const ParticleData *dataBlock )
+{
+	if( mKeyCurvesDirty )
+		bakeKeyCurves();
+	return ParticleKeyCurve::find( dataBlock, mDataBlock->particleDataBlocks, mKeyCurves );
+}
 
-			if( useEmitterSizes )
-			{
-				part->size = (sizes[i-1] * (1.0 - firstPart)) +
-					(sizes[i]   * firstPart);
-			}
-			else
-			{
-				part->size = (part->dataBlock->sizes[i-1] * (1.0 - firstPart)) +
-					(part->dataBlock->sizes[i]   * firstPart);
-			}
-			break;
+//-----------------------------------------------------------------------------
+// applyKeyCurves
+//-----------------------------------------------------------------------------
+F32 MeshEmitter::applyKeyCurves()
+{
+	if( mKeyCurvesDirty )
+		bakeKeyCurves();
+	return ParticleKeyCurve::apply( mParts, mDataBlock->particleDataBlocks, mKeyCurves );
+}
 
-		}
-	}
+//-----------------------------------------------------------------------------
+// Update attraction
+// Custom
+//-----------------------------------------------------------------------------
+void MeshEmitter::updateAttraction()
+{
+	mAttraction.setRange( attractionrange );
+	for(int i = 0; i < attrobjectCount; i++)
+		mAttraction.setAttractor( i, AttractionMode[i], Amount[i], attractedObjectID[i], Attraction_offset[i] );
 }
 
 //-----------------------------------------------------------------------------
-// Update particles
-// Changed
+// simulateForces
 //-----------------------------------------------------------------------------
-void MeshEmitter::update( U32 ms )
+void MeshEmitter::simulateForces()
 {
 	// TODO: Prefetch
 
-	// Foreach particle
-	for (Particle* part = part_list_head.next; part != NULL; part = part->next)
+	// The particles emitted since the update was queued wait behind the others
+	mParts.hideTail( mUpdateCount );
+
+	// remove dead particles
+	for (U32 i = 0; i < mParts.size(); )
 	{
-		F32 t = F32(ms) / 1000.0;
+		mParts.currentAge[i] += mUpdateMS;
+		if (mParts.currentAge[i] > mParts.totalLifetime[i])
+			mParts.kill(i); // the last particle is moved into i, so don't advance
+		else
+			i++;
+	}
 
-		for(int i = 0; i < attrobjectCount; i++)
-		{
-			PROFILE_SCOPE(meshEmitAttracted);
-			part->acc.zero();
+	if( mParts.empty() )
+	{
+		mPartBounds = Box3F::Invalid;
+		mMaxPartSize = 0.0f;
+		return;
+	}
 
-			// If particle is attracted
-			if(AttractionMode[i] > 0)
-			{
-				// First check by name then by ID
-				GameBase* GB = dynamic_cast<GameBase*>(Sim::findObject(attractedObjectID[i]));
-				if(!GB)
-					GB = dynamic_cast<GameBase*>(Sim::findObject(atoi(attractedObjectID[i])));
-				if(GB){
-					// GameBase object found!
-					Point3F target = GB->getPosition();
-					char attrBuf[255];
-					strcpy(attrBuf,Attraction_offset[i]);
-
-					MatrixF trans = GB->getTransform();
-
-					// Parse the offset from a "x y z" string format.
-					char* xBuf = strtok(attrBuf, " ");
-					F32 x = atof(xBuf);
-					char* yBuf = strtok(NULL, " ");
-					F32 y = atof(yBuf);
-					char* zBuf = strtok(NULL, " ");
-					F32 z = atof(zBuf);
-					// Rotate the offset
-					Point3F* po = new Point3F(x,y,z);
-					trans.mulV(*po);
-					target += *po;
-
-					// Read more about the attraction algorithm in the docs or on the T3D - CE wiki
-					Point3F diff = (target - part->pos);
-					Point3F* attR = new Point3F(attractionrange);
-					if(diff.len() < 1)
-						diff.normalize();
-					Point3F ndiff = diff;
-					ndiff.normalize();
-					F32 fdiff = attractionrange/(diff.len())-1;
-					if(fdiff < 0)
-						fdiff = 0;
-					// Attract
-					if(AttractionMode[i] == 1)
-						part->acc += (ndiff * fdiff)*Amount[i];
-					// Repulse
-					if(AttractionMode[i] == 2)
-						part->acc -= (ndiff * fdiff)*Amount[i];
-
-					delete(*attR);
-					delete(*po);
-				}
-			}
-		}
+	F32 t = F32(mUpdateMS) / 1000.0;
+
+	// Attract or repulse the particles, this sets their acceleration
+	mAttraction.apply( mParts );
+
+	// Apply drag, wind and gravity and move all particles, collecting their
+	// bounds on the way
+	ParticleIntegrator::integrate( mParts, mWindVelocity, t, ParticleIntegrator::IntegrateAll, &mPartBounds );
+}
+
+//-----------------------------------------------------------------------------
+// simulateMotion
+//-----------------------------------------------------------------------------
+void MeshEmitter::simulateMotion()
+{
+	if( mParts.empty() )
+		return;
 
-		Point3F a = part->acc;
-		a -= part->vel * part->dataBlock->dragCoefficient;
-		a -= mWindVelocity * part->dataBlock->windCoefficient;
-		a += Point3F(0.0f, 0.0f, -9.81f) * part->dataBlock->gravityCoefficient;
-		part->vel += a * t;
+	const U32 count = mParts.size();
 
+	// Sticky particles follow the node instead
+	if(sticky)
+		mPartBounds = Box3F::Invalid;
+
+	for (U32 idx = 0; idx < count; idx++)
+	{
 		// added part ----------------
 		// Not sure if collision will ever have any use on a mesh particle emitter.
 		/*RayInfo rInfo;
-		if(gClientContainer.castRay(part->pos, part->pos + part->vel * t, TerrainObjectType | VehicleObjectType | PlayerObjectType, &rInfo))
+		if(gClientContainer.castRay(partPos, partPos + partVel * t, TerrainObjectType | VehicleObjectType | PlayerObjectType, &rInfo))
 		{
-			Point3F proj = mDot(part->vel,rInfo.normal)/(rInfo.normal.len()*rInfo.normal.len())*rInfo.normal;
-			Point3F between = (part->vel - proj);
-			part->vel = -(part->vel-(between*2)*0.8);
+			Point3F proj = mDot(partVel,rInfo.normal)/(rInfo.normal.len()*rInfo.normal.len())*rInfo.normal;
+			Point3F between = (partVel - proj);
+			partVel = -(partVel-(between*2)*0.8);
 		}*/
 		// end addition ---------------
 
-		part->pos += part->vel * t;
 		if(sticky)
-			part->pos = parentNodePos + part->relPos;
-
-		updateKeyData( part );
+		{
+			mParts.setPos(idx, parentNodePos + mParts.relPos[idx]);
+			mPartBounds.extend(mParts.getPos(idx));
+		}
 	}
+
+	// Look up the colors and sizes of all the particles at their new age
+	mMaxPartSize = applyKeyCurves();
 }
 
 //-----------------------------------------------------------------------------
-// Copy particles to vertex buffer
-// Not changed
+// finishSimulation
 //-----------------------------------------------------------------------------
-
-// structure used for particle sorting.
-struct SortParticle
+void MeshEmitter::finishSimulation()
 {
-	Particle* p;
-	F32       k;
-};
+	// Bring back the particles emitted while the update was queued
+	extendBounds( mParts.showTail() );
 
-// qsort callback function for particle sorting
-int QSORT_CALLBACK m_cmpSortParticles(const void* p1, const void* p2)
-{
-	const SortParticle* sp1 = (const SortParticle*)p1;
-	const SortParticle* sp2 = (const SortParticle*)p2;
+	if (mParts.empty() && mDeleteWhenEmpty)
+	{
+		mDeleteOnTick = true;
+		return;
+	}
 
-	if (sp2->k > sp1->k)
-		return 1;
-	else if (sp2->k == sp1->k)
-		return 0;
-	else
-		return -1;
+	updateBounds();
 }
 
+//-----------------------------------------------------------------------------
+// Copy particles to vertex buffer
+// Changed
+//-----------------------------------------------------------------------------
+
 void MeshEmitter::copyToVB( const Point3F &camPos, const ColorF &ambientColor )
 {
-	static Vector<SortParticle> orderedVector(__FILE__, __LINE__);
-
 	PROFILE_START(MeshEmitter_copyToVB);
 
+	const S32 n_parts = mParts.size();
+
 	PROFILE_START(MeshEmitter_copyToVB_Sort);
 	// build sorted list of particles (far to near)
-	if (sortParticles)
+	const U32 *sortedParts = NULL;
+	if (sortParticles && mLOD.shouldSort())
 	{
-		orderedVector.clear();
-
 		MatrixF modelview = GFX->getWorldMatrix();
 		Point3F viewvec; modelview.getRow(1, &viewvec);
 
-		// add each particle and a distance based sort key to orderedVector
-		for (Particle* pp = part_list_head.next; pp != NULL; pp = pp->next)
-		{
-			orderedVector.increment();
-			orderedVector.last().p = pp;
-			orderedVector.last().k = mDot(pp->pos, viewvec);
-		}
-
-		// qsort the list into far to near ordering
-		dQsort(orderedVector.address(), orderedVector.size(), sizeof(SortParticle), m_cmpSortParticles);
+		// radix sort the particles into far to near ordering
+		sortedParts = mSort.sort(mParts, viewvec);
 	}
 	PROFILE_END();
 
-#if defined(TORQUE_OS_XENON)
-	// Allocate writecombined since we don't read back from this buffer (yay!)
-	if(mVertBuff.isNull())
-		mVertBuff = new GFX360MemVertexBuffer(GFX, 1, getGFXVertexFormat<ParticleVertexType>(), sizeof(ParticleVertexType), GFXBufferTypeDynamic, PAGE_WRITECOMBINE);
-	if( n_parts > mCurBuffSize )
+	// The particles are drawn in batches of at most MaxBatchQuads, each from
+	// its own vertex buffer, as the shared quad index buffer is 16 bit.
+	const U32 numBatches = (n_parts + ParticleBufferPool::MaxBatchQuads - 1) / ParticleBufferPool::MaxBatchQuads;
+	mVertBuffs.setSize(numBatches);
+
+	VertexFill fill;
+	fill.emitter = this;
+	fill.sortedParts = sortedParts;
+	fill.numParts = n_parts;
+	fill.reverse = reverseOrder;
+	fill.camPos = camPos;
+	fill.ambientColor = ambientColor;
+
+	// somewhat odd ordering so that texture coordinates match the oriented
+	// particles
+	fill.basePoints[0] = Point3F(-1.0, 0.0,  1.0);
+	fill.basePoints[1] = Point3F(-1.0, 0.0, -1.0);
+	fill.basePoints[2] = Point3F( 1.0, 0.0, -1.0);
+	fill.basePoints[3] = Point3F( 1.0, 0.0,  1.0);
+
+	fill.camView = GFX->getWorldMatrix();
+	fill.camView.transpose();  // inverse - this gets the particles facing camera
+
+	for (U32 batch = 0; batch < numBatches; batch++)
 	{
-		mCurBuffSize = n_parts;
-		mVertBuff.resize(n_parts * 4);
-	}
-
-	ParticleVertexType *buffPtr = mVertBuff.lock();
-#else
-	static Vector<ParticleVertexType> tempBuff(2048);
-	tempBuff.reserve( n_parts*4 + 64); // make sure tempBuff is big enough
-	ParticleVertexType *buffPtr = tempBuff.address(); // use direct pointer (faster)
-#endif
-
-	if (orientParticles)
-	{
-		PROFILE_START(MeshEmitter_copyToVB_Orient);
-
-		if (reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
-			// do sorted-oriented particles
-			if (sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr-=4 )
-					setupOriented(partPtr->p, camPos, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupOriented(partPtr, camPos, ambientColor, buffPtr);
-			}
-		}
-		else
-		{
-			// do sorted-oriented particles
-			if (sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr+=4 )
-					setupOriented(partPtr->p, camPos, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupOriented(partPtr, camPos, ambientColor, buffPtr);
-			}
-		}
+		const U32 first = batch * ParticleBufferPool::MaxBatchQuads;
+		const U32 last = getMin(first + ParticleBufferPool::MaxBatchQuads, (U32)n_parts);
+
+		PROFILE_START(MeshEmitter_copyToVB_Lock);
+		// The vertices are written straight into the locked buffer
+		mVertBuffs[batch] = ParticleBufferPool::borrowVerts( last - first );
+		fill.verts = mVertBuffs[batch]->lock();
+		fill.firstSlot = first;
 		PROFILE_END();
-	}
-	else if (alignParticles)
-	{
-		PROFILE_START(MeshEmitter_copyToVB_Aligned);
 
-		if (reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
-
-			// do sorted-oriented particles
-			if (sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr-=4 )
-					setupAligned(partPtr->p, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				Particle *partPtr = part_list_head.next;
-				for (; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupAligned(partPtr, ambientColor, buffPtr);
-			}
-		}
+		PROFILE_START(MeshEmitter_copyToVB_Fill);
+		// Small emitters are filled here, the dispatch would cost more
+		if (last - first >= ParticleJobScheduler::getMinParallelItems())
+			ParticleJobScheduler::runParallel( fill, last - first, VertexFillChunk );
 		else
-		{
-			// do sorted-oriented particles
-			if (sortParticles)
-			{
-				SortParticle* partPtr = orderedVector.address();
-				for (U32 i = 0; i < n_parts; i++, partPtr++, buffPtr+=4 )
-					setupAligned(partPtr->p, ambientColor, buffPtr);
-			}
-			// do unsorted-oriented particles
-			else
-			{
-				Particle *partPtr = part_list_head.next;
-				for (; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupAligned(partPtr, ambientColor, buffPtr);
-			}
-		}
+			fill.run( 0, last - first );
 		PROFILE_END();
+
+		mVertBuffs[batch]->unlock();
 	}
-	else
-	{
-		PROFILE_START(MeshEmitter_copyToVB_NonOriented);
-		// somewhat odd ordering so that texture coordinates match the oriented
-		// particles
-		Point3F basePoints[4];
-		basePoints[0] = Point3F(-1.0, 0.0,  1.0);
-		basePoints[1] = Point3F(-1.0, 0.0, -1.0);
-		basePoints[2] = Point3F( 1.0, 0.0, -1.0);
-		basePoints[3] = Point3F( 1.0, 0.0,  1.0);
 
-		MatrixF camView = GFX->getWorldMatrix();
-		camView.transpose();  // inverse - this gets the particles facing camera
+	PROFILE_END();
+}
 
-		if (reverseOrder)
-		{
-			buffPtr += 4*(n_parts-1);
-			// do sorted-billboard particles
-			if (sortParticles)
-			{
-				SortParticle *partPtr = orderedVector.address();
-				for( U32 i=0; i<n_parts; i++, partPtr++, buffPtr-=4 )
-					setupBillboard( partPtr->p, basePoints, camView, ambientColor, buffPtr );
-			}
-			// do unsorted-billboard particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr-=4)
-					setupBillboard( partPtr, basePoints, camView, ambientColor, buffPtr );
-			}
-		}
-		else
-		{
-			// do sorted-billboard particles
-			if (sortParticles)
-			{
-				SortParticle *partPtr = orderedVector.address();
-				for( U32 i=0; i<n_parts; i++, partPtr++, buffPtr+=4 )
-					setupBillboard( partPtr->p, basePoints, camView, ambientColor, buffPtr );
-			}
-			// do unsorted-billboard particles
-			else
-			{
-				for (Particle* partPtr = part_list_head.next; partPtr != NULL; partPtr = partPtr->next, buffPtr+=4)
-					setupBillboard( partPtr, basePoints, camView, ambientColor, buffPtr );
-			}
-		}
+//-----------------------------------------------------------------------------
+// VertexFill
+//-----------------------------------------------------------------------------
+void MeshEmitter::VertexFill::run( U32 start, U32 end )
+{
+	ParticleVertexType *buffPtr = verts + start * 4;
+	const U32 first = firstSlot + start;
+	const U32 last = firstSlot + end;
 
-		PROFILE_END();
+	if (emitter->orientParticles)
+	{
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupOriented(ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), camPos, ambientColor, buffPtr);
 	}
-
-#if defined(TORQUE_OS_XENON)
-	mVertBuff.unlock();
-#else
-	PROFILE_START(MeshEmitter_copyToVB_LockCopy);
-	// create new VB if emitter size grows
-	if( !mVertBuff || n_parts > mCurBuffSize )
+	else if (emitter->alignParticles)
 	{
-		mCurBuffSize = n_parts;
-		mVertBuff.set( GFX, n_parts * 4, GFXBufferTypeDynamic );
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupAligned(ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), ambientColor, buffPtr);
+	}
+	else
+	{
+		for (U32 slot = first; slot < last; slot++, buffPtr+=4)
+			emitter->setupBillboard( ParticleSort::getDrawIndex(sortedParts, numParts, slot, reverse), basePoints, camView, ambientColor, buffPtr );
 	}
-	// lock and copy tempBuff to video RAM
-	ParticleVertexType *verts = mVertBuff.lock();
-	dMemcpy( verts, tempBuff.address(), n_parts * 4 * sizeof(ParticleVertexType) );
-	mVertBuff.unlock();
-	PROFILE_END();
-#endif
-
-	PROFILE_END();
 }
 
 //-----------------------------------------------------------------------------
 // Set up particle for billboard style render
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
-void MeshEmitter::setupBillboard( Particle *part,
+void MeshEmitter::setupBillboard( U32 idx,
 	Point3F *basePts,
 	const MatrixF &camView,
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
-	F32 width     = part->size * 0.5f;
-	F32 spinAngle = part->spinSpeed * part->currentAge * AgedSpinToRadians;
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+
+	F32 width     = mParts.partSize[idx] * 0.5f;
+	F32 spinAngle = mParts.spinSpeed[idx] * mParts.currentAge[idx] * AgedSpinToRadians;
 
 	F32 sy, cy;
 	mSinCos(spinAngle, sy, cy);
 
 	const F32 ambientLerp = mClampF( ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// fill four verts, use macro and unroll loop
+	// The point is built on the stack, lVerts is locked vertex buffer memory
+	//  - which should only be written to.
 #define fillVert(){ \
-	lVerts->point.x = cy * basePts->x - sy * basePts->z;  \
-	lVerts->point.y = 0.0f;                                \
-	lVerts->point.z = sy * basePts->x + cy * basePts->z;  \
-	camView.mulV( lVerts->point );                        \
-	lVerts->point *= width;                               \
-	lVerts->point += part->pos;                           \
+	Point3F vertPoint( cy * basePts->x - sy * basePts->z,  \
+		0.0f,                                              \
+		sy * basePts->x + cy * basePts->z );               \
+	camView.mulV( vertPoint );                            \
+	lVerts->point = vertPoint * width + partPos;          \
 	lVerts->color = partCol; } \
 
 	// Here we deal with UVs for animated particle (billboard)
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
-		S32 fm = (S32)(part->currentAge*(1.0/1000.0)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0/1000.0)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		fillVert();
 		// Here and below, we copy UVs from particle datablock's current frame's UVs (billboard)
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 		++basePts;
 
 		fillVert();
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 		++basePts;
 
@@ -2614,94 +2101,110 @@ void MeshEmitter::setupBillboard( Particle *part,
 
 	fillVert();
 	// Here and below, we copy UVs from particle datablock's texCoords (billboard)
-	lVerts->texCoord = part->dataBlock->texCoords[0];
+	lVerts->texCoord = partDB->texCoords[0];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[1];
+	lVerts->texCoord = partDB->texCoords[1];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[2];
+	lVerts->texCoord = partDB->texCoords[2];
 	++lVerts;
 	++basePts;
 
 	fillVert();
-	lVerts->texCoord = part->dataBlock->texCoords[3];
+	lVerts->texCoord = partDB->texCoords[3];
 	++lVerts;
 	++basePts;
 }
 
 //-----------------------------------------------------------------------------
 // Set up oriented particle
-// Not changed
+// Changed
 //-----------------------------------------------------------------------------
-void MeshEmitter::setupOriented( Particle *part,
+void MeshEmitter::setupOriented( U32 idx,
 	const Point3F &camPos,
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+	const Point3F partVel = mParts.getVel(idx);
+
 	Point3F dir;
 
 	if( orientOnVelocity )
 	{
-		// don't render oriented particle if it has no velocity
-		if( part->vel.magnitudeSafe() == 0.0 ) return;
-		dir = part->vel;
+		// don't render oriented particle if it has no velocity, its quad is
+		//  - collapsed to a point since the buffer holds the vertices of
+		//  - whatever used it before.
+		if( partVel.magnitudeSafe() == 0.0 )
+		{
+			for( U32 i = 0; i < 4; i++, lVerts++ )
+			{
+				lVerts->point = partPos;
+				lVerts->color = ColorF( 0.0f, 0.0f, 0.0f, 0.0f );
+				lVerts->texCoord.set( 0.0f, 0.0f );
+			}
+			return;
+		}
+		dir = partVel;
 	}
 	else
 	{
-		dir = part->orientDir;
+		dir = mParts.orientDir[idx];
 	}
 
-	Point3F dirFromCam = part->pos - camPos;
+	Point3F dirFromCam = partPos - camPos;
 	Point3F crossDir;
 	mCross( dirFromCam, dir, &crossDir );
 	crossDir.normalize();
 	dir.normalize();
 
-	F32 width = part->size * 0.5f;
+	F32 width = mParts.partSize[idx] * 0.5f;
 	dir *= width;
 	crossDir *= width;
-	Point3F start = part->pos - dir;
-	Point3F end = part->pos + dir;
+	Point3F start = partPos - dir;
+	Point3F end = partPos + dir;
 
 	const F32 ambientLerp = mClampF( ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// Here we deal with UVs for animated particle (oriented)
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
 		// Let particle compute the UV indices for current frame
-		S32 fm = (S32)(part->currentAge*(1.0f/1000.0f)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0f/1000.0f)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		lVerts->point = start + crossDir;
 		lVerts->color = partCol;
 		// Here and below, we copy UVs from particle datablock's current frame's UVs (oriented)
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 
 		lVerts->point = start - crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 
 		lVerts->point = end - crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 
 		lVerts->point = end + crossDir;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 
 		return;
@@ -2710,29 +2213,33 @@ void MeshEmitter::setupOriented( Particle *part,
 	lVerts->point = start + crossDir;
 	lVerts->color = partCol;
 	// Here and below, we copy UVs from particle datablock's texCoords (oriented)
-	lVerts->texCoord = part->dataBlock->texCoords[0];
+	lVerts->texCoord = partDB->texCoords[0];
 	++lVerts;
 
 	lVerts->point = start - crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[1];
+	lVerts->texCoord = partDB->texCoords[1];
 	++lVerts;
 
 	lVerts->point = end - crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[2];
+	lVerts->texCoord = partDB->texCoords[2];
 	++lVerts;
 
 	lVerts->point = end + crossDir;
 	lVerts->color = partCol;
-	lVerts->texCoord = part->dataBlock->texCoords[3];
+	lVerts->texCoord = partDB->texCoords[3];
 	++lVerts;
 }
 
-void MeshEmitter::setupAligned( const Particle *part, 
+void MeshEmitter::setupAligned( U32 idx, 
 	const ColorF &ambientColor,
 	ParticleVertexType *lVerts )
 {
+	const Point3F partPos = mParts.getPos(idx);
+	const ColorF &partColor = mParts.color[idx];
+	const ParticleData *partDB = mParts.dataBlock[idx];
+
 	// The aligned direction will always be normalized.
 	Point3F dir = alignDirection;
 
@@ -2745,9 +2252,9 @@ void MeshEmitter::setupAligned( const Particle *part,
 	right.normalize();
 
 	// If we have a spin velocity.
-	if ( !mIsZero( part->spinSpeed ) )
+	if ( !mIsZero( mParts.spinSpeed[idx] ) )
 	{
-		F32 spinAngle = part->spinSpeed * part->currentAge * AgedSpinToRadians;
+		F32 spinAngle = mParts.spinSpeed[idx] * mParts.currentAge[idx] * AgedSpinToRadians;
 
 		// This is an inline quaternion vector rotation which
 		// is faster that QuatF.mulP(), but generates different
@@ -2773,45 +2280,45 @@ void MeshEmitter::setupAligned( const Particle *part,
 	Point3F cross;
 	mCross(right, dir, &cross);
 
-	F32 width = part->size * 0.5f;
+	F32 width = mParts.partSize[idx] * 0.5f;
 	right *= width;
 	cross *= width;
-	Point3F start = part->pos - right;
-	Point3F end = part->pos + right;
+	Point3F start = partPos - right;
+	Point3F end = partPos + right;
 
 	const F32 ambientLerp = mClampF( ambientFactor, 0.0f, 1.0f );
-	ColorF partCol = mLerp( part->color, ( part->color * ambientColor ), ambientLerp );
+	ColorF partCol = mLerp( partColor, ( partColor * ambientColor ), ambientLerp );
 
 	// Here we deal with UVs for animated particle
-	if (part->dataBlock->animateTexture)
+	if (partDB->animateTexture)
 	{ 
 		// Let particle compute the UV indices for current frame
-		S32 fm = (S32)(part->currentAge*(1.0f/1000.0f)*part->dataBlock->framesPerSec);
-		U8 fm_tile = part->dataBlock->animTexFrames[fm % part->dataBlock->numFrames];
+		S32 fm = (S32)(mParts.currentAge[idx]*(1.0f/1000.0f)*partDB->framesPerSec);
+		U8 fm_tile = partDB->animTexFrames[fm % partDB->numFrames];
 		S32 uv[4];
-		uv[0] = fm_tile + fm_tile/part->dataBlock->animTexTiling.x;
-		uv[1] = uv[0] + (part->dataBlock->animTexTiling.x + 1);
+		uv[0] = fm_tile + fm_tile/partDB->animTexTiling.x;
+		uv[1] = uv[0] + (partDB->animTexTiling.x + 1);
 		uv[2] = uv[1] + 1;
 		uv[3] = uv[0] + 1;
 
 		lVerts->point = start + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[0]];
+		lVerts->texCoord = partDB->animTexUVs[uv[0]];
 		++lVerts;
 
 		lVerts->point = start - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[1]];
+		lVerts->texCoord = partDB->animTexUVs[uv[1]];
 		++lVerts;
 
 		lVerts->point = end - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[2]];
+		lVerts->texCoord = partDB->animTexUVs[uv[2]];
 		++lVerts;
 
 		lVerts->point = end + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->animTexUVs[uv[3]];
+		lVerts->texCoord = partDB->animTexUVs[uv[3]];
 		++lVerts;
 	}
 	else
@@ -2819,22 +2326,22 @@ void MeshEmitter::setupAligned( const Particle *part,
 		// Here and below, we copy UVs from particle datablock's texCoords
 		lVerts->point = start + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[0];
+		lVerts->texCoord = partDB->texCoords[0];
 		++lVerts;
 
 		lVerts->point = start - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[1];
+		lVerts->texCoord = partDB->texCoords[1];
 		++lVerts;
 
 		lVerts->point = end - cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[2];
+		lVerts->texCoord = partDB->texCoords[2];
 		++lVerts;
 
 		lVerts->point = end + cross;
 		lVerts->color = partCol;
-		lVerts->texCoord = part->dataBlock->texCoords[3];
+		lVerts->texCoord = partDB->texCoords[3];
 		++lVerts;
 	}
 }
@@ -2908,9 +2415,9 @@ U32 MeshEmitter::packUpdate(NetConnection* con, U32 mask, BitStream* stream)
 	}
 
 	if( stream->writeFlag( mask & meshEmitterMask ) )
-	{
+	{
         SceneObject* SB = dynamic_cast<SceneObject*>(Sim::findObject(emitMesh));
-        if(!SB) SB = dynamic_cast<SceneObject*>(Sim::findObject(atoi(emitMesh)));
+        if(!SB) SB = dynamic_cast<SceneObject*>(Sim::findObject(atoi(emitMesh)));
         S32 gIndex = con->getGhostIndex(SB);
         if (stream->writeFlag(gIndex != -1))
             stream->writeInt(gIndex,NetConnection::GhostIdBitSize);
@@ -2979,7 +2486,7 @@ void MeshEmitter::unpackUpdate(NetConnection* con, BitStream* stream)
 
 	// Meshemitter mask
 	if ( stream->readFlag() )
-	{
+	{
         if (stream->readFlag()) {
             S32 gIndex = stream->readInt(NetConnection::GhostIdBitSize);
             SceneObject* obj = static_cast<SceneObject*>(con->resolveGhost(gIndex));
@@ -3013,6 +2520,8 @@ void MeshEmitter::unpackUpdate(NetConnection* con, BitStream* stream)
 		stream->read(&reverseOrder);
 		stream->read(&highResOnly);
 		stream->read(&renderReflection);
+
+		mKeyCurvesDirty = true;
 	}
 
 	// Physics mask
@@ -3026,11 +2535,12 @@ void MeshEmitter::unpackUpdate(NetConnection* con, BitStream* stream)
 			stream->read((F32 *)&Amount[i]);
 			char buf[256];
 			stream->readString(buf);
-			attractedObjectID[i] = dStrdup(buf);
+			attractedObjectID[i] = StringTable->insert(buf);
 			char buf2[256];
 			stream->readString(buf2);
-			Attraction_offset[i] = dStrdup(buf2);
+			Attraction_offset[i] = StringTable->insert(buf2);
 		}
+		updateAttraction();
 	}
 }
 
@@ -3077,7 +2587,10 @@ void MeshEmitter::onStaticModified(const char* slotName, const char*newValue)
 		strcmp(slotName, "sticky") == 0 ||
 		strcmp(slotName, "attractedObjectID") == 0 ||
 		strcmp(slotName, "AttractionMode") == 0)
+	{
 		setMaskBits(physicsMask);
+		updateAttraction();
+	}
 	
 	
 	if(!isProperlyAdded())
@@ -3134,216 +2647,19 @@ void MeshEmitter::inspectPostApply()
 
 //-----------------------------------------------------------------------------
 // loadFaces
-//  - This function calculates the area of all the triangles in the mesh
-//  - finds the average area, and adds the triangles one or more times
-//  - to the emitfaces vector based on their area relative to the other faces
-//  - not a perfect way to do it, but it works fine.
+//  - Gathers the vertices and triangles of the emitMesh into mEmitSurface,
+//  - along with the area of every triangle so faces can be picked
+//  - exactly in proportion to their area.
 // Custom
 //-----------------------------------------------------------------------------
 void MeshEmitter::loadFaces()
 {
-	emitfaces.clear();
-	vertexCount = 0;
-	SceneObject* SB = dynamic_cast<SceneObject*>(Sim::findObject(emitMesh));
-	if(!SB)
-		SB = dynamic_cast<SceneObject*>(Sim::findObject(atoi(emitMesh)));
-	if(dynamic_cast<GameBase*>(SB) || dynamic_cast<TSStatic*>(SB)){
-		ShapeBase* SS = dynamic_cast<ShapeBase*>(SB);
-		TSShapeInstance* shape;
-		if(SS)
-			shape = SS->getShapeInstance();
-		else{
-			shape = (dynamic_cast<TSStatic*>(SB))->getShapeInstance();
-		}
-		std::vector<face> triangles/* = *new std::vector<float>()*/;
-		bool skinmesh = false;
-		for(S32 meshIndex = 0; meshIndex < shape->getShape()->meshes.size(); meshIndex++)
-		{
-            if(!shape->getShape()->meshes[meshIndex])
-                continue;
-			//Mesh = shape->getShape()->meshes[meshIndex];
-			TSSkinMesh* sMesh = dynamic_cast<TSSkinMesh*>(shape->getShape()->meshes[meshIndex]);
-			if(sMesh)
-			{
-				if(sMesh->mVertexData.size()){
-					skinmesh = true;
-					break;
-				}
-			}
-		}
-		for (S32 meshIndex = 0; meshIndex < shape->getShape()->meshes.size(); meshIndex++)  
-		{
-            if(!shape->getShape()->meshes[meshIndex])
-                continue;
-			TSSkinMesh* sMesh;
-			TSMesh* Mesh;
-
-			Mesh = shape->getShape()->meshes[meshIndex];
-
-			sMesh = dynamic_cast<TSSkinMesh*>(shape->getShape()->meshes[meshIndex]);
-			
-			/*if(sMesh)
-			{
-				if(!sMesh->mVertexData.size())
-					continue;
-			}
-
-			if(!Mesh && !skinmesh)
-				continue;*/
-
-#pragma region skinMesh
-			if(skinmesh)
-			{
-				if(!sMesh)
-					continue;
-				
-				S32 numVerts = sMesh->mVertexData.size();
-				if(!numVerts)
-					continue;
-				vertexCount += numVerts;
-
-				S32 numPrims = sMesh->primitives.size();
-				if(!numPrims)
-					continue;
-
-				S32 numIndices = sMesh->indices.size();
-				if(!numIndices)
-					continue;
-
-				for( S32 primIndex = 0; primIndex < numPrims; primIndex++ )
-				{
-					S32 start = sMesh->primitives[primIndex].start;
-					
-					S32 numElements = sMesh->primitives[primIndex].numElements;
-
-					if ( (sMesh->primitives[primIndex].matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles) 
-					{
-						
-						TSMesh::__TSMeshVertexBase v1, v2, v3;
-						Point3F p1, p2, p3;
-
-						for (S32 triIndex = 0; triIndex < numElements; triIndex+=3)
-						{
-							U32 triStart = start + triIndex;
-							v1 = sMesh->mVertexData[sMesh->indices[triStart]];
-							v2 = sMesh->mVertexData[sMesh->indices[triStart + 1]];
-							v3 = sMesh->mVertexData[sMesh->indices[triStart + 2]];
-
-							Point3F scale;
-							if(SS)
-								scale = SS->getScale();
-							else
-								scale = (dynamic_cast<TSStatic*>(SB))->getScale();
-							p1 = v1.vert() * scale;
-							p2 = v2.vert() * scale;
-							p3 = v3.vert() * scale;
-
-							Point3F veca = p1 - p2;
-							Point3F vecb = p2 - p3;
-							Point3F vecc = p3 - p1;
-							F32 bounds = (veca.len() + vecb.len() + vecc.len()) / 2;
-
-							face tris;
-							tris.meshIndex = meshIndex;
-							tris.skinMesh = true;
-							tris.triStart = triStart;
-							tris.area = sqrt( bounds * (bounds - veca.len()) * (bounds - vecb.len()) * (bounds - vecc.len()));
-							triangles.push_back(tris);
-						}
-					}
-					else
-					{
-						Con::printf("Not tris");
-					}
-				}
-				
-			}
-#pragma endregion
-			#pragma region !skinMesh
-			if(!skinmesh)
-			{
-				S32 numVerts = Mesh->mVertexData.size();
-				if(!numVerts)
-					continue;
-				vertexCount += numVerts;
-
-				S32 numPrims = Mesh->primitives.size();
-				if(!numPrims)
-					continue;
-
-				S32 numIndices = Mesh->indices.size();
-				if(!numIndices)
-					continue;
-				for( S32 primIndex = 0; primIndex < numPrims; primIndex++ )
-				{
-					S32 start = Mesh->primitives[primIndex].start;
-					S32 numElements = Mesh->primitives[primIndex].numElements;
-
-					if ( (Mesh->primitives[primIndex].matIndex & TSDrawPrimitive::TypeMask) == TSDrawPrimitive::Triangles) 
-					{
-						TSMesh::__TSMeshVertexBase v1, v2, v3;
-						Point3F p1, p2, p3;
-						
-						for (S32 triIndex = 0; triIndex < numElements; triIndex+=3)
-						{
-							U32 triStart = start + triIndex;
-							v1 = Mesh->mVertexData[Mesh->indices[triStart]];
-							v2 = Mesh->mVertexData[Mesh->indices[triStart + 1]];
-							v3 = Mesh->mVertexData[Mesh->indices[triStart + 2]];
-
-							Point3F scale;
-							if(SS)
-								scale = SS->getScale();
-							else
-								scale = (dynamic_cast<TSStatic*>(SB))->getScale();
-							p1 = v1.vert() * scale;
-							p2 = v2.vert() * scale;
-							p3 = v3.vert() * scale;
-
-							Point3F veca = p1 - p2;
-							Point3F vecb = p2 - p3;
-							Point3F vecc = p3 - p1;
-							F32 bounds = (veca.len() + vecb.len() + vecc.len()) / 2;
-							face tris;
-							tris.meshIndex = meshIndex;
-							tris.skinMesh = false;
-							tris.triStart = triStart;
-							tris.area = sqrt( bounds * (bounds - veca.len()) * (bounds - vecb.len()) * (bounds - vecc.len()));
-							triangles.push_back(tris);
-						}
-					}
-					else
-					{
-						Con::printf("Not tris");
-					}
-				}
-				
-			}
-#pragma endregion
-		}
-
-		F32 averageArea = 0;
-		for(S32 index = 0; index < triangles.size(); index++)
-		{
-			averageArea += triangles[index].area;
-		}
-		averageArea = averageArea / triangles.size();
-		
-		for(S32 index = 0; index < triangles.size(); index++)
-		{
-			float n = triangles[index].area / averageArea;
-			float t;
-			t = n - floor(n);
-			if (t >= 0.5)    
-				n = ceil(n);
-			else 
-				n = floor(n);
-			for(int i = -1; i < n; i++)
-			{
-				emitfaces.push_back(triangles[index]);
-			}
-		}
-	}
+	U32 startTime = Platform::getRealMilliseconds();
+	mEmitSurface.build(emitMesh);
+	if(mEmitSurface.getVertexCount())
+		Con::printf("MeshEmitter::loadFaces - %s: %u vertices, %u faces loaded in %u ms, %u bytes",
+			emitMesh, mEmitSurface.getVertexCount(), mEmitSurface.getTriangleCount(),
+			Platform::getRealMilliseconds() - startTime, mEmitSurface.getMemoryUsage());
 }
 
 DefineEngineMethod(MeshEmitterData, reload, void,(),,
@@ -3359,3 +2675,21 @@ DefineEngineMethod(MeshEmitterData, reload, void,(),,
 {
 	object->reload();
 }
+
+DefineEngineMethod(MeshEmitter, getNumAllocs, S32, (),,
+	"@brief Returns the number of times the particles of this emitter were allocated.\n\n"
+	"Adding particles doesn't allocate, the number only increases while the emitter "
+	"has more particles than it had before. Compare it before and after a while of "
+	"steady emission to check that.\n")
+{
+	return object->getNumAllocs();
+}
+
+DefineEngineMethod(MeshEmitter, getNumBoundsUpdates, S32, (),,
+	"@brief Returns the number of times the bounding box of this emitter was refit "
+	"to its particles.\n\n"
+	"Each refit moves the emitter in the scene container. The box is padded, so "
+	"the number should only increase while the effect grows or moves.\n")
+{
+	return object->getNumBoundsUpdates();
+}
@@ -21,6 +21,36 @@
 #ifndef _PARTICLE_H_
 #include "T3D/fx/particle.h"
 #endif
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+#ifndef _H_ATTRACTION_FIELD
+#include "attractionField.h"
+#endif
+#ifndef _H_EMISSION_SURFACE
+#include "emissionSurface.h"
+#endif
+#ifndef _H_PARTICLE_SORT
+#include "particleSort.h"
+#endif
+#ifndef _H_PARTICLE_BUFFER_POOL
+#include "particleBufferPool.h"
+#endif
+#ifndef _H_PARTICLE_KEY_CURVE
+#include "particleKeyCurve.h"
+#endif
+#ifndef _H_PARTICLE_JOBS
+#include "particleJobs.h"
+#endif
+#ifndef _H_PARTICLE_LOD
+#include "particleLOD.h"
+#endif
+#ifndef _H_PARTICLE_BUDGET
+#include "particleBudget.h"
+#endif
+#ifndef _H_PARTICLE_RANDOM
+#include "particleRandom.h"
+#endif
 /*#ifndef _MESH_EMITTERNODE_H_
 #include "meshEmitterNode.h"
 #endif*/
@@ -34,9 +64,6 @@
 #include "core/stream/bitStream.h"
 #endif
 
-#if defined(TORQUE_OS_XENON)
-#include "gfx/D3D9/360/gfx360MemVertexBuffer.h"
-#endif
 
 #include <vector>
 #include <string>
@@ -64,7 +91,7 @@ public:
 	void unpackData(BitStream* stream);
 	bool preload(bool server, String &errorStr);
 	bool onAdd();
-	void allocPrimBuffer( S32 overrideSize = -1 );
+	void calcPartListInitSize();
 
 public:
 	S32   ejectionPeriodMS;					///< Time, in Milliseconds, between particle ejection
@@ -98,8 +125,9 @@ public:
 	Vector<U32>           dataBlockIds;       ///< Datablock IDs (parellel array to particleDataBlocks)
 
 	U32                   partListInitSize;   /// initial size of particle list calc'd from datablock info
+	U32                   maxPartLifeMS;      /// longest particle lifetime calc'd from datablock info
+	Vector<ParticleKeyCurve> keyCurves;       ///< Colors and sizes of particleDataBlocks baked over the particle age
 
-	GFXPrimitiveBufferHandle   primBuff;
 
 	S32                   blendStyle;         ///< Pre-define blend factor setting
 	bool                  sortParticles;      ///< Particles are sorted back-to-front
@@ -108,6 +136,10 @@ public:
 	GFXTexHandle          textureHandle;      ///< Emitter texture handle from txrName
 	bool                  highResOnly;        ///< This particle system should not use the mixed-resolution particle rendering
 	bool                  renderReflection;   ///< Enables this emitter to render into reflection passes.
+	ParticleLOD::Bands    lodBands;           ///< Detail of the emitter at increasing distances from the camera
+	S32                   budgetPriority;     ///< Emitters with a lower priority are throttled first by the ParticleBudget
+	S32                   fixedStepMS;        ///< Simulate in steps of this length for deterministic results, 0 for off
+	S32                   randomSeed;         ///< Seed of the random numbers of the emitters, 0 for a random seed each
 
 	bool reload();
 };
@@ -115,13 +147,11 @@ public:
 //*****************************************************************************
 // Particle Emitter
 //*****************************************************************************
-class MeshEmitter : public GameBase
+class MeshEmitter : public GameBase, public ParticleJob
 {
 	typedef GameBase Parent;
 
 	U32	oldTime;
-	Point3F* rotate(MatrixF trans, Point3F p);
-	Point3F* TSrotate(MatrixF trans, Point3F p);
 	
 	Point3F parentNodePos;
 
@@ -134,13 +164,8 @@ class MeshEmitter : public GameBase
 		NextFreeMask	= Parent::NextFreeMask << 4
 	};
 
-	struct face
-	{
-		S32 triStart;
-		S32 meshIndex;
-		bool skinMesh;
-		F32 area;
-	};
+	// Runs the particle passes of unregistered emitters
+	friend class ParticleBenchmark;
 
 public:
 	// Particle settings ----------------------------------------------------------------
@@ -180,7 +205,7 @@ public:
 	bool                  renderReflection;   ///< Enables this emitter to render into reflection passes.
 	// Particle settings ----------------------------------------------------------------
 
-	Vector<face> emitfaces;
+	EmissionSurface mEmitSurface;			///< Vertices and triangles of the emitMesh
 
 	std::vector<std::string> initialValues;
 	std::vector<std::string> anotherValues;
@@ -191,15 +216,7 @@ public:
 	void onStaticModified(const char* slotName, const char*newValue);
 	//void onDynamicModified(const char* slotName, const char*newValue);
 
-	U32 vertexCount;
-	Vector<int[3]> triList;
-	Vector<int[2]> edgeList;
-
-#if defined(TORQUE_OS_XENON)
-	typedef GFXVertexPCTT ParticleVertexType;
-#else
-	typedef GFXVertexPCT ParticleVertexType;
-#endif
+	typedef ParticleBufferPool::VertexType ParticleVertexType;
 
 	MeshEmitter();
 	~MeshEmitter();
@@ -220,6 +237,12 @@ public:
 	void setColors( ColorF *colorList );
 
 	MeshEmitterData *getDataBlock(){ return mDataBlock; }
+
+	/// Number of times the particle pool was allocated.
+	U32 getNumAllocs() const { return mParts.getNumAllocs(); }
+
+	/// Number of times the object box was refit to the particles.
+	U32 getNumBoundsUpdates() const { return mNumBoundsUpdates; }
 	bool onNewDataBlock( GameBaseData *dptr, bool reload );
 
 	/// By default, a particle renderer will wait for it's owner to delete it.  When this
@@ -239,6 +262,10 @@ public:
 
 	StringTableEntry attractedObjectID[attrobjectCount];
 
+	/// Sets up the attractors from the attraction fields above.
+	/// Call after changing any of the fields.
+	void updateAttraction();
+
 	/// @name Particle Emission
 	/// Main interface for creating particles.  The emitter does _not_ track changes
 	///  in axis or velocity over the course of a single update, so this should be called
@@ -272,24 +299,65 @@ protected:
 	// Added the MeshEmitterNode here
 	void addParticle(const F32 &vel);
 
+	/// Grows the particle pool to hold count particles.
+	void reserveParticles( U32 count );
+
+	/// Reserves room for the particles alive at once when ejecting every
+	/// periodMS +- varianceMS.
+	void updateCapacity( S32 periodMS, S32 varianceMS );
+
+	/// Grows a full particle pool, and logs it.
+	void growParticles();
+
+	/// Picks the detail of the emitter from its distance to the camera.
+	void updateLOD();
+
+	/// Runs the whole fixed steps in dt synchronously, emitting after each,
+	/// see fixedStepMS.
+	void advanceSteps( F32 dt );
 
-	inline void setupBillboard( Particle *part,
+
+	inline void setupBillboard( U32 idx,
 		Point3F *basePts,
 		const MatrixF &camView,
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	inline void setupOriented( Particle *part,
+	inline void setupOriented( U32 idx,
 		const Point3F &camPos,
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	inline void setupAligned(  const Particle *part, 
+	inline void setupAligned(  U32 idx, 
 		const ColorF &ambientColor,
 		ParticleVertexType *lVerts );
 
-	/// Updates the bounding box for the particle system
-	void updateBBox();
+	/// Sets up the particles drawn in a range of slots of a vertex batch.
+	/// Every slot writes its own four vertices, so large emitters split
+	/// the batch over several threads.
+	struct VertexFill : public ParticleJobScheduler::Task
+	{
+		MeshEmitter *emitter;
+		const U32 *sortedParts;    ///< Far to near order, or NULL
+		U32 numParts;
+		bool reverse;
+		U32 firstSlot;             ///< Slot of the first vertex in verts
+		ParticleVertexType *verts;
+		Point3F camPos;
+		ColorF ambientColor;
+		MatrixF camView;
+		Point3F basePoints[4];
+
+		void run( U32 start, U32 end );
+	};
+
+	/// Extends the particle bounds by the particles from first on, which
+	/// were added since the last update.
+	void extendBounds( U32 first );
+
+	/// Refits the object box to the particle bounds when the particles leave
+	/// it or fill only a small part of it.
+	void updateBounds();
 
 	/// @}
 protected:
@@ -307,8 +375,26 @@ protected:
 	// PEngine interface
 private:
 
-	void update( U32 ms );
-	inline void updateKeyData( Particle *part );
+	/// @name ParticleJob
+	/// The update queued by advanceTime, run by the ParticleJobScheduler.
+	/// @{
+	void simulateForces();
+	void simulateMotion();
+	void finishSimulation();
+	/// @}
+
+	inline void updateKeyData( U32 idx );
+
+	/// Points mKeyCurves at the curves of the datablock, or bakes the
+	/// emitter's own if it overrides the colors or sizes.
+	void bakeKeyCurves();
+
+	/// Curve of one of the particle datablocks of this emitter.
+	const ParticleKeyCurve* getKeyCurve( const ParticleData *dataBlock );
+
+	/// Sets the colors and sizes of all the particles from their age.
+	/// @return  The largest size set.
+	F32 applyKeyCurves();
 
 
 private:
@@ -323,10 +409,24 @@ private:
 
 	U32       mNextParticleTime;
 
+	U32       mUpdateMS;             ///< Milliseconds the queued update advances
+	U32       mUpdateCount;          ///< Particles alive when the update was queued
+
+	U32       mCulledTicks;          ///< Ticks the emitMesh has been out of view, up to CullDelayTicks
+	bool      mCulled;               ///< Rendering is disabled because the emitMesh is out of view
+	bool      mCullStateSet;         ///< mCulled has been applied since the emitter was created
+
+	S32       mCapacityPeriodMS;     ///< Ejection period the pool was last reserved for
+	S32       mCapacityVarianceMS;   ///< Period variance the pool was last reserved for
+
 	Point3F   mLastPosition;
 	bool      mHasLastPosition;
 	MatrixF   mBBObjToWorld;
 
+	Box3F     mPartBounds;         ///< Bounds of the particle positions
+	F32       mMaxPartSize;        ///< Largest particle size at the last update
+	U32       mNumBoundsUpdates;   ///< Times the object box was refit
+
 	bool      mDeleteWhenEmpty;
 	bool      mDeleteOnTick;
 
@@ -336,23 +436,38 @@ private:
 	F32       sizes[ ParticleData::PDC_NUM_KEYS ];
 	ColorF    colors[ ParticleData::PDC_NUM_KEYS ];
 
-#if defined(TORQUE_OS_XENON)
-	GFX360MemVertexBufferHandle<ParticleVertexType> mVertBuff;
-#else
-	GFXVertexBufferHandle<ParticleVertexType> mVertBuff;
-#endif
+	//   The color and size curves of the particle datablocks, parallel to
+	//   mDataBlock->particleDataBlocks. They are rebaked when the datablock or
+	//   the emitter colors and sizes change.
+	Vector<const ParticleKeyCurve*> mKeyCurves;
+	Vector<ParticleKeyCurve> mOwnKeyCurves;   ///< Baked with the emitter colors or sizes
+	bool      mKeyCurvesDirty;
+
+	//   The vertices written by the last copyToVB, one buffer per batch of
+	//   MaxBatchQuads particles, borrowed from the ParticleBufferPool until
+	//   the next frame.
+	Vector<ParticleBufferPool::VertexBuffer*> mVertBuffs;
+
+	//   The active emitter particles. The pool is reserved to partListInitSize
+	//   when the datablock is set, which is usually large enough to contain all
+	//   the particles, but it can be expanded in emergency circumstances.
+	ParticlePool mParts;
+
+	//   The attractors set up from the attraction fields, see updateAttraction().
+	AttractionField mAttraction;
+
+	//   Far to near order of the particles when sortParticles is on.
+	ParticleSort mSort;
+
+	//   The detail picked from the lodBands of the datablock each frame.
+	ParticleLOD mLOD;
+
+	//   Share of the particle budget, with the budgetPriority of the datablock.
+	ParticleBudget::Client mBudget;
 
-	//   These members are for implementing a link-list of the active emitter 
-	//   particles. Member part_store contains blocks of particles that can be
-	//   chained in a link-list. Usually the first part_store block is large
-	//   enough to contain all the particles but it can be expanded in emergency
-	//   circumstances.
-	Vector <Particle*> part_store;
-	Particle*  part_freelist;
-	Particle   part_list_head;
-	S32        n_part_capacity;
-	S32        n_parts;
-	S32       mCurBuffSize;
+	//   The random numbers of the particles, seeded from the randomSeed of the datablock.
+	ParticleRandom mRandom;
+	F32       mStepTime;           ///< Seconds not run in a fixed step yet
 
 
 	public:
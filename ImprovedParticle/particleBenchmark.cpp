@@ -0,0 +1,329 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleBenchmark.h"
+#include "graphEmitter.h"
+#include "meshEmitter.h"
+#include "particleIntegrator.h"
+
+#include "math/mRandom.h"
+#include "math/muParser/muParser.h"
+#include "console/engineAPI.h"
+
+// Graph expressions of increasing cost, like the ones the nodes evaluate.
+static const char *BenchmarkExpressions[] =
+{
+	"t",
+	"cos(t)*5",
+	"cos(t*3)*sin(t/2)*10+t^2/100",
+	"sin(t)*cos(t*2)*sqrt(abs(t))+ln(t+1)*atan(t/10)-rint(t/7)*2",
+};
+
+static const char *DrawModeNames[ParticleBenchmark::NumDrawModes] =
+{
+	"billboard",
+	"oriented",
+	"aligned",
+};
+
+//-----------------------------------------------------------------------------
+// run
+//-----------------------------------------------------------------------------
+void ParticleBenchmark::run( U32 numEmitters, U32 numParticles, U32 numFrames )
+{
+	Con::printf( "benchmarkParticles - %u emitters x %u particles, %u frames, %s kernel",
+		numEmitters, numParticles, numFrames, ParticleIntegrator::getKernelName() );
+
+	benchmarkExpressions( numEmitters * numParticles, numFrames );
+
+	// Two particle datablocks with different keys, so the key curves are
+	// looked up per run of particles as in a real emitter
+	ParticleData partData[2];
+	for( U32 i = 0; i < 2; i++ )
+	{
+		partData[i].dragCoefficient = 0.5f * i;
+		partData[i].windCoefficient = 1.0f;
+		partData[i].gravityCoefficient = 0.2f + 0.3f * i;
+		partData[i].lifetimeMS = 2000;
+		for( U32 key = 0; key < ParticleData::PDC_NUM_KEYS; key++ )
+		{
+			const F32 f = F32(key) / ( ParticleData::PDC_NUM_KEYS - 1 );
+			partData[i].times[key] = f;
+			partData[i].sizes[key] = 1.0f + f * ( i + 1 );
+			partData[i].colors[key].set( 1.0f - f, f, 0.5f, 1.0f - f * 0.5f );
+		}
+	}
+
+	GraphEmitterData graphData;
+	MeshEmitterData meshData;
+	for( U32 i = 0; i < 2; i++ )
+	{
+		graphData.particleDataBlocks.push_back( &partData[i] );
+		meshData.particleDataBlocks.push_back( &partData[i] );
+	}
+	graphData.keyCurves.setSize( 2 );
+	meshData.keyCurves.setSize( 2 );
+	for( U32 i = 0; i < 2; i++ )
+	{
+		graphData.keyCurves[i].bake( &partData[i] );
+		meshData.keyCurves[i].bake( &partData[i] );
+	}
+
+	benchmarkEmitters<GraphEmitter>( "GraphEmitter", &graphData, numEmitters, numParticles, numFrames );
+	benchmarkEmitters<MeshEmitter>( "MeshEmitter", &meshData, numEmitters, numParticles, numFrames );
+}
+
+//-----------------------------------------------------------------------------
+// benchmarkExpressions
+//-----------------------------------------------------------------------------
+void ParticleBenchmark::benchmarkExpressions( U32 numParticles, U32 numFrames )
+{
+	Vector<F32> t;
+	Vector<F32> results;
+	t.setSize( numParticles );
+	results.setSize( numParticles );
+	for( U32 i = 0; i < numParticles; i++ )
+		t[i] = F32(i);
+
+	const U32 numExpressions = sizeof(BenchmarkExpressions) / sizeof(BenchmarkExpressions[0]);
+	for( U32 expr = 0; expr < numExpressions; expr++ )
+	{
+		F32 var = 0.0f;
+		mu::Parser parser;
+		parser.DefineVar( "t", &var );
+		parser.SetExpr( BenchmarkExpressions[expr] );
+
+		const mu::SBatchVar tVar = { &var, t.address() };
+		const U32 start = Platform::getRealMilliseconds();
+		try
+		{
+			for( U32 frame = 0; frame < numFrames; frame++ )
+				parser.Eval( results.address(), numParticles, &tVar, 1 );
+		}
+		catch( mu::Parser::exception_type &e )
+		{
+			Con::errorf( "benchmarkParticles - %s", e.GetMsg().c_str() );
+			continue;
+		}
+		const U32 evalMS = Platform::getRealMilliseconds() - start;
+
+		Con::printf( "   expression \"%s\": %.2f ns/particle", BenchmarkExpressions[expr],
+			toNsPerParticle( evalMS, F64(numParticles) * numFrames ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// benchmarkEmitters
+// Every phase runs for all the frames before the next one is timed, so each
+// timing spans enough work to be measured in milliseconds.
+//-----------------------------------------------------------------------------
+template<class Emitter, class EmitterData>
+void ParticleBenchmark::benchmarkEmitters( const char *name, EmitterData *data,
+	U32 numEmitters, U32 numParticles, U32 numFrames )
+{
+	Vector<Emitter*> emitters;
+	for( U32 i = 0; i < numEmitters; i++ )
+	{
+		Emitter *emitter = new Emitter;
+		emitter->mDataBlock = data;
+		emitter->mParts.reserve( numParticles );
+		fillPool( emitter->mParts, numParticles, data->particleDataBlocks, 0x5e11 + i );
+		emitters.push_back( emitter );
+	}
+
+	// A large but valid run overflows a U32
+	const F64 numUpdated = F64(numEmitters) * numParticles * numFrames;
+	const F32 dt = 0.032f;
+
+	// The update, without and with an attractor in range of the particles
+	for( U32 attract = 0; attract < 2; attract++ )
+	{
+		for( U32 i = 0; i < numEmitters; i++ )
+		{
+			AttractionField &field = emitters[i]->mAttraction;
+			field.setRange( 50.0f );
+			field.setAttractor( 0, attract ? AttractionField::Attract : AttractionField::None, 5.0f, "", "" );
+			if( attract )
+				field.setTarget( 0, Point3F( 0.0f, 0.0f, 10.0f ) );
+		}
+
+		U32 start = Platform::getRealMilliseconds();
+		for( U32 frame = 0; frame < numFrames; frame++ )
+			for( U32 i = 0; i < numEmitters; i++ )
+				emitters[i]->mAttraction.apply( emitters[i]->mParts );
+		const U32 attractionMS = Platform::getRealMilliseconds() - start;
+
+		start = Platform::getRealMilliseconds();
+		for( U32 frame = 0; frame < numFrames; frame++ )
+			for( U32 i = 0; i < numEmitters; i++ )
+				ParticleIntegrator::integrate( emitters[i]->mParts, Emitter::mWindVelocity, dt,
+					ParticleIntegrator::IntegrateAll, &emitters[i]->mPartBounds );
+		const U32 integrateMS = Platform::getRealMilliseconds() - start;
+
+		start = Platform::getRealMilliseconds();
+		for( U32 frame = 0; frame < numFrames; frame++ )
+			for( U32 i = 0; i < numEmitters; i++ )
+				emitters[i]->mMaxPartSize = emitters[i]->applyKeyCurves();
+		const U32 keyCurvesMS = Platform::getRealMilliseconds() - start;
+
+		Con::printf( "   %s update, attraction %s: attraction %.2f, integration %.2f, key curves %.2f ns/particle",
+			name, attract ? "on" : "off", toNsPerParticle( attractionMS, numUpdated ),
+			toNsPerParticle( integrateMS, numUpdated ), toNsPerParticle( keyCurvesMS, numUpdated ) );
+	}
+
+	// The render, sorted and unsorted in every draw mode
+	Vector<typename Emitter::ParticleVertexType> verts;
+	verts.setSize( numParticles * 4 );
+	Vector<const U32*> sortedParts;
+	sortedParts.setSize( numEmitters );
+
+	typename Emitter::VertexFill fill;
+	fill.numParts = numParticles;
+	fill.reverse = false;
+	fill.firstSlot = 0;
+	fill.verts = verts.address();
+	fill.camPos.set( 0.0f, -30.0f, 5.0f );
+	fill.ambientColor.set( 0.5f, 0.5f, 0.5f, 1.0f );
+	fill.camView.identity();
+	fill.basePoints[0] = Point3F(-1.0, 0.0,  1.0);
+	fill.basePoints[1] = Point3F(-1.0, 0.0, -1.0);
+	fill.basePoints[2] = Point3F( 1.0, 0.0, -1.0);
+	fill.basePoints[3] = Point3F( 1.0, 0.0,  1.0);
+
+	for( U32 sorted = 0; sorted < 2; sorted++ )
+	{
+		U32 sortMS = 0;
+		if( sorted )
+		{
+			const U32 start = Platform::getRealMilliseconds();
+			for( U32 frame = 0; frame < numFrames; frame++ )
+				for( U32 i = 0; i < numEmitters; i++ )
+					sortedParts[i] = emitters[i]->mSort.sort( emitters[i]->mParts, Point3F( 0.0f, 1.0f, 0.0f ) );
+			sortMS = Platform::getRealMilliseconds() - start;
+		}
+		else
+		{
+			for( U32 i = 0; i < numEmitters; i++ )
+				sortedParts[i] = NULL;
+		}
+
+		for( U32 mode = 0; mode < NumDrawModes; mode++ )
+		{
+			for( U32 i = 0; i < numEmitters; i++ )
+				setDrawMode( emitters[i], (DrawMode)mode, sorted );
+
+			const U32 start = Platform::getRealMilliseconds();
+			for( U32 frame = 0; frame < numFrames; frame++ )
+			{
+				for( U32 i = 0; i < numEmitters; i++ )
+				{
+					fill.emitter = emitters[i];
+					fill.sortedParts = sortedParts[i];
+					fill.run( 0, numParticles );
+				}
+			}
+			const U32 fillMS = Platform::getRealMilliseconds() - start;
+
+			Con::printf( "   %s render, %s %s: sort %.2f, vertex fill %.2f ns/particle",
+				name, sorted ? "sorted" : "unsorted", DrawModeNames[mode],
+				toNsPerParticle( sortMS, numUpdated ), toNsPerParticle( fillMS, numUpdated ) );
+		}
+	}
+
+	for( U32 i = 0; i < numEmitters; i++ )
+		delete emitters[i];
+}
+
+//-----------------------------------------------------------------------------
+// fillPool
+//-----------------------------------------------------------------------------
+void ParticleBenchmark::fillPool( ParticlePool &pool, U32 numParticles,
+	const Vector<ParticleData*> &dataBlocks, U32 seed )
+{
+	MRandomLCG rand( seed );
+
+	Particle part;
+	dMemset( &part, 0, sizeof(Particle) );
+	part.orientDir.set( 0.0f, 0.0f, 1.0f );
+	part.totalLifetime = 2000;
+
+	// Runs of particles from the same datablock, like an emitter ejecting
+	// a few particles at a time
+	U32 runLeft = 0;
+	for( U32 i = 0; i < numParticles; i++ )
+	{
+		if( runLeft == 0 )
+		{
+			part.dataBlock = dataBlocks[rand.randI( 0, dataBlocks.size() - 1 )];
+			runLeft = rand.randI( 1, 16 );
+		}
+		runLeft--;
+
+		part.pos.set( rand.randF( -20.0f, 20.0f ), rand.randF( -20.0f, 20.0f ), rand.randF( 0.0f, 20.0f ) );
+		part.vel.set( rand.randF( -2.0f, 2.0f ), rand.randF( -2.0f, 2.0f ), rand.randF( 0.0f, 5.0f ) );
+		part.currentAge = rand.randI( 0, part.totalLifetime );
+		part.spinSpeed = rand.randF( -90.0f, 90.0f );
+		part.size = 1.0f;
+		part.color.set( 1.0f, 1.0f, 1.0f, 1.0f );
+		pool.add( part );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// setDrawMode
+//-----------------------------------------------------------------------------
+void ParticleBenchmark::setDrawMode( GraphEmitter *emitter, DrawMode mode, bool sorted )
+{
+	GraphEmitterData *data = emitter->mDataBlock;
+	data->orientParticles = mode == DrawOriented;
+	data->orientOnVelocity = true;
+	data->alignParticles = mode == DrawAligned;
+	data->alignDirection.set( 0.0f, 0.0f, 1.0f );
+	data->sortParticles = sorted;
+}
+
+void ParticleBenchmark::setDrawMode( MeshEmitter *emitter, DrawMode mode, bool sorted )
+{
+	emitter->orientParticles = mode == DrawOriented;
+	emitter->orientOnVelocity = true;
+	emitter->alignParticles = mode == DrawAligned;
+	emitter->alignDirection.set( 0.0f, 0.0f, 1.0f );
+	emitter->sortParticles = sorted;
+}
+
+//-----------------------------------------------------------------------------
+// toNsPerParticle
+//-----------------------------------------------------------------------------
+F32 ParticleBenchmark::toNsPerParticle( U32 ms, F64 numParticles )
+{
+	if( numParticles <= 0.0 )
+		return 0.0f;
+	return F32( F64(ms) * 1000000.0 / numParticles );
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( benchmarkParticles, void, ( S32 numEmitters, S32 numParticles, S32 numFrames ), ( 8, 10000, 100 ),
+	"@brief Times the per particle work of the particle emitters and prints the "
+	"nanoseconds spent per particle in each phase.\n\n"
+	"Covers the graph expressions, the attraction, integration and key curve "
+	"passes of the update with and without an attractor, and the sort and vertex "
+	"setup of the render in every draw mode, for both GraphEmitter and MeshEmitter. "
+	"Needs no GFX device or level, so it can run on a dedicated server.\n\n"
+	"@param numEmitters Number of emitters updated per frame.\n"
+	"@param numParticles Number of particles in each emitter.\n"
+	"@param numFrames Number of frames each phase runs for.\n"
+	"@internal")
+{
+	if( numEmitters < 1 || numParticles < 1 || numFrames < 1 )
+	{
+		Con::errorf( "benchmarkParticles - the counts must be positive" );
+		return;
+	}
+
+	ParticleBenchmark::run( numEmitters, numParticles, numFrames );
+}
@@ -0,0 +1,66 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_BENCHMARK
+#define _H_PARTICLE_BENCHMARK
+
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+
+class GraphEmitter;
+class MeshEmitter;
+
+//*****************************************************************************
+// Particle Benchmark
+//
+// Times the per particle work of the emitters outside of a running level:
+// the graph expressions evaluated on emission, the attraction, integration
+// and key curve passes of the update, and the sort and vertex setup of
+// copyToVB. The emitters and datablocks are never registered, the vertices
+// are written to system memory and the attractors get fixed targets, so the
+// benchmark needs neither a GFX device nor a scene and runs on a dedicated
+// server, giving comparable numbers on a machine without a GPU.
+// Every phase is reported in nanoseconds per particle.
+//*****************************************************************************
+class ParticleBenchmark
+{
+public:
+	/// How copyToVB sets up the particles.
+	enum DrawMode
+	{
+		DrawBillboard,
+		DrawOriented,
+		DrawAligned,
+		NumDrawModes,
+	};
+
+	/// Runs every scenario with numEmitters emitters of numParticles
+	/// particles each for numFrames frames, and prints the results.
+	static void run( U32 numEmitters, U32 numParticles, U32 numFrames );
+
+private:
+	/// Times evaluating graph expressions of increasing complexity for
+	/// batches of numParticles particles.
+	static void benchmarkExpressions( U32 numParticles, U32 numFrames );
+
+	/// Times the update and render phases of emitters of one type.
+	template<class Emitter, class EmitterData>
+	static void benchmarkEmitters( const char *name, EmitterData *data,
+		U32 numEmitters, U32 numParticles, U32 numFrames );
+
+	/// Fills a pool with particles spread around the origin.
+	static void fillPool( ParticlePool &pool, U32 numParticles,
+		const Vector<ParticleData*> &dataBlocks, U32 seed );
+
+	/// Sets how an emitter draws its particles.
+	static void setDrawMode( GraphEmitter *emitter, DrawMode mode, bool sorted );
+	static void setDrawMode( MeshEmitter *emitter, DrawMode mode, bool sorted );
+
+	/// Time spent on each of numParticles particles.
+	static F32 toNsPerParticle( U32 ms, F64 numParticles );
+};
+
+#endif // _H_PARTICLE_BENCHMARK
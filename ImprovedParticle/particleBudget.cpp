@@ -0,0 +1,322 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleBudget.h"
+
+#include "console/engineAPI.h"
+
+Vector<ParticleBudget::Client*> ParticleBudget::smClients;
+Vector<ParticleBudget::Client*> ParticleBudget::smOrder;
+U32 ParticleBudget::smMaxParticles = 0;
+U32 ParticleBudget::smMaxSpawnsPerFrame = 0;
+U32 ParticleBudget::smSpawnLimit = U32_MAX;
+bool ParticleBudget::smRegistered = false;
+ParticleBudget::Stats ParticleBudget::smStats = { 0, 0, 0, 0, 0, U32_MAX };
+
+//-----------------------------------------------------------------------------
+// Client
+//-----------------------------------------------------------------------------
+ParticleBudget::Client::Client()
+{
+	mPriority = 0;
+	mDistance = 0.0f;
+	mNumParticles = 0;
+	mNumRequested = 0;
+	mNumSpawned = 0;
+	mGranted = 1.0f;
+	mCredit = 0.0f;
+	mRegistered = false;
+}
+
+ParticleBudget::Client::~Client()
+{
+	unregisterClient();
+}
+
+void ParticleBudget::Client::registerClient()
+{
+	if( mRegistered )
+		return;
+
+	if( !smRegistered )
+	{
+		GFXDevice::getDeviceEventSignal().notify( &ParticleBudget::onDeviceEvent );
+		smRegistered = true;
+	}
+
+	smClients.push_back( this );
+	mRegistered = true;
+}
+
+void ParticleBudget::Client::unregisterClient()
+{
+	if( !mRegistered )
+		return;
+
+	for( U32 i = 0; i < smClients.size(); i++ )
+	{
+		if( smClients[i] == this )
+		{
+			smClients.erase_fast( i );
+			break;
+		}
+	}
+	mRegistered = false;
+}
+
+//-----------------------------------------------------------------------------
+// trySpawn
+// The granted fraction adds up in mCredit, and a particle is spawned each
+// time it reaches one, so a throttled emitter still spawns evenly.
+// Emitters that aren't registered, like the deterministic ones, are never
+// throttled.
+//-----------------------------------------------------------------------------
+bool ParticleBudget::Client::trySpawn()
+{
+	if( !mRegistered )
+		return true;
+
+	mNumRequested++;
+
+	if( smSpawnLimit == 0 )
+		return false;
+
+	if( mGranted < 1.0f )
+	{
+		mCredit += mGranted;
+		if( mCredit < 1.0f )
+			return false;
+		mCredit -= 1.0f;
+	}
+
+	mNumSpawned++;
+	smSpawnLimit--;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// compareClients
+// Highest priority first, nearest first within a priority.
+//-----------------------------------------------------------------------------
+S32 QSORT_CALLBACK ParticleBudget::compareClients( const void *a, const void *b )
+{
+	const Client *ca = *(const Client* const*)a;
+	const Client *cb = *(const Client* const*)b;
+
+	if( ca->mPriority != cb->mPriority )
+		return ca->mPriority > cb->mPriority ? -1 : 1;
+	if( ca->mDistance != cb->mDistance )
+		return ca->mDistance < cb->mDistance ? -1 : 1;
+	return 0;
+}
+
+//-----------------------------------------------------------------------------
+// allocate
+// The spawns asked for in the last frame are the estimate for this frame.
+// The spawns of emitters that asked for none are not limited beyond the
+// spawns left this frame, so a new explosion isn't held back a frame.
+//-----------------------------------------------------------------------------
+void ParticleBudget::allocate()
+{
+	PROFILE_SCOPE(ParticleBudget_allocate);
+
+	U32 numParticles = 0;
+	U32 numRequested = 0;
+	U32 numSpawned = 0;
+	for( U32 i = 0; i < smClients.size(); i++ )
+	{
+		numParticles += smClients[i]->mNumParticles;
+		numRequested += smClients[i]->mNumRequested;
+		numSpawned += smClients[i]->mNumSpawned;
+	}
+
+	// Spawns the budget has room for this frame
+	U32 limit = U32_MAX;
+	if( smMaxParticles != 0 )
+		limit = numParticles < smMaxParticles ? smMaxParticles - numParticles : 0;
+	if( smMaxSpawnsPerFrame != 0 )
+		limit = getMin( limit, smMaxSpawnsPerFrame );
+
+	U32 numThrottled = 0;
+	if( numRequested <= limit )
+	{
+		for( U32 i = 0; i < smClients.size(); i++ )
+			smClients[i]->mGranted = 1.0f;
+	}
+	else
+	{
+		smOrder = smClients;
+		dQsort( smOrder.address(), smOrder.size(), sizeof(Client*), compareClients );
+
+		U32 left = limit;
+		for( U32 i = 0; i < smOrder.size(); i++ )
+		{
+			Client *client = smOrder[i];
+			if( client->mNumRequested <= left )
+			{
+				client->mGranted = 1.0f;
+				left -= client->mNumRequested;
+			}
+			else
+			{
+				client->mGranted = F32(left) / F32(client->mNumRequested);
+				left = 0;
+				numThrottled++;
+			}
+		}
+	}
+
+	for( U32 i = 0; i < smClients.size(); i++ )
+	{
+		smClients[i]->mNumRequested = 0;
+		smClients[i]->mNumSpawned = 0;
+	}
+	smSpawnLimit = limit;
+
+	smStats.numClients = smClients.size();
+	smStats.numParticles = numParticles;
+	smStats.numRequested = numRequested;
+	smStats.numSpawned = numSpawned;
+	smStats.numThrottled = numThrottled;
+	smStats.spawnLimit = limit;
+}
+
+//-----------------------------------------------------------------------------
+// onDeviceEvent
+//-----------------------------------------------------------------------------
+bool ParticleBudget::onDeviceEvent( GFXDevice::GFXDeviceEventType evt )
+{
+	if( evt == GFXDevice::deStartOfFrame )
+		allocate();
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( setParticleBudget, void, ( S32 maxParticles, S32 maxSpawnsPerFrame ), ( 0 ),
+	"@brief Limits the particles of all the graph and mesh emitters together. "
+	"Emitters with a lower budgetPriority, and distant emitters within a "
+	"priority, are throttled first.\n\n"
+	"@param maxParticles Particles alive at once, 0 for no limit.\n"
+	"@param maxSpawnsPerFrame Particles spawned per frame, 0 for no limit.\n"
+	"@internal")
+{
+	ParticleBudget::setMaxParticles( getMax( maxParticles, 0 ) );
+	ParticleBudget::setMaxSpawnsPerFrame( getMax( maxSpawnsPerFrame, 0 ) );
+}
+
+DefineEngineFunction( getParticleBudgetStats, const char*, (),,
+	"@brief Returns the statistics of the particle budget as of the start of "
+	"the frame.\n\n"
+	"@return \"numEmitters numParticles numRequested numSpawned numThrottled "
+	"spawnLimit\", where the requests and spawns are those of the last frame "
+	"and spawnLimit is -1 without a limit.\n"
+	"@internal")
+{
+	const ParticleBudget::Stats &stats = ParticleBudget::getStats();
+
+	char *ret = Con::getReturnBuffer( 96 );
+	dSprintf( ret, 96, "%u %u %u %u %u %d", stats.numClients, stats.numParticles,
+		stats.numRequested, stats.numSpawned, stats.numThrottled,
+		stats.spawnLimit == U32_MAX ? -1 : (S32)stats.spawnLimit );
+	return ret;
+}
+
+DefineEngineFunction( testParticleBudget, bool, ( S32 numFrames ), ( 60 ),
+	"@brief Runs emitters of three priorities at three distances against a "
+	"spawn budget, and checks that the budget holds, that the high priority "
+	"emitters are never throttled and that the nearest of the throttled "
+	"priority spawns the most.\n\n"
+	"@param numFrames Number of frames to run.\n"
+	"@return True if the test passed.\n"
+	"@internal")
+{
+	const U32 oldMaxParticles = ParticleBudget::getMaxParticles();
+	const U32 oldMaxSpawns = ParticleBudget::getMaxSpawnsPerFrame();
+
+	// Each emitter asks for 100 spawns per frame, the budget has room for
+	// the high priority ones and about half of the medium ones
+	const U32 numClients = 9;
+	const U32 wanted = 100;
+	const S32 priorities[3] = { 2, 1, 0 };
+	const F32 distances[3] = { 10.0f, 50.0f, 200.0f };
+	ParticleBudget::setMaxParticles( 0 );
+	ParticleBudget::setMaxSpawnsPerFrame( 450 );
+
+	ParticleBudget::Client clients[numClients];
+	U32 spawned[numClients];
+	for( U32 i = 0; i < numClients; i++ )
+	{
+		clients[i].registerClient();
+		clients[i].setPriority( priorities[i / 3] );
+		clients[i].report( 0, distances[i % 3] );
+		spawned[i] = 0;
+	}
+
+	bool passed = true;
+	for( S32 frame = 0; frame < numFrames; frame++ )
+	{
+		ParticleBudget::allocate();
+
+		// The emitters ask in turns, like they do over a frame
+		U32 frameSpawned = 0;
+		for( U32 n = 0; n < wanted; n++ )
+		{
+			for( U32 i = 0; i < numClients; i++ )
+			{
+				if( clients[i].trySpawn() )
+				{
+					frameSpawned++;
+					if( frame > 0 )
+						spawned[i]++;
+				}
+			}
+		}
+
+		if( frameSpawned > ParticleBudget::getMaxSpawnsPerFrame() )
+		{
+			Con::errorf( "testParticleBudget - failed, %u spawns in frame %d over a budget of %u",
+				frameSpawned, frame, ParticleBudget::getMaxSpawnsPerFrame() );
+			passed = false;
+			break;
+		}
+	}
+
+	const U32 numMeasured = getMax( numFrames - 1, 0 );
+	if( passed && numMeasured > 0 )
+	{
+		for( U32 i = 0; i < 3; i++ )
+		{
+			if( spawned[i] != wanted * numMeasured )
+			{
+				Con::errorf( "testParticleBudget - failed, high priority emitter %u spawned %u of %u particles",
+					i, spawned[i], wanted * numMeasured );
+				passed = false;
+			}
+		}
+		if( spawned[3] < spawned[4] || spawned[4] < spawned[5] || spawned[5] < spawned[6] )
+		{
+			Con::errorf( "testParticleBudget - failed, the medium priority emitters spawned %u %u %u, the low %u",
+				spawned[3], spawned[4], spawned[5], spawned[6] );
+			passed = false;
+		}
+	}
+
+	const ParticleBudget::Stats stats = ParticleBudget::getStats();
+	for( U32 i = 0; i < numClients; i++ )
+		clients[i].unregisterClient();
+	ParticleBudget::setMaxParticles( oldMaxParticles );
+	ParticleBudget::setMaxSpawnsPerFrame( oldMaxSpawns );
+	ParticleBudget::allocate();
+
+	if( passed )
+		Con::printf( "testParticleBudget - passed, %u of %u spawns per frame allowed, %u emitters throttled, "
+			"medium priority spawned %u %u %u per frame",
+			stats.numSpawned, stats.numRequested, stats.numThrottled,
+			spawned[3] / getMax( numMeasured, 1U ), spawned[4] / getMax( numMeasured, 1U ), spawned[5] / getMax( numMeasured, 1U ) );
+	return passed;
+}
@@ -0,0 +1,114 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_BUDGET
+#define _H_PARTICLE_BUDGET
+
+#ifndef _GFXDEVICE_H_
+#include "gfx/gfxDevice.h"
+#endif
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+//*****************************************************************************
+// Particle Budget
+//
+// Limits the particles alive, and the particles spawned per frame, over all
+// the emitters. The emitters ask before adding each particle. At the start
+// of each frame the spawns they asked for in the last frame are granted in
+// order of priority, nearest first within a priority, until the budget runs
+// out. An emitter granted part of its spawns gets that fraction of its
+// particles spread evenly over the frame.
+//
+// Particles alive are never killed to meet the budget, the emitters over it
+// stop spawning until their particles die.
+//*****************************************************************************
+class ParticleBudget
+{
+public:
+	struct Stats
+	{
+		U32 numClients;         ///< Emitters registered
+		U32 numParticles;       ///< Particles alive at the last allocation
+		U32 numRequested;       ///< Spawns asked for in the last frame
+		U32 numSpawned;         ///< Spawns allowed in the last frame
+		U32 numThrottled;       ///< Emitters granted less than they asked for at the last allocation
+		U32 spawnLimit;         ///< Spawns the budget had room for this frame
+	};
+
+	/// An emitter's share of the budget.
+	class Client
+	{
+	public:
+		Client();
+		~Client();
+
+		/// Adds the emitter to the budget, until unregisterClient() or
+		/// destruction.
+		void registerClient();
+		void unregisterClient();
+
+		/// Emitters with a higher priority are throttled last.
+		void setPriority( S32 priority ) { mPriority = priority; }
+
+		/// Reports the particles alive and the distance to the camera,
+		/// once per frame.
+		void report( U32 numParticles, F32 distance )
+		{
+			mNumParticles = numParticles;
+			mDistance = distance;
+		}
+
+		/// Asks to add a particle.
+		/// @return  False if the budget doesn't allow it, always true
+		///          while unregistered.
+		bool trySpawn();
+
+		/// Fraction of its spawns the emitter was granted at the last
+		/// allocation.
+		F32 getGranted() const { return mGranted; }
+
+	private:
+		friend class ParticleBudget;
+
+		S32  mPriority;
+		F32  mDistance;
+		U32  mNumParticles;
+		U32  mNumRequested;     ///< Spawns asked for since the last allocation
+		U32  mNumSpawned;       ///< Spawns allowed since the last allocation
+		F32  mGranted;
+		F32  mCredit;           ///< Part of a spawn the granted fraction has paid for
+		bool mRegistered;
+	};
+
+	/// Particles alive over all the emitters, 0 for no limit.
+	static void setMaxParticles( U32 count ) { smMaxParticles = count; }
+	static U32 getMaxParticles() { return smMaxParticles; }
+
+	/// Particles spawned per frame over all the emitters, 0 for no limit.
+	static void setMaxSpawnsPerFrame( U32 count ) { smMaxSpawnsPerFrame = count; }
+	static U32 getMaxSpawnsPerFrame() { return smMaxSpawnsPerFrame; }
+
+	/// Grants the spawns asked for since the last allocation, called at the
+	/// start of each frame.
+	static void allocate();
+
+	static const Stats& getStats() { return smStats; }
+
+private:
+	static S32 QSORT_CALLBACK compareClients( const void *a, const void *b );
+	static bool onDeviceEvent( GFXDevice::GFXDeviceEventType evt );
+
+	static Vector<Client*> smClients;
+	static Vector<Client*> smOrder;       ///< Clients in the order they are granted spawns
+	static U32 smMaxParticles;
+	static U32 smMaxSpawnsPerFrame;
+	static U32 smSpawnLimit;              ///< Spawns left this frame
+	static bool smRegistered;
+	static Stats smStats;
+};
+
+#endif // _H_PARTICLE_BUDGET
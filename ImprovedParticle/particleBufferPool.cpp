@@ -0,0 +1,181 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleBufferPool.h"
+
+#include "math/mMathFn.h"
+#include "console/engineAPI.h"
+
+Vector<ParticleBufferPool::Buffer*> ParticleBufferPool::smBuffers;
+GFXPrimitiveBufferHandle ParticleBufferPool::smQuadIndices;
+U32 ParticleBufferPool::smNumIndexQuads = 0;
+U32 ParticleBufferPool::smFrame = 1;
+U32 ParticleBufferPool::smBytesThisFrame = 0;
+U32 ParticleBufferPool::smBorrowedThisFrame = 0;
+bool ParticleBufferPool::smRegistered = false;
+ParticleBufferPool::Stats ParticleBufferPool::smStats = { 0, 0, 0, 0, 0, 0 };
+
+//-----------------------------------------------------------------------------
+// borrowVerts
+// Picks the smallest free buffer that is large enough.
+//-----------------------------------------------------------------------------
+ParticleBufferPool::VertexBuffer* ParticleBufferPool::borrowVerts( U32 numQuads )
+{
+	AssertFatal( numQuads <= MaxBatchQuads, "ParticleBufferPool::borrowVerts - too many particles for one batch" );
+
+	if( !smRegistered )
+	{
+		GFXDevice::getDeviceEventSignal().notify( &onDeviceEvent );
+		smRegistered = true;
+	}
+
+	Buffer *best = NULL;
+	for( U32 i = 0; i < smBuffers.size(); i++ )
+	{
+		Buffer *buffer = smBuffers[i];
+		if( buffer->lastFrame == smFrame || buffer->numQuads < numQuads )
+			continue;
+		if( !best || buffer->numQuads < best->numQuads )
+			best = buffer;
+	}
+
+	if( !best )
+	{
+		best = new Buffer;
+		best->numQuads = getMax( (U32)MinQuads, getNextPow2( numQuads ) );
+		best->verts.set( GFX, best->numQuads * 4, GFXBufferTypeDynamic );
+		smBuffers.push_back( best );
+
+		smStats.numBuffers++;
+		smStats.bytesAllocated += best->numQuads * 4 * sizeof(VertexType);
+		smStats.numCreated++;
+	}
+
+	best->lastFrame = smFrame;
+	smBytesThisFrame += numQuads * 4 * sizeof(VertexType);
+	smBorrowedThisFrame++;
+	return &best->verts;
+}
+
+//-----------------------------------------------------------------------------
+// getQuadIndices
+//-----------------------------------------------------------------------------
+GFXPrimitiveBufferHandle* ParticleBufferPool::getQuadIndices( U32 numQuads )
+{
+	numQuads = getMin( numQuads, (U32)MaxBatchQuads );
+	if( numQuads <= smNumIndexQuads && smQuadIndices.isValid() )
+		return &smQuadIndices;
+
+	smNumIndexQuads = getMax( (U32)MinQuads, getNextPow2( numQuads ) );
+
+	GFXBufferType bufferType = GFXBufferTypeStatic;
+#ifdef TORQUE_OS_XENON
+	// Because of the way the volatile buffers work on Xenon this is the only
+	// way to do this.
+	bufferType = GFXBufferTypeVolatile;
+#endif
+	const U32 indexListSize = smNumIndexQuads * 6; // 6 indices per particle
+	smQuadIndices.set( GFX, indexListSize, 0, bufferType );
+
+	U16 *indices;
+	smQuadIndices.lock( &indices );
+	for( U32 i = 0; i < smNumIndexQuads; i++ )
+	{
+		// this index ordering should be optimal (hopefully) for the vertex cache
+		U16 *idx = &indices[i*6];
+		const U32 offset = i * 4;
+		idx[0] = 0 + offset;
+		idx[1] = 1 + offset;
+		idx[2] = 3 + offset;
+		idx[3] = 1 + offset;
+		idx[4] = 3 + offset;
+		idx[5] = 2 + offset;
+	}
+	smQuadIndices.unlock();
+
+	return &smQuadIndices;
+}
+
+//-----------------------------------------------------------------------------
+// startFrame
+// Every buffer is free again, the ones that have been idle for a while are
+// freed.
+//-----------------------------------------------------------------------------
+void ParticleBufferPool::startFrame()
+{
+	smStats.bytesUsed = smBytesThisFrame;
+	smStats.numBorrowed = smBorrowedThisFrame;
+	smBytesThisFrame = 0;
+	smBorrowedThisFrame = 0;
+	smFrame++;
+
+	for( S32 i = smBuffers.size() - 1; i >= 0; i-- )
+	{
+		Buffer *buffer = smBuffers[i];
+		if( smFrame - buffer->lastFrame <= MaxIdleFrames )
+			continue;
+
+		smStats.numBuffers--;
+		smStats.bytesAllocated -= buffer->numQuads * 4 * sizeof(VertexType);
+		smStats.numFreed++;
+		delete buffer;
+		smBuffers.erase_fast( i );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// reset
+//-----------------------------------------------------------------------------
+void ParticleBufferPool::reset()
+{
+	smStats.numFreed += smBuffers.size();
+	for( U32 i = 0; i < smBuffers.size(); i++ )
+		delete smBuffers[i];
+	smBuffers.clear();
+	smStats.numBuffers = 0;
+	smStats.bytesAllocated = 0;
+
+	smQuadIndices = NULL;
+	smNumIndexQuads = 0;
+}
+
+//-----------------------------------------------------------------------------
+// onDeviceEvent
+//-----------------------------------------------------------------------------
+bool ParticleBufferPool::onDeviceEvent( GFXDevice::GFXDeviceEventType evt )
+{
+	switch( evt )
+	{
+	case GFXDevice::deStartOfFrame:
+		startFrame();
+		break;
+
+	case GFXDevice::deDestroy:
+		reset();
+		break;
+
+	default:
+		break;
+	}
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( getParticleBufferStats, const char*, (),,
+	"@brief Returns the state of the vertex buffers the particle emitters render from.\n\n"
+	"@return \"buffers bytesAllocated bytesUsed borrowed created freed\", where bytesUsed "
+	"and borrowed are for the last frame and created and freed are since startup.\n"
+	"@internal")
+{
+	const ParticleBufferPool::Stats &stats = ParticleBufferPool::getStats();
+	char *ret = Con::getReturnBuffer( 128 );
+	dSprintf( ret, 128, "%u %u %u %u %u %u", stats.numBuffers, stats.bytesAllocated,
+		stats.bytesUsed, stats.numBorrowed, stats.numCreated, stats.numFreed );
+	return ret;
+}
@@ -0,0 +1,98 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_BUFFER_POOL
+#define _H_PARTICLE_BUFFER_POOL
+
+#ifndef _GFXDEVICE_H_
+#include "gfx/gfxDevice.h"
+#endif
+#ifndef _GFXVERTEXBUFFER_H_
+#include "gfx/gfxVertexBuffer.h"
+#endif
+#ifndef _GFXPRIMITIVEBUFFER_H_
+#include "gfx/gfxPrimitiveBuffer.h"
+#endif
+
+//*****************************************************************************
+// Particle Buffer Pool
+//
+// The GPU buffers the emitters render from, shared by all the emitters.
+// Instead of every emitter owning a vertex buffer that is reallocated as it
+// grows, an emitter borrows a dynamic vertex buffer for the frame it renders
+// in. The buffers come in power of two sizes and are handed back at the
+// start of the next frame, so the number of buffers follows the number of
+// emitters drawn in a frame rather than the number of emitters in the level,
+// and an emitter that grows moves to a larger buffer instead of reallocating.
+// Buffers not used for a while are freed.
+// The render bin draws every particle batch from the start of its vertex
+// buffer, so a buffer is never split between emitters.
+// All the emitters draw with the same quad index buffer. Its indices are 16
+// bit, which addresses MaxBatchQuads particles, so larger emitters draw in
+// several batches with a vertex buffer each.
+//*****************************************************************************
+class ParticleBufferPool
+{
+public:
+#if defined(TORQUE_OS_XENON)
+	typedef GFXVertexPCTT VertexType;
+#else
+	typedef GFXVertexPCT VertexType;
+#endif
+	typedef GFXVertexBufferHandle<VertexType> VertexBuffer;
+
+	enum
+	{
+		MinQuads = 64,          ///< Size of the smallest vertex buffer, in particles
+		MaxBatchQuads = 16384,  ///< Particles addressable by 16 bit indices
+		MaxIdleFrames = 120,    ///< Buffers unused for longer are freed
+	};
+
+	struct Stats
+	{
+		U32 numBuffers;         ///< Vertex buffers in the pool
+		U32 bytesAllocated;     ///< Size of those buffers
+		U32 bytesUsed;          ///< Vertex bytes written in the last frame
+		U32 numBorrowed;        ///< Buffers borrowed in the last frame
+		U32 numCreated;         ///< Vertex buffers created since startup
+		U32 numFreed;           ///< Vertex buffers freed since startup
+	};
+
+	/// Borrows a vertex buffer holding at least numQuads particles, which no
+	/// other emitter writes to until the next frame. numQuads can not exceed
+	/// MaxBatchQuads.
+	static VertexBuffer* borrowVerts( U32 numQuads );
+
+	/// Index buffer drawing 4 vertices per particle as two triangles, for at
+	/// least numQuads particles, up to MaxBatchQuads.
+	static GFXPrimitiveBufferHandle* getQuadIndices( U32 numQuads );
+
+	static const Stats& getStats() { return smStats; }
+
+	/// Frees all the buffers.
+	static void reset();
+
+private:
+	struct Buffer
+	{
+		VertexBuffer verts;
+		U32 numQuads;
+		U32 lastFrame;          ///< Last frame the buffer was borrowed in
+	};
+
+	static bool onDeviceEvent( GFXDevice::GFXDeviceEventType evt );
+	static void startFrame();
+
+	static Vector<Buffer*> smBuffers;
+	static GFXPrimitiveBufferHandle smQuadIndices;
+	static U32 smNumIndexQuads;
+	static U32 smFrame;
+	static U32 smBytesThisFrame;
+	static U32 smBorrowedThisFrame;
+	static bool smRegistered;
+	static Stats smStats;
+};
+
+#endif // _H_PARTICLE_BUFFER_POOL
@@ -0,0 +1,73 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleCamera.h"
+
+#include "scene/sceneManager.h"
+#include "T3D/gameBase/gameConnection.h"
+#include "windowManager/platformWindowMgr.h"
+
+// Used before the window reports a size, wide enough to not cull anything
+// visible on the usual screens.
+static const F32 DefaultAspectRatio = 2.4f;
+static const F32 CameraNearDist = 0.1f;
+
+ParticleCamera ParticleCamera::smCamera;
+SimTime ParticleCamera::smTime = 0;
+bool ParticleCamera::smUpdated = false;
+bool ParticleCamera::smValid = false;
+
+//-----------------------------------------------------------------------------
+// get
+//-----------------------------------------------------------------------------
+const ParticleCamera* ParticleCamera::get()
+{
+	const SimTime now = Sim::getCurrentTime();
+	if( !smUpdated || now != smTime )
+	{
+		smTime = now;
+		smUpdated = true;
+		smValid = smCamera.update();
+	}
+
+	return smValid ? &smCamera : NULL;
+}
+
+//-----------------------------------------------------------------------------
+// update
+//-----------------------------------------------------------------------------
+bool ParticleCamera::update()
+{
+	PROFILE_SCOPE(ParticleCamera_update);
+
+	// Must have a connection and control object
+	GameConnection *conn = GameConnection::getConnectionToServer();
+	if( !conn || !conn->getControlObject() )
+		return false;
+
+	MatrixF cam;
+	F32 camFov;
+	if( !conn->getControlCameraTransform( 0, &cam ) || !conn->getControlCameraFov( &camFov ) )
+		return false;
+
+	// The field of view is vertical, the horizontal one follows the shape
+	// of the window
+	F32 aspectRatio = DefaultAspectRatio;
+	PlatformWindow *window = WindowManager->getFirstWindow();
+	if( window )
+	{
+		const Point2I extent = window->getClientExtent();
+		if( extent.x > 0 && extent.y > 0 )
+			aspectRatio = F32(extent.x) / F32(extent.y);
+	}
+
+	const F32 nearTop = CameraNearDist * mTan( mDegToRad( camFov ) * 0.5f );
+	const F32 nearRight = nearTop * aspectRatio;
+	mFrustum.set( false, -nearRight, nearRight, nearTop, -nearTop,
+		CameraNearDist, gClientSceneGraph->getVisibleDistance(), cam );
+	cam.getColumn( 3, &mPosition );
+	return true;
+}
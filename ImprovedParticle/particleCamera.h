@@ -0,0 +1,58 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_CAMERA
+#define _H_PARTICLE_CAMERA
+
+#ifndef _FRUSTUM_H_
+#include "math/util/frustum.h"
+#endif
+#ifndef _SIM_H_
+#include "console/sim.h"
+#endif
+
+//*****************************************************************************
+// Particle Camera
+//
+// The control camera of the client, snapshot once per tick and shared by all
+// the emitters that cull themselves in processTick. The first emitter asking
+// in a tick looks up the connection, the camera transform and the field of
+// view and builds the view frustum, every other test in that tick is a
+// frustum test against a world box.
+//*****************************************************************************
+class ParticleCamera
+{
+public:
+	enum
+	{
+		/// Ticks an object must stay out of view before it counts as culled,
+		/// so objects at the edge of the view don't flicker on and off.
+		CullDelayTicks = 16,
+	};
+
+	/// The camera as of the current tick, or NULL if there is no connection
+	/// to the server or no control object.
+	static const ParticleCamera* get();
+
+	/// True if any part of the box is in the view frustum and within the
+	/// visible distance.
+	bool isVisible( const Box3F &worldBox ) const { return !mFrustum.isCulled( worldBox ); }
+
+	const Point3F& getPosition() const { return mPosition; }
+
+private:
+	/// Snapshots the camera, returns false if there is none.
+	bool update();
+
+	Frustum mFrustum;
+	Point3F mPosition;
+
+	static ParticleCamera smCamera;
+	static SimTime smTime;      ///< Sim time of the snapshot
+	static bool smUpdated;      ///< A snapshot was taken at smTime
+	static bool smValid;        ///< The snapshot found a camera
+};
+
+#endif // _H_PARTICLE_CAMERA
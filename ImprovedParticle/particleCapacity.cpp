@@ -0,0 +1,167 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleCapacity.h"
+
+#include "console/simObject.h"
+#include "math/mMathFn.h"
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+ParticleCapacity::Stats ParticleCapacity::smStats = { 0, 0, 0 };
+
+//-----------------------------------------------------------------------------
+// getMaxLifetime
+//-----------------------------------------------------------------------------
+U32 ParticleCapacity::getMaxLifetime( const Vector<ParticleData*> &dataBlocks )
+{
+	U32 maxLifetime = 0;
+	for( S32 i = 0; i < dataBlocks.size(); i++ )
+	{
+		U32 lifetime = dataBlocks[i]->lifetimeMS + dataBlocks[i]->lifetimeVarianceMS;
+		maxLifetime = getMax( maxLifetime, lifetime );
+	}
+	return maxLifetime;
+}
+
+//-----------------------------------------------------------------------------
+// estimate
+// Particles are ejected at least minPeriod apart, so a lifetime holds at most
+// maxLifetimeMS / minPeriod + 1 of them. That only happens if every period
+// comes out shortest though; the periods are uniform in
+// [period - variance, period + variance], so n of them add up to
+// n * period with a standard deviation of variance * sqrt(n / 3). The
+// estimate is the mean count plus 4 standard deviations, capped by the
+// bound.
+//-----------------------------------------------------------------------------
+U32 ParticleCapacity::estimate( U32 maxLifetimeMS, S32 ejectionPeriodMS, S32 periodVarianceMS )
+{
+	smStats.numEstimates++;
+
+	const S32 period = getMax( ejectionPeriodMS, 1 );
+	const S32 minPeriod = getMax( ejectionPeriodMS - periodVarianceMS, 1 );
+	const U32 bound = maxLifetimeMS / minPeriod + 1;
+
+	const F32 meanCount = F32(maxLifetimeMS) / F32(period);
+	const F32 deviation = periodVarianceMS * mSqrt( meanCount / 3.0f ) / F32(period);
+	const U32 likely = U32( meanCount + 4.0f * deviation ) + 1;
+
+	return getMin( likely, bound ) + Slack;
+}
+
+//-----------------------------------------------------------------------------
+// recordGrowth
+//-----------------------------------------------------------------------------
+void ParticleCapacity::recordGrowth( SimObject *emitter, U32 oldCapacity, U32 newCapacity )
+{
+	smStats.numGrowths++;
+	smStats.particlesGrown += newCapacity - oldCapacity;
+
+	Con::warnf( "%s(%d) - particle pool full, grew from %u to %u particles",
+		emitter->getClassName(), emitter->getId(), oldCapacity, newCapacity );
+}
+
+//-----------------------------------------------------------------------------
+// resetStats
+//-----------------------------------------------------------------------------
+void ParticleCapacity::resetStats()
+{
+	smStats.numEstimates = 0;
+	smStats.numGrowths = 0;
+	smStats.particlesGrown = 0;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( getParticleCapacityStats, const char*, (),,
+	"@brief Returns how the particle pools of the emitters were sized.\n\n"
+	"@return \"estimates growths particlesGrown\", the capacities estimated from "
+	"emission rates, the pools that filled up and grew, and the particles they grew by.\n"
+	"@internal")
+{
+	const ParticleCapacity::Stats &stats = ParticleCapacity::getStats();
+	char *ret = Con::getReturnBuffer( 64 );
+	dSprintf( ret, 64, "%u %u %u", stats.numEstimates, stats.numGrowths, stats.particlesGrown );
+	return ret;
+}
+
+DefineEngineFunction( resetParticleCapacityStats, void, (),,
+	"@brief Resets the counters returned by getParticleCapacityStats().\n\n"
+	"@internal")
+{
+	ParticleCapacity::resetStats();
+}
+
+DefineEngineFunction( testParticleCapacity, bool, ( S32 numEjections ), ( 200000 ),
+	"@brief Ejects particles at random periods with random lifetimes, and checks "
+	"that no more particles are alive at once than the estimate.\n\n"
+	"Several ejection periods, variances and lifetimes are tried, the random "
+	"periods and lifetimes of each case come from a fixed seed.\n\n"
+	"@param numEjections Number of particles ejected for each case.\n"
+	"@return True if the estimate held in every case.\n"
+	"@internal")
+{
+	struct Case { S32 period; S32 variance; U32 lifetime; U32 lifetimeVariance; };
+	const Case cases[] =
+	{
+		{ 100, 0, 1000, 0 },
+		{ 1, 0, 200, 0 },
+		{ 10, 9, 500, 250 },
+		{ 33, 20, 4000, 1000 },
+		{ 250, 100, 100, 50 },
+	};
+	const U32 numCases = sizeof(cases) / sizeof(cases[0]);
+
+	MRandomLCG rand( 0x5c3a );
+	bool passed = true;
+	for( U32 c = 0; c < numCases; c++ )
+	{
+		const Case &cs = cases[c];
+		const U32 maxLifetime = cs.lifetime + cs.lifetimeVariance;
+		const U32 capacity = ParticleCapacity::estimate( maxLifetime, cs.period, cs.variance );
+
+		// Ejection and death times of the particles, the ones from head on
+		// may still be alive
+		Vector<U32> ejected;
+		Vector<U32> deaths;
+		U32 head = 0;
+		U32 time = 0;
+		U32 maxAlive = 0;
+		for( S32 i = 0; i < numEjections; i++ )
+		{
+			time += cs.period + rand.randI( -cs.variance, cs.variance );
+			ejected.push_back( time );
+			deaths.push_back( time + cs.lifetime + rand.randI( -(S32)cs.lifetimeVariance, cs.lifetimeVariance ) );
+
+			while( ejected[head] + maxLifetime < time )
+				head++;
+
+			U32 alive = 0;
+			for( U32 j = head; j < deaths.size(); j++ )
+			{
+				if( deaths[j] >= time )
+					alive++;
+			}
+			maxAlive = getMax( maxAlive, alive );
+		}
+
+		if( maxAlive > capacity )
+		{
+			Con::errorf( "testParticleCapacity - failed, %u particles alive with period %d+-%d and lifetime %u+-%u, estimate %u",
+				maxAlive, cs.period, cs.variance, cs.lifetime, cs.lifetimeVariance, capacity );
+			passed = false;
+		}
+		else
+			Con::printf( "testParticleCapacity - period %d+-%d, lifetime %u+-%u: %u alive, estimate %u",
+				cs.period, cs.variance, cs.lifetime, cs.lifetimeVariance, maxAlive, capacity );
+	}
+
+	if( passed )
+		Con::printf( "testParticleCapacity - passed" );
+
+	return passed;
+}
@@ -0,0 +1,63 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_CAPACITY
+#define _H_PARTICLE_CAPACITY
+
+#ifndef _PARTICLE_H_
+#include "T3D/fx/particle.h"
+#endif
+
+class SimObject;
+
+//*****************************************************************************
+// Particle Capacity
+//
+// Decides how many particles an emitter reserves room for. An emitter ejects
+// one particle per ejection period, so with the shortest period and the
+// longest particle lifetime the number of particles alive at once is
+// bounded, and the pool is reserved for that up front. The emitters pass in
+// the periods they actually eject with, so rates overridden on the emitter
+// or the node are accounted for.
+// When an estimate still falls short the pool grows geometrically, and every
+// growth is logged and counted so the estimate can be fixed.
+//*****************************************************************************
+class ParticleCapacity
+{
+public:
+	enum
+	{
+		Slack = 8,        ///< Added to the estimate for particles emitted on the edge of an update
+		MinGrowth = 16,   ///< Smallest number of particles a full pool grows by
+	};
+
+	struct Stats
+	{
+		U32 numEstimates;     ///< Capacities estimated from emission rates
+		U32 numGrowths;       ///< Pools that filled up and had to grow
+		U32 particlesGrown;   ///< Particles added to the pools by growing
+	};
+
+	/// Longest lifetime a particle of any of the datablocks can get.
+	static U32 getMaxLifetime( const Vector<ParticleData*> &dataBlocks );
+
+	/// Most particles alive at once when ejecting a particle every
+	/// ejectionPeriodMS +- periodVarianceMS, each living up to maxLifetimeMS.
+	static U32 estimate( U32 maxLifetimeMS, S32 ejectionPeriodMS, S32 periodVarianceMS );
+
+	/// Capacity a full pool of capacity particles grows to.
+	static U32 grow( U32 capacity ) { return capacity + getMax( capacity, (U32)MinGrowth ); }
+
+	/// Logs and counts a pool that grew because it was full.
+	static void recordGrowth( SimObject *emitter, U32 oldCapacity, U32 newCapacity );
+
+	static const Stats& getStats() { return smStats; }
+	static void resetStats();
+
+private:
+	static Stats smStats;
+};
+
+#endif // _H_PARTICLE_CAPACITY
@@ -0,0 +1,330 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleCollision.h"
+
+#include "scene/sceneContainer.h"
+#include "collision/collision.h"
+#include "T3D/objectTypes.h"
+#include "math/mRandom.h"
+#include "platform/profiler.h"
+#include "console/engineAPI.h"
+
+F32 ParticleCollision::smMaxGatherExtent = 128.0f;
+
+//-----------------------------------------------------------------------------
+// ParticleCollision
+//-----------------------------------------------------------------------------
+ParticleCollision::ParticleCollision()
+{
+	mStamp = 0;
+	mGridOrigin.set( 0.0f, 0.0f );
+	mInvCellSize = 1.0f;
+	mGridWidth = 0;
+	mGridHeight = 0;
+}
+
+//-----------------------------------------------------------------------------
+// reflect
+//-----------------------------------------------------------------------------
+Point3F ParticleCollision::reflect( const Point3F &vel, const Point3F &normal )
+{
+	Point3F proj = mDot(vel,normal)/(normal.len()*normal.len())*normal;
+	Point3F between = (vel - proj);
+	return -(vel-(between*2)*0.8);
+}
+
+//-----------------------------------------------------------------------------
+// collideRays
+//-----------------------------------------------------------------------------
+void ParticleCollision::collideRays( ParticlePool &pool, F32 dt, U32 typeMask )
+{
+	const U32 count = pool.size();
+	for( U32 idx = 0; idx < count; idx++ )
+	{
+		Point3F partPos = pool.getPos(idx);
+		Point3F partVel = pool.getVel(idx);
+
+		RayInfo rInfo;
+		if( gClientContainer.castRay( partPos, partPos + partVel * dt, typeMask, &rInfo ) )
+			pool.setVel( idx, reflect( partVel, rInfo.normal ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// collide
+//-----------------------------------------------------------------------------
+void ParticleCollision::collide( ParticlePool &pool, F32 dt, U32 typeMask )
+{
+	const U32 count = pool.size();
+	if( count == 0 )
+		return;
+
+	PROFILE_SCOPE(ParticleCollision_collide);
+
+	// Bounds of all the segments of this update
+	Box3F box( pool.getPos(0), pool.getPos(0) );
+	for( U32 idx = 0; idx < count; idx++ )
+	{
+		Point3F start = pool.getPos(idx);
+		box.extend( start );
+		box.extend( start + pool.getVel(idx) * dt );
+	}
+
+	if( box.len_x() > smMaxGatherExtent || box.len_y() > smMaxGatherExtent || box.len_z() > smMaxGatherExtent )
+	{
+		collideRays( pool, dt, typeMask );
+		return;
+	}
+
+	gather( box, typeMask );
+	if( mTriangles.empty() )
+		return;
+
+	buildGrid( box );
+
+	for( U32 idx = 0; idx < count; idx++ )
+	{
+		Point3F partPos = pool.getPos(idx);
+		Point3F partVel = pool.getVel(idx);
+
+		Point3F normal;
+		if( castSegment( partPos, partPos + partVel * dt, normal ) )
+			pool.setVel( idx, reflect( partVel, normal ) );
+	}
+}
+
+//-----------------------------------------------------------------------------
+// gather
+// The polygons are fanned into triangles.
+//-----------------------------------------------------------------------------
+void ParticleCollision::gather( const Box3F &box, U32 typeMask )
+{
+	mPolyList.clear();
+	mTriangles.clear();
+
+	// Grow the box a bit, so segments ending on a surface still find it
+	Box3F gatherBox = box;
+	gatherBox.minExtents -= Point3F( 0.1f, 0.1f, 0.1f );
+	gatherBox.maxExtents += Point3F( 0.1f, 0.1f, 0.1f );
+	gClientContainer.buildPolyList( PLC_Collision, gatherBox, typeMask, &mPolyList );
+
+	for( U32 p = 0; p < mPolyList.mPolyList.size(); p++ )
+	{
+		const ConcretePolyList::Poly &poly = mPolyList.mPolyList[p];
+		if( poly.vertexCount < 3 )
+			continue;
+
+		const Point3F &v0 = mPolyList.mVertexList[mPolyList.mIndexList[poly.vertexStart]];
+		for( U32 v = 1; v + 1 < poly.vertexCount; v++ )
+		{
+			mTriangles.increment();
+			Triangle &tri = mTriangles.last();
+			tri.v0 = v0;
+			tri.edge1 = mPolyList.mVertexList[mPolyList.mIndexList[poly.vertexStart + v]] - v0;
+			tri.edge2 = mPolyList.mVertexList[mPolyList.mIndexList[poly.vertexStart + v + 1]] - v0;
+			tri.normal = poly.plane;
+		}
+	}
+
+	mTriStamps.setSize( mTriangles.size() );
+	dMemset( mTriStamps.address(), 0, mTriStamps.size() * sizeof(U32) );
+	mStamp = 0;
+}
+
+//-----------------------------------------------------------------------------
+// buildGrid
+// About as many cells as triangles, binned in two passes: count the
+// triangles of every cell, then fill them in.
+//-----------------------------------------------------------------------------
+void ParticleCollision::buildGrid( const Box3F &box )
+{
+	const F32 extent = getMax( getMax( box.len_x(), box.len_y() ), 0.01f );
+	const S32 cellsPerSide = mClamp( (S32)mSqrt( (F32)mTriangles.size() ), 1, (S32)MaxGridSize );
+	const F32 cellSize = extent / cellsPerSide;
+
+	mGridOrigin.set( box.minExtents.x, box.minExtents.y );
+	mInvCellSize = 1.0f / cellSize;
+	mGridWidth = mClamp( (S32)mCeil( box.len_x() * mInvCellSize ), 1, (S32)MaxGridSize );
+	mGridHeight = mClamp( (S32)mCeil( box.len_y() * mInvCellSize ), 1, (S32)MaxGridSize );
+
+	const U32 numCells = mGridWidth * mGridHeight;
+	mCellStart.setSize( numCells + 1 );
+	dMemset( mCellStart.address(), 0, mCellStart.size() * sizeof(U32) );
+
+	// The cell ranges of the triangles are needed twice
+	mTriCells.setSize( mTriangles.size() * 4 );
+
+	for( U32 t = 0; t < mTriangles.size(); t++ )
+	{
+		const Triangle &tri = mTriangles[t];
+		const Point3F v1 = tri.v0 + tri.edge1;
+		const Point3F v2 = tri.v0 + tri.edge2;
+		S32 *cells = &mTriCells[t * 4];
+		cells[0] = mClamp( (S32)mFloor( (getMin( getMin( tri.v0.x, v1.x ), v2.x ) - mGridOrigin.x) * mInvCellSize ), 0, mGridWidth - 1 );
+		cells[1] = mClamp( (S32)mFloor( (getMin( getMin( tri.v0.y, v1.y ), v2.y ) - mGridOrigin.y) * mInvCellSize ), 0, mGridHeight - 1 );
+		cells[2] = mClamp( (S32)mFloor( (getMax( getMax( tri.v0.x, v1.x ), v2.x ) - mGridOrigin.x) * mInvCellSize ), 0, mGridWidth - 1 );
+		cells[3] = mClamp( (S32)mFloor( (getMax( getMax( tri.v0.y, v1.y ), v2.y ) - mGridOrigin.y) * mInvCellSize ), 0, mGridHeight - 1 );
+
+		for( S32 y = cells[1]; y <= cells[3]; y++ )
+			for( S32 x = cells[0]; x <= cells[2]; x++ )
+				mCellStart[y * mGridWidth + x + 1]++;
+	}
+
+	for( U32 c = 0; c < numCells; c++ )
+		mCellStart[c + 1] += mCellStart[c];
+
+	mCellTris.setSize( mCellStart[numCells] );
+	mCellFill.setSize( numCells );
+	dMemcpy( mCellFill.address(), mCellStart.address(), numCells * sizeof(U32) );
+
+	for( U32 t = 0; t < mTriangles.size(); t++ )
+	{
+		const S32 *cells = &mTriCells[t * 4];
+		for( S32 y = cells[1]; y <= cells[3]; y++ )
+			for( S32 x = cells[0]; x <= cells[2]; x++ )
+				mCellTris[mCellFill[y * mGridWidth + x]++] = t;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// castSegment
+// Moller-Trumbore against the triangles of the cells the segment covers.
+// Like the container rays only surfaces facing the segment are hit.
+//-----------------------------------------------------------------------------
+bool ParticleCollision::castSegment( const Point3F &start, const Point3F &end, Point3F &normal )
+{
+	const Point3F dir = end - start;
+
+	const S32 x0 = mClamp( (S32)mFloor( (getMin( start.x, end.x ) - mGridOrigin.x) * mInvCellSize ), 0, mGridWidth - 1 );
+	const S32 y0 = mClamp( (S32)mFloor( (getMin( start.y, end.y ) - mGridOrigin.y) * mInvCellSize ), 0, mGridHeight - 1 );
+	const S32 x1 = mClamp( (S32)mFloor( (getMax( start.x, end.x ) - mGridOrigin.x) * mInvCellSize ), 0, mGridWidth - 1 );
+	const S32 y1 = mClamp( (S32)mFloor( (getMax( start.y, end.y ) - mGridOrigin.y) * mInvCellSize ), 0, mGridHeight - 1 );
+
+	if( ++mStamp == 0 )
+	{
+		dMemset( mTriStamps.address(), 0, mTriStamps.size() * sizeof(U32) );
+		mStamp = 1;
+	}
+
+	F32 closest = 2.0f;
+	for( S32 y = y0; y <= y1; y++ )
+	{
+		for( S32 x = x0; x <= x1; x++ )
+		{
+			const U32 cell = y * mGridWidth + x;
+			for( U32 i = mCellStart[cell]; i < mCellStart[cell + 1]; i++ )
+			{
+				const U32 t = mCellTris[i];
+				if( mTriStamps[t] == mStamp )
+					continue;
+				mTriStamps[t] = mStamp;
+
+				const Triangle &tri = mTriangles[t];
+				if( mDot( dir, tri.normal ) >= 0.0f )
+					continue;
+
+				Point3F pvec = mCross( dir, tri.edge2 );
+				F32 det = mDot( tri.edge1, pvec );
+				if( mFabs( det ) < 1e-12f )
+					continue;
+				F32 invDet = 1.0f / det;
+
+				Point3F tvec = start - tri.v0;
+				F32 u = mDot( tvec, pvec ) * invDet;
+				if( u < 0.0f || u > 1.0f )
+					continue;
+
+				Point3F qvec = mCross( tvec, tri.edge1 );
+				F32 v = mDot( dir, qvec ) * invDet;
+				if( v < 0.0f || u + v > 1.0f )
+					continue;
+
+				F32 hit = mDot( tri.edge2, qvec ) * invDet;
+				if( hit < 0.0f || hit > 1.0f || hit >= closest )
+					continue;
+
+				closest = hit;
+				normal = tri.normal;
+			}
+		}
+	}
+
+	return closest <= 1.0f;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testParticleCollision, bool, ( Point3F center, F32 radius, S32 numParticles, F32 tolerance ), ( Point3F::Zero, 20.0f, 2000, 0.0001f ),
+	"@brief Bounces the same particles off the scene with the triangle grid and "
+	"with a ray per particle, and checks that both give the same velocities.\n\n"
+	"The particles are scattered around center with velocities that mostly point "
+	"down, from a fixed seed. A mission with terrain or interiors around center "
+	"must be loaded.\n\n"
+	"@param center Center of the particles.\n"
+	"@param radius Distance of the particles from center along each axis.\n"
+	"@param numParticles Number of particles.\n"
+	"@param tolerance Largest allowed difference between the velocities.\n"
+	"@return True if the velocities match.\n"
+	"@internal")
+{
+	if( radius <= 0.0f || numParticles <= 0 )
+		return false;
+
+	// The collision mask of the graph emitters
+	const U32 typeMask = TerrainObjectType | InteriorObjectType | VehicleObjectType | PlayerObjectType;
+	const F32 dt = 0.032f;
+
+	MRandomLCG rand( 0x3e19 );
+	Particle part;
+	dMemset( &part, 0, sizeof(Particle) );
+
+	ParticlePool rayPool, gridPool;
+	rayPool.reserve( numParticles );
+	gridPool.reserve( numParticles );
+	for( S32 i = 0; i < numParticles; i++ )
+	{
+		part.pos = center + Point3F( rand.randF( -radius, radius ), rand.randF( -radius, radius ), rand.randF( -radius * 0.25f, radius * 0.25f ) );
+		part.vel.set( rand.randF( -30.0f, 30.0f ), rand.randF( -30.0f, 30.0f ), rand.randF( -60.0f, 10.0f ) );
+		rayPool.add( part );
+		gridPool.add( part );
+	}
+
+	Vector<Point3F> startVel( numParticles );
+	startVel.setSize( numParticles );
+	for( S32 i = 0; i < numParticles; i++ )
+		startVel[i] = rayPool.getVel( i );
+
+	ParticleCollision::collideRays( rayPool, dt, typeMask );
+	ParticleCollision collision;
+	collision.collide( gridPool, dt, typeMask );
+
+	U32 numBounced = 0, numDiffering = 0;
+	F32 maxError = 0.0f;
+	for( S32 i = 0; i < numParticles; i++ )
+	{
+		const Point3F rayVel = rayPool.getVel( i );
+		const F32 error = ( rayVel - gridPool.getVel( i ) ).len();
+		maxError = getMax( maxError, error );
+		if( error > tolerance )
+			numDiffering++;
+		if( rayVel != startVel[i] )
+			numBounced++;
+	}
+
+	if( numDiffering > 0 )
+		Con::errorf( "testParticleCollision - failed, %u of %d particles bounced differently, error up to %g",
+			numDiffering, numParticles, maxError );
+	else if( numBounced == 0 )
+		Con::warnf( "testParticleCollision - no particle hit anything, is there geometry around %g %g %g?",
+			center.x, center.y, center.z );
+	else
+		Con::printf( "testParticleCollision - passed, %u of %d particles bounced off %u triangles the same way",
+			numBounced, numParticles, collision.getTriangleCount() );
+
+	return numDiffering == 0;
+}
@@ -0,0 +1,95 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_COLLISION
+#define _H_PARTICLE_COLLISION
+
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+#ifndef _CONCRETEPOLYLIST_H_
+#include "collision/concretePolyList.h"
+#endif
+
+//*****************************************************************************
+// Particle Collision
+//
+// Bounces the particles of a pool off the scene geometry.
+// Instead of casting a container ray per particle, the collision polygons of
+// the objects around the particles are gathered once per update into a
+// triangle list, and the triangles are binned into a uniform grid over the
+// x/y plane. Each particle segment, pos to pos + vel * dt, is then only
+// tested against the triangles in the cells it crosses. A particle hitting a
+// triangle has its velocity reflected the same way as with a container ray.
+//*****************************************************************************
+class ParticleCollision
+{
+public:
+	enum
+	{
+		MaxGridSize = 64,      ///< Most cells along each side of the grid
+	};
+
+	ParticleCollision();
+
+	/// Reflects the velocity of every particle whose segment hits the
+	/// geometry of the objects in typeMask.
+	void collide( ParticlePool &pool, F32 dt, U32 typeMask );
+
+	/// Same as collide() with a container ray per particle.
+	static void collideRays( ParticlePool &pool, F32 dt, U32 typeMask );
+
+	/// The velocity after bouncing off a surface with the given normal.
+	static Point3F reflect( const Point3F &vel, const Point3F &normal );
+
+	/// Number of triangles gathered by the last collide().
+	U32 getTriangleCount() const { return mTriangles.size(); }
+
+	/// Gathered boxes larger than this fall back to collideRays(), the
+	/// polygons of a large area cost more than a ray per particle.
+	static F32 smMaxGatherExtent;
+
+private:
+	struct Triangle
+	{
+		Point3F v0;
+		Point3F edge1;     ///< v1 - v0
+		Point3F edge2;     ///< v2 - v0
+		Point3F normal;    ///< Normal of the polygon the triangle came from
+	};
+
+	/// Builds mTriangles from the polygons of the objects in the box.
+	void gather( const Box3F &box, U32 typeMask );
+
+	/// Bins mTriangles into the grid covering the box.
+	void buildGrid( const Box3F &box );
+
+	/// Finds the first triangle hit by the segment start to end.
+	bool castSegment( const Point3F &start, const Point3F &end, Point3F &normal );
+
+	ConcretePolyList mPolyList;
+	Vector<Triangle> mTriangles;
+
+	/// A triangle was already tested for the current segment if its stamp
+	/// equals mStamp. Triangles can be binned into several cells.
+	Vector<U32> mTriStamps;
+	U32 mStamp;
+
+	/// @name Grid
+	/// The triangles of cell i are mCellTris[mCellStart[i]] up to
+	/// mCellTris[mCellStart[i+1]].
+	/// @{
+	Point2F mGridOrigin;
+	F32 mInvCellSize;
+	S32 mGridWidth;
+	S32 mGridHeight;
+	Vector<U32> mCellStart;
+	Vector<U32> mCellTris;
+	Vector<S32> mTriCells;   ///< Cell range of each triangle, min x, min y, max x, max y
+	Vector<U32> mCellFill;   ///< Next free slot of each cell while binning
+	/// @}
+};
+
+#endif // _H_PARTICLE_COLLISION
@@ -0,0 +1,361 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleIntegrator.h"
+
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+#ifdef IPS_INTEGRATOR_SSE
+#include <xmmintrin.h>
+#endif
+
+ParticleIntegrator::Kernel ParticleIntegrator::smKernel = NULL;
+const char* ParticleIntegrator::smKernelName = "";
+
+//-----------------------------------------------------------------------------
+// Forces
+//-----------------------------------------------------------------------------
+void ParticleIntegrator::Forces::set( const ParticleData *dataBlock, const Point3F &windVelocity )
+{
+	drag = dataBlock->dragCoefficient;
+	windX = windVelocity.x * dataBlock->windCoefficient;
+	windY = windVelocity.y * dataBlock->windCoefficient;
+	windZ = windVelocity.z * dataBlock->windCoefficient;
+	gravityZ = -9.81f * dataBlock->gravityCoefficient;
+}
+
+//-----------------------------------------------------------------------------
+// Kernel selection
+//-----------------------------------------------------------------------------
+void ParticleIntegrator::selectKernel()
+{
+	smKernel = &scalarKernel;
+	smKernelName = "scalar";
+
+#ifdef IPS_INTEGRATOR_SSE
+	if( Platform::SystemInfo.processor.properties & CPU_PROP_SSE )
+	{
+		smKernel = &sseKernel;
+		smKernelName = "SSE";
+	}
+#endif
+}
+
+ParticleIntegrator::Kernel ParticleIntegrator::getKernel()
+{
+	if( !smKernel )
+		selectKernel();
+	return smKernel;
+}
+
+const char* ParticleIntegrator::getKernelName()
+{
+	if( !smKernel )
+		selectKernel();
+	return smKernelName;
+}
+
+//-----------------------------------------------------------------------------
+// integrate
+//-----------------------------------------------------------------------------
+void ParticleIntegrator::integrate( ParticlePool &pool, const Point3F &windVelocity, F32 dt, U32 flags, Box3F *bounds )
+{
+	integrate( getKernel(), pool, windVelocity, dt, flags, bounds );
+}
+
+void ParticleIntegrator::integrate( Kernel kernel, ParticlePool &pool, const Point3F &windVelocity, F32 dt, U32 flags, Box3F *bounds )
+{
+	// The kernels only extend the bounds
+	if( !(flags & IntegratePosition) )
+		bounds = NULL;
+	if( bounds )
+	{
+		bounds->minExtents.set( F32_MAX, F32_MAX, F32_MAX );
+		bounds->maxExtents.set( -F32_MAX, -F32_MAX, -F32_MAX );
+	}
+
+	const U32 count = pool.size();
+	if( count == 0 )
+		return;
+
+	// Moving the particles doesn't depend on the datablock, do it in one go.
+	if( !(flags & IntegrateVelocity) )
+	{
+		Forces none;
+		dMemset( &none, 0, sizeof(Forces) );
+		kernel( pool, 0, count, none, dt, flags, bounds );
+		return;
+	}
+
+	// Hand each run of particles sharing a datablock to the kernel.
+	ParticleData **dataBlocks = pool.dataBlock;
+	U32 start = 0;
+	while( start < count )
+	{
+		const ParticleData *runDataBlock = dataBlocks[start];
+		U32 end = start + 1;
+		while( end < count && dataBlocks[end] == runDataBlock )
+			end++;
+
+		Forces forces;
+		forces.set( runDataBlock, windVelocity );
+		kernel( pool, start, end - start, forces, dt, flags, bounds );
+
+		start = end;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// scalarKernel
+// The operations are done in the same order as the SSE kernel, so both
+// kernels produce the same results.
+//-----------------------------------------------------------------------------
+void ParticleIntegrator::scalarKernel( ParticlePool &pool, U32 start, U32 count, const Forces &forces, F32 dt, U32 flags, Box3F *bounds )
+{
+	const U32 end = start + count;
+
+	if( flags & IntegrateVelocity )
+	{
+		for( U32 i = start; i < end; i++ )
+		{
+			F32 ax = pool.accX[i] - pool.velX[i] * forces.drag - forces.windX;
+			F32 ay = pool.accY[i] - pool.velY[i] * forces.drag - forces.windY;
+			F32 az = pool.accZ[i] - pool.velZ[i] * forces.drag - forces.windZ + forces.gravityZ;
+
+			pool.velX[i] += ax * dt;
+			pool.velY[i] += ay * dt;
+			pool.velZ[i] += az * dt;
+		}
+	}
+
+	if( (flags & IntegratePosition) && bounds )
+	{
+		Point3F minPt = bounds->minExtents;
+		Point3F maxPt = bounds->maxExtents;
+		for( U32 i = start; i < end; i++ )
+		{
+			const F32 x = pool.posX[i] += pool.velX[i] * dt;
+			const F32 y = pool.posY[i] += pool.velY[i] * dt;
+			const F32 z = pool.posZ[i] += pool.velZ[i] * dt;
+
+			minPt.x = getMin( minPt.x, x );
+			minPt.y = getMin( minPt.y, y );
+			minPt.z = getMin( minPt.z, z );
+			maxPt.x = getMax( maxPt.x, x );
+			maxPt.y = getMax( maxPt.y, y );
+			maxPt.z = getMax( maxPt.z, z );
+		}
+		bounds->minExtents = minPt;
+		bounds->maxExtents = maxPt;
+	}
+	else if( flags & IntegratePosition )
+	{
+		for( U32 i = start; i < end; i++ )
+		{
+			pool.posX[i] += pool.velX[i] * dt;
+			pool.posY[i] += pool.velY[i] * dt;
+			pool.posZ[i] += pool.velZ[i] * dt;
+		}
+	}
+}
+
+#ifdef IPS_INTEGRATOR_SSE
+
+// Smallest and largest of the 4 lanes.
+static inline F32 reduceMin( __m128 v )
+{
+	v = _mm_min_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	v = _mm_min_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	return _mm_cvtss_f32( v );
+}
+
+static inline F32 reduceMax( __m128 v )
+{
+	v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 2, 3, 0, 1 ) ) );
+	v = _mm_max_ps( v, _mm_shuffle_ps( v, v, _MM_SHUFFLE( 1, 0, 3, 2 ) ) );
+	return _mm_cvtss_f32( v );
+}
+
+//-----------------------------------------------------------------------------
+// sseKernel
+// Integrates 4 particles at a time, the remaining particles of the run are
+// passed on to the scalar kernel. Runs can start anywhere in the pool, so
+// the columns are accessed with unaligned loads. The bounds are kept per
+// lane and reduced once at the end.
+//-----------------------------------------------------------------------------
+void ParticleIntegrator::sseKernel( ParticlePool &pool, U32 start, U32 count, const Forces &forces, F32 dt, U32 flags, Box3F *bounds )
+{
+	const U32 end = start + count;
+	const U32 simdEnd = start + (count & ~3);
+
+	const __m128 vDt = _mm_set1_ps( dt );
+
+	if( flags & IntegrateVelocity )
+	{
+		const __m128 vDrag = _mm_set1_ps( forces.drag );
+		const __m128 vWindX = _mm_set1_ps( forces.windX );
+		const __m128 vWindY = _mm_set1_ps( forces.windY );
+		const __m128 vWindZ = _mm_set1_ps( forces.windZ );
+		const __m128 vGravityZ = _mm_set1_ps( forces.gravityZ );
+
+		for( U32 i = start; i < simdEnd; i += 4 )
+		{
+			__m128 vx = _mm_loadu_ps( pool.velX + i );
+			__m128 vy = _mm_loadu_ps( pool.velY + i );
+			__m128 vz = _mm_loadu_ps( pool.velZ + i );
+
+			__m128 ax = _mm_sub_ps( _mm_sub_ps( _mm_loadu_ps( pool.accX + i ), _mm_mul_ps( vx, vDrag ) ), vWindX );
+			__m128 ay = _mm_sub_ps( _mm_sub_ps( _mm_loadu_ps( pool.accY + i ), _mm_mul_ps( vy, vDrag ) ), vWindY );
+			__m128 az = _mm_sub_ps( _mm_sub_ps( _mm_loadu_ps( pool.accZ + i ), _mm_mul_ps( vz, vDrag ) ), vWindZ );
+			az = _mm_add_ps( az, vGravityZ );
+
+			_mm_storeu_ps( pool.velX + i, _mm_add_ps( vx, _mm_mul_ps( ax, vDt ) ) );
+			_mm_storeu_ps( pool.velY + i, _mm_add_ps( vy, _mm_mul_ps( ay, vDt ) ) );
+			_mm_storeu_ps( pool.velZ + i, _mm_add_ps( vz, _mm_mul_ps( az, vDt ) ) );
+		}
+	}
+
+	if( (flags & IntegratePosition) && bounds && simdEnd > start )
+	{
+		__m128 vMinX = _mm_set1_ps( bounds->minExtents.x );
+		__m128 vMinY = _mm_set1_ps( bounds->minExtents.y );
+		__m128 vMinZ = _mm_set1_ps( bounds->minExtents.z );
+		__m128 vMaxX = _mm_set1_ps( bounds->maxExtents.x );
+		__m128 vMaxY = _mm_set1_ps( bounds->maxExtents.y );
+		__m128 vMaxZ = _mm_set1_ps( bounds->maxExtents.z );
+
+		for( U32 i = start; i < simdEnd; i += 4 )
+		{
+			__m128 px = _mm_add_ps( _mm_loadu_ps( pool.posX + i ), _mm_mul_ps( _mm_loadu_ps( pool.velX + i ), vDt ) );
+			__m128 py = _mm_add_ps( _mm_loadu_ps( pool.posY + i ), _mm_mul_ps( _mm_loadu_ps( pool.velY + i ), vDt ) );
+			__m128 pz = _mm_add_ps( _mm_loadu_ps( pool.posZ + i ), _mm_mul_ps( _mm_loadu_ps( pool.velZ + i ), vDt ) );
+			_mm_storeu_ps( pool.posX + i, px );
+			_mm_storeu_ps( pool.posY + i, py );
+			_mm_storeu_ps( pool.posZ + i, pz );
+
+			vMinX = _mm_min_ps( vMinX, px );
+			vMinY = _mm_min_ps( vMinY, py );
+			vMinZ = _mm_min_ps( vMinZ, pz );
+			vMaxX = _mm_max_ps( vMaxX, px );
+			vMaxY = _mm_max_ps( vMaxY, py );
+			vMaxZ = _mm_max_ps( vMaxZ, pz );
+		}
+
+		bounds->minExtents.set( reduceMin( vMinX ), reduceMin( vMinY ), reduceMin( vMinZ ) );
+		bounds->maxExtents.set( reduceMax( vMaxX ), reduceMax( vMaxY ), reduceMax( vMaxZ ) );
+	}
+	else if( flags & IntegratePosition )
+	{
+		for( U32 i = start; i < simdEnd; i += 4 )
+		{
+			_mm_storeu_ps( pool.posX + i, _mm_add_ps( _mm_loadu_ps( pool.posX + i ), _mm_mul_ps( _mm_loadu_ps( pool.velX + i ), vDt ) ) );
+			_mm_storeu_ps( pool.posY + i, _mm_add_ps( _mm_loadu_ps( pool.posY + i ), _mm_mul_ps( _mm_loadu_ps( pool.velY + i ), vDt ) ) );
+			_mm_storeu_ps( pool.posZ + i, _mm_add_ps( _mm_loadu_ps( pool.posZ + i ), _mm_mul_ps( _mm_loadu_ps( pool.velZ + i ), vDt ) ) );
+		}
+	}
+
+	if( simdEnd < end )
+		scalarKernel( pool, simdEnd, end - simdEnd, forces, dt, flags, bounds );
+}
+
+#endif // IPS_INTEGRATOR_SSE
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testParticleIntegrator, bool, ( S32 numParticles, S32 numSteps, F32 tolerance ), ( 1027, 16, 0.0001f ),
+	"@brief Integrates the same random particles with the selected kernel and with "
+	"the scalar kernel, and compares the results and the bounds they collected.\n\n"
+	"The particles use three different datablocks in runs of random length, so both "
+	"full SIMD batches and scalar tails are covered. The random generator is seeded "
+	"with a constant, so the test is deterministic.\n\n"
+	"@param numParticles Number of particles to integrate.\n"
+	"@param numSteps Number of 32ms steps to integrate.\n"
+	"@param tolerance Largest allowed difference in position and velocity.\n"
+	"@return True if all particles match within the tolerance.\n"
+	"@internal")
+{
+	Con::printf( "testParticleIntegrator - selected kernel: %s", ParticleIntegrator::getKernelName() );
+
+	const U32 numDataBlocks = 3;
+	ParticleData dataBlocks[numDataBlocks];
+	for( U32 i = 0; i < numDataBlocks; i++ )
+	{
+		dataBlocks[i].dragCoefficient = 0.25f * i;
+		dataBlocks[i].windCoefficient = 1.0f - 0.3f * i;
+		dataBlocks[i].gravityCoefficient = 0.5f * i - 0.2f;
+	}
+
+	ParticlePool scalarPool;
+	ParticlePool kernelPool;
+	scalarPool.reserve( numParticles );
+	kernelPool.reserve( numParticles );
+
+	MRandomLCG rand( 0x1fd8 );
+	Particle part;
+	part.orientDir.set( 0.0f, 0.0f, 1.0f );
+	part.relPos.zero();
+	part.currentAge = 0;
+	part.totalLifetime = 1000;
+	part.color.set( 1.0f, 1.0f, 1.0f, 1.0f );
+	part.size = 1.0f;
+	part.spinSpeed = 0.0f;
+	part.next = NULL;
+	U32 runLeft = 0;
+	ParticleData *runDataBlock = NULL;
+	for( S32 i = 0; i < numParticles; i++ )
+	{
+		if( runLeft == 0 )
+		{
+			runDataBlock = &dataBlocks[rand.randI( 0, numDataBlocks - 1 )];
+			runLeft = rand.randI( 1, 11 );
+		}
+		runLeft--;
+
+		part.pos.set( rand.randF( -10.0f, 10.0f ), rand.randF( -10.0f, 10.0f ), rand.randF( -10.0f, 10.0f ) );
+		part.vel.set( rand.randF( -5.0f, 5.0f ), rand.randF( -5.0f, 5.0f ), rand.randF( -5.0f, 5.0f ) );
+		part.acc.set( rand.randF( -1.0f, 1.0f ), rand.randF( -1.0f, 1.0f ), rand.randF( -1.0f, 1.0f ) );
+		part.dataBlock = runDataBlock;
+		scalarPool.add( part );
+		kernelPool.add( part );
+	}
+
+	const Point3F wind( 1.5f, -0.5f, 0.25f );
+	const F32 dt = 0.032f;
+	Box3F scalarBounds;
+	Box3F kernelBounds;
+	for( S32 step = 0; step < numSteps; step++ )
+	{
+		ParticleIntegrator::integrate( &ParticleIntegrator::scalarKernel, scalarPool, wind, dt, ParticleIntegrator::IntegrateAll, &scalarBounds );
+		ParticleIntegrator::integrate( ParticleIntegrator::getKernel(), kernelPool, wind, dt, ParticleIntegrator::IntegrateAll, &kernelBounds );
+	}
+
+	// The bounds have to match a scan of the final positions
+	Box3F scanBounds;
+	scanBounds.minExtents.set( F32_MAX, F32_MAX, F32_MAX );
+	scanBounds.maxExtents.set( -F32_MAX, -F32_MAX, -F32_MAX );
+	F32 maxError = 0.0f;
+	for( S32 i = 0; i < numParticles; i++ )
+	{
+		maxError = getMax( maxError, (scalarPool.getPos(i) - kernelPool.getPos(i)).len() );
+		maxError = getMax( maxError, (scalarPool.getVel(i) - kernelPool.getVel(i)).len() );
+		scanBounds.minExtents.setMin( scalarPool.getPos(i) );
+		scanBounds.maxExtents.setMax( scalarPool.getPos(i) );
+	}
+	maxError = getMax( maxError, (scanBounds.minExtents - scalarBounds.minExtents).len() );
+	maxError = getMax( maxError, (scanBounds.maxExtents - scalarBounds.maxExtents).len() );
+	maxError = getMax( maxError, (scanBounds.minExtents - kernelBounds.minExtents).len() );
+	maxError = getMax( maxError, (scanBounds.maxExtents - kernelBounds.maxExtents).len() );
+
+	bool passed = maxError <= tolerance;
+	if( passed )
+		Con::printf( "testParticleIntegrator - passed, largest difference %g", maxError );
+	else
+		Con::errorf( "testParticleIntegrator - failed, largest difference %g exceeds %g", maxError, tolerance );
+
+	return passed;
+}
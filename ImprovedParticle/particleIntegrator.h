@@ -0,0 +1,81 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_INTEGRATOR
+#define _H_PARTICLE_INTEGRATOR
+
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+#ifndef _MBOX_H_
+#include "math/mBox.h"
+#endif
+
+#if defined( TORQUE_CPU_X86 ) || defined( TORQUE_CPU_X64 )
+#define IPS_INTEGRATOR_SSE
+#endif
+
+//*****************************************************************************
+// Particle Integrator
+//
+// Applies drag, wind and gravity to the particles of a ParticlePool and moves
+// them along their velocity. The pool is walked in runs of particles that
+// share a ParticleData, so the coefficients are only loaded once per run.
+// Runs are handed to a kernel that is picked at startup from the CPU
+// features: an SSE kernel integrating 4 particles per instruction, or the
+// plain scalar kernel which produces the same results.
+// While moving the particles the kernels can also collect the bounds of
+// their new positions, so the emitters don't need a pass of their own.
+//*****************************************************************************
+class ParticleIntegrator
+{
+public:
+	enum IntegrateFlags
+	{
+		IntegrateVelocity = BIT(0),   ///< vel += (acc - drag - wind + gravity) * dt
+		IntegratePosition = BIT(1),   ///< pos += vel * dt
+		IntegrateAll      = IntegrateVelocity | IntegratePosition,
+	};
+
+	/// Forces shared by a run of particles with the same ParticleData.
+	struct Forces
+	{
+		F32 drag;       ///< ParticleData::dragCoefficient
+		F32 windX;      ///< Wind velocity scaled by ParticleData::windCoefficient
+		F32 windY;
+		F32 windZ;
+		F32 gravityZ;   ///< -9.81 scaled by ParticleData::gravityCoefficient
+
+		void set( const ParticleData *dataBlock, const Point3F &windVelocity );
+	};
+
+	/// Extends bounds, when not NULL, by the positions the kernel moved the
+	/// particles to.
+	typedef void (*Kernel)( ParticlePool &pool, U32 start, U32 count, const Forces &forces, F32 dt, U32 flags, Box3F *bounds );
+
+	/// Integrates every particle of the pool over dt seconds.
+	/// @param bounds  If not NULL and the particles are moved, set to the
+	///                bounds of their new positions.
+	static void integrate( ParticlePool &pool, const Point3F &windVelocity, F32 dt, U32 flags = IntegrateAll, Box3F *bounds = NULL );
+
+	/// Integrates the pool with a specific kernel, used to compare the kernels.
+	static void integrate( Kernel kernel, ParticlePool &pool, const Point3F &windVelocity, F32 dt, U32 flags, Box3F *bounds = NULL );
+
+	/// The kernel selected for this CPU.
+	static Kernel getKernel();
+	static const char* getKernelName();
+
+	static void scalarKernel( ParticlePool &pool, U32 start, U32 count, const Forces &forces, F32 dt, U32 flags, Box3F *bounds );
+#ifdef IPS_INTEGRATOR_SSE
+	static void sseKernel( ParticlePool &pool, U32 start, U32 count, const Forces &forces, F32 dt, U32 flags, Box3F *bounds );
+#endif
+
+private:
+	static Kernel smKernel;
+	static const char* smKernelName;
+	static void selectKernel();
+};
+
+#endif // _H_PARTICLE_INTEGRATOR
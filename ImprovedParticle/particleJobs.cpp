@@ -0,0 +1,437 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleJobs.h"
+#include "particleIntegrator.h"
+
+#include "platform/platformIntrinsics.h"
+#include "platform/threads/threadPool.h"
+#include "platform/threads/threadSafeRefCount.h"
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+Vector<ParticleJob*> ParticleJobScheduler::smJobs;
+bool ParticleJobScheduler::smParallel = true;
+U32 ParticleJobScheduler::smMinParallelItems = ParticleJobScheduler::DefaultMinParallelItems;
+bool ParticleJobScheduler::smRegistered = false;
+bool ParticleJobScheduler::smFlushing = false;
+ParticleJobScheduler::Stats ParticleJobScheduler::smStats = { 0, 0, 0, 0 };
+
+//-----------------------------------------------------------------------------
+// ParallelRun
+// One runParallel call. Every thread taking part takes the next chunk from the
+// shared counter until none are left. Workers that only start after the
+// calling thread has finished find the counter past the end and return
+// without touching the task, the reference they hold keeps the run alive
+// until then.
+//-----------------------------------------------------------------------------
+struct ParticleJobScheduler::ParallelRun : public ThreadSafeRefCount<ParallelRun>
+{
+	Task *task;
+	U32 count;
+	U32 chunkSize;
+	U32 numChunks;
+	volatile U32 next;      ///< Next chunk to take
+	volatile U32 done;      ///< Chunks finished
+
+	ParallelRun( Task *task, U32 count, U32 chunkSize )
+		: task( task ), count( count ), chunkSize( chunkSize ),
+		numChunks( ( count + chunkSize - 1 ) / chunkSize ), next( 0 ), done( 0 ) {}
+
+	void work()
+	{
+		for( ;; )
+		{
+			const U32 chunk = dFetchAndAdd( next, 1 );
+			if( chunk >= numChunks )
+				break;
+
+			const U32 start = chunk * chunkSize;
+			task->run( start, getMin( start + chunkSize, count ) );
+
+			dFetchAndAdd( done, 1 );
+		}
+	}
+};
+
+class ParticleJobScheduler::ParallelWorker : public ThreadPool::WorkItem
+{
+public:
+	ParallelWorker( ParallelRun *run ) : mRun( run ) {}
+
+protected:
+	virtual void execute() { mRun->work(); }
+
+private:
+	ThreadSafeRef<ParallelRun> mRun;
+};
+
+// Runs one phase of the jobs, a job per item.
+class ParticleJobScheduler::PhaseTask : public ParticleJobScheduler::Task
+{
+public:
+	PhaseTask( ParticleJob *const *jobs, Phase phase ) : mJobs( jobs ), mPhase( phase ) {}
+
+	virtual void run( U32 start, U32 end )
+	{
+		for( U32 i = start; i < end; i++ )
+		{
+			if( mPhase == PhaseForces )
+				mJobs[i]->simulateForces();
+			else
+				mJobs[i]->simulateMotion();
+		}
+	}
+
+private:
+	ParticleJob *const *mJobs;
+	Phase mPhase;
+};
+
+//-----------------------------------------------------------------------------
+// queue
+//-----------------------------------------------------------------------------
+void ParticleJobScheduler::queue( ParticleJob *job )
+{
+	AssertFatal( !job->mQueued, "ParticleJobScheduler::queue - job is queued already" );
+	AssertFatal( !smFlushing, "ParticleJobScheduler::queue - can't queue while flushing" );
+
+	if( !smRegistered )
+	{
+		GFXDevice::getDeviceEventSignal().notify( &onDeviceEvent );
+		smRegistered = true;
+	}
+
+	job->mQueued = true;
+	smJobs.push_back( job );
+}
+
+//-----------------------------------------------------------------------------
+// cancel
+//-----------------------------------------------------------------------------
+void ParticleJobScheduler::cancel( ParticleJob *job )
+{
+	if( !job->mQueued )
+		return;
+
+	AssertFatal( !smFlushing, "ParticleJobScheduler::cancel - can't cancel while flushing" );
+
+	job->mQueued = false;
+	for( U32 i = 0; i < smJobs.size(); i++ )
+	{
+		if( smJobs[i] == job )
+		{
+			smJobs.erase( i );
+			break;
+		}
+	}
+}
+
+//-----------------------------------------------------------------------------
+// flush
+//-----------------------------------------------------------------------------
+void ParticleJobScheduler::flush()
+{
+	if( smJobs.empty() || smFlushing )
+		return;
+
+	PROFILE_SCOPE( ParticleJobScheduler_flush );
+
+	const U32 startMS = Platform::getRealMilliseconds();
+	smFlushing = true;
+	smStats.numWorkers = 0;
+
+	runPhase( PhaseForces );
+
+	for( U32 i = 0; i < smJobs.size(); i++ )
+		smJobs[i]->simulateCollision();
+
+	runPhase( PhaseMotion );
+
+	for( U32 i = 0; i < smJobs.size(); i++ )
+	{
+		smJobs[i]->mQueued = false;
+		smJobs[i]->finishSimulation();
+	}
+
+	smStats.numFlushes++;
+	smStats.numJobs = smJobs.size();
+	smStats.lastFlushMS = Platform::getRealMilliseconds() - startMS;
+
+	smJobs.clear();
+	smFlushing = false;
+}
+
+//-----------------------------------------------------------------------------
+// runPhase
+//-----------------------------------------------------------------------------
+void ParticleJobScheduler::runPhase( Phase phase )
+{
+	PhaseTask task( smJobs.address(), phase );
+	const U32 numWorkers = runParallel( task, smJobs.size(), 1 );
+	smStats.numWorkers = getMax( smStats.numWorkers, numWorkers );
+}
+
+//-----------------------------------------------------------------------------
+// runParallel
+//-----------------------------------------------------------------------------
+U32 ParticleJobScheduler::runParallel( Task &task, U32 count, U32 chunkSize )
+{
+	AssertFatal( chunkSize > 0, "ParticleJobScheduler::runParallel - chunks must hold an item at least" );
+
+	ThreadSafeRef<ParallelRun> run = new ParallelRun( &task, count, chunkSize );
+
+	// A single chunk gains nothing from the workers
+	U32 numWorkers = 0;
+	if( smParallel && run->numChunks > 1 )
+		numWorkers = getMin( (U32)ThreadPool::GLOBAL().getNumThreads(), run->numChunks - 1 );
+
+	for( U32 i = 0; i < numWorkers; i++ )
+		ThreadPool::GLOBAL().queueWorkItem( new ParallelWorker( run ) );
+
+	run->work();
+
+	// Wait for the chunks the workers took
+	while( dAtomicRead( run->done ) < run->numChunks )
+		Platform::sleep( 0 );
+
+	return numWorkers;
+}
+
+//-----------------------------------------------------------------------------
+// onDeviceEvent
+//-----------------------------------------------------------------------------
+bool ParticleJobScheduler::onDeviceEvent( GFXDevice::GFXDeviceEventType evt )
+{
+	if( evt == GFXDevice::deStartOfFrame )
+		flush();
+
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( getParticleJobStats, const char*, (),,
+	"@brief Returns the statistics of the last flush of the particle job "
+	"scheduler.\n\n"
+	"@return \"numFlushes numJobs numWorkers lastFlushMS\"\n"
+	"@internal")
+{
+	const ParticleJobScheduler::Stats &stats = ParticleJobScheduler::getStats();
+
+	char *ret = Con::getReturnBuffer( 64 );
+	dSprintf( ret, 64, "%u %u %u %u", stats.numFlushes, stats.numJobs,
+		stats.numWorkers, stats.lastFlushMS );
+	return ret;
+}
+
+DefineEngineFunction( setParticleJobsParallel, void, ( bool parallel ),,
+	"@brief Turns updating the particle emitters and filling their vertices on "
+	"worker threads on or off.\n\n"
+	"@param parallel False to do all the particle work on the main thread.\n"
+	"@internal")
+{
+	ParticleJobScheduler::setParallel( parallel );
+}
+
+DefineEngineFunction( setParticleParallelThreshold, void, ( S32 numParticles ),,
+	"@brief Sets the number of particles an emitter needs before its vertices "
+	"are filled on several threads.\n\n"
+	"Below it the dispatch costs more than it saves.\n\n"
+	"@param numParticles Smallest number of particles filled in parallel.\n"
+	"@internal")
+{
+	ParticleJobScheduler::setMinParallelItems( getMax( numParticles, 1 ) );
+}
+
+//-----------------------------------------------------------------------------
+// TestParticleJob
+// A stand-in emitter for testParticleJobs, aging and integrating a pool the
+// way the emitters do. The last particles are added after the job is queued,
+// like the particles of a node emitting before the flush.
+//-----------------------------------------------------------------------------
+class TestParticleJob : public ParticleJob
+{
+public:
+	ParticlePool parts;
+	U32 updateCount;
+	U32 numPhases;
+	Vector<U32> emittedAges;   ///< Ages of the particles added after queueing
+
+	TestParticleJob( ParticleData *dataBlock, U32 numParticles, U32 numEmitted, U32 seed ) : numPhases( 0 )
+	{
+		MRandomLCG rand( seed );
+		parts.reserve( numParticles + numEmitted );
+
+		Particle part;
+		dMemset( &part, 0, sizeof(Particle) );
+		part.dataBlock = dataBlock;
+		part.color.set( 1.0f, 1.0f, 1.0f, 1.0f );
+		for( U32 i = 0; i < numParticles + numEmitted; i++ )
+		{
+			part.pos.set( rand.randF( -10.0f, 10.0f ), rand.randF( -10.0f, 10.0f ), rand.randF( 0.0f, 10.0f ) );
+			part.vel.set( rand.randF( -1.0f, 1.0f ), rand.randF( -1.0f, 1.0f ), rand.randF( 0.0f, 5.0f ) );
+			part.currentAge = rand.randI( 0, 900 );
+			part.totalLifetime = 1000;
+			parts.add( part );
+			if( i >= numParticles )
+				emittedAges.push_back( part.currentAge );
+		}
+		updateCount = numParticles;
+	}
+
+	virtual void simulateForces()
+	{
+		numPhases++;
+		parts.hideTail( updateCount );
+		for( U32 i = 0; i < parts.size(); )
+		{
+			parts.currentAge[i] += 32;
+			if( parts.currentAge[i] > parts.totalLifetime[i] )
+				parts.kill( i );
+			else
+				i++;
+		}
+		ParticleIntegrator::integrate( parts, Point3F( 1.0f, 0.0f, 0.0f ), 0.032f, ParticleIntegrator::IntegrateVelocity );
+	}
+
+	virtual void simulateMotion()
+	{
+		numPhases++;
+		ParticleIntegrator::integrate( parts, Point3F( 1.0f, 0.0f, 0.0f ), 0.032f, ParticleIntegrator::IntegratePosition );
+	}
+
+	virtual void finishSimulation()
+	{
+		numPhases++;
+		parts.showTail();
+	}
+};
+
+DefineEngineFunction( testParticleJobs, bool, ( S32 numJobs, S32 numParticles ), ( 37, 3000 ),
+	"@brief Runs the same particle updates through the job scheduler with and "
+	"without worker threads, and compares the results.\n\n"
+	"Every job holds a different number of particles, some of which are added "
+	"after the job is queued and must come out of the flush untouched. Each job "
+	"is seeded from its index, so both runs start from the same particles.\n\n"
+	"@param numJobs Number of jobs queued for each flush.\n"
+	"@param numParticles Largest number of particles in a job.\n"
+	"@return True if both flushes give the same particles and every job ran each phase once.\n"
+	"@internal")
+{
+	ParticleData dataBlock;
+	dataBlock.dragCoefficient = 0.2f;
+	dataBlock.windCoefficient = 0.5f;
+	dataBlock.gravityCoefficient = 0.3f;
+
+	Vector<TestParticleJob*> jobs[2];
+	for( U32 run = 0; run < 2; run++ )
+	{
+		for( S32 i = 0; i < numJobs; i++ )
+		{
+			const U32 count = 1 + ( i * 7919 ) % numParticles;
+			jobs[run].push_back( new TestParticleJob( &dataBlock, count, count / 8, 0x3c11 + i ) );
+		}
+	}
+
+	// Run whatever the emitters queued first, so the flushes below only hold the test jobs
+	ParticleJobScheduler::flush();
+
+	const bool wasParallel = ParticleJobScheduler::isParallel();
+	U32 numWorkers = 0;
+	for( U32 run = 0; run < 2; run++ )
+	{
+		ParticleJobScheduler::setParallel( run == 0 );
+		for( S32 i = 0; i < numJobs; i++ )
+			ParticleJobScheduler::queue( jobs[run][i] );
+		ParticleJobScheduler::flush();
+		if( run == 0 )
+			numWorkers = ParticleJobScheduler::getStats().numWorkers;
+	}
+	ParticleJobScheduler::setParallel( wasParallel );
+
+	U32 numMismatches = 0;
+	for( S32 i = 0; i < numJobs; i++ )
+	{
+		const ParticlePool &a = jobs[0][i]->parts;
+		const ParticlePool &b = jobs[1][i]->parts;
+		bool match = jobs[0][i]->numPhases == 3 && jobs[1][i]->numPhases == 3 && a.size() == b.size();
+
+		for( U32 p = 0; match && p < a.size(); p++ )
+			match = a.getPos( p ) == b.getPos( p ) && a.getVel( p ) == b.getVel( p ) && a.currentAge[p] == b.currentAge[p];
+
+		// The emitted particles end up behind the updated ones, with their ages unchanged
+		const Vector<U32> &emittedAges = jobs[0][i]->emittedAges;
+		const U32 firstEmitted = a.size() - emittedAges.size();
+		for( U32 p = 0; match && p < emittedAges.size(); p++ )
+			match = a.currentAge[firstEmitted + p] == emittedAges[p];
+
+		if( !match )
+			numMismatches++;
+	}
+
+	for( U32 run = 0; run < 2; run++ )
+		for( S32 i = 0; i < numJobs; i++ )
+			delete jobs[run][i];
+
+	if( numMismatches == 0 )
+		Con::printf( "testParticleJobs - passed, %d jobs match, %u workers helped", numJobs, numWorkers );
+	else
+		Con::errorf( "testParticleJobs - failed, %u of %d jobs differ", numMismatches, numJobs );
+
+	return numMismatches == 0;
+}
+
+// Counts the visits of every item, for testParticleParallelRun.
+class TestParallelTask : public ParticleJobScheduler::Task
+{
+public:
+	Vector<U32> visits;
+
+	virtual void run( U32 start, U32 end )
+	{
+		for( U32 i = start; i < end; i++ )
+			visits[i]++;
+	}
+};
+
+DefineEngineFunction( testParticleParallelRun, bool, ( S32 numItems ), ( 100003 ),
+	"@brief Runs a loop through ParticleJobScheduler::runParallel with several "
+	"chunk sizes, and checks that every item is visited exactly once.\n\n"
+	"@param numItems Number of items in the loop.\n"
+	"@return True if every item was visited once for every chunk size.\n"
+	"@internal")
+{
+	const U32 chunkSizes[] = { 1, 7, 1024, 65536, 1000000 };
+	const U32 numChunkSizes = sizeof(chunkSizes) / sizeof(chunkSizes[0]);
+
+	TestParallelTask task;
+	task.visits.setSize( numItems );
+
+	U32 numFailed = 0;
+	for( U32 c = 0; c < numChunkSizes; c++ )
+	{
+		dMemset( task.visits.address(), 0, numItems * sizeof(U32) );
+		ParticleJobScheduler::runParallel( task, numItems, chunkSizes[c] );
+
+		for( S32 i = 0; i < numItems; i++ )
+		{
+			if( task.visits[i] != 1 )
+			{
+				Con::errorf( "testParticleParallelRun - item %d visited %u times with chunks of %u",
+					i, task.visits[i], chunkSizes[c] );
+				numFailed++;
+				break;
+			}
+		}
+	}
+
+	if( numFailed == 0 )
+		Con::printf( "testParticleParallelRun - passed, %d items with %u chunk sizes", numItems, numChunkSizes );
+
+	return numFailed == 0;
+}
@@ -0,0 +1,144 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_JOBS
+#define _H_PARTICLE_JOBS
+
+#ifndef _GFXDEVICE_H_
+#include "gfx/gfxDevice.h"
+#endif
+#ifndef _TVECTOR_H_
+#include "core/util/tVector.h"
+#endif
+
+//*****************************************************************************
+// Particle Job
+//
+// The update of an emitter, split into the phases the ParticleJobScheduler
+// runs for all the queued emitters at once. The parallel phases may run on
+// any thread and must only touch the emitter itself, the main thread phases
+// do everything that needs the scene or the console.
+//*****************************************************************************
+class ParticleJob
+{
+public:
+	ParticleJob() : mQueued( false ) {}
+	virtual ~ParticleJob() {}
+
+	/// Parallel: ages and kills the particles and applies the forces.
+	virtual void simulateForces() = 0;
+
+	/// Main thread: collides the particles with the scene.
+	virtual void simulateCollision() {}
+
+	/// Parallel: moves the particles and sets their colors and sizes.
+	virtual void simulateMotion() = 0;
+
+	/// Main thread: hands the results to the scene, like the object box.
+	virtual void finishSimulation() = 0;
+
+	/// True while the job waits for the next flush.
+	bool isQueued() const { return mQueued; }
+
+private:
+	friend class ParticleJobScheduler;
+	bool mQueued;
+};
+
+//*****************************************************************************
+// Particle Job Scheduler
+//
+// Runs the particle updates of all the emitters together, instead of each
+// emitter updating in its own advanceTime. An emitter snapshots what it
+// needs from the scene (attractor positions and the like) and queues itself
+// in advanceTime, and the queue is flushed at the start of the next frame,
+// before anything is rendered. A flush runs each phase of ParticleJob for
+// all the jobs before starting the next phase: the parallel phases are
+// spread over the global thread pool, with the main thread helping and the
+// workers taking the next job as they finish one so uneven emitters balance
+// out, the main thread phases run in queue order.
+// Particles emitted while an update is queued are not updated by it, the
+// same as when the update ran in advanceTime, see ParticlePool::hideTail().
+// Other particle loops, like filling the vertices of a large emitter, can
+// use the same workers through runParallel().
+//*****************************************************************************
+class ParticleJobScheduler
+{
+public:
+	struct Stats
+	{
+		U32 numFlushes;         ///< Flushes since startup
+		U32 numJobs;            ///< Jobs run in the last flush
+		U32 numWorkers;         ///< Worker threads helping in the last flush
+		U32 lastFlushMS;        ///< Duration of the last flush
+	};
+
+	/// A loop over items that can be split into chunks, run on any thread.
+	class Task
+	{
+	public:
+		virtual ~Task() {}
+
+		/// Runs the items [start, end).
+		virtual void run( U32 start, U32 end ) = 0;
+	};
+
+	enum
+	{
+		DefaultMinParallelItems = 2048,   ///< Default of setMinParallelItems()
+	};
+
+	/// Queues the update of an emitter for the next flush.
+	/// The job must not be queued already.
+	static void queue( ParticleJob *job );
+
+	/// Removes a job from the queue, when its emitter goes away.
+	static void cancel( ParticleJob *job );
+
+	/// Runs all the queued jobs.
+	static void flush();
+
+	/// Runs a task over count items in chunks of chunkSize, spread over the
+	/// worker threads and the calling thread, and returns once all the chunks
+	/// are done. The chunks run in no particular order.
+	/// @return  Number of worker threads asked to help.
+	static U32 runParallel( Task &task, U32 count, U32 chunkSize );
+
+	/// Turns running the parallel phases on worker threads on or off.
+	/// When off, the jobs still run in phases, but on the main thread.
+	static void setParallel( bool parallel ) { smParallel = parallel; }
+	static bool isParallel() { return smParallel; }
+
+	/// Loops over fewer items than this, like the vertices of a small
+	/// emitter, are not worth handing to the workers.
+	static void setMinParallelItems( U32 count ) { smMinParallelItems = count; }
+	static U32 getMinParallelItems() { return smMinParallelItems; }
+
+	static const Stats& getStats() { return smStats; }
+
+private:
+	enum Phase
+	{
+		PhaseForces,
+		PhaseMotion,
+	};
+
+	struct ParallelRun;
+	class ParallelWorker;
+	class PhaseTask;
+
+	/// Runs a parallel phase for all the queued jobs.
+	static void runPhase( Phase phase );
+	static bool onDeviceEvent( GFXDevice::GFXDeviceEventType evt );
+
+	static Vector<ParticleJob*> smJobs;
+	static bool smParallel;
+	static U32 smMinParallelItems;
+	static bool smRegistered;
+	static bool smFlushing;
+	static Stats smStats;
+};
+
+#endif // _H_PARTICLE_JOBS
@@ -0,0 +1,211 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleKeyCurve.h"
+
+#include "math/mMathFn.h"
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+// Particles whose entries are computed before they are fetched.
+static const U32 KeyCurveBlockSize = 64;
+
+//-----------------------------------------------------------------------------
+// evaluate
+//-----------------------------------------------------------------------------
+void ParticleKeyCurve::evaluate( const F32 *times, const ColorF *colors, const F32 *sizes, U32 numKeys,
+	F32 t, ColorF &color, F32 &size )
+{
+	for( U32 i = 1; i < numKeys; i++ )
+	{
+		if( times[i] >= t )
+		{
+			F32 total = times[i] - times[i-1];
+			F32 firstPart = total > 0.0f ? (t - times[i-1]) / total : 1.0f;
+
+			color.interpolate( colors[i-1], colors[i], firstPart );
+			size = (sizes[i-1] * (1.0f - firstPart)) + (sizes[i] * firstPart);
+			return;
+		}
+	}
+
+	color = colors[numKeys-1];
+	size = sizes[numKeys-1];
+}
+
+//-----------------------------------------------------------------------------
+// bake
+//-----------------------------------------------------------------------------
+void ParticleKeyCurve::bake( const F32 *times, const ColorF *colors, const F32 *sizes, U32 numKeys )
+{
+	AssertFatal( numKeys > 0, "ParticleKeyCurve::bake - no keys" );
+
+	for( U32 i = 0; i < NumEntries; i++ )
+		evaluate( times, colors, sizes, numKeys, F32(i) / Resolution, mColors[i], mSizes[i] );
+}
+
+void ParticleKeyCurve::bake( const ParticleData *dataBlock, const ColorF *colorOverride, const F32 *sizeOverride )
+{
+	bake( dataBlock->times,
+		colorOverride ? colorOverride : dataBlock->colors,
+		sizeOverride ? sizeOverride : dataBlock->sizes,
+		ParticleData::PDC_NUM_KEYS );
+}
+
+//-----------------------------------------------------------------------------
+// apply
+// The entries of a block of particles are computed in one loop, which
+// the compiler can vectorize, and then fetched.
+//-----------------------------------------------------------------------------
+F32 ParticleKeyCurve::apply( ParticlePool &pool, U32 start, U32 count ) const
+{
+	F32 maxSize = 0.0f;
+	U32 entries[KeyCurveBlockSize];
+
+	const U32 end = start + count;
+	for( U32 blockStart = start; blockStart < end; blockStart += KeyCurveBlockSize )
+	{
+		const U32 blockCount = getMin( end - blockStart, KeyCurveBlockSize );
+		const U32 *ages = pool.currentAge + blockStart;
+		const U32 *lifetimes = pool.totalLifetime + blockStart;
+
+		for( U32 i = 0; i < blockCount; i++ )
+		{
+			F32 t = getMin( F32(ages[i]) / getMax( F32(lifetimes[i]), 1.0f ), 1.0f );
+			entries[i] = U32( t * Resolution + 0.5f );
+		}
+
+		for( U32 i = 0; i < blockCount; i++ )
+		{
+			const U32 entry = entries[i];
+			pool.color[blockStart + i] = mColors[entry];
+			pool.partSize[blockStart + i] = mSizes[entry];
+			maxSize = getMax( maxSize, mSizes[entry] );
+		}
+	}
+
+	return maxSize;
+}
+
+//-----------------------------------------------------------------------------
+// find
+//-----------------------------------------------------------------------------
+const ParticleKeyCurve* ParticleKeyCurve::find( const ParticleData *dataBlock,
+	const Vector<ParticleData*> &dataBlocks, const Vector<const ParticleKeyCurve*> &curves )
+{
+	for( S32 i = 0; i < dataBlocks.size(); i++ )
+	{
+		if( dataBlocks[i] == dataBlock )
+			return curves[i];
+	}
+	return NULL;
+}
+
+F32 ParticleKeyCurve::apply( ParticlePool &pool, const Vector<ParticleData*> &dataBlocks,
+	const Vector<const ParticleKeyCurve*> &curves )
+{
+	F32 maxSize = 0.0f;
+
+	ParticleData **poolDataBlocks = pool.dataBlock;
+	const U32 count = pool.size();
+	U32 start = 0;
+	while( start < count )
+	{
+		const ParticleData *runDataBlock = poolDataBlocks[start];
+		U32 end = start + 1;
+		while( end < count && poolDataBlocks[end] == runDataBlock )
+			end++;
+
+		const ParticleKeyCurve *curve = find( runDataBlock, dataBlocks, curves );
+		AssertFatal( curve, "ParticleKeyCurve::apply - particle datablock isn't baked" );
+		if( curve )
+			maxSize = getMax( maxSize, curve->apply( pool, start, end - start ) );
+
+		start = end;
+	}
+
+	return maxSize;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testParticleKeyCurve, bool, ( S32 numParticles, F32 tolerance ), ( 10000, 0.02f ),
+	"@brief Bakes curves with 4 and with 8 keys and compares the colors and sizes "
+	"looked up for particles of random age with the interpolated keys.\n\n"
+	"The lookup uses the entry nearest the age, so the difference is bounded by "
+	"the steepest key over half an entry. The random generator is seeded with a "
+	"constant, so the test is deterministic.\n\n"
+	"@param numParticles Number of particles looked up for each curve.\n"
+	"@param tolerance Largest allowed difference in a color channel or the size.\n"
+	"@return True if all the lookups match within the tolerance.\n"
+	"@internal")
+{
+	const U32 maxKeys = 8;
+	F32 times[maxKeys];
+	ColorF colors[maxKeys];
+	F32 sizes[maxKeys];
+
+	MRandomLCG rand( 0x4e1d );
+	ParticleKeyCurve *curve = new ParticleKeyCurve;
+	ParticlePool pool;
+	pool.reserve( numParticles );
+
+	Particle part;
+	dMemset( &part, 0, sizeof(Particle) );
+
+	bool passed = true;
+	for( U32 numKeys = 4; numKeys <= maxKeys; numKeys += 4 )
+	{
+		// Evenly spread keys, the last one short of the end of the life
+		for( U32 i = 0; i < numKeys; i++ )
+		{
+			times[i] = F32(i) / numKeys;
+			colors[i].set( rand.randF(), rand.randF(), rand.randF(), rand.randF() );
+			sizes[i] = rand.randF( 0.5f, 4.0f );
+		}
+		curve->bake( times, colors, sizes, numKeys );
+
+		pool.clear();
+		for( S32 i = 0; i < numParticles; i++ )
+		{
+			part.totalLifetime = rand.randI( 1, 5000 );
+			part.currentAge = rand.randI( 0, part.totalLifetime );
+			pool.add( part );
+		}
+		curve->apply( pool, 0, pool.size() );
+
+		F32 maxError = 0.0f;
+		for( U32 i = 0; i < pool.size(); i++ )
+		{
+			ColorF color;
+			F32 size;
+			ParticleKeyCurve::evaluate( times, colors, sizes, numKeys,
+				F32(pool.currentAge[i]) / F32(pool.totalLifetime[i]), color, size );
+
+			maxError = getMax( maxError, mFabs( color.red - pool.color[i].red ) );
+			maxError = getMax( maxError, mFabs( color.green - pool.color[i].green ) );
+			maxError = getMax( maxError, mFabs( color.blue - pool.color[i].blue ) );
+			maxError = getMax( maxError, mFabs( color.alpha - pool.color[i].alpha ) );
+			maxError = getMax( maxError, mFabs( size - pool.partSize[i] ) / 4.0f );
+		}
+
+		if( maxError > tolerance )
+		{
+			Con::errorf( "testParticleKeyCurve - failed, %u keys differ by %g", numKeys, maxError );
+			passed = false;
+		}
+		else
+			Con::printf( "testParticleKeyCurve - %u keys, largest difference %g", numKeys, maxError );
+	}
+
+	delete curve;
+
+	if( passed )
+		Con::printf( "testParticleKeyCurve - passed" );
+
+	return passed;
+}
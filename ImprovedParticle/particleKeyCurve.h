@@ -0,0 +1,84 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_KEY_CURVE
+#define _H_PARTICLE_KEY_CURVE
+
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+
+//*****************************************************************************
+// Particle Key Curve
+//
+// The color and size keys of a ParticleData baked into tables over the age
+// of a particle. Looking up a particle is a single fetch from the entry
+// nearest its normalized age, instead of searching the keys and
+// interpolating between them. The keys are only walked when baking, so a
+// curve can have any number of keys at no extra cost per particle.
+// The emitters bake a curve per ParticleData when the datablock is
+// preloaded, and bake their own if they override the colors or sizes.
+//*****************************************************************************
+class ParticleKeyCurve
+{
+public:
+	enum
+	{
+		Resolution = 256,              ///< Entries over the age of a particle
+		NumEntries = Resolution + 1,   ///< Both ends are included
+	};
+
+	/// Bakes numKeys keys. The times go from 0 to 1 in increasing order, past
+	/// the last key the last color and size are kept.
+	void bake( const F32 *times, const ColorF *colors, const F32 *sizes, U32 numKeys );
+
+	/// Bakes the keys of a ParticleData, with the colors and sizes replaced
+	/// by the overrides that aren't NULL.
+	void bake( const ParticleData *dataBlock, const ColorF *colorOverride = NULL, const F32 *sizeOverride = NULL );
+
+	/// Color and size at the normalized age t of the keys, the way the
+	/// emitters interpolated them per particle.
+	static void evaluate( const F32 *times, const ColorF *colors, const F32 *sizes, U32 numKeys,
+		F32 t, ColorF &color, F32 &size );
+
+	/// Entry for a particle of age ms that lives lifetime ms.
+	static U32 getEntry( U32 age, U32 lifetime )
+	{
+		if( age >= lifetime )
+			return Resolution;
+		return U32( F32(age) / F32(lifetime) * Resolution + 0.5f );
+	}
+
+	const ColorF& getColor( U32 entry ) const { return mColors[entry]; }
+	F32 getSize( U32 entry ) const { return mSizes[entry]; }
+
+	/// Sets the color and size of particle idx from its age.
+	void apply( ParticlePool &pool, U32 idx ) const
+	{
+		const U32 entry = getEntry( pool.currentAge[idx], pool.totalLifetime[idx] );
+		pool.color[idx] = mColors[entry];
+		pool.partSize[idx] = mSizes[entry];
+	}
+
+	/// Sets the colors and sizes of count particles from start.
+	/// @return  The largest size set.
+	F32 apply( ParticlePool &pool, U32 start, U32 count ) const;
+
+	/// Curve of a datablock, curves is parallel to dataBlocks.
+	static const ParticleKeyCurve* find( const ParticleData *dataBlock,
+		const Vector<ParticleData*> &dataBlocks, const Vector<const ParticleKeyCurve*> &curves );
+
+	/// Sets the colors and sizes of every particle in the pool, a run of
+	/// particles sharing a datablock at a time.
+	/// @return  The largest size set.
+	static F32 apply( ParticlePool &pool, const Vector<ParticleData*> &dataBlocks,
+		const Vector<const ParticleKeyCurve*> &curves );
+
+private:
+	ColorF mColors[NumEntries];
+	F32 mSizes[NumEntries];
+};
+
+#endif // _H_PARTICLE_KEY_CURVE
@@ -0,0 +1,299 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleLOD.h"
+
+#include "math/mMathFn.h"
+#include "core/stream/bitStream.h"
+#include "console/engineAPI.h"
+
+// Lowest ejection rate of a band, so the period stays finite.
+static const F32 MinEjectionRate = 0.01f;
+
+// The particle cap of a band is sent in this many bits.
+static const U32 MaxParticlesBits = 16;
+static const U32 MaxParticlesLimit = ( 1 << MaxParticlesBits ) - 1;
+
+// Sorting and collision only switch back on this much closer than their
+// distance, so an emitter at the limit doesn't switch every frame.
+static const F32 SwitchHysteresis = 0.05f;
+
+//-----------------------------------------------------------------------------
+// Bands
+//-----------------------------------------------------------------------------
+ParticleLOD::Bands::Bands()
+{
+	for( U32 i = 0; i < MaxBands; i++ )
+	{
+		distance[i] = 0.0f;
+		ejectionRate[i] = 1.0f;
+		maxParticles[i] = 0;
+		tickInterval[i] = 1;
+	}
+	sortDistance = 0.0f;
+	collisionDistance = 0.0f;
+}
+
+U32 ParticleLOD::Bands::getNumBands() const
+{
+	U32 count = 0;
+	while( count < MaxBands && distance[count] > 0.0f )
+		count++;
+	return count;
+}
+
+//-----------------------------------------------------------------------------
+// validate
+//-----------------------------------------------------------------------------
+void ParticleLOD::Bands::validate( const char *className, const char *name )
+{
+	const U32 numBands = getNumBands();
+	for( U32 i = 0; i < MaxBands; i++ )
+	{
+		if( i > 0 && i < numBands && distance[i] <= distance[i-1] )
+		{
+			Con::warnf( ConsoleLogEntry::General, "%s(%s) lodDistance[%d] is not beyond lodDistance[%d], the bands from %d are ignored",
+				className, name, i, i - 1, i );
+			for( U32 j = i; j < MaxBands; j++ )
+				distance[j] = 0.0f;
+		}
+		if( distance[i] < 0.0f )
+			distance[i] = 0.0f;
+
+		ejectionRate[i] = mClampF( ejectionRate[i], MinEjectionRate, 1.0f );
+		maxParticles[i] = mClamp( maxParticles[i], 0, (S32)MaxParticlesLimit );
+		tickInterval[i] = mClamp( tickInterval[i], 1, (S32)MaxTickInterval );
+	}
+	sortDistance = getMax( sortDistance, 0.0f );
+	collisionDistance = getMax( collisionDistance, 0.0f );
+}
+
+//-----------------------------------------------------------------------------
+// pack / unpack
+//-----------------------------------------------------------------------------
+void ParticleLOD::Bands::pack( BitStream *stream ) const
+{
+	const U32 numBands = getNumBands();
+	stream->writeInt( numBands, 3 );
+	for( U32 i = 0; i < numBands; i++ )
+	{
+		stream->write( distance[i] );
+		stream->writeFloat( ejectionRate[i], 8 );
+		stream->writeInt( maxParticles[i], MaxParticlesBits );
+		stream->writeRangedU32( tickInterval[i], 1, MaxTickInterval );
+	}
+	stream->write( sortDistance );
+	stream->write( collisionDistance );
+}
+
+void ParticleLOD::Bands::unpack( BitStream *stream )
+{
+	*this = Bands();
+
+	const U32 numBands = stream->readInt( 3 );
+	for( U32 i = 0; i < numBands; i++ )
+	{
+		stream->read( &distance[i] );
+		ejectionRate[i] = getMax( stream->readFloat( 8 ), MinEjectionRate );
+		maxParticles[i] = stream->readInt( MaxParticlesBits );
+		tickInterval[i] = stream->readRangedU32( 1, MaxTickInterval );
+	}
+	stream->read( &sortDistance );
+	stream->read( &collisionDistance );
+}
+
+//-----------------------------------------------------------------------------
+// ParticleLOD
+//-----------------------------------------------------------------------------
+ParticleLOD::ParticleLOD()
+{
+	reset();
+	mSkippedFrames = 0;
+	mSkippedMS = 0;
+	mSkippedCount = 0;
+}
+
+void ParticleLOD::reset()
+{
+	mDistance = 0.0f;
+	mEjectionRate = 1.0f;
+	mMaxParticles = 0;
+	mTickInterval = 1;
+	mSort = true;
+	mCollide = true;
+}
+
+//-----------------------------------------------------------------------------
+// update
+// The ejection rate is interpolated from full at the camera to the rate of
+// the first band, and on between the bands. The other settings are those of
+// the band the emitter is in.
+//-----------------------------------------------------------------------------
+void ParticleLOD::update( const Bands &bands, F32 dist )
+{
+	mDistance = dist;
+
+	const U32 numBands = bands.getNumBands();
+	U32 band = 0;
+	while( band < numBands && bands.distance[band] <= dist )
+		band++;
+
+	// band is now the first band further away than dist
+	if( numBands == 0 )
+		mEjectionRate = 1.0f;
+	else if( band == numBands )
+		mEjectionRate = bands.ejectionRate[numBands - 1];
+	else
+	{
+		const F32 startDist = band > 0 ? bands.distance[band - 1] : 0.0f;
+		const F32 startRate = band > 0 ? bands.ejectionRate[band - 1] : 1.0f;
+		const F32 blend = ( dist - startDist ) / ( bands.distance[band] - startDist );
+		mEjectionRate = startRate + ( bands.ejectionRate[band] - startRate ) * mClampF( blend, 0.0f, 1.0f );
+	}
+
+	if( band > 0 )
+	{
+		mMaxParticles = bands.maxParticles[band - 1];
+		mTickInterval = bands.tickInterval[band - 1];
+	}
+	else
+	{
+		mMaxParticles = 0;
+		mTickInterval = 1;
+	}
+
+	if( bands.sortDistance > 0.0f )
+		mSort = dist < bands.sortDistance * ( mSort ? 1.0f : 1.0f - SwitchHysteresis );
+	else
+		mSort = true;
+
+	if( bands.collisionDistance > 0.0f )
+		mCollide = dist < bands.collisionDistance * ( mCollide ? 1.0f : 1.0f - SwitchHysteresis );
+	else
+		mCollide = true;
+}
+
+//-----------------------------------------------------------------------------
+// scalePeriod
+//-----------------------------------------------------------------------------
+S32 ParticleLOD::scalePeriod( S32 periodMS ) const
+{
+	if( mEjectionRate >= 1.0f )
+		return periodMS;
+	return getMax( (S32)( periodMS / mEjectionRate + 0.5f ), 1 );
+}
+
+//-----------------------------------------------------------------------------
+// advanceFrame
+//-----------------------------------------------------------------------------
+bool ParticleLOD::advanceFrame( U32 &ms, U32 &count )
+{
+	if( mSkippedFrames == 0 )
+		mSkippedCount = count;
+	mSkippedMS += ms;
+	if( ++mSkippedFrames < mTickInterval )
+		return false;
+
+	ms = mSkippedMS;
+	count = getMin( mSkippedCount, count );
+	mSkippedFrames = 0;
+	mSkippedMS = 0;
+	return true;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testParticleLOD, bool, ( S32 numFrames ), ( 1000 ),
+	"@brief Moves an emitter away from the camera through a set of LOD bands, "
+	"and checks that the ejection rate falls without jumps, that the particles "
+	"are simulated at the band tick rate, that no time is lost doing so and "
+	"that the particles emitted during an interval are left to the next one.\n\n"
+	"@param numFrames Number of frames the emitter moves over.\n"
+	"@return True if the test passed.\n"
+	"@internal")
+{
+	ParticleLOD::Bands bands;
+	bands.distance[0] = 20.0f;   bands.ejectionRate[0] = 1.0f;   bands.tickInterval[0] = 1;
+	bands.distance[1] = 60.0f;   bands.ejectionRate[1] = 0.5f;   bands.tickInterval[1] = 2;
+	bands.maxParticles[1] = 200;
+	bands.distance[2] = 150.0f;  bands.ejectionRate[2] = 0.1f;   bands.tickInterval[2] = 4;
+	bands.maxParticles[2] = 50;
+	bands.sortDistance = 40.0f;
+	bands.collisionDistance = 80.0f;
+	bands.validate( "testParticleLOD", "bands" );
+
+	ParticleLOD lod;
+	const F32 maxDist = 200.0f;
+	const F32 step = maxDist / getMax( numFrames, 1 );
+	const F32 maxRateStep = 0.5f / 40.0f * step * 1.01f;   // Steepest blend of the bands
+
+	bool passed = true;
+	F32 lastRate = 1.0f;
+	U32 totalMS = 0, simulatedMS = 0, numSimulated = 0;
+	U32 numParts = 0, intervalParts = 0;
+	bool intervalStart = true;
+	for( S32 i = 0; i <= numFrames; i++ )
+	{
+		const F32 dist = i * step;
+		lod.update( bands, dist );
+
+		const F32 rate = lod.getEjectionRate();
+		if( rate > lastRate || lastRate - rate > maxRateStep )
+		{
+			Con::errorf( "testParticleLOD - failed, the ejection rate jumps from %g to %g at %g meters", lastRate, rate, dist );
+			passed = false;
+			break;
+		}
+		lastRate = rate;
+
+		// A few particles are emitted every frame
+		numParts += 2;
+		if( intervalStart )
+			intervalParts = numParts;
+
+		U32 ms = 16 + i % 3;
+		U32 count = numParts;
+		totalMS += ms;
+		intervalStart = lod.advanceFrame( ms, count );
+		if( !intervalStart )
+			continue;
+		if( count != intervalParts )
+		{
+			Con::errorf( "testParticleLOD - failed, %u of %u particles were simulated, %u were there when the interval started",
+				count, numParts, intervalParts );
+			passed = false;
+			break;
+		}
+		simulatedMS += ms;
+		numSimulated++;
+	}
+
+	// Finish the last simulation interval
+	for( U32 i = 1; i < lod.getTickInterval(); i++ )
+	{
+		U32 ms = 0, count = numParts;
+		if( lod.advanceFrame( ms, count ) )
+			simulatedMS += ms;
+	}
+
+	const S32 farPeriod = lod.scalePeriod( 100 );
+	if( passed && simulatedMS != totalMS )
+	{
+		Con::errorf( "testParticleLOD - failed, %u of %u ms were simulated", simulatedMS, totalMS );
+		passed = false;
+	}
+	if( passed && ( lod.shouldSort() || lod.shouldCollide() || lod.getMaxParticles() != 50 || farPeriod != 1000 ) )
+	{
+		Con::errorf( "testParticleLOD - failed, the last band is not applied beyond it" );
+		passed = false;
+	}
+
+	if( passed )
+		Con::printf( "testParticleLOD - passed, %d frames simulated %u times, ejection period 100 ms -> %d ms at %g meters",
+			numFrames + 1, numSimulated, farPeriod, maxDist );
+	return passed;
+}
@@ -0,0 +1,100 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_LOD
+#define _H_PARTICLE_LOD
+
+class BitStream;
+
+//*****************************************************************************
+// Particle LOD
+//
+// The detail an emitter runs at, picked from its distance to the camera.
+// Distant emitters eject fewer particles, keep fewer alive, simulate them
+// every few frames and skip sorting and collision.
+//
+// The ejection rate is blended between the bands, and the particle cap only
+// holds back new particles, so the particles of an emitter thin out as it
+// moves away instead of popping.
+//*****************************************************************************
+class ParticleLOD
+{
+public:
+	enum
+	{
+		MaxBands = 4,
+		MaxTickInterval = 8,
+	};
+
+	/// The detail at increasing distances from the camera, set on the
+	/// datablocks. Closer than the first band the emitter runs at full
+	/// detail.
+	struct Bands
+	{
+		F32 distance[MaxBands];       ///< Distance the band starts at, 0 for unused bands
+		F32 ejectionRate[MaxBands];   ///< Fraction of the particles ejected at the band distance
+		S32 maxParticles[MaxBands];   ///< Particles alive at once, 0 for no limit
+		S32 tickInterval[MaxBands];   ///< The particles are simulated every tickInterval frames
+		F32 sortDistance;             ///< Particles are not sorted beyond this, 0 to always sort
+		F32 collisionDistance;        ///< Particles don't collide beyond this, 0 to always collide
+
+		Bands();
+
+		/// Number of bands in use, they must be first.
+		U32 getNumBands() const;
+
+		/// Clamps the values to their ranges and warns about bands out of
+		/// order, for onAdd of the datablocks.
+		void validate( const char *className, const char *name );
+
+		void pack( BitStream *stream ) const;
+		void unpack( BitStream *stream );
+	};
+
+	ParticleLOD();
+
+	/// Picks the detail for an emitter dist meters from the camera.
+	void update( const Bands &bands, F32 dist );
+
+	/// Full detail, for emitters without bands or without a camera.
+	void reset();
+
+	/// Period between two ejections at this detail.
+	S32 scalePeriod( S32 periodMS ) const;
+
+	/// True if a particle may be added to an emitter with count particles.
+	bool canAdd( U32 count ) const { return mMaxParticles == 0 || count < mMaxParticles; }
+
+	/// Counts a frame of ms milliseconds of an emitter with count particles.
+	/// @return  True if the particles are simulated this frame, ms is then
+	///          set to the time since they were last simulated and count to
+	///          the particles there were at the first frame of that time.
+	///          The ones emitted later are simulated from the next time on,
+	///          so they are not aged by frames from before they were emitted.
+	bool advanceFrame( U32 &ms, U32 &count );
+
+	bool shouldSort() const { return mSort; }
+	bool shouldCollide() const { return mCollide; }
+	F32 getEjectionRate() const { return mEjectionRate; }
+	U32 getMaxParticles() const { return mMaxParticles; }
+	U32 getTickInterval() const { return mTickInterval; }
+
+	/// Distance from the camera at the last update, 0 without a camera.
+	F32 getDistance() const { return mDistance; }
+
+private:
+	F32  mDistance;
+	F32  mEjectionRate;
+	U32  mMaxParticles;
+	U32  mTickInterval;
+	bool mSort;
+	bool mCollide;
+
+	U32  mSkippedFrames;   ///< Frames since the particles were simulated
+	U32  mSkippedMS;       ///< Milliseconds of those frames
+	U32  mSkippedCount;    ///< Particles at the first of those frames
+};
+
+#endif // _H_PARTICLE_LOD
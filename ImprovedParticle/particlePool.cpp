@@ -0,0 +1,311 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particlePool.h"
+#include "particleCapacity.h"
+
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+// Alignment of the columns, large enough for AVX loads.
+static const S32 PoolColumnAlign = 32;
+
+//-----------------------------------------------------------------------------
+// growColumn
+// Moves a column into a new, larger aligned allocation.
+//-----------------------------------------------------------------------------
+template<class T>
+static void growColumn( T *&column, U32 count, U32 newCapacity )
+{
+	T *newColumn = (T*)dMalloc_aligned( newCapacity * sizeof(T), PoolColumnAlign );
+	if( column )
+	{
+		dMemcpy( newColumn, column, count * sizeof(T) );
+		dFree_aligned( column );
+	}
+	column = newColumn;
+}
+
+template<class T>
+static void moveColumn( T *column, U32 from, U32 to, U32 count )
+{
+	dMemmove( column + to, column + from, count * sizeof(T) );
+}
+
+template<class T>
+static void freeColumn( T *&column )
+{
+	if( column )
+		dFree_aligned( column );
+	column = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// ParticlePool
+//-----------------------------------------------------------------------------
+ParticlePool::ParticlePool()
+{
+	posX = posY = posZ = NULL;
+	velX = velY = velZ = NULL;
+	accX = accY = accZ = NULL;
+	orientDir = NULL;
+	relPos = NULL;
+	currentAge = NULL;
+	totalLifetime = NULL;
+	color = NULL;
+	partSize = NULL;
+	spinSpeed = NULL;
+	dataBlock = NULL;
+
+	mSize = 0;
+	mCapacity = 0;
+	mNumAllocs = 0;
+	mTailStart = 0;
+	mTailSize = 0;
+}
+
+ParticlePool::~ParticlePool()
+{
+	reset();
+}
+
+//-----------------------------------------------------------------------------
+// reserve
+//-----------------------------------------------------------------------------
+void ParticlePool::reserve( U32 newCapacity )
+{
+	if( newCapacity <= mCapacity )
+		return;
+
+	AssertFatal( mTailSize == 0, "ParticlePool::reserve - can't grow while particles are hidden" );
+
+	growColumn( posX, mSize, newCapacity );
+	growColumn( posY, mSize, newCapacity );
+	growColumn( posZ, mSize, newCapacity );
+	growColumn( velX, mSize, newCapacity );
+	growColumn( velY, mSize, newCapacity );
+	growColumn( velZ, mSize, newCapacity );
+	growColumn( accX, mSize, newCapacity );
+	growColumn( accY, mSize, newCapacity );
+	growColumn( accZ, mSize, newCapacity );
+	growColumn( orientDir, mSize, newCapacity );
+	growColumn( relPos, mSize, newCapacity );
+	growColumn( currentAge, mSize, newCapacity );
+	growColumn( totalLifetime, mSize, newCapacity );
+	growColumn( color, mSize, newCapacity );
+	growColumn( partSize, mSize, newCapacity );
+	growColumn( spinSpeed, mSize, newCapacity );
+	growColumn( dataBlock, mSize, newCapacity );
+
+	mCapacity = newCapacity;
+	mNumAllocs++;
+}
+
+//-----------------------------------------------------------------------------
+// reset
+//-----------------------------------------------------------------------------
+void ParticlePool::reset()
+{
+	freeColumn( posX );
+	freeColumn( posY );
+	freeColumn( posZ );
+	freeColumn( velX );
+	freeColumn( velY );
+	freeColumn( velZ );
+	freeColumn( accX );
+	freeColumn( accY );
+	freeColumn( accZ );
+	freeColumn( orientDir );
+	freeColumn( relPos );
+	freeColumn( currentAge );
+	freeColumn( totalLifetime );
+	freeColumn( color );
+	freeColumn( partSize );
+	freeColumn( spinSpeed );
+	freeColumn( dataBlock );
+
+	mSize = 0;
+	mCapacity = 0;
+	mTailStart = 0;
+	mTailSize = 0;
+}
+
+//-----------------------------------------------------------------------------
+// add
+//-----------------------------------------------------------------------------
+U32 ParticlePool::add( const Particle &part )
+{
+	AssertFatal( mSize < mCapacity, "ParticlePool::add - pool is full, reserve more particles first" );
+
+	U32 idx = mSize++;
+	set( idx, part );
+	return idx;
+}
+
+//-----------------------------------------------------------------------------
+// kill
+//-----------------------------------------------------------------------------
+void ParticlePool::kill( U32 idx )
+{
+	AssertFatal( idx < mSize, "ParticlePool::kill - index out of range" );
+
+	U32 last = --mSize;
+	if( idx == last )
+		return;
+
+	posX[idx] = posX[last];
+	posY[idx] = posY[last];
+	posZ[idx] = posZ[last];
+	velX[idx] = velX[last];
+	velY[idx] = velY[last];
+	velZ[idx] = velZ[last];
+	accX[idx] = accX[last];
+	accY[idx] = accY[last];
+	accZ[idx] = accZ[last];
+	orientDir[idx] = orientDir[last];
+	relPos[idx] = relPos[last];
+	currentAge[idx] = currentAge[last];
+	totalLifetime[idx] = totalLifetime[last];
+	color[idx] = color[last];
+	partSize[idx] = partSize[last];
+	spinSpeed[idx] = spinSpeed[last];
+	dataBlock[idx] = dataBlock[last];
+}
+
+//-----------------------------------------------------------------------------
+// hideTail
+//-----------------------------------------------------------------------------
+void ParticlePool::hideTail( U32 count )
+{
+	AssertFatal( mTailSize == 0, "ParticlePool::hideTail - a tail is hidden already" );
+
+	count = getMin( count, mSize );
+	mTailStart = count;
+	mTailSize = mSize - count;
+	mSize = count;
+}
+
+//-----------------------------------------------------------------------------
+// showTail
+// The particles killed while the tail was hidden left a gap between the live
+// particles and the tail, which is closed by moving the tail down.
+//-----------------------------------------------------------------------------
+U32 ParticlePool::showTail()
+{
+	const U32 first = mSize;
+	if( mTailSize > 0 && mTailStart != first )
+	{
+		moveColumn( posX, mTailStart, first, mTailSize );
+		moveColumn( posY, mTailStart, first, mTailSize );
+		moveColumn( posZ, mTailStart, first, mTailSize );
+		moveColumn( velX, mTailStart, first, mTailSize );
+		moveColumn( velY, mTailStart, first, mTailSize );
+		moveColumn( velZ, mTailStart, first, mTailSize );
+		moveColumn( accX, mTailStart, first, mTailSize );
+		moveColumn( accY, mTailStart, first, mTailSize );
+		moveColumn( accZ, mTailStart, first, mTailSize );
+		moveColumn( orientDir, mTailStart, first, mTailSize );
+		moveColumn( relPos, mTailStart, first, mTailSize );
+		moveColumn( currentAge, mTailStart, first, mTailSize );
+		moveColumn( totalLifetime, mTailStart, first, mTailSize );
+		moveColumn( color, mTailStart, first, mTailSize );
+		moveColumn( partSize, mTailStart, first, mTailSize );
+		moveColumn( spinSpeed, mTailStart, first, mTailSize );
+		moveColumn( dataBlock, mTailStart, first, mTailSize );
+	}
+
+	mSize += mTailSize;
+	mTailStart = 0;
+	mTailSize = 0;
+	return first;
+}
+
+//-----------------------------------------------------------------------------
+// get
+//-----------------------------------------------------------------------------
+void ParticlePool::get( U32 idx, Particle &part ) const
+{
+	part.pos = getPos(idx);
+	part.vel = getVel(idx);
+	part.acc = getAcc(idx);
+	part.orientDir = orientDir[idx];
+	part.relPos = relPos[idx];
+	part.currentAge = currentAge[idx];
+	part.totalLifetime = totalLifetime[idx];
+	part.color = color[idx];
+	part.size = partSize[idx];
+	part.spinSpeed = spinSpeed[idx];
+	part.dataBlock = dataBlock[idx];
+	part.next = NULL;
+}
+
+//-----------------------------------------------------------------------------
+// set
+//-----------------------------------------------------------------------------
+void ParticlePool::set( U32 idx, const Particle &part )
+{
+	setPos( idx, part.pos );
+	setVel( idx, part.vel );
+	setAcc( idx, part.acc );
+	orientDir[idx] = part.orientDir;
+	relPos[idx] = part.relPos;
+	currentAge[idx] = part.currentAge;
+	totalLifetime[idx] = part.totalLifetime;
+	color[idx] = part.color;
+	partSize[idx] = part.size;
+	spinSpeed[idx] = part.spinSpeed;
+	dataBlock[idx] = part.dataBlock;
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+DefineEngineFunction( testParticlePoolAllocs, bool, ( S32 numParticles, S32 numSpawns ), ( 500, 100000 ),
+	"@brief Spawns and kills particles in a pool the way an emitter does, and "
+	"checks that the pool stops allocating once it holds the steady state "
+	"number of particles.\n\n"
+	"The pool starts out empty and grows when full, like the emitters do in "
+	"an emergency. Each spawn kills a random particle once numParticles are alive.\n\n"
+	"@param numParticles Number of particles alive in the steady state.\n"
+	"@param numSpawns Number of particles spawned after the steady state is reached.\n"
+	"@return True if no allocations were made in the steady state.\n"
+	"@internal")
+{
+	if( numParticles <= 0 || numSpawns <= 0 )
+		return false;
+
+	ParticlePool pool;
+	MRandomLCG rand( 0x2b41 );
+
+	Particle part;
+	dMemset( &part, 0, sizeof(Particle) );
+
+	for( S32 i = 0; i < numParticles; i++ )
+	{
+		if( pool.size() >= pool.capacity() )
+			pool.reserve( ParticleCapacity::grow( pool.capacity() ) );
+		pool.add( part );
+	}
+
+	const U32 warmupAllocs = pool.getNumAllocs();
+	for( S32 i = 0; i < numSpawns; i++ )
+	{
+		pool.kill( rand.randI( 0, pool.size() - 1 ) );
+		if( pool.size() >= pool.capacity() )
+			pool.reserve( ParticleCapacity::grow( pool.capacity() ) );
+		pool.add( part );
+	}
+
+	const U32 steadyAllocs = pool.getNumAllocs() - warmupAllocs;
+	if( steadyAllocs == 0 )
+		Con::printf( "testParticlePoolAllocs - passed, %u allocations to reach %d particles, none for %d spawns",
+			warmupAllocs, numParticles, numSpawns );
+	else
+		Con::errorf( "testParticlePoolAllocs - failed, %u allocations for %d spawns in the steady state",
+			steadyAllocs, numSpawns );
+
+	return steadyAllocs == 0;
+}
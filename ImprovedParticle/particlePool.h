@@ -0,0 +1,115 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_POOL
+#define _H_PARTICLE_POOL
+
+#ifndef _PARTICLE_H_
+#include "T3D/fx/particle.h"
+#endif
+
+//*****************************************************************************
+// Particle Pool
+//
+// Structure-of-arrays storage for the live particles of an emitter.
+// Every particle attribute lives in its own contiguous, 32 byte aligned
+// column, so passes over the pool (aging, integration, bounds, vertex fill)
+// walk memory linearly and can be vectorized.
+// Live particles always occupy the indices [0, size()). A dead particle is
+// removed by moving the last live particle into its slot (swap-remove), so
+// the order of the pool is not the order of emission.
+//*****************************************************************************
+class ParticlePool
+{
+public:
+	ParticlePool();
+	~ParticlePool();
+
+	/// Number of live particles
+	U32 size() const { return mSize; }
+	/// Number of particles the columns can hold without growing
+	U32 capacity() const { return mCapacity; }
+	bool empty() const { return mSize == 0; }
+
+	/// Grows every column to hold at least newCapacity particles.
+	/// Live particles are kept, a smaller capacity is ignored.
+	void reserve( U32 newCapacity );
+
+	/// Kills all particles but keeps the memory.
+	void clear() { mSize = 0; }
+
+	/// Frees all memory.
+	void reset();
+
+	/// Number of times the columns were allocated, for checking that
+	/// spawning particles doesn't allocate once the pool is large enough.
+	U32 getNumAllocs() const { return mNumAllocs; }
+
+	/// Appends a particle and returns its index.
+	/// The pool must have room for it, see reserve().
+	U32 add( const Particle &part );
+
+	/// Kills the particle at idx by moving the last live particle into its slot.
+	void kill( U32 idx );
+
+	/// Hides the particles from index count on, so size(), kill() and the
+	/// passes over the pool only see the first count particles. Used to
+	/// update the particles that existed when an update was queued, while
+	/// the ones emitted since then wait at the end of the pool.
+	/// Only one tail can be hidden at a time, and the pool can't grow meanwhile.
+	void hideTail( U32 count );
+
+	/// Moves the hidden particles down behind the live ones and shows them again.
+	/// @return  Index of the first of them.
+	U32 showTail();
+
+	/// Copies a particle in or out of the pool.
+	void get( U32 idx, Particle &part ) const;
+	void set( U32 idx, const Particle &part );
+
+	Point3F getPos( U32 idx ) const { return Point3F( posX[idx], posY[idx], posZ[idx] ); }
+	Point3F getVel( U32 idx ) const { return Point3F( velX[idx], velY[idx], velZ[idx] ); }
+	Point3F getAcc( U32 idx ) const { return Point3F( accX[idx], accY[idx], accZ[idx] ); }
+
+	void setPos( U32 idx, const Point3F &p ) { posX[idx] = p.x; posY[idx] = p.y; posZ[idx] = p.z; }
+	void setVel( U32 idx, const Point3F &v ) { velX[idx] = v.x; velY[idx] = v.y; velZ[idx] = v.z; }
+	void setAcc( U32 idx, const Point3F &a ) { accX[idx] = a.x; accY[idx] = a.y; accZ[idx] = a.z; }
+
+public:
+	/// @name Columns
+	/// Indexed by particle, valid for [0, size()).
+	/// @{
+	F32*           posX;
+	F32*           posY;
+	F32*           posZ;
+	F32*           velX;
+	F32*           velY;
+	F32*           velZ;
+	F32*           accX;
+	F32*           accY;
+	F32*           accZ;
+	Point3F*       orientDir;     ///< Direction the particle should face if using oriented particles
+	Point3F*       relPos;        ///< Position relative to the emitting node, used by sticky emitters
+	U32*           currentAge;
+	U32*           totalLifetime;
+	ColorF*        color;
+	F32*           partSize;
+	F32*           spinSpeed;
+	ParticleData** dataBlock;
+	/// @}
+
+private:
+	U32 mSize;
+	U32 mCapacity;
+	U32 mNumAllocs;
+	U32 mTailStart;   ///< First hidden particle, see hideTail()
+	U32 mTailSize;    ///< Number of hidden particles
+
+	// The columns are owned by the pool, so it can't be copied.
+	ParticlePool( const ParticlePool& );
+	ParticlePool& operator=( const ParticlePool& );
+};
+
+#endif // _H_PARTICLE_POOL
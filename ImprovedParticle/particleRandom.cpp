@@ -0,0 +1,152 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleRandom.h"
+#include "particleJobs.h"
+
+#include "T3D/fx/particle.h"
+#include "math/mMathFn.h"
+#include "console/engineAPI.h"
+
+//-----------------------------------------------------------------------------
+// randomizeParticle
+//-----------------------------------------------------------------------------
+void ParticleRandom::randomizeParticle( const ParticleData *data, Particle &part )
+{
+	F32 randoms[2];
+	fill( randoms, 2 );
+
+	part.totalLifetime = data->lifetimeMS;
+	if( data->lifetimeVarianceMS != 0 )
+		part.totalLifetime += S32( toIndex( randoms[0], 2 * data->lifetimeVarianceMS + 1 ) ) - data->lifetimeVarianceMS;
+
+	part.spinSpeed = data->spinSpeed * ( data->spinRandomMin + ( data->spinRandomMax - data->spinRandomMin ) * randoms[1] );
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+
+// Fills the part of a shared sequence in each chunk.
+struct RandomFillTask : public ParticleJobScheduler::Task
+{
+	const ParticleRandom *rand;
+	F32 *out;
+
+	void run( U32 start, U32 end ) { rand->fill( start, out + start, end - start ); }
+};
+
+DefineEngineFunction( testParticleRandom, bool, ( S32 numSamples ), ( 1000000 ),
+	"@brief Checks that the particle random numbers are uniform, that a seed "
+	"always gives the same sequence, that two seeds don't, that a sequence "
+	"can be resumed from its counter and that a batch filled on the worker "
+	"threads holds the same numbers as drawing them one by one.\n\n"
+	"@param numSamples Number of numbers drawn for the uniformity test.\n"
+	"@return True if the test passed.\n"
+	"@internal")
+{
+	const U32 numBuckets = 64;
+	U32 buckets[numBuckets];
+	dMemset( buckets, 0, sizeof(buckets) );
+
+	ParticleRandom rand( 0x1e55 );
+	F64 sum = 0.0;
+	F32 lowest = 1.0f, highest = 0.0f;
+	for( S32 i = 0; i < numSamples; i++ )
+	{
+		const F32 f = rand.randF();
+		sum += f;
+		lowest = getMin( lowest, f );
+		highest = getMax( highest, f );
+		buckets[ getMin( U32( f * numBuckets ), numBuckets - 1 ) ]++;
+	}
+
+	// Chi square of the buckets, 63 degrees of freedom put 99.9% below 104
+	const F64 expected = F64( numSamples ) / numBuckets;
+	F64 chiSquare = 0.0;
+	for( U32 i = 0; i < numBuckets; i++ )
+		chiSquare += ( buckets[i] - expected ) * ( buckets[i] - expected ) / expected;
+
+	bool passed = true;
+	// The mean of n uniform numbers has a deviation of 0.29 / sqrt(n)
+	const F64 mean = sum / getMax( numSamples, 1 );
+	const F64 meanTolerance = 2.0 / mSqrt( F32( getMax( numSamples, 1 ) ) );
+	if( lowest < 0.0f || highest >= 1.0f || mFabs( mean - 0.5 ) > meanTolerance || chiSquare > 104.0 )
+	{
+		Con::errorf( "testParticleRandom - failed, range [%g, %g], mean %g, chi square %g",
+			lowest, highest, mean, chiSquare );
+		passed = false;
+	}
+
+	// Same seed, same sequence, also when resumed from the counter
+	ParticleRandom a( 42 ), b( 42 ), c( 43 );
+	U32 numSame = 0;
+	for( U32 i = 0; i < 1000; i++ )
+	{
+		const U32 x = a.randI();
+		if( x != b.randI() )
+		{
+			Con::errorf( "testParticleRandom - failed, seed 42 differs at number %u", i );
+			passed = false;
+			break;
+		}
+		if( x == c.randI() )
+			numSame++;
+	}
+	if( numSame > 1 )
+	{
+		Con::errorf( "testParticleRandom - failed, seeds 42 and 43 share %u of 1000 numbers", numSame );
+		passed = false;
+	}
+
+	ParticleRandom resumed( 42 );
+	resumed.setCounter( a.getCounter() );
+	if( resumed.randI() != a.randI() )
+	{
+		Con::errorf( "testParticleRandom - failed, the sequence doesn't resume from its counter" );
+		passed = false;
+	}
+
+	// A batch holds the same numbers as drawing them one by one, also when
+	// the worker threads fill parts of it at once
+	const U32 count = getMax( numSamples, 0 );
+	Vector<F32> serial, parallel;
+	serial.setSize( count );
+	parallel.setSize( count );
+
+	ParticleRandom filled( 0x1e55 ), single( 0x1e55 );
+	filled.fill( serial.address(), count );
+	for( U32 i = 0; i < count; i++ )
+	{
+		if( serial[i] != single.randF() )
+		{
+			Con::errorf( "testParticleRandom - failed, fill() differs from randF() at number %u", i );
+			passed = false;
+			break;
+		}
+	}
+	if( filled.getCounter() != single.getCounter() )
+	{
+		Con::errorf( "testParticleRandom - failed, fill() left the counter at %u instead of %u",
+			filled.getCounter(), single.getCounter() );
+		passed = false;
+	}
+
+	RandomFillTask task;
+	task.rand = &filled;
+	task.out = parallel.address();
+	const U32 numWorkers = ParticleJobScheduler::runParallel( task, count, 4096 );
+	if( count > 0 && dMemcmp( serial.address(), parallel.address(), count * sizeof(F32) ) != 0 )
+	{
+		Con::errorf( "testParticleRandom - failed, the sequence filled by %u workers differs", numWorkers );
+		passed = false;
+	}
+
+	if( passed )
+		Con::printf( "testParticleRandom - passed, %d numbers, mean %.4f, chi square %.1f over %u buckets, "
+			"filled by %u workers", numSamples, mean, chiSquare, numBuckets, numWorkers );
+	return passed;
+}
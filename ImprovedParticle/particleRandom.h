@@ -0,0 +1,103 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_RANDOM
+#define _H_PARTICLE_RANDOM
+
+class ParticleData;
+struct Particle;
+
+//*****************************************************************************
+// Particle Random
+//
+// A counter based random number generator, each emitter has its own. The
+// n'th number is a hash of the seed and n, so the sequence of an emitter is
+// set by its seed alone, no matter what else draws random numbers, and the
+// state can be saved and restored as a single counter.
+// The numbers don't depend on each other, so fill() draws a batch of them in
+// a loop that vectorizes, and threads can fill parts of the same sequence at
+// once. An emitter draws all the numbers of a spawn in one fill().
+//*****************************************************************************
+class ParticleRandom
+{
+public:
+	ParticleRandom( U32 seed = 0 ) { setSeed( seed ); }
+
+	/// Restarts the sequence of the seed.
+	void setSeed( U32 seed )
+	{
+		mSeed = seed;
+		mKey = mix( seed );
+		mStream = mix( mKey + 0x9e3779b9 );
+		mCounter = 0;
+	}
+	U32 getSeed() const { return mSeed; }
+
+	/// Numbers drawn since the seed was set.
+	U32 getCounter() const { return mCounter; }
+	void setCounter( U32 counter ) { mCounter = counter; }
+
+	/// Number index of the sequence.
+	U32 at( U32 index ) const { return mix( mix( index + mKey ) ^ mStream ); }
+
+	/// Uniform in [0, 2^32).
+	U32 randI() { return at( mCounter++ ); }
+
+	/// Uniform in [0, 1).
+	F32 randF() { return toUnitF( randI() ); }
+
+	/// Uniform integer in [i, n].
+	S32 randI( S32 i, S32 n ) { return i + S32( randI() % U32( n - i + 1 ) ); }
+
+	/// Uniform in [min, max).
+	F32 randF( F32 min, F32 max ) { return min + ( max - min ) * randF(); }
+
+	/// Writes the next count numbers to out, uniform in [0, 1). The same
+	/// numbers as count calls to randF().
+	void fill( F32 *out, U32 count )
+	{
+		fill( mCounter, out, count );
+		mCounter += count;
+	}
+
+	/// Writes the numbers first to first + count - 1 of the sequence to out,
+	/// uniform in [0, 1). Doesn't touch the counter, so it is safe to call
+	/// from several threads at once.
+	void fill( U32 first, F32 *out, U32 count ) const
+	{
+		for( U32 i = 0; i < count; i++ )
+			out[i] = toUnitF( at( first + i ) );
+	}
+
+	/// Scales a number from fill() to an index in [0, count).
+	static U32 toIndex( F32 unit, U32 count ) { return getMin( U32( unit * count ), count - 1 ); }
+
+	/// Redraws the lifetime and spin of a particle that
+	/// ParticleData::initializeParticle drew from gRandGen, so the
+	/// particles of an emitter only depend on its own sequence.
+	void randomizeParticle( const ParticleData *data, Particle &part );
+
+	/// The upper 24 bits of a number as a float in [0, 1).
+	static F32 toUnitF( U32 bits ) { return F32( bits >> 8 ) * ( 1.0f / 16777216.0f ); }
+
+private:
+	/// Avalanches the bits of x, every input bit flips about half of the output bits.
+	static U32 mix( U32 x )
+	{
+		x ^= x >> 16;
+		x *= 0x7feb352d;
+		x ^= x >> 15;
+		x *= 0x846ca68b;
+		x ^= x >> 16;
+		return x;
+	}
+
+	U32 mSeed;
+	U32 mKey;
+	U32 mStream;
+	U32 mCounter;
+};
+
+#endif // _H_PARTICLE_RANDOM
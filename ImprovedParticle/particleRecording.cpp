@@ -0,0 +1,151 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleRecording.h"
+#include "particlePool.h"
+
+#include "core/stream/stream.h"
+#include "math/mathIO.h"
+
+// "IPSR" and the version of the file layout.
+static const U32 RecordingMagic = 0x52535049;
+static const U32 RecordingVersion = 2;
+
+// Bytes of the header and of a step in the file, see write().
+static const U32 HeaderSize = 6 * sizeof(U32);
+static const U32 StepSize = 4 * sizeof(U32) + 3 * sizeof(Point3F) + 16 * sizeof(F32) +
+	AttractionField::MaxAttractors * sizeof(Point3F);
+
+//-----------------------------------------------------------------------------
+// clear
+//-----------------------------------------------------------------------------
+void ParticleRecording::clear()
+{
+	seed = 0;
+	lifetimeMS = 0;
+	nodeProgress = 0.0f;
+	steps.clear();
+}
+
+//-----------------------------------------------------------------------------
+// checksum
+// FNV-1a over the raw bytes of the columns.
+//-----------------------------------------------------------------------------
+static U32 hashBytes( U32 hash, const void *data, U32 numBytes )
+{
+	const U8 *bytes = (const U8*)data;
+	for( U32 i = 0; i < numBytes; i++ )
+	{
+		hash ^= bytes[i];
+		hash *= 16777619;
+	}
+	return hash;
+}
+
+U32 ParticleRecording::checksum( const ParticlePool &pool )
+{
+	const U32 count = pool.size();
+	U32 hash = hashBytes( 2166136261u, &count, sizeof(count) );
+	hash = hashBytes( hash, pool.posX, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.posY, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.posZ, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.velX, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.velY, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.velZ, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.currentAge, count * sizeof(U32) );
+	hash = hashBytes( hash, pool.totalLifetime, count * sizeof(U32) );
+	hash = hashBytes( hash, pool.color, count * sizeof(ColorF) );
+	hash = hashBytes( hash, pool.partSize, count * sizeof(F32) );
+	hash = hashBytes( hash, pool.spinSpeed, count * sizeof(F32) );
+	return hash;
+}
+
+//-----------------------------------------------------------------------------
+// getStreamSize
+//-----------------------------------------------------------------------------
+U32 ParticleRecording::getStreamSize() const
+{
+	return HeaderSize + steps.size() * StepSize;
+}
+
+//-----------------------------------------------------------------------------
+// write
+//-----------------------------------------------------------------------------
+bool ParticleRecording::write( Stream &stream ) const
+{
+	stream.write( RecordingMagic );
+	stream.write( RecordingVersion );
+	stream.write( seed );
+	stream.write( lifetimeMS );
+	stream.write( nodeProgress );
+	stream.write( (U32)steps.size() );
+
+	for( U32 i = 0; i < steps.size(); i++ )
+	{
+		const Step &step = steps[i];
+		stream.write( step.stepMS );
+		stream.write( step.emitMS );
+		mathWrite( stream, step.point );
+		mathWrite( stream, step.axis );
+		mathWrite( stream, step.velocity );
+		mathWrite( stream, step.transform );
+		stream.write( step.targetMask );
+		for( U32 j = 0; j < AttractionField::MaxAttractors; j++ )
+			mathWrite( stream, step.targets[j] );
+		stream.write( step.checksum );
+	}
+
+	return stream.getStatus() == Stream::Ok;
+}
+
+//-----------------------------------------------------------------------------
+// read
+//-----------------------------------------------------------------------------
+bool ParticleRecording::read( Stream &stream )
+{
+	clear();
+
+	U32 magic, version, numSteps;
+	stream.read( &magic );
+	stream.read( &version );
+	if( magic != RecordingMagic || version != RecordingVersion )
+		return false;
+
+	stream.read( &seed );
+	stream.read( &lifetimeMS );
+	stream.read( &nodeProgress );
+	stream.read( &numSteps );
+	if( stream.getStatus() != Stream::Ok )
+		return false;
+
+	// A damaged count must not allocate more steps than the file holds
+	const U32 numBytes = stream.getStreamSize() - stream.getPosition();
+	if( numSteps > numBytes / StepSize )
+		return false;
+
+	steps.setSize( numSteps );
+	for( U32 i = 0; i < numSteps; i++ )
+	{
+		Step &step = steps[i];
+		stream.read( &step.stepMS );
+		stream.read( &step.emitMS );
+		mathRead( stream, &step.point );
+		mathRead( stream, &step.axis );
+		mathRead( stream, &step.velocity );
+		mathRead( stream, &step.transform );
+		stream.read( &step.targetMask );
+		for( U32 j = 0; j < AttractionField::MaxAttractors; j++ )
+			mathRead( stream, &step.targets[j] );
+		stream.read( &step.checksum );
+
+		if( stream.getStatus() != Stream::Ok )
+		{
+			clear();
+			return false;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,61 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_RECORDING
+#define _H_PARTICLE_RECORDING
+
+#ifndef _H_ATTRACTION_FIELD
+#include "attractionField.h"
+#endif
+
+class Stream;
+class ParticlePool;
+
+//*****************************************************************************
+// Particle Recording
+//
+// The inputs of an emitter running fixed steps, one entry per step, with a
+// checksum of its particles after each step. Replaying the inputs from the
+// same seed must give the same checksums bit for bit, so a recording of an
+// effect is both a regression test for its looks and a benchmark.
+//*****************************************************************************
+class ParticleRecording
+{
+public:
+	/// The inputs of a step.
+	struct Step
+	{
+		U32     stepMS;          ///< Milliseconds the particles are moved
+		U32     emitMS;          ///< Milliseconds emitted for after moving them, 0 for none
+		Point3F point;           ///< Emission point
+		Point3F axis;            ///< Emission axis
+		Point3F velocity;        ///< Velocity of the emission point
+		MatrixF transform;       ///< Transform of the emitter node
+		U32     targetMask;      ///< Bit i is set if attractor i has a target
+		Point3F targets[AttractionField::MaxAttractors];
+		U32     checksum;        ///< Of the particles after the step
+	};
+
+	ParticleRecording() { clear(); }
+
+	void clear();
+
+	U32         seed;            ///< Seed of the emitter's ParticleRandom
+	S32         lifetimeMS;      ///< Lifetime of the emitter
+	F32         nodeProgress;    ///< Value of t of the emitter node before the first step
+	Vector<Step> steps;
+
+	/// Hash of every particle's position, velocity, age, lifetime, color,
+	/// size and spin, in pool order.
+	static U32 checksum( const ParticlePool &pool );
+
+	/// Bytes write() writes.
+	U32 getStreamSize() const;
+
+	bool write( Stream &stream ) const;
+	bool read( Stream &stream );
+};
+
+#endif // _H_PARTICLE_RECORDING
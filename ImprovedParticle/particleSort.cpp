@@ -0,0 +1,229 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "particleSort.h"
+
+#include "math/mRandom.h"
+#include "console/engineAPI.h"
+
+//-----------------------------------------------------------------------------
+// depthKey
+// Positive floats order like their bits, negative floats order reversed.
+// Flipping the sign bit of positives and all bits of negatives gives an
+// ascending key, inverting that gives a descending key.
+//-----------------------------------------------------------------------------
+inline U32 ParticleSort::depthKey( F32 depth )
+{
+	U32 bits;
+	dMemcpy( &bits, &depth, sizeof(U32) );
+	const U32 mask = ( bits & 0x80000000 ) ? 0xFFFFFFFF : 0x80000000;
+	return ~( bits ^ mask );
+}
+
+//-----------------------------------------------------------------------------
+// sort
+//-----------------------------------------------------------------------------
+const U32* ParticleSort::sort( const ParticlePool &pool, const Point3F &viewVec )
+{
+	const U32 count = pool.size();
+	mDepths.setSize( count );
+	F32 *depths = mDepths.address();
+	for( U32 i = 0; i < count; i++ )
+		depths[i] = pool.posX[i] * viewVec.x + pool.posY[i] * viewVec.y + pool.posZ[i] * viewVec.z;
+
+	return sort( depths, count );
+}
+
+const U32* ParticleSort::sort( const F32 *depths, U32 count )
+{
+	mEntries.setSize( count );
+	mOrder.setSize( count );
+	if( count == 0 )
+		return mOrder.address();
+
+	U64 *entries = mEntries.address();
+	for( U32 i = 0; i < count; i++ )
+		entries[i] = ( U64(depthKey( depths[i] )) << 32 ) | i;
+
+	if( count <= InsertionSortMax )
+		insertionSort( count );
+	else
+		radixSort( count );
+
+	entries = mEntries.address();
+	U32 *order = mOrder.address();
+	for( U32 i = 0; i < count; i++ )
+		order[i] = U32( entries[i] );
+
+	return order;
+}
+
+//-----------------------------------------------------------------------------
+// insertionSort
+//-----------------------------------------------------------------------------
+void ParticleSort::insertionSort( U32 count )
+{
+	U64 *entries = mEntries.address();
+	for( U32 i = 1; i < count; i++ )
+	{
+		const U64 entry = entries[i];
+		const U32 key = U32( entry >> 32 );
+		U32 j = i;
+		while( j > 0 && U32( entries[j - 1] >> 32 ) > key )
+		{
+			entries[j] = entries[j - 1];
+			j--;
+		}
+		entries[j] = entry;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// radixSort
+// Least significant digit first, the histograms of all the passes are
+// counted in one go. Every pass is stable so the earlier passes are kept.
+//-----------------------------------------------------------------------------
+void ParticleSort::radixSort( U32 count )
+{
+	U32 histograms[NumPasses][RadixSize];
+	dMemset( histograms, 0, sizeof(histograms) );
+
+	const U64 *entries = mEntries.address();
+	for( U32 i = 0; i < count; i++ )
+	{
+		const U32 key = U32( entries[i] >> 32 );
+		for( U32 pass = 0; pass < NumPasses; pass++ )
+			histograms[pass][( key >> ( pass * RadixBits ) ) & ( RadixSize - 1 )]++;
+	}
+
+	mScratch.setSize( count );
+	U64 *src = mEntries.address();
+	U64 *dst = mScratch.address();
+	for( U32 pass = 0; pass < NumPasses; pass++ )
+	{
+		U32 *histogram = histograms[pass];
+		const U32 shift = 32 + pass * RadixBits;
+
+		// All the keys have the same digit, the pass wouldn't move anything.
+		if( histogram[( src[0] >> shift ) & ( RadixSize - 1 )] == count )
+			continue;
+
+		// Turn the counts into the first destination of each digit
+		U32 offset = 0;
+		for( U32 digit = 0; digit < RadixSize; digit++ )
+		{
+			const U32 digitCount = histogram[digit];
+			histogram[digit] = offset;
+			offset += digitCount;
+		}
+
+		for( U32 i = 0; i < count; i++ )
+		{
+			const U64 entry = src[i];
+			dst[histogram[( entry >> shift ) & ( RadixSize - 1 )]++] = entry;
+		}
+
+		U64 *swap = src;
+		src = dst;
+		dst = swap;
+	}
+
+	// An odd number of passes leaves the result in the scratch array.
+	if( src != mEntries.address() )
+		dMemcpy( mEntries.address(), src, count * sizeof(U64) );
+}
+
+//-----------------------------------------------------------------------------
+// Console functions
+//-----------------------------------------------------------------------------
+
+// The qsort comparison the emitters used before ParticleSort.
+struct QSortParticle
+{
+	U32 p;
+	F32 k;
+};
+
+static int QSORT_CALLBACK cmpQSortParticles( const void* p1, const void* p2 )
+{
+	const QSortParticle* sp1 = (const QSortParticle*)p1;
+	const QSortParticle* sp2 = (const QSortParticle*)p2;
+
+	if (sp2->k > sp1->k)
+		return 1;
+	else if (sp2->k == sp1->k)
+		return 0;
+	else
+		return -1;
+}
+
+DefineEngineFunction( benchmarkParticleSort, bool, ( S32 numSorts ), ( 100 ),
+	"@brief Times ParticleSort against dQsort for 1000, 10000 and 100000 particles, "
+	"and checks that ParticleSort orders the particles far to near.\n\n"
+	"The particles are spread randomly over a 100m box, the random generator is "
+	"seeded with a constant so the runs are comparable.\n\n"
+	"@param numSorts Number of sorts per particle count and method.\n"
+	"@return True if every sort was ordered far to near.\n"
+	"@internal")
+{
+	static const U32 counts[] = { 1000, 10000, 100000 };
+	const Point3F viewVec( 0.48f, 0.64f, 0.6f );
+
+	bool passed = true;
+	for( U32 c = 0; c < sizeof(counts) / sizeof(counts[0]); c++ )
+	{
+		const U32 count = counts[c];
+
+		ParticlePool pool;
+		pool.reserve( count );
+		MRandomLCG rand( 0x51e7 );
+		Particle part;
+		dMemset( &part, 0, sizeof(Particle) );
+		for( U32 i = 0; i < count; i++ )
+		{
+			part.pos.set( rand.randF( -50.0f, 50.0f ), rand.randF( -50.0f, 50.0f ), rand.randF( -50.0f, 50.0f ) );
+			pool.add( part );
+		}
+
+		Vector<QSortParticle> ordered;
+		ordered.setSize( count );
+		U32 start = Platform::getRealMilliseconds();
+		for( S32 n = 0; n < numSorts; n++ )
+		{
+			for( U32 i = 0; i < count; i++ )
+			{
+				ordered[i].p = i;
+				ordered[i].k = mDot( pool.getPos(i), viewVec );
+			}
+			dQsort( ordered.address(), count, sizeof(QSortParticle), cmpQSortParticles );
+		}
+		const U32 qsortTime = Platform::getRealMilliseconds() - start;
+
+		ParticleSort sorter;
+		const U32 *order = NULL;
+		start = Platform::getRealMilliseconds();
+		for( S32 n = 0; n < numSorts; n++ )
+			order = sorter.sort( pool, viewVec );
+		const U32 radixTime = Platform::getRealMilliseconds() - start;
+
+		bool sorted = true;
+		for( U32 i = 1; order && i < count; i++ )
+		{
+			if( mDot( pool.getPos(order[i - 1]), viewVec ) < mDot( pool.getPos(order[i]), viewVec ) )
+			{
+				sorted = false;
+				break;
+			}
+		}
+		passed &= sorted;
+
+		Con::printf( "%7u particles: dQsort %5ums, radix %5ums, speedup %.2fx%s", count,
+			qsortTime, radixTime, radixTime ? (F32)qsortTime / radixTime : 0.0f,
+			sorted ? "" : " - NOT SORTED" );
+	}
+
+	return passed;
+}
@@ -0,0 +1,68 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_PARTICLE_SORT
+#define _H_PARTICLE_SORT
+
+#ifndef _H_PARTICLE_POOL
+#include "particlePool.h"
+#endif
+
+//*****************************************************************************
+// Particle Sort
+//
+// Orders the particles of a pool far to near for sorted rendering.
+// The depth of each particle is turned into a 32 bit key whose unsigned
+// order is the float order, and packed with the particle index into a 64 bit
+// entry. The entries are radix sorted on the key, 11 bits per pass, so the
+// cost is linear in the number of particles and there are no comparison
+// callbacks. Passes where every key has the same digit are skipped, which is
+// common as the depths of an emitter's particles are close together.
+// Few particles are insertion sorted instead.
+//*****************************************************************************
+class ParticleSort
+{
+public:
+	enum
+	{
+		RadixBits = 11,
+		RadixSize = 1 << RadixBits,
+		NumPasses = (32 + RadixBits - 1) / RadixBits,
+		InsertionSortMax = 64,   ///< Counts up to this are insertion sorted
+	};
+
+	/// Sorts the particles of the pool far to near along viewVec.
+	/// @return  The indices of the particles in drawing order, valid until
+	///          the next sort.
+	const U32* sort( const ParticlePool &pool, const Point3F &viewVec );
+
+	/// Sorts count depths far to near, larger depths first.
+	/// @return  The indices of the depths in sorted order.
+	const U32* sort( const F32 *depths, U32 count );
+
+	/// Index of the particle drawn in vertex slot 'slot' of an emitter with
+	/// count particles. Sorted particles are drawn in the sorted order,
+	/// unsorted ones newest first, and reverse flips the order.
+	static U32 getDrawIndex( const U32 *sortedParts, U32 count, U32 slot, bool reverse )
+	{
+		const U32 pos = reverse ? count - 1 - slot : slot;
+		return sortedParts ? sortedParts[pos] : count - 1 - pos;
+	}
+
+private:
+	/// A key whose unsigned order is the reverse of the order of the floats,
+	/// so sorting the keys ascending sorts the depths descending.
+	static U32 depthKey( F32 depth );
+
+	void radixSort( U32 count );
+	void insertionSort( U32 count );
+
+	Vector<F32> mDepths;
+	Vector<U64> mEntries;   ///< Key in the high 32 bits, index in the low 32 bits
+	Vector<U64> mScratch;
+	Vector<U32> mOrder;
+};
+
+#endif // _H_PARTICLE_SORT
@@ -0,0 +1,130 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#include "platform/platform.h"
+#include "terrainHeightCache.h"
+
+#include "scene/sceneContainer.h"
+#include "T3D/objectTypes.h"
+#include "collision/collision.h"
+
+// Distance between two grid points in world units.
+static const F32 CellSize = 1.0f;
+
+//-----------------------------------------------------------------------------
+// TerrainHeightCache
+//-----------------------------------------------------------------------------
+TerrainHeightCache::TerrainHeightCache()
+{
+	mCentered = false;
+	mCenter.set( 0.0f, 0.0f );
+	mOriginX = 0;
+	mOriginY = 0;
+	mGeneration = 1;
+	dMemset( mStamps, 0, sizeof(mStamps) );
+	dMemset( mHeights, 0, sizeof(mHeights) );
+	dMemset( mHits, 0, sizeof(mHits) );
+	mRayCount = 0;
+}
+
+//-----------------------------------------------------------------------------
+// clear
+//-----------------------------------------------------------------------------
+void TerrainHeightCache::clear()
+{
+	mGeneration++;
+
+	// Stamps from before the wrap could match again, start over
+	if( mGeneration == 0 )
+	{
+		dMemset( mStamps, 0, sizeof(mStamps) );
+		mGeneration = 1;
+	}
+}
+
+//-----------------------------------------------------------------------------
+// update
+//-----------------------------------------------------------------------------
+void TerrainHeightCache::update( const Point3F &nodePos )
+{
+	const F32 threshold = MoveThreshold * CellSize;
+	if( mCentered && mFabs( nodePos.x - mCenter.x ) <= threshold && mFabs( nodePos.y - mCenter.y ) <= threshold )
+		return;
+
+	mCenter.set( nodePos.x, nodePos.y );
+	mOriginX = (S32)mFloor( nodePos.x / CellSize ) - GridSize / 2;
+	mOriginY = (S32)mFloor( nodePos.y / CellSize ) - GridSize / 2;
+	mCentered = true;
+	clear();
+}
+
+//-----------------------------------------------------------------------------
+// getHeight
+//-----------------------------------------------------------------------------
+F32 TerrainHeightCache::getHeight( F32 x, F32 y )
+{
+	const F32 gx = x / CellSize;
+	const F32 gy = y / CellSize;
+	const F32 fx = mFloor( gx );
+	const F32 fy = mFloor( gy );
+	const S32 ix = (S32)fx;
+	const S32 iy = (S32)fy;
+	const F32 tx = gx - fx;
+	const F32 ty = gy - fy;
+
+	// At the edges and holes of the terrain the missing heights would be
+	// blended in, the position is raycast instead
+	F32 h00, h10, h01, h11, height;
+	if( !getPoint( ix, iy, h00 ) || !getPoint( ix + 1, iy, h10 ) ||
+		!getPoint( ix, iy + 1, h01 ) || !getPoint( ix + 1, iy + 1, h11 ) )
+	{
+		castRay( x, y, height );
+		return height;
+	}
+
+	const F32 h0 = h00 + (h10 - h00) * tx;
+	const F32 h1 = h01 + (h11 - h01) * tx;
+	return h0 + (h1 - h0) * ty;
+}
+
+//-----------------------------------------------------------------------------
+// getPoint
+//-----------------------------------------------------------------------------
+bool TerrainHeightCache::getPoint( S32 x, S32 y, F32 &height )
+{
+	const S32 gx = x - mOriginX;
+	const S32 gy = y - mOriginY;
+	if( !mCentered || gx < 0 || gy < 0 || gx > GridSize || gy > GridSize )
+		return castRay( x * CellSize, y * CellSize, height );
+
+	const U32 idx = gy * PointsPerSide + gx;
+	if( mStamps[idx] != mGeneration )
+	{
+		mHits[idx] = castRay( x * CellSize, y * CellSize, mHeights[idx] );
+		mStamps[idx] = mGeneration;
+	}
+	height = mHeights[idx];
+	return mHits[idx];
+}
+
+//-----------------------------------------------------------------------------
+// castRay
+//-----------------------------------------------------------------------------
+bool TerrainHeightCache::castRay( F32 x, F32 y, F32 &height )
+{
+	mRayCount++;
+
+	Point3F startPnt( x, y, 10000.0f );
+	Point3F endPnt( x, y, -10000.0f );
+
+	RayInfo ri;
+	if( gClientContainer.castRay( startPnt, endPnt, TerrainObjectType, &ri ) )
+	{
+		height = ri.point.z;
+		return true;
+	}
+	height = 0.0f;
+	return false;
+}
@@ -0,0 +1,79 @@
+//-----------------------------------------------------------------------------
+// IPS Lite
+// @Author Lukas Joergensen, Fuzzy Void Studio 2012
+//-----------------------------------------------------------------------------
+
+#ifndef _H_TERRAIN_HEIGHT_CACHE
+#define _H_TERRAIN_HEIGHT_CACHE
+
+#ifndef _MPOINT3_H_
+#include "math/mPoint3.h"
+#endif
+
+//*****************************************************************************
+// Terrain Height Cache
+//
+// Terrain heights around an emitter node, used for the terz variable.
+// The heights are sampled on a grid of GridSize x GridSize cells of one
+// world unit, the default terrain square size, centered on the node. A grid
+// point is only sampled, with a vertical ray against the terrain, the first
+// time a lookup needs it. Lookups interpolate between the four grid points
+// around the position, so following the ground costs a lookup instead of a
+// ray per particle. When the node moves further than MoveThreshold cells
+// from the center of the grid, the grid is centered on the node again and
+// all samples are dropped. The cells are counted from the world origin and
+// the grid points outside the grid are raycast each time they are needed,
+// so a height never depends on where the grid was. Positions next to a grid
+// point whose ray missed the terrain, at its edges and holes, are raycast
+// directly.
+//*****************************************************************************
+class TerrainHeightCache
+{
+public:
+	enum
+	{
+		GridSize = 64,         ///< Cells along each side of the grid
+		MoveThreshold = 16,    ///< Cells the node can move before the grid is recentered
+	};
+
+	TerrainHeightCache();
+
+	/// Recenters the grid if the node moved too far, call before the lookups.
+	void update( const Point3F &nodePos );
+
+	/// World space height of the terrain below x, y. 0 if there is no terrain.
+	F32 getHeight( F32 x, F32 y );
+
+	/// Drops all samples, for example after the terrain was edited.
+	void clear();
+
+	/// Number of rays cast since the cache was created.
+	U32 getRayCount() const { return mRayCount; }
+
+private:
+	enum { PointsPerSide = GridSize + 1 };
+
+	/// Height of the grid point x, y, counted in cells from the world
+	/// origin, sampled if needed.
+	/// @return  False if there is no terrain at the point.
+	bool getPoint( S32 x, S32 y, F32 &height );
+
+	/// @return  False if the ray missed the terrain, height is then 0.
+	bool castRay( F32 x, F32 y, F32 &height );
+
+	bool mCentered;
+	Point2F mCenter;       ///< Node position the grid was centered on
+	S32 mOriginX;          ///< Cells from the world origin to the first point of the grid
+	S32 mOriginY;
+
+	/// A grid point is sampled if its stamp equals mGeneration, so clearing
+	/// the grid is a matter of incrementing mGeneration.
+	U32 mGeneration;
+	U32 mStamps[PointsPerSide * PointsPerSide];
+	F32 mHeights[PointsPerSide * PointsPerSide];
+	bool mHits[PointsPerSide * PointsPerSide];   ///< The ray of the point hit the terrain
+
+	U32 mRayCount;
+};
+
+#endif // _H_TERRAIN_HEIGHT_CACHE
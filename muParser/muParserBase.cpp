@@ -76,6 +76,7 @@ namespace mu
   ParserBase::ParserBase()
     :m_pParseFormula(&ParserBase::ParseString)
     ,m_vRPN()
+    ,m_Closures()
     ,m_vStringBuf()
     ,m_pTokenReader()
     ,m_FunDef()
@@ -86,11 +87,14 @@ namespace mu
     ,m_StrVarDef()
     ,m_VarDef()
     ,m_bBuiltInOp(true)
+    ,m_bCompile(true)
     ,m_sNameChars()
     ,m_sOprtChars()
     ,m_sInfixOprtChars()
     ,m_nIfElseCounter(0)
     ,m_vStackBuffer()
+    ,m_vBatchBuffer()
+    ,m_vBatchArgs()
     ,m_nFinalResultIdx(0)
   {
     InitTokenReader();
@@ -105,6 +109,7 @@ namespace mu
   ParserBase::ParserBase(const ParserBase &a_Parser)
     :m_pParseFormula(&ParserBase::ParseString)
     ,m_vRPN()
+    ,m_Closures()
     ,m_vStringBuf()
     ,m_pTokenReader()
     ,m_FunDef()
@@ -115,6 +120,7 @@ namespace mu
     ,m_StrVarDef()
     ,m_VarDef()
     ,m_bBuiltInOp(true)
+    ,m_bCompile(true)
     ,m_sNameChars()
     ,m_sOprtChars()
     ,m_sInfixOprtChars()
@@ -163,6 +169,7 @@ namespace mu
     m_ConstDef        = a_Parser.m_ConstDef;         // Copy user define constants
     m_VarDef          = a_Parser.m_VarDef;           // Copy user defined variables
     m_bBuiltInOp      = a_Parser.m_bBuiltInOp;
+    m_bCompile        = a_Parser.m_bCompile;
     m_vStringBuf      = a_Parser.m_vStringBuf;
     m_vStackBuffer    = a_Parser.m_vStackBuffer;
     m_nFinalResultIdx = a_Parser.m_nFinalResultIdx;
@@ -247,6 +254,7 @@ namespace mu
     m_pParseFormula = &ParserBase::ParseString;
     m_vStringBuf.clear();
     m_vRPN.clear();
+    m_Closures.clear();
     m_pTokenReader->ReInit();
     m_nIfElseCounter = 0;
   }
@@ -707,6 +715,44 @@ namespace mu
     return m_pTokenReader->GetUsedVar();
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Check if the expression reads a variable.
+      \param a_pVar Address of the variable
+      \throw ParserException if the expression can't be parsed.
+
+    Unlike GetUsedVar() this doesn't reset the parser to string parsing mode.
+    The bytecode is created if needed and searched for the variable, which
+    makes this cheap enough to call before every evaluation.
+  */
+  bool ParserBase::IsVarUsed(const value_type *a_pVar) const
+  {
+    if (m_pParseFormula==&ParserBase::ParseString)
+    {
+      CreateRPN();
+      CompileRPN();
+    }
+
+    for (const SToken *pTok = m_vRPN.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      switch (pTok->Cmd)
+      {
+      case cmVAR:
+      case cmVARMUL:
+      case cmVARPOW2:
+      case cmVARPOW3:
+      case cmVARPOW4:
+            if (pTok->Val.ptr==a_pVar)
+              return true;
+            break;
+
+      default:
+            break;
+      }
+    }
+
+    return false;
+  }
+
   //---------------------------------------------------------------------------
   /** \brief Return a map containing the used variables only. */
   const varmap_type& ParserBase::GetVar() const
@@ -1038,7 +1084,7 @@ namespace mu
                   continue;
 
       case  cmPOW: 
-              Stack[--sidx]  = MathImpl<value_type>::Pow(Stack[sidx], Stack[1+sidx]); ;
+              --sidx; Stack[sidx] = MathImpl<value_type>::Pow(Stack[sidx], Stack[1+sidx]);
               continue;
 
       case  cmLAND: --sidx; Stack[sidx]  = Stack[sidx] && Stack[sidx+1]; continue;
@@ -1178,6 +1224,269 @@ namespace mu
     return Stack[m_nFinalResultIdx];  
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Call a numeric function of the bytecode with arguments taken from a batch stack. 
+      \param pTok The function token
+      \param pArg Address of the first argument, the following arguments are nStride values apart
+      \param nStride Distance between two arguments
+      \param nOffset Index of the batch item (passed on to bulk functions)
+  */
+  static value_type CallBatchFun(const SToken *pTok, const value_type *pArg, int nStride, int nOffset)
+  {
+    value_type a[10];
+    int iArgCount = pTok->Fun.argc;
+    for (int i=0; i<iArgCount; ++i)
+      a[i] = pArg[i*nStride];
+
+    if (pTok->Cmd==cmFUNC_BULK)
+    {
+      switch(iArgCount)
+      {
+      case 0: return (*(bulkfun_type0 )pTok->Fun.ptr)(nOffset, 0);
+      case 1: return (*(bulkfun_type1 )pTok->Fun.ptr)(nOffset, 0, a[0]);
+      case 2: return (*(bulkfun_type2 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1]);
+      case 3: return (*(bulkfun_type3 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2]);
+      case 4: return (*(bulkfun_type4 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3]);
+      case 5: return (*(bulkfun_type5 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4]);
+      case 6: return (*(bulkfun_type6 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4], a[5]);
+      case 7: return (*(bulkfun_type7 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+      case 8: return (*(bulkfun_type8 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+      case 9: return (*(bulkfun_type9 )pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+      case 10:return (*(bulkfun_type10)pTok->Fun.ptr)(nOffset, 0, a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+      }
+    }
+    else
+    {
+      switch(iArgCount)
+      {
+      case 0: return (*(fun_type0 )pTok->Fun.ptr)();
+      case 1: return (*(fun_type1 )pTok->Fun.ptr)(a[0]);
+      case 2: return (*(fun_type2 )pTok->Fun.ptr)(a[0], a[1]);
+      case 3: return (*(fun_type3 )pTok->Fun.ptr)(a[0], a[1], a[2]);
+      case 4: return (*(fun_type4 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3]);
+      case 5: return (*(fun_type5 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4]);
+      case 6: return (*(fun_type6 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4], a[5]);
+      case 7: return (*(fun_type7 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+      case 8: return (*(fun_type8 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+      case 9: return (*(fun_type9 )pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+      case 10:return (*(fun_type10)pTok->Fun.ptr)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+      }
+    }
+
+    throw ParserError(ecINTERNAL_ERROR);
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the RPN for a whole batch at once. 
+
+      Same as ParseCmdCodeBulk but the stack holds a column of nBulkSize values
+      for every stack position, so each token is dispatched once per batch. 
+      Variables listed in a_pVars take their value from the batch, all other 
+      variables have the same value for every item. 
+      
+      The bytecode must not contain if-then-else or assignments.
+  */
+  void ParserBase::ParseCmdCodeBatch(value_type *results, int nBulkSize, const SBatchVar *a_pVars, int a_iNumVars) const
+  {
+    const int n = nBulkSize;
+    m_vBatchBuffer.resize((m_vRPN.GetMaxStackSize() + 1) * n);
+    value_type *Stack = &m_vBatchBuffer[0];
+    int sidx(0);
+
+// Loop a binary operation over the two topmost stack columns
+#define MUP_BATCH_BINOP(EXPR)                       \
+    {                                               \
+      --sidx;                                       \
+      value_type *a = &Stack[sidx * n];             \
+      const value_type *b = a + n;                  \
+      for (int i=0; i<n; ++i)                       \
+        a[i] = EXPR;                                \
+      continue;                                     \
+    }
+
+    for (const SToken *pTok = m_vRPN.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      // values of a variable token, NULL if the variable is not part of the batch
+      const value_type *pVarValues = NULL;
+      if (pTok->Cmd==cmVAR || pTok->Cmd==cmVARPOW2 || pTok->Cmd==cmVARPOW3 || pTok->Cmd==cmVARPOW4 || pTok->Cmd==cmVARMUL)
+      {
+        for (int v=0; v<a_iNumVars; ++v)
+        {
+          if (a_pVars[v].pVar==pTok->Val.ptr)
+          {
+            pVarValues = a_pVars[v].pValues;
+            break;
+          }
+        }
+      }
+
+      switch (pTok->Cmd)
+      {
+      // built in binary operators
+      case  cmLE:   MUP_BATCH_BINOP(a[i] <= b[i])
+      case  cmGE:   MUP_BATCH_BINOP(a[i] >= b[i])
+      case  cmNEQ:  MUP_BATCH_BINOP(a[i] != b[i])
+      case  cmEQ:   MUP_BATCH_BINOP(a[i] == b[i])
+      case  cmLT:   MUP_BATCH_BINOP(a[i] < b[i])
+      case  cmGT:   MUP_BATCH_BINOP(a[i] > b[i])
+      case  cmADD:  MUP_BATCH_BINOP(a[i] + b[i])
+      case  cmSUB:  MUP_BATCH_BINOP(a[i] - b[i])
+      case  cmMUL:  MUP_BATCH_BINOP(a[i] * b[i])
+      case  cmDIV:  
+  #if defined(MUP_MATH_EXCEPTIONS)
+                  for (int i=0; i<n; ++i)
+                    if (Stack[sidx * n + i]==0)
+                      Error(ecDIV_BY_ZERO);
+  #endif
+                    MUP_BATCH_BINOP(a[i] / b[i])
+      case  cmPOW:  MUP_BATCH_BINOP(MathImpl<value_type>::Pow(a[i], b[i]))
+      case  cmLAND: MUP_BATCH_BINOP(a[i] && b[i])
+      case  cmLOR:  MUP_BATCH_BINOP(a[i] || b[i])
+
+      // value and variable tokens
+      case  cmVAL:
+      case  cmVAR:
+      case  cmVARPOW2:
+      case  cmVARPOW3:
+      case  cmVARPOW4:
+      case  cmVARMUL:
+            {
+              value_type *r = &Stack[++sidx * n];
+              if (pVarValues)
+              {
+                value_type buf;
+                switch (pTok->Cmd)
+                {
+                case cmVAR:     for (int i=0; i<n; ++i) r[i] = pVarValues[i]; break;
+                case cmVARPOW2: for (int i=0; i<n; ++i) { buf = pVarValues[i]; r[i] = buf*buf; } break;
+                case cmVARPOW3: for (int i=0; i<n; ++i) { buf = pVarValues[i]; r[i] = buf*buf*buf; } break;
+                case cmVARPOW4: for (int i=0; i<n; ++i) { buf = pVarValues[i]; r[i] = buf*buf*buf*buf; } break;
+                default:        for (int i=0; i<n; ++i) r[i] = pVarValues[i] * pTok->Val.data + pTok->Val.data2; break;
+                }
+              }
+              else
+              {
+                // Constant for the whole batch, calculate it once
+                value_type val, buf;
+                switch (pTok->Cmd)
+                {
+                case cmVAL:     val = pTok->Val.data2; break;
+                case cmVAR:     val = *pTok->Val.ptr; break;
+                case cmVARPOW2: buf = *pTok->Val.ptr; val = buf*buf; break;
+                case cmVARPOW3: buf = *pTok->Val.ptr; val = buf*buf*buf; break;
+                case cmVARPOW4: buf = *pTok->Val.ptr; val = buf*buf*buf*buf; break;
+                default:        val = *pTok->Val.ptr * pTok->Val.data + pTok->Val.data2; break;
+                }
+                for (int i=0; i<n; ++i)
+                  r[i] = val;
+              }
+            }
+            continue;
+
+      // Next is treatment of numeric functions
+      case  cmFUNC:
+            {
+              int iArgCount = pTok->Fun.argc;
+
+              // The most common functions get a loop of their own
+              if (iArgCount==1)
+              {
+                value_type *r = &Stack[sidx * n];
+                fun_type1 pFun = (fun_type1)pTok->Fun.ptr;
+                for (int i=0; i<n; ++i)
+                  r[i] = (*pFun)(r[i]);
+                continue;
+              }
+
+              if (iArgCount==2)
+              {
+                --sidx;
+                value_type *r = &Stack[sidx * n];
+                const value_type *b = r + n;
+                fun_type2 pFun = (fun_type2)pTok->Fun.ptr;
+                for (int i=0; i<n; ++i)
+                  r[i] = (*pFun)(r[i], b[i]);
+                continue;
+              }
+
+              if (iArgCount<0)
+              {
+                // function with variable arguments store the number as a negative value
+                // the arguments are gathered into a row for each item
+                int nArgs = -iArgCount;
+                sidx -= nArgs - 1;
+                value_type *r = &Stack[sidx * n];
+                if ((int)m_vBatchArgs.size() < nArgs)
+                  m_vBatchArgs.resize(nArgs);
+                value_type *vArg = &m_vBatchArgs[0];
+                for (int i=0; i<n; ++i)
+                {
+                  for (int k=0; k<nArgs; ++k)
+                    vArg[k] = r[k * n + i];
+                  r[i] = (*(multfun_type)pTok->Fun.ptr)(vArg, nArgs);
+                }
+                continue;
+              }
+
+              if (iArgCount==0)
+                ++sidx;
+              else
+                sidx -= iArgCount - 1;
+
+              value_type *r = &Stack[sidx * n];
+              for (int i=0; i<n; ++i)
+                r[i] = CallBatchFun(pTok, r + i, n, i);
+              continue;
+            }
+
+      // Next is treatment of string functions
+      case  cmFUNC_STR:
+            {
+              sidx -= pTok->Fun.argc -1;
+
+              // The index of the string argument in the string table
+              int iIdxStack = pTok->Fun.idx;  
+              MUP_ASSERT( iIdxStack>=0 && iIdxStack<(int)m_vStringBuf.size() );
+              const char_type *szArg = m_vStringBuf[iIdxStack].c_str();
+
+              value_type *r = &Stack[sidx * n];
+              switch(pTok->Fun.argc)  // switch according to argument count
+              {
+              case 0: for (int i=0; i<n; ++i) r[i] = (*(strfun_type1)pTok->Fun.ptr)(szArg); continue;
+              case 1: for (int i=0; i<n; ++i) r[i] = (*(strfun_type2)pTok->Fun.ptr)(szArg, r[i]); continue;
+              case 2: for (int i=0; i<n; ++i) r[i] = (*(strfun_type3)pTok->Fun.ptr)(szArg, r[i], r[n + i]); continue;
+              }
+
+              continue;
+            }
+
+      case  cmFUNC_BULK:
+            {
+              int iArgCount = pTok->Fun.argc;
+              if (iArgCount==0)
+                ++sidx;
+              else
+                sidx -= iArgCount - 1;
+
+              value_type *r = &Stack[sidx * n];
+              for (int i=0; i<n; ++i)
+                r[i] = CallBatchFun(pTok, r + i, n, i);
+              continue;
+            }
+
+      default:
+            Error(ecINTERNAL_ERROR, 3);
+            return;
+      } // switch CmdCode
+    } // for all bytecode tokens
+
+#undef MUP_BATCH_BINOP
+
+    const value_type *pResult = &Stack[m_nFinalResultIdx * n];
+    for (int i=0; i<n; ++i)
+      results[i] = pResult[i];
+  }
+
   //---------------------------------------------------------------------------
   void ParserBase::CreateRPN() const
   {
@@ -1423,10 +1732,33 @@ namespace mu
   value_type ParserBase::ParseString() const
   {
     CreateRPN();
-    m_pParseFormula = &ParserBase::ParseCmdCode;
+    CompileRPN();
     return (this->*m_pParseFormula)(); 
   }
 
+  //---------------------------------------------------------------------------
+  /** \brief Select the parse function for the bytecode.
+
+    The bytecode is compiled into a closure tree if the compiler is enabled
+    and the expression can be compiled, #m_pParseFormula is set to 
+    ParseCompiled() in that case. Otherwise the bytecode is interpreted by 
+    ParseCmdCode().
+  */
+  void ParserBase::CompileRPN() const
+  {
+    if (m_bCompile && m_Closures.Compile(m_vRPN))
+      m_pParseFormula = &ParserBase::ParseCompiled;
+    else
+      m_pParseFormula = &ParserBase::ParseCmdCode;
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the closure tree created by CompileRPN(). */
+  value_type ParserBase::ParseCompiled() const
+  {
+    return m_Closures.Eval();
+  }
+
   //---------------------------------------------------------------------------
   /** \brief Create an error containing the parse error position.
 
@@ -1540,6 +1872,21 @@ namespace mu
     ReInit();
   }
 
+  //------------------------------------------------------------------------------
+  /** \brief Enable or disable compiling the bytecode into a closure tree. 
+      \post Resets the parser to string parser mode.
+      \throw nothrow
+      \sa ParserClosureTree
+
+    The closure tree gives the same results as the bytecode interpreter, 
+    disabling it is meant for comparing the two.
+  */
+  void ParserBase::EnableCompiler(bool a_bIsOn)
+  {
+    m_bCompile = a_bIsOn;
+    ReInit();
+  }
+
   //---------------------------------------------------------------------------
   /** \brief Enable the dumping of bytecode amd stack content on the console. 
       \param bDumpCmd Flag to enable dumping of the current bytecode to the console.
@@ -1671,7 +2018,18 @@ namespace mu
   */
   value_type* ParserBase::Eval(int &nStackSize) const
   {
-    (this->*m_pParseFormula)(); 
+    if (m_pParseFormula==&ParserBase::ParseString)
+    {
+      CreateRPN();
+      CompileRPN();
+    }
+
+    // The closure tree doesn't use the stack, run the bytecode to fill it
+    if (m_pParseFormula==&ParserBase::ParseCompiled)
+      ParseCmdCode();
+    else
+      (this->*m_pParseFormula)(); 
+
     nStackSize = m_nFinalResultIdx;
 
     // (for historic reasons the stack starts at position 1)
@@ -1766,4 +2124,62 @@ namespace mu
 #endif
 
   }
+
+  //---------------------------------------------------------------------------
+  /** \brief Evaluate the expression for a batch of variable values.
+      \param [out] results Array receiving one result per batch item
+      \param nBulkSize Number of batch items
+      \param a_pVars The variables that change from item to item
+      \param a_iNumVars Number of entries in a_pVars
+
+      Unlike Eval(value_type*, int) only the listed variables take a different
+      value for every item, all other variables keep their current value. The
+      results are the same as setting the variables and calling Eval() for 
+      every item, but each bytecode token is only dispatched once per batch.
+      Expressions using if-then-else or assignments are evaluated item by item.
+      The listed variables keep their values.
+  */
+  void ParserBase::Eval(value_type *results, int nBulkSize, const SBatchVar *a_pVars, int a_iNumVars) const
+  {
+    if (nBulkSize<=0)
+      return;
+
+    // Create the bytecode if this hasn't been done yet
+    if (m_pParseFormula==&ParserBase::ParseString)
+    {
+      CreateRPN();
+      CompileRPN();
+    }
+
+    bool bByItem = false;
+    for (const SToken *pTok = m_vRPN.GetBase(); pTok->Cmd!=cmEND ; ++pTok)
+    {
+      if (pTok->Cmd==cmIF || pTok->Cmd==cmELSE || pTok->Cmd==cmENDIF || pTok->Cmd==cmASSIGN)
+      {
+        bByItem = true;
+        break;
+      }
+    }
+
+    if (!bByItem)
+    {
+      ParseCmdCodeBatch(results, nBulkSize, a_pVars, a_iNumVars);
+      return;
+    }
+
+    // Branches and assignments can't be evaluated token by token
+    valbuf_type vSaved(a_iNumVars);
+    for (int v=0; v<a_iNumVars; ++v)
+      vSaved[v] = *a_pVars[v].pVar;
+
+    for (int i=0; i<nBulkSize; ++i)
+    {
+      for (int v=0; v<a_iNumVars; ++v)
+        *a_pVars[v].pVar = a_pVars[v].pValues[i];
+      results[i] = ParseCmdCode();
+    }
+
+    for (int v=0; v<a_iNumVars; ++v)
+      *a_pVars[v].pVar = vSaved[v];
+  }
 } // namespace mu
@@ -38,6 +38,7 @@
 #include "muParserStack.h"
 #include "muParserTokenReader.h"
 #include "muParserBytecode.h"
+#include "muParserClosure.h"
 #include "muParserError.h"
 
 
@@ -106,6 +107,7 @@ private:
 	  value_type  Eval() const;
     value_type* Eval(int &nStackSize) const;
     void Eval(value_type *results, int nBulkSize);
+    void Eval(value_type *results, int nBulkSize, const SBatchVar *a_pVars, int a_iNumVars) const;
 
     int GetNumResults() const;
 
@@ -117,6 +119,7 @@ private:
     void ResetLocale();
 
     void EnableOptimizer(bool a_bIsOn=true);
+    void EnableCompiler(bool a_bIsOn=true);
     void EnableBuiltInOprt(bool a_bIsOn=true);
 
     bool HasBuiltInOprt() const;
@@ -155,6 +158,7 @@ private:
     
     void RemoveVar(const string_type &a_strVarName);
     const varmap_type& GetUsedVar() const;
+    bool IsVarUsed(const value_type *a_pVar) const;
     const varmap_type& GetVar() const;
     const valmap_type& GetConst() const;
     const string_type& GetExpr() const;
@@ -260,10 +264,13 @@ private:
     EOprtAssociativity GetOprtAssociativity(const token_type &a_Tok) const;
 
     void CreateRPN() const;
+    void CompileRPN() const;
 
     value_type ParseString() const; 
     value_type ParseCmdCode() const;
+    value_type ParseCompiled() const;
     value_type ParseCmdCodeBulk(int nOffset, int nThreadID) const;
+    void ParseCmdCodeBatch(value_type *results, int nBulkSize, const SBatchVar *a_pVars, int a_iNumVars) const;
 
     void  CheckName(const string_type &a_strName, const string_type &a_CharSet) const;
     void  CheckOprt(const string_type &a_sName,
@@ -279,6 +286,7 @@ private:
     */
     mutable ParseFunction  m_pParseFormula;
     mutable ParserByteCode m_vRPN;        ///< The Bytecode class.
+    mutable ParserClosureTree m_Closures; ///< The bytecode compiled into a closure tree
     mutable stringbuf_type  m_vStringBuf; ///< String buffer, used for storing string function arguments
     stringbuf_type  m_vStringVarBuf;
 
@@ -293,6 +301,7 @@ private:
     varmap_type  m_VarDef;         ///< user defind variables.
 
     bool m_bBuiltInOp;             ///< Flag that can be used for switching built in operators on and off
+    bool m_bCompile;               ///< Flag that can be used for switching the closure compiler on and off
 
     string_type m_sNameChars;      ///< Charset for names
     string_type m_sOprtChars;      ///< Charset for postfix/ binary operator tokens
@@ -302,6 +311,8 @@ private:
 
     // items merely used for caching state information
     mutable valbuf_type m_vStackBuffer; ///< This is merely a buffer used for the stack in the cmd parsing routine
+    mutable valbuf_type m_vBatchBuffer; ///< Stack used by the batch parsing routine, one column per stack position
+    mutable valbuf_type m_vBatchArgs;   ///< Arguments of a function with variable arguments in the batch parsing routine
     mutable int m_nFinalResultIdx;
 };
 
@@ -0,0 +1,441 @@
+/*
+                 __________                                      
+    _____   __ __\______   \_____  _______  ______  ____ _______ 
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|   
+        \/                       \/            \/      \/        
+  Copyright (C) 2004-2012 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this 
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify, 
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or 
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+#include "muParserClosure.h"
+
+#include <cassert>
+#include <vector>
+
+#include "muParserDef.h"
+#include "muParserError.h"
+#include "muParserTemplateMagic.h"
+
+/** \file
+    \brief Implementation of the closure tree.
+*/
+
+
+namespace mu
+{
+  typedef ParserClosureTree::SNode SNode;
+  typedef ParserClosureTree::eval_fun eval_fun;
+
+  /** \brief How an operand is read by the specialized evaluation functions. */
+  enum EOperandKind
+  {
+    okNODE = 0,   ///< Call the evaluation function of the operand
+    okVAL  = 1,   ///< The operand is a constant, read its value
+    okVAR  = 2    ///< The operand is a variable, read the variable
+  };
+
+  //---------------------------------------------------------------------------
+  // Leaf nodes
+
+  static value_type EvalVal(const SNode *a_pNode)
+  {
+    return a_pNode->fVal;
+  }
+
+  static value_type EvalVar(const SNode *a_pNode)
+  {
+    return *a_pNode->pVar;
+  }
+
+  static value_type EvalVarMul(const SNode *a_pNode)
+  {
+    return *a_pNode->pVar * a_pNode->fVal + a_pNode->fVal2;
+  }
+
+  static value_type EvalVarPow2(const SNode *a_pNode)
+  {
+    value_type buf = *a_pNode->pVar;
+    return buf*buf;
+  }
+
+  static value_type EvalVarPow3(const SNode *a_pNode)
+  {
+    value_type buf = *a_pNode->pVar;
+    return buf*buf*buf;
+  }
+
+  static value_type EvalVarPow4(const SNode *a_pNode)
+  {
+    value_type buf = *a_pNode->pVar;
+    return buf*buf*buf*buf;
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Read an operand. */
+  template<int Kind>
+  inline value_type Fetch(const SNode *a_pArg)
+  {
+    switch(Kind)
+    {
+    case okVAL: return a_pArg->fVal;
+    case okVAR: return *a_pArg->pVar;
+    default:    return a_pArg->pEval(a_pArg);
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Apply a built in binary operator, same as the bytecode interpreter. */
+  template<ECmdCode Op>
+  inline value_type ApplyOprt(value_type x, value_type y)
+  {
+    switch(Op)
+    {
+    case cmLE:   return x <= y;
+    case cmGE:   return x >= y;
+    case cmNEQ:  return x != y;
+    case cmEQ:   return x == y;
+    case cmLT:   return x < y;
+    case cmGT:   return x > y;
+    case cmADD:  return x + y;
+    case cmSUB:  return x - y;
+    case cmMUL:  return x * y;
+    case cmDIV:  
+  #if defined(MUP_MATH_EXCEPTIONS)
+                 if (y==0)
+                   throw ParserError(ecDIV_BY_ZERO);
+  #endif
+                 return x / y;
+    case cmPOW:  return MathImpl<value_type>::Pow(x, y);
+    case cmLAND: return x && y;
+    case cmLOR:  return x || y;
+    default:     return 0;
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Operators and functions
+  //
+  // The left operand is always evaluated before the right one, as in the 
+  // bytecode interpreter.
+
+  template<ECmdCode Op, int Left, int Right>
+  static value_type EvalOprt(const SNode *a_pNode)
+  {
+    value_type x = Fetch<Left>(a_pNode->pArg1);
+    value_type y = Fetch<Right>(a_pNode->pArg2);
+    return ApplyOprt<Op>(x, y);
+  }
+
+  static value_type EvalFun0(const SNode *a_pNode)
+  {
+    return (*(fun_type0)a_pNode->pFun)();
+  }
+
+  template<int Arg>
+  static value_type EvalFun1(const SNode *a_pNode)
+  {
+    return (*(fun_type1)a_pNode->pFun)(Fetch<Arg>(a_pNode->pArg1));
+  }
+
+  template<int Arg1, int Arg2>
+  static value_type EvalFun2(const SNode *a_pNode)
+  {
+    value_type x = Fetch<Arg1>(a_pNode->pArg1);
+    value_type y = Fetch<Arg2>(a_pNode->pArg2);
+    return (*(fun_type2)a_pNode->pFun)(x, y);
+  }
+
+  /** \brief Functions with 3 to 10 arguments and functions with a variable number of arguments. */
+  static value_type EvalFunN(const SNode *a_pNode)
+  {
+    value_type a[10];
+    int iArgCount = (a_pNode->iArgc<0) ? -a_pNode->iArgc : a_pNode->iArgc;
+    for (int i=0; i<iArgCount; ++i)
+      a[i] = a_pNode->pArgs[i]->pEval(a_pNode->pArgs[i]);
+
+    switch(a_pNode->iArgc)
+    {
+    case 3: return (*(fun_type3 )a_pNode->pFun)(a[0], a[1], a[2]);
+    case 4: return (*(fun_type4 )a_pNode->pFun)(a[0], a[1], a[2], a[3]);
+    case 5: return (*(fun_type5 )a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4]);
+    case 6: return (*(fun_type6 )a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4], a[5]);
+    case 7: return (*(fun_type7 )a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4], a[5], a[6]);
+    case 8: return (*(fun_type8 )a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7]);
+    case 9: return (*(fun_type9 )a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8]);
+    case 10:return (*(fun_type10)a_pNode->pFun)(a[0], a[1], a[2], a[3], a[4], a[5], a[6], a[7], a[8], a[9]);
+    default:return (*(multfun_type)a_pNode->pFun)(a, iArgCount);
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  // Selection of the specialized evaluation functions
+
+  static int GetOperandKind(const SNode *a_pNode)
+  {
+    if (a_pNode->pEval==&EvalVal)
+      return okVAL;
+    if (a_pNode->pEval==&EvalVar)
+      return okVAR;
+    return okNODE;
+  }
+
+  template<ECmdCode Op>
+  static eval_fun SelectOprt(int a_iLeft, int a_iRight)
+  {
+    static const eval_fun f[3][3] = 
+    {
+      { &EvalOprt<Op, okNODE, okNODE>, &EvalOprt<Op, okNODE, okVAL>, &EvalOprt<Op, okNODE, okVAR> },
+      { &EvalOprt<Op, okVAL,  okNODE>, &EvalOprt<Op, okVAL,  okVAL>, &EvalOprt<Op, okVAL,  okVAR> },
+      { &EvalOprt<Op, okVAR,  okNODE>, &EvalOprt<Op, okVAR,  okVAL>, &EvalOprt<Op, okVAR,  okVAR> }
+    };
+    return f[a_iLeft][a_iRight];
+  }
+
+  static eval_fun SelectFun1(int a_iArg)
+  {
+    static const eval_fun f[3] = { &EvalFun1<okNODE>, &EvalFun1<okVAL>, &EvalFun1<okVAR> };
+    return f[a_iArg];
+  }
+
+  static eval_fun SelectFun2(int a_iArg1, int a_iArg2)
+  {
+    static const eval_fun f[3][3] = 
+    {
+      { &EvalFun2<okNODE, okNODE>, &EvalFun2<okNODE, okVAL>, &EvalFun2<okNODE, okVAR> },
+      { &EvalFun2<okVAL,  okNODE>, &EvalFun2<okVAL,  okVAL>, &EvalFun2<okVAL,  okVAR> },
+      { &EvalFun2<okVAR,  okNODE>, &EvalFun2<okVAR,  okVAL>, &EvalFun2<okVAR,  okVAR> }
+    };
+    return f[a_iArg1][a_iArg2];
+  }
+
+  //---------------------------------------------------------------------------
+  ParserClosureTree::ParserClosureTree()
+    :m_vNodes()
+    ,m_vArgs()
+    ,m_pRoot(0)
+  {}
+
+  //---------------------------------------------------------------------------
+  /** \brief Copy constructor. 
+    
+    The nodes point to each other, so they are not copied. The copy has to 
+    be compiled again.
+  */
+  ParserClosureTree::ParserClosureTree(const ParserClosureTree &)
+    :m_vNodes()
+    ,m_vArgs()
+    ,m_pRoot(0)
+  {}
+
+  //---------------------------------------------------------------------------
+  /** \brief Assignment operator, clears the tree. 
+      \sa ParserClosureTree(const ParserClosureTree&)
+  */
+  ParserClosureTree& ParserClosureTree::operator=(const ParserClosureTree &)
+  {
+    clear();
+    return *this;
+  }
+
+  //---------------------------------------------------------------------------
+  void ParserClosureTree::clear()
+  {
+    m_vNodes.clear();
+    m_vArgs.clear();
+    m_pRoot = 0;
+  }
+
+  //---------------------------------------------------------------------------
+  ParserClosureTree::SNode* ParserClosureTree::AddNode(eval_fun a_pEval)
+  {
+    // The storage is reserved in Compile, so the node addresses stay valid
+    assert(m_vNodes.size()<m_vNodes.capacity());
+
+    SNode node;
+    node.pEval = a_pEval;
+    node.pArg1 = 0;
+    node.pArg2 = 0;
+    node.pArgs = 0;
+    node.pVar  = 0;
+    node.fVal  = 0;
+    node.fVal2 = 0;
+    node.pFun  = 0;
+    node.iArgc = 0;
+    m_vNodes.push_back(node);
+    return &m_vNodes.back();
+  }
+
+  //---------------------------------------------------------------------------
+  /** \brief Compile the bytecode into a closure tree.
+      \param a_ByteCode Finalized bytecode
+      \return true if the bytecode was compiled, false if it contains commands
+              the tree doesn't support. The tree is empty in that case.
+  */
+  bool ParserClosureTree::Compile(const ParserByteCode &a_ByteCode)
+  {
+    clear();
+
+    // Every token creates at most one node and consumes at most one argument entry
+    m_vNodes.reserve(a_ByteCode.GetSize());
+    m_vArgs.reserve(a_ByteCode.GetSize());
+
+    std::vector<const SNode*> stNode;
+    for (const SToken *pTok = a_ByteCode.GetBase(); pTok->Cmd!=cmEND; ++pTok)
+    {
+      SNode *pNode = 0;
+
+      switch (pTok->Cmd)
+      {
+      case cmLE:
+      case cmGE:
+      case cmNEQ:
+      case cmEQ:
+      case cmLT:
+      case cmGT:
+      case cmADD:
+      case cmSUB:
+      case cmMUL:
+      case cmDIV:
+      case cmPOW:
+      case cmLAND:
+      case cmLOR:
+            {
+              if (stNode.size()<2)
+                break;
+
+              const SNode *pRight = stNode.back(); stNode.pop_back();
+              const SNode *pLeft  = stNode.back(); stNode.pop_back();
+              int iLeft  = GetOperandKind(pLeft);
+              int iRight = GetOperandKind(pRight);
+
+              eval_fun pEval = 0;
+              switch (pTok->Cmd)
+              {
+              case cmLE:   pEval = SelectOprt<cmLE>  (iLeft, iRight); break;
+              case cmGE:   pEval = SelectOprt<cmGE>  (iLeft, iRight); break;
+              case cmNEQ:  pEval = SelectOprt<cmNEQ> (iLeft, iRight); break;
+              case cmEQ:   pEval = SelectOprt<cmEQ>  (iLeft, iRight); break;
+              case cmLT:   pEval = SelectOprt<cmLT>  (iLeft, iRight); break;
+              case cmGT:   pEval = SelectOprt<cmGT>  (iLeft, iRight); break;
+              case cmADD:  pEval = SelectOprt<cmADD> (iLeft, iRight); break;
+              case cmSUB:  pEval = SelectOprt<cmSUB> (iLeft, iRight); break;
+              case cmMUL:  pEval = SelectOprt<cmMUL> (iLeft, iRight); break;
+              case cmDIV:  pEval = SelectOprt<cmDIV> (iLeft, iRight); break;
+              case cmPOW:  pEval = SelectOprt<cmPOW> (iLeft, iRight); break;
+              case cmLAND: pEval = SelectOprt<cmLAND>(iLeft, iRight); break;
+              default:     pEval = SelectOprt<cmLOR> (iLeft, iRight); break;
+              }
+
+              pNode = AddNode(pEval);
+              pNode->pArg1 = pLeft;
+              pNode->pArg2 = pRight;
+            }
+            break;
+
+      case cmVAL:
+            pNode = AddNode(&EvalVal);
+            pNode->fVal = pTok->Val.data2;
+            break;
+
+      case cmVAR:
+            pNode = AddNode(&EvalVar);
+            pNode->pVar = pTok->Val.ptr;
+            break;
+
+      case cmVARMUL:
+            pNode = AddNode(&EvalVarMul);
+            pNode->pVar  = pTok->Val.ptr;
+            pNode->fVal  = pTok->Val.data;
+            pNode->fVal2 = pTok->Val.data2;
+            break;
+
+      case cmVARPOW2:
+      case cmVARPOW3:
+      case cmVARPOW4:
+            pNode = AddNode( (pTok->Cmd==cmVARPOW2) ? &EvalVarPow2 : 
+                             (pTok->Cmd==cmVARPOW3) ? &EvalVarPow3 : &EvalVarPow4 );
+            pNode->pVar = pTok->Val.ptr;
+            break;
+
+      case cmFUNC:
+            {
+              int iArgc = pTok->Fun.argc;
+              int iArgCount = (iArgc<0) ? -iArgc : iArgc;
+              if (iArgCount>10 || (int)stNode.size()<iArgCount)
+                break;
+
+              if (iArgc==0)
+              {
+                pNode = AddNode(&EvalFun0);
+              }
+              else if (iArgc==1)
+              {
+                const SNode *pArg = stNode.back(); stNode.pop_back();
+                pNode = AddNode(SelectFun1(GetOperandKind(pArg)));
+                pNode->pArg1 = pArg;
+              }
+              else if (iArgc==2)
+              {
+                const SNode *pArg2 = stNode.back(); stNode.pop_back();
+                const SNode *pArg1 = stNode.back(); stNode.pop_back();
+                pNode = AddNode(SelectFun2(GetOperandKind(pArg1), GetOperandKind(pArg2)));
+                pNode->pArg1 = pArg1;
+                pNode->pArg2 = pArg2;
+              }
+              else
+              {
+                // Move the operands from the stack into the argument list
+                std::size_t iFirst = m_vArgs.size();
+                m_vArgs.insert(m_vArgs.end(), stNode.end() - iArgCount, stNode.end());
+                stNode.resize(stNode.size() - iArgCount);
+                pNode = AddNode(&EvalFunN);
+                pNode->pArgs = &m_vArgs[iFirst];
+              }
+
+              pNode->pFun  = pTok->Fun.ptr;
+              pNode->iArgc = iArgc;
+            }
+            break;
+
+      default:
+            // if-then-else, assignments, string and bulk functions are left
+            // to the bytecode interpreter
+            break;
+      }
+
+      if (!pNode)
+      {
+        clear();
+        return false;
+      }
+
+      stNode.push_back(pNode);
+    }
+
+    // Comma separated expressions give more than one result
+    if (stNode.size()!=1)
+    {
+      clear();
+      return false;
+    }
+
+    m_pRoot = stNode.back();
+    return true;
+  }
+} // namespace mu
@@ -0,0 +1,104 @@
+/*
+                 __________                                      
+    _____   __ __\______   \_____  _______  ______  ____ _______ 
+   /     \ |  |  \|     ___/\__  \ \_  __ \/  ___/_/ __ \\_  __ \
+  |  Y Y  \|  |  /|    |     / __ \_|  | \/\___ \ \  ___/ |  | \/
+  |__|_|  /|____/ |____|    (____  /|__|  /____  > \___  >|__|   
+        \/                       \/            \/      \/        
+  Copyright (C) 2004-2012 Ingo Berg
+
+  Permission is hereby granted, free of charge, to any person obtaining a copy of this 
+  software and associated documentation files (the "Software"), to deal in the Software
+  without restriction, including without limitation the rights to use, copy, modify, 
+  merge, publish, distribute, sublicense, and/or sell copies of the Software, and to 
+  permit persons to whom the Software is furnished to do so, subject to the following conditions:
+
+  The above copyright notice and this permission notice shall be included in all copies or 
+  substantial portions of the Software.
+
+  THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR IMPLIED, INCLUDING BUT
+  NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, FITNESS FOR A PARTICULAR PURPOSE AND 
+  NONINFRINGEMENT. IN NO EVENT SHALL THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, 
+  DAMAGES OR OTHER LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM, 
+  OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE SOFTWARE. 
+*/
+
+#ifndef MU_PARSER_CLOSURE_H
+#define MU_PARSER_CLOSURE_H
+
+#include <vector>
+
+#include "muParserDef.h"
+#include "muParserBytecode.h"
+
+/** \file
+    \brief Definition of the closure tree, the compiled form of the bytecode.
+*/
+
+
+namespace mu
+{
+  /** \brief Compiled form of the bytecode.
+
+    The RPN of a finalized ParserByteCode is turned into a tree of nodes. Each
+    node holds a pointer to a function that evaluates the node, calling the
+    evaluation functions of its operands directly. There is no value stack and
+    no switch over the command codes. The evaluation functions are generated 
+    from templates, with specialized versions for the common shapes like a 
+    function of a variable (sin(t)) or an operator with a constant operand.
+
+    Bytecode with if-then-else, assignments, string functions, bulk functions
+    or several comma separated results can't be compiled. Those expressions 
+    are left to the bytecode interpreter.
+
+    \author (C) 2004-2012 Ingo Berg 
+  */
+  class ParserClosureTree
+  {
+  public:
+
+    struct SNode;
+
+    /** \brief Function evaluating a node. */
+    typedef value_type (*eval_fun)(const SNode *a_pNode);
+
+    /** \brief Node of the tree. */
+    struct SNode
+    {
+      eval_fun pEval;               ///< Evaluates this node
+      const SNode *pArg1;           ///< First operand
+      const SNode *pArg2;           ///< Second operand
+      const SNode * const *pArgs;   ///< All operands of functions with more than two arguments
+      value_type *pVar;             ///< Variable of variable nodes
+      value_type fVal;              ///< Value of constants, factor of cmVARMUL, constant operand
+      value_type fVal2;             ///< Offset of cmVARMUL
+      generic_fun_type pFun;        ///< Callback of function nodes
+      int iArgc;                    ///< Number of arguments of function nodes
+    };
+
+    ParserClosureTree();
+    ParserClosureTree(const ParserClosureTree &a_Tree);
+    ParserClosureTree& operator=(const ParserClosureTree &a_Tree);
+
+    bool Compile(const ParserByteCode &a_ByteCode);
+    void clear();
+
+    /** \brief Evaluate the compiled expression. 
+        \pre Compile() succeeded.
+    */
+    value_type Eval() const
+    {
+      return m_pRoot->pEval(m_pRoot);
+    }
+
+  private:
+
+    SNode* AddNode(eval_fun a_pEval);
+
+    std::vector<SNode> m_vNodes;         ///< Storage of the nodes
+    std::vector<const SNode*> m_vArgs;   ///< Operand lists of functions with more than two arguments
+    const SNode *m_pRoot;                ///< The node giving the result
+  };
+} // namespace mu
+
+#endif
@@ -274,6 +274,15 @@ namespace mu
   /** \brief Type for assigning a string name to an index in the internal string table. */
   typedef std::map<string_type, std::size_t> strmap_type;
 
+  /** \brief A variable taking a different value for every item of a batch evaluation. 
+      \sa ParserBase::Eval(value_type*, int, const SBatchVar*, int)
+  */
+  struct SBatchVar
+  {
+    value_type *pVar;           ///< Address of the variable as passed to DefineVar
+    const value_type *pValues;  ///< One value per batch item
+  };
+
   // Parser callbacks
   
   /** \brief Callback type used for functions without arguments. */
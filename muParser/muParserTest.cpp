@@ -551,6 +551,12 @@ namespace mu
         for (idx=0; item!=UsedVar.end(); ++item)
           if (&vVarVal[idx++]!=item->second) throw false;
 
+        // Test lookup of variables read by the bytecode
+        p.SetExpr( _T("sin(b)*2+c^2+3*d") );
+        if (!p.IsVarUsed(&vVarVal[1]) || !p.IsVarUsed(&vVarVal[2]) || !p.IsVarUsed(&vVarVal[3]))
+          throw false;
+        if (p.IsVarUsed(&vVarVal[0]) || p.IsVarUsed(&vVarVal[4]))
+          throw false;
       }
       catch(...)
       {
@@ -1312,6 +1318,33 @@ namespace mu
           int nNum;
           value_type *v = p2.Eval(nNum);
           fVal[4] = v[nNum-1];
+
+          // Test batch evaluation, it must yield the same results as evaluating
+          // the bytecode once for every value of the batch variable
+          value_type vBatchVal[] = { 1, -0.5, 3, 7, 1 };
+          const int nBatch = sizeof(vBatchVal)/sizeof(value_type);
+          value_type vBatchRes[nBatch];
+          SBatchVar batchVar = { &vVarVal[0], vBatchVal };
+          p2.Eval(vBatchRes, nBatch, &batchVar, 1);
+          for (int i=0; i<nBatch; ++i)
+          {
+            vVarVal[0] = vBatchVal[i];
+            value_type fItem = p2.Eval();
+            bool bBothNaN = (fItem!=fItem) && (vBatchRes[i]!=vBatchRes[i]);
+            if (fItem!=vBatchRes[i] && !bBothNaN)
+              throw Parser::exception_type( _T("Batch / bytecode mismatch.") );
+          }
+          vVarVal[0] = 1;
+
+          // Test the closure tree, it must yield the same result as the 
+          // bytecode interpreter
+          mu::Parser p4(p2);
+          p4.EnableCompiler(false);
+          value_type fCompiled = p2.Eval();
+          value_type fInterpreted = p4.Eval();
+          bool bBothNaN = (fCompiled!=fCompiled) && (fInterpreted!=fInterpreted);
+          if (fCompiled!=fInterpreted && !bBothNaN)
+            throw Parser::exception_type( _T("Closure tree / bytecode mismatch.") );
         }
         catch(std::exception &e)
         {